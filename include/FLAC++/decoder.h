@@ -123,6 +123,12 @@ namespace FLAC {
 
 			virtual bool set_ogg_serial_number(long value);                        ///< See FLAC__stream_decoder_set_ogg_serial_number()
 			virtual bool set_md5_checking(bool value);                             ///< See FLAC__stream_decoder_set_md5_checking()
+			virtual bool set_crc_check_only(bool value);                           ///< See FLAC__stream_decoder_set_crc_check_only()
+			virtual bool set_channel_mask(FLAC__uint32 value);                     ///< See FLAC__stream_decoder_set_channel_mask()
+			virtual bool set_waveform_summary(unsigned samples_per_bucket);        ///< See FLAC__stream_decoder_set_waveform_summary()
+			virtual bool set_write_batch_size(unsigned samples);                   ///< See FLAC__stream_decoder_set_write_batch_size()
+			virtual bool set_read_size(unsigned value);                            ///< See FLAC__stream_decoder_set_read_size()
+			virtual bool set_thread_pool(::FLAC__ThreadPool *pool);                ///< See FLAC__stream_decoder_set_thread_pool()
 			virtual bool set_metadata_respond(::FLAC__MetadataType type);          ///< See FLAC__stream_decoder_set_metadata_respond()
 			virtual bool set_metadata_respond_application(const FLAC__byte id[4]); ///< See FLAC__stream_decoder_set_metadata_respond_application()
 			virtual bool set_metadata_respond_all();                               ///< See FLAC__stream_decoder_set_metadata_respond_all()
@@ -133,6 +139,12 @@ namespace FLAC {
 			/* get_state() is not virtual since we want subclasses to be able to return their own state */
 			State get_state() const;                                          ///< See FLAC__stream_decoder_get_state()
 			virtual bool get_md5_checking() const;                            ///< See FLAC__stream_decoder_get_md5_checking()
+			virtual bool get_crc_check_only() const;                          ///< See FLAC__stream_decoder_get_crc_check_only()
+			virtual FLAC__uint32 get_channel_mask() const;                    ///< See FLAC__stream_decoder_get_channel_mask()
+			virtual unsigned get_waveform_summary() const;                    ///< See FLAC__stream_decoder_get_waveform_summary()
+			virtual unsigned get_write_batch_size() const;                    ///< See FLAC__stream_decoder_get_write_batch_size()
+			virtual unsigned get_read_size() const;                           ///< See FLAC__stream_decoder_get_read_size()
+			virtual ::FLAC__ThreadPool *get_thread_pool() const;              ///< See FLAC__stream_decoder_get_thread_pool()
 			virtual FLAC__uint64 get_total_samples() const;                   ///< See FLAC__stream_decoder_get_total_samples()
 			virtual unsigned get_channels() const;                            ///< See FLAC__stream_decoder_get_channels()
 			virtual ::FLAC__ChannelAssignment get_channel_assignment() const; ///< See FLAC__stream_decoder_get_channel_assignment()
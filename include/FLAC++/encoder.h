@@ -34,6 +34,7 @@
 
 #include "export.h"
 
+#include <vector>
 #include "FLAC/stream_encoder.h"
 #include "decoder.h"
 #include "metadata.h"
@@ -132,20 +133,31 @@ namespace FLAC {
 			virtual bool set_sample_rate(unsigned value);                   ///< See FLAC__stream_encoder_set_sample_rate()
 			virtual bool set_compression_level(unsigned value);             ///< See FLAC__stream_encoder_set_compression_level()
 			virtual bool set_blocksize(unsigned value);                     ///< See FLAC__stream_encoder_set_blocksize()
+			virtual bool set_variable_blocksize(bool value);                ///< See FLAC__stream_encoder_set_variable_blocksize()
 			virtual bool set_do_mid_side_stereo(bool value);                ///< See FLAC__stream_encoder_set_do_mid_side_stereo()
 			virtual bool set_loose_mid_side_stereo(bool value);             ///< See FLAC__stream_encoder_set_loose_mid_side_stereo()
 			virtual bool set_apodization(const char *specification);        ///< See FLAC__stream_encoder_set_apodization()
+			virtual bool set_adaptive_apodization(bool value);              ///< See FLAC__stream_encoder_set_adaptive_apodization()
 			virtual bool set_max_lpc_order(unsigned value);                 ///< See FLAC__stream_encoder_set_max_lpc_order()
 			virtual bool set_qlp_coeff_precision(unsigned value);           ///< See FLAC__stream_encoder_set_qlp_coeff_precision()
 			virtual bool set_do_qlp_coeff_prec_search(bool value);          ///< See FLAC__stream_encoder_set_do_qlp_coeff_prec_search()
 			virtual bool set_do_escape_coding(bool value);                  ///< See FLAC__stream_encoder_set_do_escape_coding()
 			virtual bool set_do_exhaustive_model_search(bool value);        ///< See FLAC__stream_encoder_set_do_exhaustive_model_search()
+			virtual bool set_prune_model_search(bool value);                ///< See FLAC__stream_encoder_set_prune_model_search()
+			virtual bool set_quiet_signal_bits(unsigned value);             ///< See FLAC__stream_encoder_set_quiet_signal_bits()
 			virtual bool set_min_residual_partition_order(unsigned value);  ///< See FLAC__stream_encoder_set_min_residual_partition_order()
 			virtual bool set_max_residual_partition_order(unsigned value);  ///< See FLAC__stream_encoder_set_max_residual_partition_order()
 			virtual bool set_rice_parameter_search_dist(unsigned value);    ///< See FLAC__stream_encoder_set_rice_parameter_search_dist()
+			virtual bool set_time_budget(unsigned value);                   ///< See FLAC__stream_encoder_set_time_budget()
 			virtual bool set_total_samples_estimate(FLAC__uint64 value);    ///< See FLAC__stream_encoder_set_total_samples_estimate()
 			virtual bool set_metadata(::FLAC__StreamMetadata **metadata, unsigned num_blocks);    ///< See FLAC__stream_encoder_set_metadata()
 			virtual bool set_metadata(FLAC::Metadata::Prototype **metadata, unsigned num_blocks); ///< See FLAC__stream_encoder_set_metadata()
+			virtual bool set_thread_pool(::FLAC__ThreadPool *pool);         ///< See FLAC__stream_encoder_set_thread_pool()
+			virtual bool set_parallel_subframes(bool value);                ///< See FLAC__stream_encoder_set_parallel_subframes()
+			virtual bool set_parallel_apodizations(bool value);             ///< See FLAC__stream_encoder_set_parallel_apodizations()
+			virtual bool set_frame_buffer_output(bool value);               ///< See FLAC__stream_encoder_set_frame_buffer_callbacks(); \c true sends frames through reserve_callback() and commit_callback()
+			virtual bool set_write_buffer_size(unsigned value);             ///< See FLAC__stream_encoder_set_write_buffer_size()
+			virtual bool set_async_write(bool value);                       ///< See FLAC__stream_encoder_set_async_write()
 
 			/* get_state() is not virtual since we want subclasses to be able to return their own state */
 			State get_state() const;                                   ///< See FLAC__stream_encoder_get_state()
@@ -159,15 +171,26 @@ namespace FLAC {
 			virtual unsigned get_bits_per_sample() const;              ///< See FLAC__stream_encoder_get_bits_per_sample()
 			virtual unsigned get_sample_rate() const;                  ///< See FLAC__stream_encoder_get_sample_rate()
 			virtual unsigned get_blocksize() const;                    ///< See FLAC__stream_encoder_get_blocksize()
+			virtual bool     get_variable_blocksize() const;           ///< See FLAC__stream_encoder_get_variable_blocksize()
+			virtual bool     get_adaptive_apodization() const;         ///< See FLAC__stream_encoder_get_adaptive_apodization()
 			virtual unsigned get_max_lpc_order() const;                ///< See FLAC__stream_encoder_get_max_lpc_order()
 			virtual unsigned get_qlp_coeff_precision() const;          ///< See FLAC__stream_encoder_get_qlp_coeff_precision()
 			virtual bool     get_do_qlp_coeff_prec_search() const;     ///< See FLAC__stream_encoder_get_do_qlp_coeff_prec_search()
 			virtual bool     get_do_escape_coding() const;             ///< See FLAC__stream_encoder_get_do_escape_coding()
 			virtual bool     get_do_exhaustive_model_search() const;   ///< See FLAC__stream_encoder_get_do_exhaustive_model_search()
+			virtual bool     get_prune_model_search() const;           ///< See FLAC__stream_encoder_get_prune_model_search()
+			virtual unsigned get_quiet_signal_bits() const;            ///< See FLAC__stream_encoder_get_quiet_signal_bits()
 			virtual unsigned get_min_residual_partition_order() const; ///< See FLAC__stream_encoder_get_min_residual_partition_order()
 			virtual unsigned get_max_residual_partition_order() const; ///< See FLAC__stream_encoder_get_max_residual_partition_order()
 			virtual unsigned get_rice_parameter_search_dist() const;   ///< See FLAC__stream_encoder_get_rice_parameter_search_dist()
+			virtual unsigned get_time_budget() const;                  ///< See FLAC__stream_encoder_get_time_budget()
 			virtual FLAC__uint64 get_total_samples_estimate() const;   ///< See FLAC__stream_encoder_get_total_samples_estimate()
+			virtual ::FLAC__ThreadPool *get_thread_pool() const;       ///< See FLAC__stream_encoder_get_thread_pool()
+			virtual bool     get_parallel_subframes() const;           ///< See FLAC__stream_encoder_get_parallel_subframes()
+			virtual bool     get_parallel_apodizations() const;        ///< See FLAC__stream_encoder_get_parallel_apodizations()
+			virtual unsigned get_write_buffer_size() const;            ///< See FLAC__stream_encoder_get_write_buffer_size()
+			virtual bool     get_async_write() const;                  ///< See FLAC__stream_encoder_get_async_write()
+			virtual size_t   get_workspace_bytes() const;              ///< See FLAC__stream_encoder_get_workspace_bytes()
 
 			virtual ::FLAC__StreamEncoderInitStatus init();            ///< See FLAC__stream_encoder_init_stream()
 			virtual ::FLAC__StreamEncoderInitStatus init_ogg();        ///< See FLAC__stream_encoder_init_ogg_stream()
@@ -192,6 +215,12 @@ namespace FLAC {
 			/// See FLAC__StreamEncoderMetadataCallback
 			virtual void metadata_callback(const ::FLAC__StreamMetadata *metadata);
 
+			/// See FLAC__StreamEncoderReserveCallback; only called after set_frame_buffer_output(true).  This default returns \c 0.
+			virtual FLAC__byte *reserve_callback(size_t max_bytes);
+
+			/// See FLAC__stream_encoder_set_frame_buffer_callbacks(); only called after set_frame_buffer_output(true).  This default passes the frame on to write_callback().
+			virtual ::FLAC__StreamEncoderWriteStatus commit_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame);
+
 #if (defined _MSC_VER) || (defined __BORLANDC__) || (defined __GNUG__ && (__GNUG__ < 2 || (__GNUG__ == 2 && __GNUC_MINOR__ < 96))) || (defined __SUNPRO_CC)
 			// lame hack: some MSVC/GCC versions can't see a protected encoder_ from nested State::resolved_as_cstring()
 			friend State;
@@ -203,6 +232,8 @@ namespace FLAC {
 			static ::FLAC__StreamEncoderSeekStatus seek_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data);
 			static ::FLAC__StreamEncoderTellStatus tell_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
 			static void metadata_callback_(const ::FLAC__StreamEncoder *encoder, const ::FLAC__StreamMetadata *metadata, void *client_data);
+			static FLAC__byte *reserve_callback_(const ::FLAC__StreamEncoder *encoder, size_t max_bytes, void *client_data);
+			static ::FLAC__StreamEncoderWriteStatus commit_callback_(const ::FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
 		private:
 			// Private and undefined so you can't use them:
 			Stream(const Stream &);
@@ -254,6 +285,79 @@ namespace FLAC {
 			void operator=(const Stream &);
 		};
 
+		/** \ingroup flacpp_encoder
+		 *  \brief
+		 *  This class keeps finished encoders of type \a T (a class
+		 *  derived from FLAC::Encoder::Stream or FLAC::Encoder::File) for
+		 *  reuse.
+		 *
+		 * An encoder keeps its sample and analysis buffers across
+		 * finish() (see FLAC__stream_encoder_finish()), so a program
+		 * that encodes many short streams can save most of the setup
+		 * cost by taking encoders from a pool instead of constructing
+		 * a new one for each stream.  acquire() hands out an idle
+		 * encoder, or a new one if there is none; release() finishes
+		 * it and keeps it for the next acquire(), up to \a max_idle
+		 * idle encoders.  An encoder whose finish() fails is deleted
+		 * instead of kept.  Since finish() resets the encoder settings
+		 * to their defaults, they must be set again after every
+		 * acquire().
+		 *
+		 * The pool does no locking; use one pool per thread, or guard
+		 * it yourself.
+		 */
+		template<class T> class Pool {
+		public:
+			explicit Pool(unsigned max_idle = 8): max_idle_(max_idle) { }
+			~Pool() { clear(); }
+
+			/// Returns an idle encoder, or a new one if the pool is empty, or \c 0 if a new one could not be created.
+			T *acquire()
+			{
+				T *encoder;
+				if(idle_.empty()) {
+					encoder = new T;
+					if(!encoder->is_valid()) {
+						delete encoder;
+						return 0;
+					}
+					return encoder;
+				}
+				encoder = idle_.back();
+				idle_.pop_back();
+				return encoder;
+			}
+
+			/// Finishes \a encoder and keeps it for reuse, or deletes it if finishing failed or the pool is full.
+			void release(T *encoder)
+			{
+				if(0 == encoder)
+					return;
+				if(!encoder->finish() || idle_.size() >= max_idle_)
+					delete encoder;
+				else
+					idle_.push_back(encoder);
+			}
+
+			/// Deletes all idle encoders.
+			void clear()
+			{
+				for(typename std::vector<T*>::iterator i = idle_.begin(); i != idle_.end(); ++i)
+					delete *i;
+				idle_.clear();
+			}
+
+			/// Returns the number of idle encoders.
+			unsigned get_idle_count() const { return (unsigned)idle_.size(); }
+		private:
+			std::vector<T*> idle_;
+			unsigned max_idle_;
+
+			// Private and undefined so you can't use them:
+			Pool(const Pool &);
+			void operator=(const Pool &);
+		};
+
 	}
 }
 
@@ -41,6 +41,7 @@
 #include "ordinals.h"
 #include "stream_decoder.h"
 #include "stream_encoder.h"
+#include "thread_pool.h"
 
 /** \mainpage
  *
@@ -35,6 +35,7 @@
 #include <stdio.h> /* for FILE */
 #include "export.h"
 #include "format.h"
+#include "thread_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -674,6 +675,13 @@ typedef FLAC__bool (*FLAC__StreamDecoderEofCallback)(const FLAC__StreamDecoder *
  *                  Channels will be ordered according to the FLAC
  *                  specification; see the documentation for the
  *                  <A HREF="../format.html#frame_header">frame header</A>.
+ *                  If CRC-check-only mode is on (see
+ *                  FLAC__stream_decoder_set_crc_check_only()),
+ *                  \a buffer will be \c NULL.
+ *                  In waveform summary mode (see
+ *                  FLAC__stream_decoder_set_waveform_summary()) each
+ *                  pointer instead points to the per-bucket summaries
+ *                  of the channel.
  * \param  client_data  The callee's client data set through
  *                      FLAC__stream_decoder_init_*().
  * \retval FLAC__StreamDecoderWriteStatus
@@ -796,6 +804,176 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_ogg_serial_number(FLAC__StreamDecod
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *decoder, FLAC__bool value);
 
+/** Set the "CRC check only" flag.  If \c true, the decoder will parse
+ *  every frame and check the frame header CRC-8 and frame CRC-16 but
+ *  will not restore the signal (no predictor restoration, no channel
+ *  decorrelation) and will not do MD5 signature checking.  This makes
+ *  for a much cheaper integrity test of a stream.
+ *
+ *  The write callback is still called once per frame so that the client
+ *  can track progress, but the \a buffer argument will be \c NULL.  CRC
+ *  errors are reported through the error callback as usual.  The one
+ *  exception is the frame holding the target sample of a seek, which is
+ *  always fully decoded; the frames read while searching for it are
+ *  only checked.
+ *
+ * \default \c false
+ * \param  decoder  A decoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_crc_check_only(FLAC__StreamDecoder *decoder, FLAC__bool value);
+
+/** Set the mask of channels to restore.  Bit \a n of \a value
+ *  corresponds to channel \a n of the stream, in the order given by
+ *  the FLAC specification.  Subframes of channels whose bit is not set
+ *  are still parsed (so the decoder stays in sync and the CRCs are
+ *  checked) but the signal is not restored, which saves time when a
+ *  client only needs some of the channels of a multichannel stream.
+ *
+ *  In the write callback, the \a buffer entries for channels not in
+ *  the mask are still valid pointers but their contents are undefined.
+ *  If a wanted channel is stereo-decorrelated with another (left/side,
+ *  right/side or mid/side coding), both channels of the pair are
+ *  restored as necessary.
+ *
+ *  MD5 signature checking is turned off (until the next
+ *  FLAC__stream_decoder_reset()) when a frame is decoded with any of
+ *  its channels left out of the mask, since the signature covers all
+ *  channels.
+ *
+ * \default \c 0xffffffff (all channels)
+ * \param  decoder  A decoder instance to set.
+ * \param  value    The channel mask (see above).
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_channel_mask(FLAC__StreamDecoder *decoder, FLAC__uint32 value);
+
+/** Set waveform summary mode.  If \a samples_per_bucket is non-zero,
+ *  each decoded frame is reduced to a series of per-bucket summaries
+ *  and these are passed to the write callback instead of the decoded
+ *  signal.  This is meant for clients that only want to draw a
+ *  waveform overview and would otherwise throw the PCM away.
+ *
+ *  Each channel of the frame is cut into buckets of
+ *  \a samples_per_bucket samples (the last bucket in the frame may be
+ *  shorter; buckets never span write callbacks) and for every bucket three
+ *  signed values are written: the minimum sample, the maximum sample,
+ *  and the RMS value rounded down to an integer.  So in the write
+ *  callback, \a buffer[channel] points to
+ *  3 * ceil(\a frame->header.blocksize / \a samples_per_bucket)
+ *  samples, laid out as min, max, RMS for the first bucket, then the
+ *  second bucket, etc.  The \a frame still describes the decoded
+ *  frame, i.e. \a frame->header.blocksize is in samples, not buckets.
+ *
+ *  MD5 signature checking, if enabled, is still done on the decoded
+ *  signal.  Channels excluded by FLAC__stream_decoder_set_channel_mask()
+ *  are not summarized and their contents are undefined.
+ *
+ * \default \c 0
+ * \param  decoder             A decoder instance to set.
+ * \param  samples_per_bucket  The bucket size in samples, or \c 0 to
+ *                             deliver the decoded signal as usual.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_waveform_summary(FLAC__StreamDecoder *decoder, unsigned samples_per_bucket);
+
+/** Set the write batch size.  If \a samples is non-zero, decoded frames
+ *  are held and joined into larger per-channel buffers, and the write
+ *  callback is only called once at least \a samples samples (per
+ *  channel) have been collected.  This cuts down on the per-callback
+ *  overhead and makes for larger writes downstream.
+ *
+ *  In the write callback, the \a frame header describes the whole
+ *  batch: \a frame->header.blocksize is the total number of samples
+ *  and \a frame->header.number.sample_number is the number of the first
+ *  one.  The subframe information is that of the first frame in the
+ *  batch and should not be relied on.  A batch may be larger than
+ *  \a samples by up to one frame, and may exceed
+ *  \c FLAC__MAX_BLOCK_SIZE.
+ *
+ *  Held samples are dropped only when a callback aborts the decoder by
+ *  returning an ABORT status; the client then gets none of them, not
+ *  even from FLAC__stream_decoder_flush() or
+ *  FLAC__stream_decoder_reset().  A batch is passed on early when
+ *  the next frame does not directly follow it or has a different
+ *  format, at the end of the stream, and before
+ *  FLAC__stream_decoder_flush(), FLAC__stream_decoder_reset(),
+ *  FLAC__stream_decoder_seek_absolute() or
+ *  FLAC__stream_decoder_finish() do their work.  Note that this means
+ *  FLAC__stream_decoder_process_single() may return without calling
+ *  the write callback.
+ *
+ * \default \c 0
+ * \param  decoder  A decoder instance to set.
+ * \param  samples  The minimum number of samples per write callback,
+ *                  or \c 0 to call it once per frame.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_write_batch_size(FLAC__StreamDecoder *decoder, unsigned samples);
+
+/** Set the size of the reads the decoder makes when decoding a file
+ *  opened with FLAC__stream_decoder_init*_FILE() or
+ *  FLAC__stream_decoder_init*_file().  If \a value is non-zero and the
+ *  platform has \c pread(), the file is read through the descriptor
+ *  in blocks of \a value bytes (rounded up to a multiple of 4096) that
+ *  start on 4096-byte boundaries, instead of through stdio.  The kernel
+ *  is told the file will be read sequentially, and once a seek has
+ *  narrowed its search down to a small enough part of the file, the
+ *  kernel is hinted to bring that part into the page cache.  The
+ *  search still reads it step by step, but on a cold cache those reads
+ *  wait on the disk less.  Seeks that land inside the current block do
+ *  not touch the file at all.
+ *
+ *  The \c FILE* handed to FLAC__stream_decoder_init*_FILE() is only
+ *  used for its descriptor in this mode, starting from its position at
+ *  the time of the call.  The setting has no effect when decoding from
+ *  \c stdin or with FLAC__stream_decoder_init*_stream().
+ *
+ * \default \c 0
+ * \param  decoder  A decoder instance to set.
+ * \param  value    The read size in bytes, or \c 0 to read the file
+ *                  through stdio.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_read_size(FLAC__StreamDecoder *decoder, unsigned value);
+
+/** Set the worker pool the decoder hands its parallel work to.  With a
+ *  pool set, MD5 checking (see FLAC__stream_decoder_set_md5_checking())
+ *  runs on the pool's threads while the decoder goes on with the next
+ *  frame.  The decoded output is the same with or without a pool.
+ *
+ *  The pool may be shared with any number of other encoder and decoder
+ *  instances, and must not be deleted before FLAC__stream_decoder_finish()
+ *  has been called.  See the \link flac_thread_pool thread pool module
+ *  \endlink for details.
+ *
+ * \default \c NULL
+ * \param  decoder  A decoder instance to set.
+ * \param  pool     The pool to use, or \c NULL to do all the work in the
+ *                  calling thread.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_thread_pool(FLAC__StreamDecoder *decoder, FLAC__ThreadPool *pool);
+
 /** Direct the decoder to pass on all metadata blocks of type \a type.
  *
  * \default By default, only the \c STREAMINFO block is returned via the
@@ -912,6 +1090,66 @@ FLAC_API const char *FLAC__stream_decoder_get_resolved_state_string(const FLAC__
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_get_md5_checking(const FLAC__StreamDecoder *decoder);
 
+/** Get the "CRC check only" flag.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See above.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_crc_check_only(const FLAC__StreamDecoder *decoder);
+
+/** Get the mask of channels to restore.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__uint32
+ *    See FLAC__stream_decoder_set_channel_mask().
+ */
+FLAC_API FLAC__uint32 FLAC__stream_decoder_get_channel_mask(const FLAC__StreamDecoder *decoder);
+
+/** Get the waveform summary bucket size.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_decoder_set_waveform_summary().
+ */
+FLAC_API unsigned FLAC__stream_decoder_get_waveform_summary(const FLAC__StreamDecoder *decoder);
+
+/** Get the write batch size.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_decoder_set_write_batch_size().
+ */
+FLAC_API unsigned FLAC__stream_decoder_get_write_batch_size(const FLAC__StreamDecoder *decoder);
+
+/** Get the read size used for files.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_decoder_set_read_size().
+ */
+FLAC_API unsigned FLAC__stream_decoder_get_read_size(const FLAC__StreamDecoder *decoder);
+
+/** Get the worker pool the decoder uses.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__ThreadPool*
+ *    See FLAC__stream_decoder_set_thread_pool().
+ */
+FLAC_API FLAC__ThreadPool *FLAC__stream_decoder_get_thread_pool(const FLAC__StreamDecoder *decoder);
+
 /** Get the total number of samples in the stream being decoded.
  *  Will only be valid after decoding has started and will contain the
  *  value from the \c STREAMINFO block.  A value of \c 0 means "unknown".
@@ -1371,7 +1609,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder);
 /** Flush the stream input.
  *  The decoder's input buffer will be cleared and the state set to
  *  \c FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC.  This will also turn
- *  off MD5 checking.
+ *  off MD5 checking.  Any samples held for a batched write (see
+ *  FLAC__stream_decoder_set_write_batch_size()) are passed to the write
+ *  callback first.
  *
  * \param  decoder  A decoder instance.
  * \assert
@@ -1379,7 +1619,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder);
  * \retval FLAC__bool
  *    \c true if successful, else \c false if a memory allocation
  *    error occurs (in which case the state will be set to
- *    \c FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR).
+ *    \c FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR) or the write
+ *    callback returned \c FLAC__STREAM_DECODER_WRITE_STATUS_ABORT for
+ *    a held batch.
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder);
 
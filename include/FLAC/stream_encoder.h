@@ -303,7 +303,9 @@ typedef enum {
 	 */
 
 	FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS,
-	/**< A required callback was not supplied. */
+	/**< A required callback was not supplied, or the frame buffer callbacks
+	 * were set for an init function that does not support them.
+	 */
 
 	FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_NUMBER_OF_CHANNELS,
 	/**< The encoder has an invalid setting for number of channels. */
@@ -555,6 +557,30 @@ typedef FLAC__StreamEncoderReadStatus (*FLAC__StreamEncoderReadCallback)(const F
  */
 typedef FLAC__StreamEncoderWriteStatus (*FLAC__StreamEncoderWriteCallback)(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
 
+/** Signature for the reserve callback.
+ *
+ *  A function pointer matching this signature may be passed to
+ *  FLAC__stream_encoder_set_frame_buffer_callbacks().  The supplied
+ *  function will be called by the encoder before it starts encoding each
+ *  audio frame, and must return a writable region of at least
+ *  \a max_bytes bytes, aligned to 8 bytes, which the encoder will encode
+ *  the frame into.  The region must stay valid until it is passed to the
+ *  commit callback.
+ *
+ * \note In general, FLAC__StreamEncoder functions which change the
+ * state should not be called on the \a encoder while in the callback.
+ *
+ * \param  encoder    The encoder instance calling the callback.
+ * \param  max_bytes  The most bytes the frame can take up.  This is the
+ *                    same for every frame of a stream.
+ * \param  client_data  The callee's client data set through
+ *                      FLAC__stream_encoder_init_stream().
+ * \retval FLAC__byte*
+ *    The region to encode into, or \c NULL to stop encoding with a
+ *    \c FLAC__STREAM_ENCODER_CLIENT_ERROR.
+ */
+typedef FLAC__byte *(*FLAC__StreamEncoderReserveCallback)(const FLAC__StreamEncoder *encoder, size_t max_bytes, void *client_data);
+
 /** Signature for the seek callback.
  *
  *  A function pointer matching this signature may be passed to
@@ -878,6 +904,33 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_compression_level(FLAC__StreamEncod
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_blocksize(FLAC__StreamEncoder *encoder, unsigned value);
 
+/** Set to \c true to let the encoder split blocks into shorter frames.
+ *  The blocksize then becomes the largest frame size, and each block
+ *  may be encoded as 2, 4 or 8 shorter frames, none shorter than 256
+ *  samples.  The encoder picks the split of each block with a quick
+ *  estimate of the bits needed by the fixed predictors, plus the
+ *  overhead of each extra frame, so that transients get short frames
+ *  and steady passages keep long ones.  This is cheap compared to a
+ *  larger maximum LPC order or more apodization functions.
+ *
+ *  The stream is written with variable-blocksize frames, which carry
+ *  their first sample number instead of a frame number.  The STREAMINFO
+ *  block first gets the shortest and longest frame sizes that can be
+ *  used; FLAC__stream_encoder_finish() puts in the ones actually used
+ *  (leaving out the last frame, as usual), and when the output is
+ *  seekable, rewrites them with the rest of the STREAMINFO block.  The
+ *  final, partial block is never split.
+ *
+ * \default \c false
+ * \param  encoder  An encoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_variable_blocksize(FLAC__StreamEncoder *encoder, FLAC__bool value);
+
 /** Set to \c true to enable mid-side encoding on stereo input.  The
  *  number of channels must be 2 for this to have any effect.  Set to
  *  \c false to use only independent channel coding.
@@ -953,6 +1006,26 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_loose_mid_side_stereo(FLAC__StreamE
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_apodization(FLAC__StreamEncoder *encoder, const char *specification);
 
+/** Set to \c true to try only the likely apodization functions on most
+ *  frames.  When several are given with
+ *  FLAC__stream_encoder_set_apodization(), one or two of them usually
+ *  win nearly every subframe of a given stream.  With this set, every
+ *  function is still tried on one frame in 16, and the other frames only
+ *  try the two that have lately won the most subframes on those frames.
+ *  This gives most of the compression of many functions for little more
+ *  than the cost of two.  The functions chosen only depend on the audio,
+ *  so the output is the same however the search is threaded.
+ *
+ * \default \c false
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_adaptive_apodization(FLAC__StreamEncoder *encoder, FLAC__bool value);
+
 /** Set the maximum LPC order, or \c 0 to use only the fixed predictors.
  *
  * \default \c 0
@@ -1023,6 +1096,47 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_do_escape_coding(FLAC__StreamEncode
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_do_exhaustive_model_search(FLAC__StreamEncoder *encoder, FLAC__bool value);
 
+/** Set to \c true to skip LPC candidates that provably cannot beat the
+ *  best subframe found so far.  Each candidate's header and coefficients
+ *  are a known size, and the residual is computed a partition at a time
+ *  against a lower bound on its Rice-coded size, so a losing candidate
+ *  is usually dropped before its residual is finished.  This mostly
+ *  pays off with FLAC__stream_encoder_set_do_exhaustive_model_search()
+ *  and FLAC__stream_encoder_set_do_qlp_coeff_prec_search().  Only
+ *  candidates that would have lost are skipped, so the encoded output
+ *  is the same as without pruning.  With
+ *  FLAC__stream_encoder_set_do_escape_coding() the residual bound does
+ *  not hold and only the header check is done.
+ *
+ * \default \c false
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_prune_model_search(FLAC__StreamEncoder *encoder, FLAC__bool value);
+
+/** Set the size, in bits, below which a subframe's signal counts as
+ *  quiet.  A subframe whose samples all fit in \a value bits (as signed
+ *  numbers, so \c 2 allows -2 to 1) skips the LPC search and is coded
+ *  with the fixed predictors.  Such a signal, like the dithered silence
+ *  between programmes in a radio capture, is mostly rounding noise,
+ *  which LPC rarely predicts better than the fixed predictors do, so
+ *  the output is only slightly larger while those blocks cost a small
+ *  part of a full search.  Constant subframes are found either way.
+ *
+ * \default \c 0, which turns this off
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_quiet_signal_bits(FLAC__StreamEncoder *encoder, unsigned value);
+
 /** Set the minimum partition order to search when coding the residual.
  *  This is used in tandem with
  *  FLAC__stream_encoder_set_max_residual_partition_order().
@@ -1081,6 +1195,36 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_max_residual_partition_order(FLAC__
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_rice_parameter_search_dist(FLAC__StreamEncoder *encoder, unsigned value);
 
+/** Set a limit on the time spent encoding, as a percentage of the
+ *  duration of the audio; e.g. \c 50 means a second of audio should take
+ *  no more than half a second to encode.  This is meant for live sources
+ *  that the encoder must keep up with.  The encoder times each frame
+ *  and, while it is over the budget, cuts back the search one step at a
+ *  time, in this order:
+ *  - no exhaustive model search or QLP coefficient precision search
+ *  - only the first apodization function (or, with
+ *    FLAC__stream_encoder_set_adaptive_apodization(), the best one)
+ *  - loose mid/side stereo instead of full mid/side stereo
+ *  - a maximum residual partition order of at most 3
+ *  - a maximum LPC order of at most 8, then 4, then only fixed predictors
+ *
+ *  When there is room in the budget again, the search is slowly restored
+ *  to the settings given.  The other settings are never exceeded, so
+ *  choose them for the best compression wanted.  The time measured is
+ *  elapsed time on a monotonic clock, from when a frame is ready until
+ *  it is encoded; the time spent in the write callback does not count.
+ *  Output depends on the timing, and so will differ from run to run.
+ *
+ * \default \c 0, meaning no limit
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_time_budget(FLAC__StreamEncoder *encoder, unsigned value);
+
 /** Set an estimate of the total samples that will be encoded.
  *  This is merely an estimate and may be set to \c 0 if unknown.
  *  This value will be written to the STREAMINFO block before encoding,
@@ -1180,6 +1324,154 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_total_samples_estimate(FLAC__Stream
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_metadata(FLAC__StreamEncoder *encoder, FLAC__StreamMetadata **metadata, unsigned num_blocks);
 
+/** Set the worker pool the encoder hands its parallel work to.  With a
+ *  pool set, the MD5 signature (see FLAC__stream_encoder_set_do_md5())
+ *  of each frame is computed on the pool's threads while the frame is
+ *  being encoded.  The encoded output is the same with or without a
+ *  pool.
+ *
+ *  The pool may be shared with any number of other encoder and decoder
+ *  instances, and must not be deleted before FLAC__stream_encoder_finish()
+ *  has been called.  See the \link flac_thread_pool thread pool module
+ *  \endlink for details.
+ *
+ * \default \c NULL
+ * \param  encoder  An encoder instance to set.
+ * \param  pool     The pool to use, or \c NULL to do all the work in the
+ *                  calling thread.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_thread_pool(FLAC__StreamEncoder *encoder, FLAC__ThreadPool *pool);
+
+/** Set to \c true to search for the best subframe of each channel of a
+ *  frame in parallel.  When mid-side stereo is being tried, the mid and
+ *  side channels are searched alongside the independent ones.  This
+ *  only has an effect if a pool is also set with
+ *  FLAC__stream_encoder_set_thread_pool(); the encoded output is the
+ *  same either way.  Each extra search needs its own scratch buffers, so
+ *  the encoder uses somewhat more memory.
+ *
+ * \default \c false
+ * \param  encoder  An encoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_parallel_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value);
+
+/** Set to \c true to split the LPC search of each subframe among the
+ *  threads of the pool set with FLAC__stream_encoder_set_thread_pool().
+ *  The apodization functions (see FLAC__stream_encoder_set_apodization())
+ *  are shared out between the threads, or, if there are fewer of them
+ *  than threads and FLAC__stream_encoder_set_do_exhaustive_model_search()
+ *  is on, the LPC orders are.  This pays off mostly with several
+ *  apodization functions or an exhaustive search; it can be combined
+ *  with FLAC__stream_encoder_set_parallel_subframes().  The encoded
+ *  output is the same either way, but each thread needs its own scratch
+ *  buffers.
+ *
+ * \default \c false
+ * \param  encoder  An encoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_parallel_apodizations(FLAC__StreamEncoder *encoder, FLAC__bool value);
+
+/** Set callbacks to have audio frames encoded straight into buffers owned
+ *  by the client, instead of being handed to the write callback from the
+ *  encoder's own buffer.  Before each frame the encoder calls
+ *  \a reserve_callback for a region to encode into, and when the frame is
+ *  done it calls \a commit_callback with that same region and the number
+ *  of bytes actually used, where it would otherwise have called the write
+ *  callback.  This saves a copy for clients that queue the frames in
+ *  their own buffers anyway.  Metadata, and the STREAMINFO and SEEKTABLE
+ *  updates in FLAC__stream_encoder_finish(), still go through the write
+ *  callback.
+ *
+ *  This only works with FLAC__stream_encoder_init_stream();
+ *  the other init functions return
+ *  \c FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS if the callbacks
+ *  are set.
+ *
+ * \default \c NULL, \c NULL
+ * \param  encoder          An encoder instance to set.
+ * \param  reserve_callback  See FLAC__StreamEncoderReserveCallback, or
+ *                          \c NULL to use the write callback for frames.
+ * \param  commit_callback   See FLAC__StreamEncoderWriteCallback; the
+ *                          \a buffer argument is the region returned by
+ *                          \a reserve_callback.  Must be \c NULL if and
+ *                          only if \a reserve_callback is.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized or only one of the
+ *    callbacks is \c NULL, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_frame_buffer_callbacks(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderReserveCallback reserve_callback, FLAC__StreamEncoderWriteCallback commit_callback);
+
+/** Set the size in bytes of a buffer to gather the output in when
+ *  encoding with FLAC__stream_encoder_init*_FILE() or
+ *  FLAC__stream_encoder_init*_file().  Without one, each frame or Ogg
+ *  page is passed to \c fwrite() on its own and, with the usual stdio
+ *  buffer of a few kilobytes, goes to the file in small writes.  With a
+ *  buffer of a megabyte or more the encoded frames are written out in
+ *  far fewer, larger writes, which helps a lot on network file systems.
+ *  The buffer is flushed before the encoder seeks back to update the
+ *  STREAMINFO and SEEKTABLE blocks in FLAC__stream_encoder_finish(), and
+ *  when the output is closed.  The progress callback is still called for
+ *  each frame.  The setting has no effect with
+ *  FLAC__stream_encoder_init*_stream().
+ *
+ * \default \c 0
+ * \param  encoder  An encoder instance to set.
+ * \param  value    The buffer size in bytes, or \c 0 to write each
+ *                  frame as it is done.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_write_buffer_size(FLAC__StreamEncoder *encoder, unsigned value);
+
+/** Set to \c true to have the encoded frames written to the file
+ *  asynchronously when encoding with FLAC__stream_encoder_init*_FILE()
+ *  or FLAC__stream_encoder_init*_file().  The frames are gathered in a
+ *  small fixed set of buffers registered with the kernel, and a full
+ *  buffer is submitted through io_uring while the encoder goes on with
+ *  the next frames; the encoder only waits when all the buffers are
+ *  still being written.  This keeps encoder threads from stalling in
+ *  \c write() when many of them share a slow disk.
+ *
+ *  The buffers are the size set with
+ *  FLAC__stream_encoder_set_write_buffer_size(), or one megabyte if
+ *  that is \c 0.  All writes are waited for before the STREAMINFO and
+ *  SEEKTABLE blocks are updated in FLAC__stream_encoder_finish(); an
+ *  error in any of them is reported there as
+ *  #FLAC__STREAM_ENCODER_IO_ERROR, or by the write that found it.
+ *
+ *  This is only available on Linux, and only for regular files.  When
+ *  io_uring cannot be used (an older kernel or C library headers,
+ *  another OS, output to \c stdout), the setting is ignored and the
+ *  output is written as usual.
+ *
+ * \default \c false
+ * \param  encoder  An encoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_async_write(FLAC__StreamEncoder *encoder, FLAC__bool value);
+
 /** Get the current encoder state.
  *
  * \param  encoder  An encoder instance to query.
@@ -1294,6 +1586,16 @@ FLAC_API unsigned FLAC__stream_encoder_get_sample_rate(const FLAC__StreamEncoder
  */
 FLAC_API unsigned FLAC__stream_encoder_get_blocksize(const FLAC__StreamEncoder *encoder);
 
+/** Get the variable blocksize flag.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_encoder_set_variable_blocksize().
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_variable_blocksize(const FLAC__StreamEncoder *encoder);
+
 /** Get the "mid/side stereo coding" flag.
  *
  * \param  encoder  An encoder instance to query.
@@ -1314,6 +1616,16 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_do_mid_side_stereo(const FLAC__Stre
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_get_loose_mid_side_stereo(const FLAC__StreamEncoder *encoder);
 
+/** Get the adaptive apodization flag.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_encoder_set_adaptive_apodization().
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_adaptive_apodization(const FLAC__StreamEncoder *encoder);
+
 /** Get the maximum LPC order setting.
  *
  * \param  encoder  An encoder instance to query.
@@ -1364,6 +1676,26 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_do_escape_coding(const FLAC__Stream
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_get_do_exhaustive_model_search(const FLAC__StreamEncoder *encoder);
 
+/** Get the model search pruning flag.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_encoder_set_prune_model_search().
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_prune_model_search(const FLAC__StreamEncoder *encoder);
+
+/** Get the quiet signal size.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_encoder_set_quiet_signal_bits().
+ */
+FLAC_API unsigned FLAC__stream_encoder_get_quiet_signal_bits(const FLAC__StreamEncoder *encoder);
+
 /** Get the minimum residual partition order setting.
  *
  * \param  encoder  An encoder instance to query.
@@ -1394,6 +1726,16 @@ FLAC_API unsigned FLAC__stream_encoder_get_max_residual_partition_order(const FL
  */
 FLAC_API unsigned FLAC__stream_encoder_get_rice_parameter_search_dist(const FLAC__StreamEncoder *encoder);
 
+/** Get the time budget.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_encoder_set_time_budget().
+ */
+FLAC_API unsigned FLAC__stream_encoder_get_time_budget(const FLAC__StreamEncoder *encoder);
+
 /** Get the previously set estimate of the total samples to be encoded.
  *  The encoder merely mimics back the value given to
  *  FLAC__stream_encoder_set_total_samples_estimate() since it has no
@@ -1407,6 +1749,71 @@ FLAC_API unsigned FLAC__stream_encoder_get_rice_parameter_search_dist(const FLAC
  */
 FLAC_API FLAC__uint64 FLAC__stream_encoder_get_total_samples_estimate(const FLAC__StreamEncoder *encoder);
 
+/** Get the worker pool the encoder uses.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__ThreadPool*
+ *    See FLAC__stream_encoder_set_thread_pool().
+ */
+FLAC_API FLAC__ThreadPool *FLAC__stream_encoder_get_thread_pool(const FLAC__StreamEncoder *encoder);
+
+/** Get the "parallel subframes" flag.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_encoder_set_parallel_subframes().
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_parallel_subframes(const FLAC__StreamEncoder *encoder);
+
+/** Get the "parallel apodizations" flag.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_encoder_set_parallel_apodizations().
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_parallel_apodizations(const FLAC__StreamEncoder *encoder);
+
+/** Get the size of the output file buffer.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_encoder_set_write_buffer_size().
+ */
+FLAC_API unsigned FLAC__stream_encoder_get_write_buffer_size(const FLAC__StreamEncoder *encoder);
+
+/** Get the "async write" flag.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_encoder_set_async_write().
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_async_write(const FLAC__StreamEncoder *encoder);
+
+/** Get the size of the workspace holding the encoder's signal, residual
+ *  and search buffers.  It is allocated in one piece by the init
+ *  functions, sized by the blocksize, the number of channels, the
+ *  maximum LPC order and the number of parallel searches, and is kept
+ *  across FLAC__stream_encoder_finish() for the next stream.
+ *
+ * \param  encoder  An encoder instance to query.
+ * ssert
+ *    \code encoder != NULL \endcode
+ * etval size_t
+ *    The size of the workspace in bytes, or \c 0 if none has been
+ *    allocated yet.
+ */
+FLAC_API size_t FLAC__stream_encoder_get_workspace_bytes(const FLAC__StreamEncoder *encoder);
+
 /** Initialize the encoder instance to encode native FLAC streams.
  *
  *  This flavor of initialization sets up the encoder to encode to a
@@ -1688,6 +2095,12 @@ FLAC_API FLAC__StreamEncoderInitStatus FLAC__stream_encoder_init_ogg_file(FLAC__
  *  but it is good practice to match every FLAC__stream_encoder_init_*()
  *  with a FLAC__stream_encoder_finish().
  *
+ *  The sample and analysis buffers are not freed here but kept for the
+ *  next FLAC__stream_encoder_init_*() on the same instance, which reuses
+ *  them when they are big enough for the new settings.  So encoding many
+ *  short streams with one instance costs much less than creating a new
+ *  encoder for each.  FLAC__stream_encoder_delete() frees them.
+ *
  * \param  encoder  An uninitialized encoder instance.
  * \assert
  *    \code encoder != NULL \endcode
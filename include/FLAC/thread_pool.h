@@ -0,0 +1,146 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FLAC__THREAD_POOL_H
+#define FLAC__THREAD_POOL_H
+
+#include "export.h"
+#include "ordinals.h"
+
+/** \file include/FLAC/thread_pool.h
+ *
+ *  \brief
+ *  This module contains the functions for creating a pool of worker
+ *  threads that can be shared by many encoder and decoder instances.
+ *
+ *  See the detailed documentation in the
+ *  \link flac_thread_pool thread pool \endlink module.
+ */
+
+/** \defgroup flac_thread_pool FLAC/thread_pool.h: shared worker pool interface
+ *  \ingroup flac
+ *
+ *  \brief
+ *  This module contains the functions for creating a pool of worker
+ *  threads that can be shared by many encoder and decoder instances.
+ *
+ *  An application handling many streams at once would quickly use up
+ *  the available cores if every encoder and decoder started its own
+ *  threads.  Instead, it can create a single pool with
+ *  FLAC__thread_pool_new() and attach it to each instance with
+ *  FLAC__stream_encoder_set_thread_pool() or
+ *  FLAC__stream_decoder_set_thread_pool() before initializing it.  The
+ *  instances then hand their parallel work (e.g. MD5 computation in
+ *  the decoder) to the pool's threads.
+ *
+ *  Each initialized instance gets its own queue in the pool, holding
+ *  at most the number of tasks given to FLAC__thread_pool_new().  When
+ *  an instance's queue is full the instance does the work itself, so a
+ *  busy instance cannot flood the pool.  Each queue has its own lock,
+ *  so instances handing out work do not hold each other up however
+ *  many share the pool.  Idle threads take work from the instances in
+ *  turn, and an instance waiting for its own tasks to finish runs them
+ *  itself rather than waiting for a free thread.
+ *
+ *  The pool must not be deleted while any instance using it is still
+ *  initialized.  Attaching a pool never changes the encoded or decoded
+ *  result.
+ *
+ *  If libFLAC was built without thread support the pool has no threads
+ *  and all work is done by the instances themselves.
+ *
+ * \{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct FLAC__ThreadPool;
+/** The opaque structure definition for the shared worker pool type.
+ *  See the \link flac_thread_pool thread pool module \endlink for a
+ *  detailed description.
+ */
+typedef struct FLAC__ThreadPool FLAC__ThreadPool;
+
+/** Create a new worker pool instance and start its threads.
+ *
+ * \param  threads      The number of worker threads, or \c 0 to start
+ *                      one per online processor.
+ * \param  queue_depth  The maximum number of tasks that each attached
+ *                      instance may have waiting in the pool, or \c 0
+ *                      for twice the number of threads.
+ * \retval FLAC__ThreadPool*
+ *    \c NULL if there was an error allocating memory or starting the
+ *    threads, else the new instance.
+ */
+FLAC_API FLAC__ThreadPool *FLAC__thread_pool_new(unsigned threads, unsigned queue_depth);
+
+/** Stop the worker threads and free a pool instance.  Deletes the
+ *  object pointed to by \a pool.  No encoder or decoder instance may
+ *  still be using the pool.
+ *
+ * \param  pool  A pointer to an existing pool.
+ * \assert
+ *    \code pool != NULL \endcode
+ */
+FLAC_API void FLAC__thread_pool_delete(FLAC__ThreadPool *pool);
+
+/** Get the number of worker threads in the pool.
+ *
+ * \param  pool  A pool instance to query.
+ * \assert
+ *    \code pool != NULL \endcode
+ * \retval unsigned
+ *    The number of worker threads; \c 0 if libFLAC was built without
+ *    thread support.
+ */
+FLAC_API unsigned FLAC__thread_pool_get_threads(const FLAC__ThreadPool *pool);
+
+/** Get the per-instance queue depth of the pool.
+ *
+ * \param  pool  A pool instance to query.
+ * \assert
+ *    \code pool != NULL \endcode
+ * \retval unsigned
+ *    The maximum number of tasks each attached instance may have
+ *    waiting in the pool.
+ */
+FLAC_API unsigned FLAC__thread_pool_get_queue_depth(const FLAC__ThreadPool *pool);
+
+/* \} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
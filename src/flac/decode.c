@@ -62,6 +62,7 @@ typedef struct {
 	} replaygain;
 
 	FLAC__bool test_only;
+	FLAC__bool crc_check_only; /* only check frame CRCs, no signal reconstruction or MD5 */
 	FLAC__bool analysis_mode;
 	analysis_options aopts;
 	utils__SkipUntilSpecification *skip_specification;
@@ -109,7 +110,7 @@ static FLAC__bool is_big_endian_host_;
 /*
  * local routines
  */
-static FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename);
+static FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, FLAC__bool crc_check_only, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename);
 static void DecoderSession_destroy(DecoderSession *d, FLAC__bool error_occurred);
 static FLAC__bool DecoderSession_init_decoder(DecoderSession *d, const char *infilename);
 static FLAC__bool DecoderSession_process(DecoderSession *d);
@@ -171,6 +172,7 @@ int flac__decode_file(const char *infilename, const char *outfilename, FLAC__boo
 			options.treat_warnings_as_errors,
 			options.continue_through_decode_errors,
 			options.channel_map_none,
+			options.crc_check_only,
 			options.replaygain_synthesis_spec,
 			analysis_mode,
 			aopts,
@@ -193,7 +195,7 @@ int flac__decode_file(const char *infilename, const char *outfilename, FLAC__boo
 	return DecoderSession_finish_ok(&decoder_session);
 }
 
-FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename)
+FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, FLAC__bool crc_check_only, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename)
 {
 #if FLAC__HAS_OGG
 	d->is_ogg = is_ogg;
@@ -214,6 +216,7 @@ FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__
 	d->replaygain.scale = 0.0;
 	/* d->replaygain.dither_context gets initialized later once we know the sample resolution */
 	d->test_only = (0 == outfilename);
+	d->crc_check_only = crc_check_only;
 	d->analysis_mode = analysis_mode;
 	d->aopts = aopts;
 	d->skip_specification = skip_specification;
@@ -250,6 +253,7 @@ FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__
 	d->foreign_metadata = foreign_metadata;
 
 	FLAC__ASSERT(!(d->test_only && d->analysis_mode));
+	FLAC__ASSERT(!d->crc_check_only || d->test_only);
 
 	if(!d->test_only) {
 		if(0 == strcmp(outfilename, "-")) {
@@ -302,6 +306,7 @@ FLAC__bool DecoderSession_init_decoder(DecoderSession *decoder_session, const ch
 	}
 
 	FLAC__stream_decoder_set_md5_checking(decoder_session->decoder, true);
+	FLAC__stream_decoder_set_crc_check_only(decoder_session->decoder, decoder_session->crc_check_only);
 	if (0 != decoder_session->cue_specification)
 		FLAC__stream_decoder_set_metadata_respond(decoder_session->decoder, FLAC__METADATA_TYPE_CUESHEET);
 	if (decoder_session->replaygain.spec.apply)
@@ -449,7 +454,10 @@ int DecoderSession_finish_ok(DecoderSession *d)
 		ok = d->continue_through_decode_errors;
 	}
 	else {
-		if(!d->got_stream_info) {
+		if(d->crc_check_only) {
+			/* no MD5 checking in this mode, so nothing to warn about */
+		}
+		else if(!d->got_stream_info) {
 			flac__utils_printf(stderr, 1, "\r%s: WARNING, cannot check MD5 signature since there was no STREAMINFO\n", d->inbasefilename);
 			ok = !d->treat_warnings_as_errors;
 		}
@@ -51,6 +51,7 @@ typedef struct {
 	FLAC__bool has_cue_specification;
 	utils__CueSpecification cue_specification;
 	FLAC__bool channel_map_none; /* --channel-map=none specified, eventually will expand to take actual channel map */
+	FLAC__bool crc_check_only; /* --quick-test specified; only meaningful in test mode */
 
 	FileFormat format;
 	union {
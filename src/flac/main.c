@@ -104,6 +104,7 @@ static struct share__option long_options_[] = {
 	{ "decode"                , share__no_argument, 0, 'd' },
 	{ "analyze"               , share__no_argument, 0, 'a' },
 	{ "test"                  , share__no_argument, 0, 't' },
+	{ "quick-test"            , share__no_argument, 0, 0 },
 	{ "stdout"                , share__no_argument, 0, 'c' },
 	{ "silent"                , share__no_argument, 0, 's' },
 	{ "totally-silent"        , share__no_argument, 0, 0 },
@@ -237,6 +238,7 @@ static struct {
 	replaygain_synthesis_spec_t replaygain_synthesis_spec;
 	FLAC__bool lax;
 	FLAC__bool test_only;
+	FLAC__bool quick_test; /* true iff --quick-test was used; implies test_only */
 	FLAC__bool analyze;
 	FLAC__bool use_ogg;
 	FLAC__bool has_serial_number; /* true iff --serial-number was used */
@@ -543,6 +545,7 @@ FLAC__bool init_options(void)
 	option_values.replaygain_synthesis_spec.preamp = 0.0;
 	option_values.lax = false;
 	option_values.test_only = false;
+	option_values.quick_test = false;
 	option_values.analyze = false;
 	option_values.use_ogg = false;
 	option_values.has_serial_number = false;
@@ -649,6 +652,11 @@ int parse_option(int short_option, const char *long_option, const char *option_a
 		if(0 == strcmp(long_option, "totally-silent")) {
 			flac__utils_verbosity_ = 0;
 		}
+		else if(0 == strcmp(long_option, "quick-test")) {
+			option_values.mode_decode = true;
+			option_values.test_only = true;
+			option_values.quick_test = true;
+		}
 		else if(0 == strcmp(long_option, "delete-input-file")) {
 			option_values.delete_input = true;
 		}
@@ -1202,6 +1210,7 @@ void show_help(void)
 	printf("  -H, --explain                Show detailed explanation of usage and options\n");
 	printf("  -d, --decode                 Decode (the default behavior is to encode)\n");
 	printf("  -t, --test                   Same as -d except no decoded file is written\n");
+	printf("      --quick-test             Same as -t but only checks CRCs, not MD5\n");
 	printf("  -a, --analyze                Same as -d except an analysis file is written\n");
 	printf("  -c, --stdout                 Write output to stdout\n");
 	printf("  -s, --silent                 Do not write runtime encode/decode statistics\n");
@@ -1327,6 +1336,10 @@ void show_explain(void)
 	printf("  -H, --explain                Show this screen\n");
 	printf("  -d, --decode                 Decode (the default behavior is to encode)\n");
 	printf("  -t, --test                   Same as -d except no decoded file is written\n");
+	printf("      --quick-test             Same as -t except the audio is not actually\n");
+	printf("                               reconstructed; only the frame CRCs are checked,\n");
+	printf("                               not the MD5 signature.  Much faster than -t but\n");
+	printf("                               will not catch every kind of error.\n");
 	printf("  -a, --analyze                Same as -d except an analysis file is written\n");
 	printf("  -c, --stdout                 Write output to stdout\n");
 	printf("  -s, --silent                 Do not write runtime encode/decode statistics\n");
@@ -2084,6 +2097,7 @@ int decode_file(const char *infilename)
 	decode_options.serial_number = option_values.serial_number;
 #endif
 	decode_options.channel_map_none = option_values.channel_map_none;
+	decode_options.crc_check_only = option_values.quick_test;
 	decode_options.format = output_format;
 
 	if(output_format == FORMAT_RAW) {
@@ -75,6 +75,42 @@ namespace FLAC {
 			return (bool)::FLAC__stream_decoder_set_md5_checking(decoder_, value);
 		}
 
+		bool Stream::set_crc_check_only(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_set_crc_check_only(decoder_, value);
+		}
+
+		bool Stream::set_channel_mask(FLAC__uint32 value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_set_channel_mask(decoder_, value);
+		}
+
+		bool Stream::set_waveform_summary(unsigned samples_per_bucket)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_set_waveform_summary(decoder_, samples_per_bucket);
+		}
+
+		bool Stream::set_write_batch_size(unsigned samples)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_set_write_batch_size(decoder_, samples);
+		}
+
+		bool Stream::set_read_size(unsigned value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_set_read_size(decoder_, value);
+		}
+
+		bool Stream::set_thread_pool(::FLAC__ThreadPool *pool)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_set_thread_pool(decoder_, pool);
+		}
+
 		bool Stream::set_metadata_respond(::FLAC__MetadataType type)
 		{
 			FLAC__ASSERT(is_valid());
@@ -123,6 +159,42 @@ namespace FLAC {
 			return (bool)::FLAC__stream_decoder_get_md5_checking(decoder_);
 		}
 
+		bool Stream::get_crc_check_only() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_decoder_get_crc_check_only(decoder_);
+		}
+
+		FLAC__uint32 Stream::get_channel_mask() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_channel_mask(decoder_);
+		}
+
+		unsigned Stream::get_waveform_summary() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_waveform_summary(decoder_);
+		}
+
+		unsigned Stream::get_write_batch_size() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_write_batch_size(decoder_);
+		}
+
+		unsigned Stream::get_read_size() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_read_size(decoder_);
+		}
+
+		::FLAC__ThreadPool *Stream::get_thread_pool() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_thread_pool(decoder_);
+		}
+
 		FLAC__uint64 Stream::get_total_samples() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -112,6 +112,12 @@ namespace FLAC {
 			return (bool)::FLAC__stream_encoder_set_blocksize(encoder_, value);
 		}
 
+		bool Stream::set_variable_blocksize(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_variable_blocksize(encoder_, value);
+		}
+
 		bool Stream::set_do_mid_side_stereo(bool value)
 		{
 			FLAC__ASSERT(is_valid());
@@ -130,6 +136,12 @@ namespace FLAC {
 			return (bool)::FLAC__stream_encoder_set_apodization(encoder_, specification);
 		}
 
+		bool Stream::set_adaptive_apodization(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_adaptive_apodization(encoder_, value);
+		}
+
 		bool Stream::set_max_lpc_order(unsigned value)
 		{
 			FLAC__ASSERT(is_valid());
@@ -160,6 +172,18 @@ namespace FLAC {
 			return (bool)::FLAC__stream_encoder_set_do_exhaustive_model_search(encoder_, value);
 		}
 
+		bool Stream::set_prune_model_search(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_prune_model_search(encoder_, value);
+		}
+
+		bool Stream::set_quiet_signal_bits(unsigned value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_quiet_signal_bits(encoder_, value);
+		}
+
 		bool Stream::set_min_residual_partition_order(unsigned value)
 		{
 			FLAC__ASSERT(is_valid());
@@ -178,6 +202,12 @@ namespace FLAC {
 			return (bool)::FLAC__stream_encoder_set_rice_parameter_search_dist(encoder_, value);
 		}
 
+		bool Stream::set_time_budget(unsigned value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_time_budget(encoder_, value);
+		}
+
 		bool Stream::set_total_samples_estimate(FLAC__uint64 value)
 		{
 			FLAC__ASSERT(is_valid());
@@ -215,6 +245,44 @@ namespace FLAC {
 #endif
 		}
 
+		bool Stream::set_thread_pool(::FLAC__ThreadPool *pool)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_thread_pool(encoder_, pool);
+		}
+
+		bool Stream::set_parallel_subframes(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_parallel_subframes(encoder_, value);
+		}
+
+		bool Stream::set_parallel_apodizations(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_parallel_apodizations(encoder_, value);
+		}
+
+		bool Stream::set_frame_buffer_output(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return value?
+				(bool)::FLAC__stream_encoder_set_frame_buffer_callbacks(encoder_, reserve_callback_, commit_callback_) :
+				(bool)::FLAC__stream_encoder_set_frame_buffer_callbacks(encoder_, 0, 0);
+		}
+
+		bool Stream::set_write_buffer_size(unsigned value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_write_buffer_size(encoder_, value);
+		}
+
+		bool Stream::set_async_write(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_set_async_write(encoder_, value);
+		}
+
 		Stream::State Stream::get_state() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -281,6 +349,18 @@ namespace FLAC {
 			return ::FLAC__stream_encoder_get_blocksize(encoder_);
 		}
 
+		bool Stream::get_variable_blocksize() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_get_variable_blocksize(encoder_);
+		}
+
+		bool Stream::get_adaptive_apodization() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_get_adaptive_apodization(encoder_);
+		}
+
 		unsigned Stream::get_max_lpc_order() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -311,6 +391,18 @@ namespace FLAC {
 			return (bool)::FLAC__stream_encoder_get_do_exhaustive_model_search(encoder_);
 		}
 
+		bool Stream::get_prune_model_search() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_get_prune_model_search(encoder_);
+		}
+
+		unsigned Stream::get_quiet_signal_bits() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_quiet_signal_bits(encoder_);
+		}
+
 		unsigned Stream::get_min_residual_partition_order() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -329,12 +421,54 @@ namespace FLAC {
 			return ::FLAC__stream_encoder_get_rice_parameter_search_dist(encoder_);
 		}
 
+		unsigned Stream::get_time_budget() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_time_budget(encoder_);
+		}
+
 		FLAC__uint64 Stream::get_total_samples_estimate() const
 		{
 			FLAC__ASSERT(is_valid());
 			return ::FLAC__stream_encoder_get_total_samples_estimate(encoder_);
 		}
 
+		::FLAC__ThreadPool *Stream::get_thread_pool() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_thread_pool(encoder_);
+		}
+
+		bool Stream::get_parallel_subframes() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_get_parallel_subframes(encoder_);
+		}
+
+		bool Stream::get_parallel_apodizations() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_get_parallel_apodizations(encoder_);
+		}
+
+		unsigned Stream::get_write_buffer_size() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_write_buffer_size(encoder_);
+		}
+
+		bool Stream::get_async_write() const
+		{
+			FLAC__ASSERT(is_valid());
+			return (bool)::FLAC__stream_encoder_get_async_write(encoder_);
+		}
+
+		size_t Stream::get_workspace_bytes() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_workspace_bytes(encoder_);
+		}
+
 		::FLAC__StreamEncoderInitStatus Stream::init()
 		{
 			FLAC__ASSERT(is_valid());
@@ -388,6 +522,17 @@ namespace FLAC {
 			(void)metadata;
 		}
 
+		FLAC__byte *Stream::reserve_callback(size_t max_bytes)
+		{
+			(void)max_bytes;
+			return 0;
+		}
+
+		::FLAC__StreamEncoderWriteStatus Stream::commit_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame)
+		{
+			return write_callback(buffer, bytes, samples, current_frame);
+		}
+
 		::FLAC__StreamEncoderReadStatus Stream::read_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
 		{
 			(void)encoder;
@@ -433,6 +578,24 @@ namespace FLAC {
 			instance->metadata_callback(metadata);
 		}
 
+		FLAC__byte *Stream::reserve_callback_(const ::FLAC__StreamEncoder *encoder, size_t max_bytes, void *client_data)
+		{
+			(void)encoder;
+			FLAC__ASSERT(0 != client_data);
+			Stream *instance = reinterpret_cast<Stream *>(client_data);
+			FLAC__ASSERT(0 != instance);
+			return instance->reserve_callback(max_bytes);
+		}
+
+		::FLAC__StreamEncoderWriteStatus Stream::commit_callback_(const ::FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
+		{
+			(void)encoder;
+			FLAC__ASSERT(0 != client_data);
+			Stream *instance = reinterpret_cast<Stream *>(client_data);
+			FLAC__ASSERT(0 != instance);
+			return instance->commit_callback(buffer, bytes, samples, current_frame);
+		}
+
 		// ------------------------------------------------------------
 		//
 		// File
@@ -60,20 +60,31 @@
  */
 unsigned FLAC__bitmath_ilog2(FLAC__uint32 v)
 {
+#if defined __GNUC__ && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+	FLAC__ASSERT(v > 0);
+	/* the encoder's Rice parameter selection calls this for every partition */
+	return sizeof(unsigned long) * 8 - 1 - __builtin_clzl(v);
+#else
 	unsigned l = 0;
 	FLAC__ASSERT(v > 0);
 	while(v >>= 1)
 		l++;
 	return l;
+#endif
 }
 
 unsigned FLAC__bitmath_ilog2_wide(FLAC__uint64 v)
 {
+#if defined __GNUC__ && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+	FLAC__ASSERT(v > 0);
+	return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(v);
+#else
 	unsigned l = 0;
 	FLAC__ASSERT(v > 0);
 	while(v >>= 1)
 		l++;
 	return l;
+#endif
 }
 
 /* An example of what FLAC__bitmath_silog2() computes:
@@ -51,20 +51,37 @@
 #include "private/bitmath.h"
 #endif
 #include "private/bitwriter.h"
+#include "private/cpu.h"
 #include "private/crc.h"
 #include "FLAC/assert.h"
 #include "share/alloc.h"
 
+/* adjust for compilers that can't understand using LLU suffix for uint64_t literals */
+#ifdef _MSC_VER
+#define FLAC__U64L(x) x
+#else
+#define FLAC__U64L(x) x##LLU
+#endif
+
 /* Things should be fastest when this matches the machine word size */
 /* WATCHOUT: if you change this you must also change the following #defines down to SWAP_BE_WORD_TO_HOST below to match */
 /* WATCHOUT: there are a few places where the code will not work unless bwword is >= 32 bits wide */
+#if FLAC__BITWRITER_64BIT_WORDS
+typedef FLAC__uint64 bwword;
+#define FLAC__BYTES_PER_WORD 8
+#define FLAC__BITS_PER_WORD 64
+#define FLAC__WORD_ALL_ONES ((FLAC__uint64)FLAC__U64L(0xffffffffffffffff))
+#else
 typedef FLAC__uint32 bwword;
 #define FLAC__BYTES_PER_WORD 4
 #define FLAC__BITS_PER_WORD 32
 #define FLAC__WORD_ALL_ONES ((FLAC__uint32)0xffffffff)
+#endif
 /* SWAP_BE_WORD_TO_HOST swaps bytes in a bwword (which is always big-endian) if necessary to match host byte order */
 #if WORDS_BIGENDIAN
 #define SWAP_BE_WORD_TO_HOST(x) (x)
+#elif FLAC__BITWRITER_64BIT_WORDS
+#define SWAP_BE_WORD_TO_HOST(x) local_swap64_(x)
 #else
 #ifdef _MSC_VER
 #define SWAP_BE_WORD_TO_HOST(x) local_swap32_(x)
@@ -91,23 +108,24 @@ static const unsigned FLAC__BITWRITER_DEFAULT_INCREMENT = 4096u / sizeof(bwword)
 #endif
 #define min(x,y) ((x)<(y)?(x):(y))
 
-/* adjust for compilers that can't understand using LLU suffix for uint64_t literals */
-#ifdef _MSC_VER
-#define FLAC__U64L(x) x
-#else
-#define FLAC__U64L(x) x##LLU
-#endif
-
 #ifndef FLaC__INLINE
 #define FLaC__INLINE
 #endif
 
+/*
+ * Complete words are appended to the buffer in host byte order, and only
+ * swapped to big-endian by FLAC__bitwriter_get_buffer(), in one pass over
+ * all the words added since it was last called.
+ */
 struct FLAC__BitWriter {
 	bwword *buffer;
 	bwword accum; /* accumulator; bits are right-justified; when full, accum is appended to buffer */
 	unsigned capacity; /* capacity of buffer in words */
 	unsigned words; /* # of complete words in buffer */
 	unsigned bits; /* # of used bits in accum */
+	unsigned swapped_words; /* # of words at the start of buffer already swapped to big-endian */
+	bwword *own_buffer; /* while a caller's buffer is attached, our own buffer is kept here; else 0 */
+	unsigned own_capacity;
 };
 
 #ifdef _MSC_VER
@@ -119,6 +137,56 @@ static _inline FLAC__uint32 local_swap32_(FLAC__uint32 x)
 }
 #endif
 
+#if FLAC__BITWRITER_64BIT_WORDS && !WORDS_BIGENDIAN
+static FLaC__INLINE FLAC__uint64 local_swap64_(FLAC__uint64 x)
+{
+#if defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))
+	return __builtin_bswap64(x);
+#elif defined _MSC_VER
+	return _byteswap_uint64(x);
+#else
+	x = ((x<<8)&FLAC__U64L(0xFF00FF00FF00FF00)) | ((x>>8)&FLAC__U64L(0x00FF00FF00FF00FF));
+	x = ((x<<16)&FLAC__U64L(0xFFFF0000FFFF0000)) | ((x>>16)&FLAC__U64L(0x0000FFFF0000FFFF));
+	return (x>>32) | (x<<32);
+#endif
+}
+#endif
+
+#if !WORDS_BIGENDIAN && defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+#include <emmintrin.h>
+
+/* SSE2 is part of the x86-64 baseline, so this needs no CPU check */
+static void swap_words_to_big_endian_(bwword *buffer, unsigned words)
+{
+	unsigned i = 0;
+
+	for( ; i + 16 / FLAC__BYTES_PER_WORD <= words; i += 16 / FLAC__BYTES_PER_WORD) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(buffer+i));
+		/* swap the bytes of each 16-bit lane, then reverse the lanes of each word */
+		x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+#if FLAC__BITWRITER_64BIT_WORDS
+		x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(0,1,2,3)), _MM_SHUFFLE(0,1,2,3));
+#else
+		x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+#endif
+		_mm_storeu_si128((__m128i*)(buffer+i), x);
+	}
+	for( ; i < words; i++)
+		buffer[i] = SWAP_BE_WORD_TO_HOST(buffer[i]);
+}
+#else
+static void swap_words_to_big_endian_(bwword *buffer, unsigned words)
+{
+#if WORDS_BIGENDIAN
+	(void)buffer, (void)words;
+#else
+	unsigned i;
+	for(i = 0; i < words; i++)
+		buffer[i] = SWAP_BE_WORD_TO_HOST(buffer[i]);
+#endif
+}
+#endif
+
 /* * WATCHOUT: The current implementation only grows the buffer. */
 static FLAC__bool bitwriter_grow_(FLAC__BitWriter *bw, unsigned bits_to_add)
 {
@@ -137,6 +205,10 @@ static FLAC__bool bitwriter_grow_(FLAC__BitWriter *bw, unsigned bits_to_add)
 	if(bw->capacity >= new_capacity)
 		return true;
 
+	/* an attached buffer belongs to the caller and cannot be resized */
+	if(0 != bw->own_buffer)
+		return false;
+
 	/* round up capacity increase to the nearest FLAC__BITWRITER_DEFAULT_INCREMENT */
 	if((new_capacity - bw->capacity) % FLAC__BITWRITER_DEFAULT_INCREMENT)
 		new_capacity += FLAC__BITWRITER_DEFAULT_INCREMENT - ((new_capacity - bw->capacity) % FLAC__BITWRITER_DEFAULT_INCREMENT);
@@ -185,7 +257,7 @@ FLAC__bool FLAC__bitwriter_init(FLAC__BitWriter *bw)
 {
 	FLAC__ASSERT(0 != bw);
 
-	bw->words = bw->bits = 0;
+	bw->words = bw->bits = bw->swapped_words = 0;
 	bw->capacity = FLAC__BITWRITER_DEFAULT_CAPACITY;
 	bw->buffer = (bwword*)malloc(sizeof(bwword) * bw->capacity);
 	if(bw->buffer == 0)
@@ -198,16 +270,49 @@ void FLAC__bitwriter_free(FLAC__BitWriter *bw)
 {
 	FLAC__ASSERT(0 != bw);
 
+	if(0 != bw->own_buffer)
+		FLAC__bitwriter_detach_buffer(bw);
 	if(0 != bw->buffer)
 		free(bw->buffer);
 	bw->buffer = 0;
 	bw->capacity = 0;
-	bw->words = bw->bits = 0;
+	bw->words = bw->bits = bw->swapped_words = 0;
 }
 
 void FLAC__bitwriter_clear(FLAC__BitWriter *bw)
 {
-	bw->words = bw->bits = 0;
+	bw->words = bw->bits = bw->swapped_words = 0;
+}
+
+FLAC__bool FLAC__bitwriter_attach_buffer(FLAC__BitWriter *bw, FLAC__byte *buffer, size_t bytes)
+{
+	FLAC__ASSERT(0 != bw);
+	FLAC__ASSERT(0 != bw->buffer);
+	FLAC__ASSERT(0 == bw->own_buffer);
+	FLAC__ASSERT(bw->words == 0 && bw->bits == 0);
+
+	/* the words are stored directly, so the buffer must be aligned for them */
+	if(0 == buffer || ((size_t)buffer & (sizeof(bwword)-1)) || bytes / sizeof(bwword) == 0)
+		return false;
+
+	bw->own_buffer = bw->buffer;
+	bw->own_capacity = bw->capacity;
+	bw->buffer = (bwword*)buffer;
+	bw->capacity = (unsigned)(bytes / sizeof(bwword));
+	bw->words = bw->bits = bw->swapped_words = 0;
+	return true;
+}
+
+void FLAC__bitwriter_detach_buffer(FLAC__BitWriter *bw)
+{
+	FLAC__ASSERT(0 != bw);
+	FLAC__ASSERT(0 != bw->own_buffer);
+
+	bw->buffer = bw->own_buffer;
+	bw->capacity = bw->own_capacity;
+	bw->own_buffer = 0;
+	bw->own_capacity = 0;
+	bw->words = bw->bits = bw->swapped_words = 0;
 }
 
 void FLAC__bitwriter_dump(const FLAC__BitWriter *bw, FILE *out)
@@ -220,15 +325,17 @@ void FLAC__bitwriter_dump(const FLAC__BitWriter *bw, FILE *out)
 		fprintf(out, "bitwriter: capacity=%u words=%u bits=%u total_bits=%u\n", bw->capacity, bw->words, bw->bits, FLAC__TOTAL_BITS(bw));
 
 		for(i = 0; i < bw->words; i++) {
+			/* the words already handed out by FLAC__bitwriter_get_buffer() are big-endian */
+			const bwword word = i < bw->swapped_words? SWAP_BE_WORD_TO_HOST(bw->buffer[i]) : bw->buffer[i];
 			fprintf(out, "%08X: ", i);
 			for(j = 0; j < FLAC__BITS_PER_WORD; j++)
-				fprintf(out, "%01u", bw->buffer[i] & (1 << (FLAC__BITS_PER_WORD-j-1)) ? 1:0);
+				fprintf(out, "%01u", word & ((bwword)1 << (FLAC__BITS_PER_WORD-j-1)) ? 1:0);
 			fprintf(out, "\n");
 		}
 		if(bw->bits > 0) {
 			fprintf(out, "%08X: ", i);
 			for(j = 0; j < bw->bits; j++)
-				fprintf(out, "%01u", bw->accum & (1 << (bw->bits-j-1)) ? 1:0);
+				fprintf(out, "%01u", bw->accum & ((bwword)1 << (bw->bits-j-1)) ? 1:0);
 			fprintf(out, "\n");
 		}
 	}
@@ -280,6 +387,9 @@ FLAC__bool FLAC__bitwriter_get_buffer(FLAC__BitWriter *bw, const FLAC__byte **bu
 	/* double protection */
 	if(bw->bits & 7)
 		return false;
+	/* the complete words are big-endian from here on */
+	swap_words_to_big_endian_(bw->buffer + bw->swapped_words, bw->words - bw->swapped_words);
+	bw->swapped_words = bw->words;
 	/* if we have bits in the accumulator we have to flush those to the buffer first */
 	if(bw->bits) {
 		FLAC__ASSERT(bw->words <= bw->capacity);
@@ -321,7 +431,7 @@ FLaC__INLINE FLAC__bool FLAC__bitwriter_write_zeroes(FLAC__BitWriter *bw, unsign
 		bits -= n;
 		bw->bits += n;
 		if(bw->bits == FLAC__BITS_PER_WORD) {
-			bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(bw->accum);
+			bw->buffer[bw->words++] = bw->accum;
 			bw->bits = 0;
 		}
 		else
@@ -367,13 +477,13 @@ FLaC__INLINE FLAC__bool FLAC__bitwriter_write_raw_uint32(FLAC__BitWriter *bw, FL
 	else if(bw->bits) { /* WATCHOUT: if bw->bits == 0, left==FLAC__BITS_PER_WORD and bw->accum<<=left is a NOP instead of setting to 0 */
 		bw->accum <<= left;
 		bw->accum |= val >> (bw->bits = bits - left);
-		bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(bw->accum);
+		bw->buffer[bw->words++] = bw->accum;
 		bw->accum = val;
 	}
 	else {
 		bw->accum = val;
 		bw->bits = 0;
-		bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(val);
+		bw->buffer[bw->words++] = val;
 	}
 
 	return true;
@@ -543,16 +653,18 @@ FLAC__bool FLAC__bitwriter_write_rice_signed(FLAC__BitWriter *bw, FLAC__int32 va
 
 FLAC__bool FLAC__bitwriter_write_rice_signed_block(FLAC__BitWriter *bw, const FLAC__int32 *vals, unsigned nvals, unsigned parameter)
 {
-	const FLAC__uint32 mask1 = FLAC__WORD_ALL_ONES << parameter; /* we val|=mask1 to set the stop bit above it... */
-	const FLAC__uint32 mask2 = FLAC__WORD_ALL_ONES >> (31-parameter); /* ...then mask off the bits above the stop bit with val&=mask2*/
-	FLAC__uint32 uval;
-	unsigned left;
+	const FLAC__uint32 mask1 = (FLAC__uint32)0xffffffff << parameter; /* we val|=mask1 to set the stop bit above it... */
+	const FLAC__uint32 mask2 = (FLAC__uint32)0xffffffff >> (31-parameter); /* ...then mask off the bits above the stop bit with val&=mask2*/
 	const unsigned lsbits = 1 + parameter;
-	unsigned msbits;
+	FLAC__uint32 uval;
+	unsigned msbits, total_bits, left;
+	/* the accumulator is kept in locals, and only written back around the calls that need it in bw */
+	bwword accum = bw->accum;
+	unsigned bits = bw->bits;
 
 	FLAC__ASSERT(0 != bw);
 	FLAC__ASSERT(0 != bw->buffer);
-	FLAC__ASSERT(parameter < 8*sizeof(bwword)-1);
+	FLAC__ASSERT(parameter < 32);
 	/* WATCHOUT: code does not work with <32bit words; we can make things much faster with this assertion */
 	FLAC__ASSERT(FLAC__BITS_PER_WORD >= 32);
 
@@ -561,99 +673,44 @@ FLAC__bool FLAC__bitwriter_write_rice_signed_block(FLAC__BitWriter *bw, const FL
 		uval = (*vals<<1) ^ (*vals>>31);
 
 		msbits = uval >> parameter;
-
-#if 0 /* OPT: can remove this special case if it doesn't make up for the extra compare (doesn't make a statistically significant difference with msvc or gcc/x86) */
-		if(bw->bits && bw->bits + msbits + lsbits <= FLAC__BITS_PER_WORD) { /* i.e. if the whole thing fits in the current bwword */
-			/* ^^^ if bw->bits is 0 then we may have filled the buffer and have no free bwword to work in */
-			bw->bits = bw->bits + msbits + lsbits;
-			uval |= mask1; /* set stop bit */
-			uval &= mask2; /* mask off unused top bits */
-			/* NOT: bw->accum <<= msbits + lsbits because msbits+lsbits could be 32, then the shift would be a NOP */
-			bw->accum <<= msbits;
-			bw->accum <<= lsbits;
-			bw->accum |= uval;
-			if(bw->bits == FLAC__BITS_PER_WORD) {
-				bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(bw->accum);
-				bw->bits = 0;
-				/* burying the capacity check down here means we have to grow the buffer a little if there are more vals to do */
-				if(bw->capacity <= bw->words && nvals > 1 && !bitwriter_grow_(bw, 1)) {
-					FLAC__ASSERT(bw->capacity == bw->words);
-					return false;
-				}
-			}
+		total_bits = msbits + lsbits;
+		uval |= mask1; /* set stop bit */
+		uval &= mask2; /* mask off unused top bits; uval is now the whole code, less its leading zeroes */
+
+		if(bits + total_bits < FLAC__BITS_PER_WORD) { /* i.e. if the whole thing fits in the current bwword */
+			/* this is the common case; with 64-bit words, several codes are packed in between flushes */
+			accum <<= total_bits;
+			accum |= uval;
+			bits += total_bits;
 		}
-		else {
-#elif 1 /*@@@@@@ OPT: try this version with MSVC6 to see if better, not much difference for gcc-4 */
-		if(bw->bits && bw->bits + msbits + lsbits < FLAC__BITS_PER_WORD) { /* i.e. if the whole thing fits in the current bwword */
-			/* ^^^ if bw->bits is 0 then we may have filled the buffer and have no free bwword to work in */
-			bw->bits = bw->bits + msbits + lsbits;
-			uval |= mask1; /* set stop bit */
-			uval &= mask2; /* mask off unused top bits */
-			bw->accum <<= msbits + lsbits;
-			bw->accum |= uval;
+		else if(bits && total_bits <= 32) {
+			/* the code straddles a word boundary; flush the full word and start the next with the rest of the code */
+			/* ^^^ if bits is 0 then total_bits >= FLAC__BITS_PER_WORD and the shift by 'left' below would be a NOP */
+			if(bw->capacity <= bw->words && !bitwriter_grow_(bw, total_bits))
+				return false;
+			left = FLAC__BITS_PER_WORD - bits;
+			accum <<= left;
+			accum |= uval >> (bits = total_bits - left);
+			bw->buffer[bw->words++] = accum;
+			accum = uval;
 		}
 		else {
-#endif
-			/* slightly pessimistic size check but faster than "<= bw->words + (bw->bits+msbits+lsbits+FLAC__BITS_PER_WORD-1)/FLAC__BITS_PER_WORD" */
-			/* OPT: pessimism may cause flurry of false calls to grow_ which eat up all savings before it */
-			if(bw->capacity <= bw->words + bw->bits + msbits + 1/*lsbits always fit in 1 bwword*/ && !bitwriter_grow_(bw, msbits+lsbits))
+			/* a long code; write it in two parts the slow way */
+			bw->accum = accum;
+			bw->bits = bits;
+			if(
+				!FLAC__bitwriter_write_zeroes(bw, msbits) || /* write the unary MSBs */
+				!FLAC__bitwriter_write_raw_uint32(bw, uval, lsbits) /* write the unary end bit and binary LSBs */
+			)
 				return false;
-
-			if(msbits) {
-				/* first part gets to word alignment */
-				if(bw->bits) {
-					left = FLAC__BITS_PER_WORD - bw->bits;
-					if(msbits < left) {
-						bw->accum <<= msbits;
-						bw->bits += msbits;
-						goto break1;
-					}
-					else {
-						bw->accum <<= left;
-						msbits -= left;
-						bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(bw->accum);
-						bw->bits = 0;
-					}
-				}
-				/* do whole words */
-				while(msbits >= FLAC__BITS_PER_WORD) {
-					bw->buffer[bw->words++] = 0;
-					msbits -= FLAC__BITS_PER_WORD;
-				}
-				/* do any leftovers */
-				if(msbits > 0) {
-					bw->accum = 0;
-					bw->bits = msbits;
-				}
-			}
-break1:
-			uval |= mask1; /* set stop bit */
-			uval &= mask2; /* mask off unused top bits */
-
-			left = FLAC__BITS_PER_WORD - bw->bits;
-			if(lsbits < left) {
-				bw->accum <<= lsbits;
-				bw->accum |= uval;
-				bw->bits += lsbits;
-			}
-			else {
-				/* if bw->bits == 0, left==FLAC__BITS_PER_WORD which will always
-				 * be > lsbits (because of previous assertions) so it would have
-				 * triggered the (lsbits<left) case above.
-				 */
-				FLAC__ASSERT(bw->bits);
-				FLAC__ASSERT(left < FLAC__BITS_PER_WORD);
-				bw->accum <<= left;
-				bw->accum |= uval >> (bw->bits = lsbits - left);
-				bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(bw->accum);
-				bw->accum = uval;
-			}
-#if 1
+			accum = bw->accum;
+			bits = bw->bits;
 		}
-#endif
 		vals++;
 		nvals--;
 	}
+	bw->accum = accum;
+	bw->bits = bits;
 	return true;
 }
 
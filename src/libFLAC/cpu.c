@@ -93,6 +93,44 @@ static const unsigned FLAC__CPUINFO_IA32_CPUID_SSE = 0x02000000;
 /* these are flags in EDX of CPUID AX=80000001 */
 static const unsigned FLAC__CPUINFO_IA32_CPUID_EXTENDED_AMD_3DNOW = 0x80000000;
 
+#if defined FLAC__CPU_X86_64 && !defined FLAC__NO_ASM && defined FLAC__HAS_X86INTRIN
+# if defined _MSC_VER
+#  include <intrin.h>
+# endif
+/* these are flags in ECX of CPUID AX=00000001 */
+static const unsigned FLAC__CPUINFO_X86_64_CPUID_OSXSAVE = 0x08000000;
+static const unsigned FLAC__CPUINFO_X86_64_CPUID_AVX = 0x10000000;
+/* these are flags in EBX of CPUID AX=00000007 CX=00000000 */
+static const unsigned FLAC__CPUINFO_X86_64_CPUID_AVX2 = 0x00000020;
+
+static void cpuid_x86_64_(FLAC__uint32 level, FLAC__uint32 sublevel, FLAC__uint32 *eax, FLAC__uint32 *ebx, FLAC__uint32 *ecx, FLAC__uint32 *edx)
+{
+#if defined _MSC_VER
+	int regs[4];
+	__cpuidex(regs, (int)level, (int)sublevel);
+	*eax = (FLAC__uint32)regs[0];
+	*ebx = (FLAC__uint32)regs[1];
+	*ecx = (FLAC__uint32)regs[2];
+	*edx = (FLAC__uint32)regs[3];
+#else
+	__asm__ __volatile__ ("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(level), "c"(sublevel));
+#endif
+}
+
+/* which register sets the OS saves on a context switch (XCR0) */
+static FLAC__uint32 xgetbv_x86_64_(void)
+{
+#if defined _MSC_VER
+	return (FLAC__uint32)_xgetbv(0);
+#else
+	FLAC__uint32 lo, hi;
+	__asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0)); /* xgetbv, which older assemblers do not know */
+	(void)hi;
+	return lo;
+#endif
+}
+#endif
+
 
 /*
  * Extra stuff needed for detection of OS support for SSE on IA-32
@@ -303,6 +341,39 @@ void FLAC__cpu_info(FLAC__CPUInfo *info)
 	info->use_asm = false;
 #endif
 
+/*
+ * x86-64-specific
+ */
+#elif defined FLAC__CPU_X86_64
+	info->type = FLAC__CPUINFO_TYPE_X86_64;
+#if !defined FLAC__NO_ASM && defined FLAC__HAS_X86INTRIN
+	info->use_asm = true;
+	info->data.x86_64.sse2 = true; /* SSE2 is part of the x86-64 baseline */
+	info->data.x86_64.avx2 = false;
+	{
+		FLAC__uint32 max_level, flags_eax, flags_ebx, flags_ecx, flags_edx;
+		cpuid_x86_64_(0, 0, &max_level, &flags_ebx, &flags_ecx, &flags_edx);
+		cpuid_x86_64_(1, 0, &flags_eax, &flags_ebx, &flags_ecx, &flags_edx);
+		/* AVX2 also needs the OS to save the YMM registers, i.e. XCR0 bits 1 and 2 */
+		if(
+			max_level >= 7 &&
+			(flags_ecx & FLAC__CPUINFO_X86_64_CPUID_OSXSAVE) &&
+			(flags_ecx & FLAC__CPUINFO_X86_64_CPUID_AVX) &&
+			(xgetbv_x86_64_() & 6) == 6
+		) {
+			cpuid_x86_64_(7, 0, &flags_eax, &flags_ebx, &flags_ecx, &flags_edx);
+			info->data.x86_64.avx2 = (flags_ebx & FLAC__CPUINFO_X86_64_CPUID_AVX2)? true : false;
+		}
+	}
+#ifdef DEBUG
+	fprintf(stderr, "CPU info (x86-64):\n");
+	fprintf(stderr, "  SSE2 ....... %c\n", info->data.x86_64.sse2 ? 'Y' : 'n');
+	fprintf(stderr, "  AVX2 ....... %c\n", info->data.x86_64.avx2 ? 'Y' : 'n');
+#endif
+#else
+	info->use_asm = false;
+#endif
+
 /*
  * PPC-specific
  */
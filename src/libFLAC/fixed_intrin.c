@@ -0,0 +1,282 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+#ifndef FLAC__NO_ASM
+#if defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+
+#include <math.h>
+#include <immintrin.h>
+#include "private/fixed.h"
+#include "FLAC/assert.h"
+
+#ifndef M_LN2
+/* math.h in VC++ doesn't seem to have this (how Microsoft is that?) */
+#define M_LN2 0.69314718055994530942
+#endif
+
+#ifndef FLaC__INLINE
+#define FLaC__INLINE
+#endif
+
+#ifdef local_abs
+#undef local_abs
+#endif
+#define local_abs(x) ((unsigned)((x)<0? -(x) : (x)))
+
+/*
+ * The scalar FLAC__fixed_compute_best_predictor() carries the last error
+ * of each order from one sample to the next.  Here every lane instead
+ * differences the samples x[i-4..i] directly:
+ *
+ *   order 1: x[i]-x[i-1]                (and the same for i-1, i-2, i-3)
+ *   order 2: the order 1 errors of i and i-1, differenced again
+ *   ...
+ *
+ * which gives exactly the same wrapping 32-bit errors, so the totals, the
+ * chosen order and the residual bits per sample all match the C versions.
+ */
+
+/* the scalar equivalent of one lane, for the samples left over at the end */
+static void add_remaining_errors_(const FLAC__int32 data[], unsigned i, unsigned data_len, FLAC__uint64 total_error[FLAC__MAX_FIXED_ORDER+1])
+{
+	for( ; i < data_len; i++) {
+		const FLAC__int32 *x = data + i; /* so x[-1] is not data[i-1] with i unsigned */
+		const FLAC__int32 d0 = x[0] - x[-1], d1 = x[-1] - x[-2], d2 = x[-2] - x[-3], d3 = x[-3] - x[-4];
+		const FLAC__int32 e0 = d0 - d1, e1 = d1 - d2, e2 = d2 - d3;
+		const FLAC__int32 f0 = e0 - e1, f1 = e1 - e2;
+		total_error[0] += local_abs(x[0]);
+		total_error[1] += local_abs(d0);
+		total_error[2] += local_abs(e0);
+		total_error[3] += local_abs(f0);
+		total_error[4] += local_abs(f0 - f1);
+	}
+}
+
+static unsigned best_predictor_from_totals_(const FLAC__uint64 total_error[FLAC__MAX_FIXED_ORDER+1], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+{
+	unsigned order, i;
+
+	/* the lowest order whose total is strictly less than all the higher orders' */
+	for(order = 0; order < FLAC__MAX_FIXED_ORDER; order++) {
+		for(i = order + 1; i <= FLAC__MAX_FIXED_ORDER; i++)
+			if(total_error[i] <= total_error[order])
+				break;
+		if(i > FLAC__MAX_FIXED_ORDER)
+			break;
+	}
+
+	/* see FLAC__fixed_compute_best_predictor_wide() */
+	for(i = 0; i <= FLAC__MAX_FIXED_ORDER; i++) {
+		FLAC__ASSERT(data_len > 0 || total_error[i] == 0);
+		residual_bits_per_sample[i] = (FLAC__float)((total_error[i] > 0) ? log(M_LN2 * (FLAC__double)(FLAC__int64)total_error[i] / (FLAC__double)data_len) / M_LN2 : 0.0);
+	}
+
+	return order;
+}
+
+/*
+ * SSE2
+ */
+
+static FLaC__INLINE __m128i abs_epi32_sse2_(__m128i x)
+{
+	const __m128i sign = _mm_srai_epi32(x, 31);
+	return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+}
+
+/* abs(error) of orders 0-4 for the 4 samples starting at data[0] */
+static FLaC__INLINE void abs_errors_sse2_(const FLAC__int32 data[], __m128i err[FLAC__MAX_FIXED_ORDER+1])
+{
+	const __m128i x0 = _mm_loadu_si128((const __m128i*)data);
+	const __m128i x1 = _mm_loadu_si128((const __m128i*)(data-1));
+	const __m128i x2 = _mm_loadu_si128((const __m128i*)(data-2));
+	const __m128i x3 = _mm_loadu_si128((const __m128i*)(data-3));
+	const __m128i x4 = _mm_loadu_si128((const __m128i*)(data-4));
+	const __m128i d0 = _mm_sub_epi32(x0, x1), d1 = _mm_sub_epi32(x1, x2), d2 = _mm_sub_epi32(x2, x3), d3 = _mm_sub_epi32(x3, x4);
+	const __m128i e0 = _mm_sub_epi32(d0, d1), e1 = _mm_sub_epi32(d1, d2), e2 = _mm_sub_epi32(d2, d3);
+	const __m128i f0 = _mm_sub_epi32(e0, e1), f1 = _mm_sub_epi32(e1, e2);
+	err[0] = abs_epi32_sse2_(x0);
+	err[1] = abs_epi32_sse2_(d0);
+	err[2] = abs_epi32_sse2_(e0);
+	err[3] = abs_epi32_sse2_(f0);
+	err[4] = abs_epi32_sse2_(_mm_sub_epi32(f0, f1));
+}
+
+unsigned FLAC__fixed_compute_best_predictor_intrin_sse2(const FLAC__int32 data[], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+{
+	__m128i sum[FLAC__MAX_FIXED_ORDER+1], err[FLAC__MAX_FIXED_ORDER+1];
+	FLAC__uint32 lane[4];
+	FLAC__uint64 total_error[FLAC__MAX_FIXED_ORDER+1];
+	unsigned i, order;
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+		sum[order] = _mm_setzero_si128();
+
+	for(i = 0; i + 4 <= data_len; i += 4) {
+		abs_errors_sse2_(data+i, err);
+		for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+			sum[order] = _mm_add_epi32(sum[order], err[order]);
+	}
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+		_mm_storeu_si128((__m128i*)lane, sum[order]);
+		total_error[order] = lane[0] + lane[1] + lane[2] + lane[3];
+	}
+	add_remaining_errors_(data, i, data_len, total_error);
+	/* the totals wrap at 32 bits just like the C version's */
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+		total_error[order] = (FLAC__uint32)total_error[order];
+
+	return best_predictor_from_totals_(total_error, data_len, residual_bits_per_sample);
+}
+
+unsigned FLAC__fixed_compute_best_predictor_wide_intrin_sse2(const FLAC__int32 data[], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum[FLAC__MAX_FIXED_ORDER+1], err[FLAC__MAX_FIXED_ORDER+1];
+	FLAC__uint64 lane[2];
+	FLAC__uint64 total_error[FLAC__MAX_FIXED_ORDER+1];
+	unsigned i, order;
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+		sum[order] = zero;
+
+	for(i = 0; i + 4 <= data_len; i += 4) {
+		abs_errors_sse2_(data+i, err);
+		/* zero-extend the 32-bit magnitudes into two 64-bit lanes each */
+		for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+			sum[order] = _mm_add_epi64(sum[order], _mm_unpacklo_epi32(err[order], zero));
+			sum[order] = _mm_add_epi64(sum[order], _mm_unpackhi_epi32(err[order], zero));
+		}
+	}
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+		_mm_storeu_si128((__m128i*)lane, sum[order]);
+		total_error[order] = lane[0] + lane[1];
+	}
+	add_remaining_errors_(data, i, data_len, total_error);
+
+	return best_predictor_from_totals_(total_error, data_len, residual_bits_per_sample);
+}
+
+/*
+ * AVX2
+ */
+
+/* abs(error) of orders 0-4 for the 8 samples starting at data[0] */
+static FLaC__INLINE FLAC__AVX2_TARGET void abs_errors_avx2_(const FLAC__int32 data[], __m256i err[FLAC__MAX_FIXED_ORDER+1])
+{
+	const __m256i x0 = _mm256_loadu_si256((const __m256i*)data);
+	const __m256i x1 = _mm256_loadu_si256((const __m256i*)(data-1));
+	const __m256i x2 = _mm256_loadu_si256((const __m256i*)(data-2));
+	const __m256i x3 = _mm256_loadu_si256((const __m256i*)(data-3));
+	const __m256i x4 = _mm256_loadu_si256((const __m256i*)(data-4));
+	const __m256i d0 = _mm256_sub_epi32(x0, x1), d1 = _mm256_sub_epi32(x1, x2), d2 = _mm256_sub_epi32(x2, x3), d3 = _mm256_sub_epi32(x3, x4);
+	const __m256i e0 = _mm256_sub_epi32(d0, d1), e1 = _mm256_sub_epi32(d1, d2), e2 = _mm256_sub_epi32(d2, d3);
+	const __m256i f0 = _mm256_sub_epi32(e0, e1), f1 = _mm256_sub_epi32(e1, e2);
+	err[0] = _mm256_abs_epi32(x0);
+	err[1] = _mm256_abs_epi32(d0);
+	err[2] = _mm256_abs_epi32(e0);
+	err[3] = _mm256_abs_epi32(f0);
+	err[4] = _mm256_abs_epi32(_mm256_sub_epi32(f0, f1));
+}
+
+FLAC__AVX2_TARGET
+unsigned FLAC__fixed_compute_best_predictor_intrin_avx2(const FLAC__int32 data[], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+{
+	__m256i sum[FLAC__MAX_FIXED_ORDER+1], err[FLAC__MAX_FIXED_ORDER+1];
+	FLAC__uint32 lane[8];
+	FLAC__uint64 total_error[FLAC__MAX_FIXED_ORDER+1];
+	unsigned i, order;
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+		sum[order] = _mm256_setzero_si256();
+
+	for(i = 0; i + 8 <= data_len; i += 8) {
+		abs_errors_avx2_(data+i, err);
+		for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+			sum[order] = _mm256_add_epi32(sum[order], err[order]);
+	}
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+		_mm256_storeu_si256((__m256i*)lane, sum[order]);
+		total_error[order] = (FLAC__uint32)(lane[0] + lane[1] + lane[2] + lane[3] + lane[4] + lane[5] + lane[6] + lane[7]);
+	}
+	_mm256_zeroupper();
+	add_remaining_errors_(data, i, data_len, total_error);
+	/* the totals wrap at 32 bits just like the C version's */
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+		total_error[order] = (FLAC__uint32)total_error[order];
+
+	return best_predictor_from_totals_(total_error, data_len, residual_bits_per_sample);
+}
+
+FLAC__AVX2_TARGET
+unsigned FLAC__fixed_compute_best_predictor_wide_intrin_avx2(const FLAC__int32 data[], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i sum[FLAC__MAX_FIXED_ORDER+1], err[FLAC__MAX_FIXED_ORDER+1];
+	FLAC__uint64 lane[4];
+	FLAC__uint64 total_error[FLAC__MAX_FIXED_ORDER+1];
+	unsigned i, order;
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++)
+		sum[order] = zero;
+
+	for(i = 0; i + 8 <= data_len; i += 8) {
+		abs_errors_avx2_(data+i, err);
+		/* zero-extend the 32-bit magnitudes into two 64-bit lanes each */
+		for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+			sum[order] = _mm256_add_epi64(sum[order], _mm256_unpacklo_epi32(err[order], zero));
+			sum[order] = _mm256_add_epi64(sum[order], _mm256_unpackhi_epi32(err[order], zero));
+		}
+	}
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+		_mm256_storeu_si256((__m256i*)lane, sum[order]);
+		total_error[order] = lane[0] + lane[1] + lane[2] + lane[3];
+	}
+	_mm256_zeroupper();
+	add_remaining_errors_(data, i, data_len, total_error);
+
+	return best_predictor_from_totals_(total_error, data_len, residual_bits_per_sample);
+}
+
+#endif /* FLAC__CPU_X86_64 && FLAC__HAS_X86INTRIN */
+#endif /* FLAC__NO_ASM */
+#endif /* FLAC__INTEGER_ONLY_LIBRARY */
@@ -51,6 +51,17 @@ void FLAC__bitwriter_free(FLAC__BitWriter *bw); /* does not 'free(buffer)' */
 void FLAC__bitwriter_clear(FLAC__BitWriter *bw);
 void FLAC__bitwriter_dump(const FLAC__BitWriter *bw, FILE *out);
 
+/*
+ * caller-supplied buffer
+ *
+ * attach makes the bitwriter write into 'buffer' (which must be aligned to
+ * 8 bytes) instead of its own until detach; the bitwriter must be empty.
+ * an attached buffer is never grown, so writes past its end fail.
+ * both functions leave the bitwriter cleared.
+ */
+FLAC__bool FLAC__bitwriter_attach_buffer(FLAC__BitWriter *bw, FLAC__byte *buffer, size_t bytes);
+void FLAC__bitwriter_detach_buffer(FLAC__BitWriter *bw);
+
 /*
  * CRC functions
  *
@@ -40,6 +40,7 @@
 
 typedef enum {
 	FLAC__CPUINFO_TYPE_IA32,
+	FLAC__CPUINFO_TYPE_X86_64,
 	FLAC__CPUINFO_TYPE_PPC,
 	FLAC__CPUINFO_TYPE_UNKNOWN
 } FLAC__CPUInfo_Type;
@@ -52,6 +53,11 @@ typedef struct {
 	FLAC__bool _3dnow;
 } FLAC__CPUInfo_IA32;
 
+typedef struct {
+	FLAC__bool sse2;
+	FLAC__bool avx2;
+} FLAC__CPUInfo_x86_64;
+
 typedef struct {
 	FLAC__bool altivec;
 	FLAC__bool ppc64;
@@ -62,12 +68,30 @@ typedef struct {
 	FLAC__CPUInfo_Type type;
 	union {
 		FLAC__CPUInfo_IA32 ia32;
+		FLAC__CPUInfo_x86_64 x86_64;
 		FLAC__CPUInfo_PPC ppc;
 	} data;
 } FLAC__CPUInfo;
 
 void FLAC__cpu_info(FLAC__CPUInfo *info);
 
+/*
+ * On x86-64 the SSE2/AVX2 routines are written with compiler intrinsics
+ * instead of NASM.  AVX2 is not part of the x86-64 baseline, so those
+ * routines are compiled for it one function at a time with
+ * FLAC__AVX2_TARGET and only called when FLAC__cpu_info() finds it.
+ */
+#if defined FLAC__CPU_X86_64 && !defined FLAC__NO_ASM
+# if defined __clang__ || (defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || (defined _MSC_VER && _MSC_VER >= 1800)
+#  define FLAC__HAS_X86INTRIN 1
+#  if defined __GNUC__
+#   define FLAC__AVX2_TARGET __attribute__((target("avx2")))
+#  else
+#   define FLAC__AVX2_TARGET
+#  endif
+# endif
+#endif
+
 #ifndef FLAC__NO_ASM
 #ifdef FLAC__CPU_IA32
 #ifdef FLAC__HAS_NASM
@@ -36,6 +36,7 @@
 #include <config.h>
 #endif
 
+#include "private/cpu.h"
 #include "private/float.h"
 #include "FLAC/format.h"
 
@@ -45,7 +46,6 @@
  *	FLAC__lpc_window_data()
  *	--------------------------------------------------------------------
  *	Applies the given window to the data.
- *  OPT: asm implementation
  *
  *	IN in[0,data_len-1]
  *	IN window[0,data_len-1]
@@ -53,6 +53,12 @@
  *	IN data_len
  */
 void FLAC__lpc_window_data(const FLAC__int32 in[], const FLAC__real window[], FLAC__real out[], unsigned data_len);
+#ifndef FLAC__NO_ASM
+#  if defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+void FLAC__lpc_window_data_intrin_sse2(const FLAC__int32 in[], const FLAC__real window[], FLAC__real out[], unsigned data_len);
+void FLAC__lpc_window_data_intrin_avx2(const FLAC__int32 in[], const FLAC__real window[], FLAC__real out[], unsigned data_len);
+#  endif
+#endif
 
 /*
  *	FLAC__lpc_compute_autocorrelation()
@@ -77,6 +83,10 @@ void FLAC__lpc_compute_autocorrelation_asm_ia32_sse_lag_12(const FLAC__real data
 void FLAC__lpc_compute_autocorrelation_asm_ia32_3dnow(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[]);
 #    endif
 #  endif
+#  if defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+void FLAC__lpc_compute_autocorrelation_intrin_sse2(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[]);
+void FLAC__lpc_compute_autocorrelation_intrin_avx2(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[]);
+#  endif
 #endif
 
 /*
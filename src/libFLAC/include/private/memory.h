@@ -53,4 +53,16 @@ FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(unsigned elements, unsigned
 FLAC__bool FLAC__memory_alloc_aligned_real_array(unsigned elements, FLAC__real **unaligned_pointer, FLAC__real **aligned_pointer);
 #endif
 
+/* One cache line; everything carved out of an arena starts on one. */
+#define FLAC__MEMORY_ARENA_ALIGNMENT 64
+
+/* Allocates a block of at least 'bytes' with *aligned_address on a
+ * FLAC__MEMORY_ARENA_ALIGNMENT boundary.  Large blocks are mapped
+ * directly and backed by huge pages where the system supports it;
+ * *mapped says which.  Returns the address to pass, with the same
+ * 'bytes' and *mapped, to FLAC__memory_free_arena().
+ */
+void *FLAC__memory_alloc_arena(size_t bytes, void **aligned_address, FLAC__bool *mapped);
+void FLAC__memory_free_arena(void *block, size_t bytes, FLAC__bool mapped);
+
 #endif
@@ -0,0 +1,56 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLAC__PRIVATE__THREAD_POOL_H
+#define FLAC__PRIVATE__THREAD_POOL_H
+
+#include "FLAC/thread_pool.h"
+
+/*
+ * Each encoder or decoder instance using a pool gets its own queue in
+ * it.  Tasks submitted to a queue are run by the pool's threads in any
+ * order; the only ordering guarantee is that all of them have finished
+ * when FLAC__thread_pool_wait() returns.
+ */
+typedef struct FLAC__ThreadPoolQueue FLAC__ThreadPoolQueue;
+
+typedef void (*FLAC__ThreadPoolTask)(void *data);
+
+/* returns NULL on allocation failure */
+FLAC__ThreadPoolQueue *FLAC__thread_pool_attach(FLAC__ThreadPool *pool);
+/* waits for the queue's outstanding tasks, then frees it */
+void FLAC__thread_pool_detach(FLAC__ThreadPoolQueue *queue);
+/* if the queue is full, or the pool has no threads, the task is run right away in the caller */
+void FLAC__thread_pool_submit(FLAC__ThreadPoolQueue *queue, FLAC__ThreadPoolTask task, void *data);
+/* the caller runs any of its tasks that are still queued instead of waiting for a thread to pick them up */
+void FLAC__thread_pool_wait(FLAC__ThreadPoolQueue *queue);
+
+#endif
@@ -0,0 +1,57 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLAC__PRIVATE__URING_WRITER_H
+#define FLAC__PRIVATE__URING_WRITER_H
+
+#include <stddef.h> /* for size_t */
+#include "FLAC/ordinals.h"
+
+/*
+ * Writes a regular file through a Linux io_uring.  Data is gathered in
+ * a fixed set of buffers registered with the kernel; a full buffer is
+ * submitted at its file offset and the caller goes on filling the next
+ * one while the write completes.  The caller only blocks when every
+ * buffer is still in flight.
+ */
+typedef struct FLAC__UringWriter FLAC__UringWriter;
+
+/* returns NULL if io_uring is not available, or the kernel cannot write files with it, or on allocation failure; the caller then writes the file as usual */
+FLAC__UringWriter *FLAC__uring_writer_new(int fd, FLAC__uint64 offset, unsigned buffers, size_t buffer_size);
+/* does not wait for outstanding writes; call FLAC__uring_writer_drain() first */
+void FLAC__uring_writer_delete(FLAC__UringWriter *writer);
+FLAC__bool FLAC__uring_writer_write(FLAC__UringWriter *writer, const FLAC__byte buffer[], size_t bytes);
+/* submits what is buffered and waits for all writes; false if any of them failed */
+FLAC__bool FLAC__uring_writer_drain(FLAC__UringWriter *writer);
+/* the file offset just past the last byte handed to FLAC__uring_writer_write() */
+FLAC__uint64 FLAC__uring_writer_get_offset(const FLAC__UringWriter *writer);
+
+#endif
@@ -38,6 +38,7 @@
 
 #include "private/float.h"
 #include "FLAC/format.h"
+#include "protected/stream_encoder.h"
 
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 
@@ -66,6 +67,22 @@ void FLAC__window_triangle(FLAC__real *window, const FLAC__int32 L);
 void FLAC__window_tukey(FLAC__real *window, const FLAC__int32 L, const FLAC__real p);
 void FLAC__window_welch(FLAC__real *window, const FLAC__int32 L);
 
+/*
+ *	FLAC__window_cache_acquire()
+ *	--------------------------------------------------------------------
+ *	Returns the window for an apodization function and length, shared
+ *	with every other encoder in the process using the same one.  It is
+ *	only computed if no encoder holds it and it has not been released
+ *	recently.  Every window acquired must be given back with
+ *	FLAC__window_cache_release().
+ *
+ *	IN apodization
+ *	IN L (number of points in window)
+ *	RETURN the read-only window[0,L-1], or NULL on a memory error
+ */
+const FLAC__real *FLAC__window_cache_acquire(const FLAC__ApodizationSpecification *apodization, unsigned L);
+void FLAC__window_cache_release(const FLAC__real *window);
+
 #endif /* !defined FLAC__INTEGER_ONLY_LIBRARY */
 
 #endif
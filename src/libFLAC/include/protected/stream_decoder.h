@@ -45,6 +45,12 @@ typedef struct FLAC__StreamDecoderProtected {
 	unsigned sample_rate; /* in Hz */
 	unsigned blocksize; /* in samples (per channel) */
 	FLAC__bool md5_checking; /* if true, generate MD5 signature of decoded data and compare against signature in the STREAMINFO metadata block */
+	FLAC__bool crc_check_only; /* if true, only parse frames and check their CRCs; skip restoring the signal and MD5 checking */
+	FLAC__uint32 channel_mask; /* bit n set means restore channel n; subframes of other channels are only parsed */
+	unsigned waveform_summary; /* if non-zero, the number of samples per bucket to reduce each frame to min/max/RMS summaries */
+	unsigned write_batch_size; /* if non-zero, hold decoded frames until at least this many samples can be passed to the write callback at once */
+	unsigned read_size; /* if non-zero, files are read with pread() in blocks of this many bytes */
+	FLAC__ThreadPool *thread_pool; /* if set, MD5 checking is done on the pool's threads */
 #if FLAC__HAS_OGG
 	FLAC__OggDecoderAspect ogg_decoder_aspect;
 #endif
@@ -86,22 +86,32 @@ typedef struct FLAC__StreamEncoderProtected {
 	unsigned bits_per_sample;
 	unsigned sample_rate;
 	unsigned blocksize;
+	FLAC__bool variable_blocksize;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	unsigned num_apodizations;
 	FLAC__ApodizationSpecification apodizations[FLAC__MAX_APODIZATION_FUNCTIONS];
 #endif
+	FLAC__bool adaptive_apodization;
 	unsigned max_lpc_order;
 	unsigned qlp_coeff_precision;
 	FLAC__bool do_qlp_coeff_prec_search;
 	FLAC__bool do_exhaustive_model_search;
+	FLAC__bool prune_model_search;
+	unsigned quiet_signal_bits;
 	FLAC__bool do_escape_coding;
 	unsigned min_residual_partition_order;
 	unsigned max_residual_partition_order;
 	unsigned rice_parameter_search_dist;
+	unsigned time_budget;
 	FLAC__uint64 total_samples_estimate;
 	FLAC__StreamMetadata **metadata;
 	unsigned num_metadata_blocks;
 	FLAC__uint64 streaminfo_offset, seektable_offset, audio_offset;
+	FLAC__ThreadPool *thread_pool;
+	FLAC__bool parallel_subframes;
+	FLAC__bool parallel_apodizations;
+	unsigned write_buffer_size;
+	FLAC__bool async_write;
 #if FLAC__HAS_OGG
 	FLAC__OggEncoderAspect ogg_encoder_aspect;
 #endif
@@ -269,6 +269,10 @@ SOURCE=.\fixed.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\fixed_intrin.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\float.c
 # End Source File
 # Begin Source File
@@ -281,6 +285,10 @@ SOURCE=.\lpc.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\lpc_intrin.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\md5.c
 # End Source File
 # Begin Source File
@@ -321,10 +329,22 @@ SOURCE=.\stream_encoder.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\stream_encoder_intrin.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\stream_encoder_framing.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\thread_pool.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\uring_writer.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\window.c
 # End Source File
 # End Group
@@ -405,6 +425,18 @@ SOURCE=.\include\private\stream_encoder_framing.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\private\stream_encoder.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\private\thread_pool.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\private\uring_writer.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\private\window.h
 # End Source File
 # End Group
@@ -459,6 +491,10 @@ SOURCE=..\..\include\FLAC\stream_decoder.h
 
 SOURCE=..\..\include\FLAC\stream_encoder.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\include\FLAC\thread_pool.h
+# End Source File
 # End Group
 # End Target
 # End Project
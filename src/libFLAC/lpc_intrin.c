@@ -0,0 +1,191 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+#ifndef FLAC__NO_ASM
+#if defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+
+#include <immintrin.h>
+#include "FLAC/assert.h"
+#include "private/lpc.h"
+
+#ifndef FLaC__INLINE
+#define FLaC__INLINE
+#endif
+
+/*
+ * The conversions and products are the same single-precision operations
+ * as FLAC__lpc_window_data()'s, so the output matches it exactly.
+ */
+
+void FLAC__lpc_window_data_intrin_sse2(const FLAC__int32 in[], const FLAC__real window[], FLAC__real out[], unsigned data_len)
+{
+	unsigned i;
+
+	for(i = 0; i + 4 <= data_len; i += 4) {
+		const __m128 x = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(in+i)));
+		_mm_storeu_ps(out+i, _mm_mul_ps(x, _mm_loadu_ps(window+i)));
+	}
+	for( ; i < data_len; i++)
+		out[i] = in[i] * window[i];
+}
+
+FLAC__AVX2_TARGET
+void FLAC__lpc_window_data_intrin_avx2(const FLAC__int32 in[], const FLAC__real window[], FLAC__real out[], unsigned data_len)
+{
+	unsigned i;
+
+	for(i = 0; i + 8 <= data_len; i += 8) {
+		const __m256 x = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(in+i)));
+		_mm256_storeu_ps(out+i, _mm256_mul_ps(x, _mm256_loadu_ps(window+i)));
+	}
+	_mm256_zeroupper();
+	for( ; i < data_len; i++)
+		out[i] = in[i] * window[i];
+}
+
+/*
+ * The autocorrelation routines below vectorize across the lags: each lane
+ * accumulates one autoc[] value over the samples in the same order, and
+ * with the same single-precision products and sums, as the C version
+ * does, so again the results are identical.  Up to 5 vectors of lags are
+ * accumulated per pass over the data; the last few samples of each lag,
+ * which a full vector load would read past the end of data[], are added
+ * in by autocorrelation_tail_().
+ */
+
+static void autocorrelation_tail_(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[], const FLAC__real sums[], unsigned first, unsigned count, unsigned sample)
+{
+	unsigned coeff, i;
+
+	for(coeff = first; coeff < first + count && coeff < lag; coeff++) {
+		FLAC__real d = sums[coeff - first];
+		for(i = sample; i + coeff < data_len; i++)
+			d += data[i] * data[i+coeff];
+		autoc[coeff] = d;
+	}
+}
+
+static FLaC__INLINE void autocorrelation_pass_sse2_(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[], unsigned first, const unsigned vectors)
+{
+	__m128 s0 = _mm_setzero_ps(), s1 = s0, s2 = s0, s3 = s0, s4 = s0;
+	FLAC__real sums[20];
+	const FLAC__real *x = data + first;
+	const unsigned limit = data_len >= first + 4*vectors? data_len - first - 4*vectors + 1 : 0;
+	unsigned sample;
+
+	for(sample = 0; sample < limit; sample++) {
+		const __m128 d = _mm_load1_ps(data+sample);
+		s0 = _mm_add_ps(s0, _mm_mul_ps(d, _mm_loadu_ps(x+sample)));
+		if(vectors > 1) s1 = _mm_add_ps(s1, _mm_mul_ps(d, _mm_loadu_ps(x+sample+4)));
+		if(vectors > 2) s2 = _mm_add_ps(s2, _mm_mul_ps(d, _mm_loadu_ps(x+sample+8)));
+		if(vectors > 3) s3 = _mm_add_ps(s3, _mm_mul_ps(d, _mm_loadu_ps(x+sample+12)));
+		if(vectors > 4) s4 = _mm_add_ps(s4, _mm_mul_ps(d, _mm_loadu_ps(x+sample+16)));
+	}
+	_mm_storeu_ps(sums, s0);
+	_mm_storeu_ps(sums+4, s1);
+	_mm_storeu_ps(sums+8, s2);
+	_mm_storeu_ps(sums+12, s3);
+	_mm_storeu_ps(sums+16, s4);
+	autocorrelation_tail_(data, data_len, lag, autoc, sums, first, 4*vectors, limit);
+}
+
+void FLAC__lpc_compute_autocorrelation_intrin_sse2(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[])
+{
+	unsigned first;
+
+	FLAC__ASSERT(lag > 0);
+	FLAC__ASSERT(lag <= data_len);
+
+	for(first = 0; first < lag; first += 20) {
+		switch((lag - first + 3) / 4) {
+			case 1: autocorrelation_pass_sse2_(data, data_len, lag, autoc, first, 1); break;
+			case 2: autocorrelation_pass_sse2_(data, data_len, lag, autoc, first, 2); break;
+			case 3: autocorrelation_pass_sse2_(data, data_len, lag, autoc, first, 3); break;
+			case 4: autocorrelation_pass_sse2_(data, data_len, lag, autoc, first, 4); break;
+			default: autocorrelation_pass_sse2_(data, data_len, lag, autoc, first, 5); break;
+		}
+	}
+}
+
+static FLaC__INLINE FLAC__AVX2_TARGET void autocorrelation_pass_avx2_(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[], unsigned first, const unsigned vectors)
+{
+	__m256 s0 = _mm256_setzero_ps(), s1 = s0, s2 = s0, s3 = s0, s4 = s0;
+	FLAC__real sums[40];
+	const FLAC__real *x = data + first;
+	const unsigned limit = data_len >= first + 8*vectors? data_len - first - 8*vectors + 1 : 0;
+	unsigned sample;
+
+	for(sample = 0; sample < limit; sample++) {
+		const __m256 d = _mm256_broadcast_ss(data+sample);
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(d, _mm256_loadu_ps(x+sample)));
+		if(vectors > 1) s1 = _mm256_add_ps(s1, _mm256_mul_ps(d, _mm256_loadu_ps(x+sample+8)));
+		if(vectors > 2) s2 = _mm256_add_ps(s2, _mm256_mul_ps(d, _mm256_loadu_ps(x+sample+16)));
+		if(vectors > 3) s3 = _mm256_add_ps(s3, _mm256_mul_ps(d, _mm256_loadu_ps(x+sample+24)));
+		if(vectors > 4) s4 = _mm256_add_ps(s4, _mm256_mul_ps(d, _mm256_loadu_ps(x+sample+32)));
+	}
+	_mm256_storeu_ps(sums, s0);
+	_mm256_storeu_ps(sums+8, s1);
+	_mm256_storeu_ps(sums+16, s2);
+	_mm256_storeu_ps(sums+24, s3);
+	_mm256_storeu_ps(sums+32, s4);
+	autocorrelation_tail_(data, data_len, lag, autoc, sums, first, 8*vectors, limit);
+}
+
+FLAC__AVX2_TARGET
+void FLAC__lpc_compute_autocorrelation_intrin_avx2(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[])
+{
+	unsigned first;
+
+	FLAC__ASSERT(lag > 0);
+	FLAC__ASSERT(lag <= data_len);
+
+	for(first = 0; first < lag; first += 40) {
+		switch((lag - first + 7) / 8) {
+			case 1: autocorrelation_pass_avx2_(data, data_len, lag, autoc, first, 1); break;
+			case 2: autocorrelation_pass_avx2_(data, data_len, lag, autoc, first, 2); break;
+			case 3: autocorrelation_pass_avx2_(data, data_len, lag, autoc, first, 3); break;
+			case 4: autocorrelation_pass_avx2_(data, data_len, lag, autoc, first, 4); break;
+			default: autocorrelation_pass_avx2_(data, data_len, lag, autoc, first, 5); break;
+		}
+	}
+	_mm256_zeroupper();
+}
+
+#endif /* FLAC__CPU_X86_64 && FLAC__HAS_X86INTRIN */
+#endif /* FLAC__NO_ASM */
+#endif /* FLAC__INTEGER_ONLY_LIBRARY */
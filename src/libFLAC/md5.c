@@ -390,6 +390,23 @@ static void format_input_(FLAC__byte *buf, const FLAC__int32 * const signal[], u
  * Convert the incoming audio signal to a byte stream and FLAC__MD5Update it.
  */
 FLAC__bool FLAC__MD5Accumulate(FLAC__MD5Context *ctx, const FLAC__int32 * const signal[], unsigned channels, unsigned samples, unsigned bytes_per_sample)
+{
+	size_t bytes;
+
+	if(!FLAC__MD5Format(ctx, signal, channels, samples, bytes_per_sample, &bytes))
+		return false;
+
+	FLAC__MD5AccumulateFormatted(ctx, bytes);
+
+	return true;
+}
+
+/*
+ * Convert the incoming audio signal to a byte stream in the context's
+ * buffer without hashing it yet.  Until FLAC__MD5AccumulateFormatted()
+ * is called the signal may be reused but the context must be left alone.
+ */
+FLAC__bool FLAC__MD5Format(FLAC__MD5Context *ctx, const FLAC__int32 * const signal[], unsigned channels, unsigned samples, unsigned bytes_per_sample, size_t *bytes)
 {
 	const size_t bytes_needed = (size_t)channels * (size_t)samples * (size_t)bytes_per_sample;
 
@@ -412,7 +429,14 @@ FLAC__bool FLAC__MD5Accumulate(FLAC__MD5Context *ctx, const FLAC__int32 * const
 
 	format_input_(ctx->internal_buf, signal, channels, samples, bytes_per_sample);
 
-	FLAC__MD5Update(ctx, ctx->internal_buf, bytes_needed);
-
+	*bytes = bytes_needed;
 	return true;
 }
+
+/*
+ * FLAC__MD5Update the byte stream left by FLAC__MD5Format().
+ */
+void FLAC__MD5AccumulateFormatted(FLAC__MD5Context *ctx, size_t bytes)
+{
+	FLAC__MD5Update(ctx, ctx->internal_buf, bytes);
+}
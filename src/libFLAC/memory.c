@@ -33,10 +33,18 @@
 #  include <config.h>
 #endif
 
+#ifdef HAVE_MADVISE
+#include <sys/mman.h>
+#endif
 #include "private/memory.h"
 #include "FLAC/assert.h"
 #include "share/alloc.h"
 
+#if defined HAVE_MADVISE && defined MADV_HUGEPAGE && defined MAP_ANONYMOUS
+/* arenas at least this big get their own mapping, so that they can be huge pages */
+#define ARENA_HUGE_PAGE_SIZE_ ((size_t)2 << 20)
+#endif
+
 void *FLAC__memory_alloc_aligned(size_t bytes, void **aligned_address)
 {
 	void *x;
@@ -219,3 +227,47 @@ FLAC__bool FLAC__memory_alloc_aligned_real_array(unsigned elements, FLAC__real *
 }
 
 #endif
+
+void *FLAC__memory_alloc_arena(size_t bytes, void **aligned_address, FLAC__bool *mapped)
+{
+	FLAC__byte *x;
+
+	FLAC__ASSERT(0 != aligned_address);
+	FLAC__ASSERT(0 != mapped);
+
+#ifdef ARENA_HUGE_PAGE_SIZE_
+	if(bytes >= ARENA_HUGE_PAGE_SIZE_ && bytes <= SIZE_MAX - ARENA_HUGE_PAGE_SIZE_) {
+		const size_t length = (bytes + ARENA_HUGE_PAGE_SIZE_ - 1) & ~(ARENA_HUGE_PAGE_SIZE_ - 1);
+		void *map = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(map != MAP_FAILED) {
+			/* only a hint; without transparent huge pages the mapping works the same */
+			(void)madvise(map, length, MADV_HUGEPAGE);
+			*mapped = true;
+			*aligned_address = map;
+			return map;
+		}
+	}
+#endif
+
+	*mapped = false;
+	if(0 == (x = (FLAC__byte*)safe_malloc_add_2op_(bytes, /*+*/FLAC__MEMORY_ARENA_ALIGNMENT-1)))
+		return 0;
+	*aligned_address = x + (FLAC__MEMORY_ARENA_ALIGNMENT - (size_t)x % FLAC__MEMORY_ARENA_ALIGNMENT) % FLAC__MEMORY_ARENA_ALIGNMENT;
+	return x;
+}
+
+void FLAC__memory_free_arena(void *block, size_t bytes, FLAC__bool mapped)
+{
+	if(0 == block)
+		return;
+#ifdef ARENA_HUGE_PAGE_SIZE_
+	if(mapped) {
+		(void)munmap(block, (bytes + ARENA_HUGE_PAGE_SIZE_ - 1) & ~(ARENA_HUGE_PAGE_SIZE_ - 1));
+		return;
+	}
+#else
+	(void)bytes;
+	FLAC__ASSERT(!mapped);
+#endif
+	free(block);
+}
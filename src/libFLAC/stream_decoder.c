@@ -46,6 +46,11 @@
 #include <string.h> /* for memset/memcpy() */
 #include <sys/stat.h> /* for stat() */
 #include <sys/types.h> /* for off_t */
+#if defined HAVE_PREAD || defined HAVE_POSIX_FADVISE
+#include <errno.h>
+#include <fcntl.h> /* for posix_fadvise() */
+#include <unistd.h> /* for pread() */
+#endif
 #if defined _MSC_VER || defined __BORLANDC__ || defined __MINGW32__
 #if _MSC_VER <= 1600 || defined __BORLANDC__ /* @@@ [2G limit] */
 #define fseeko fseek
@@ -64,11 +69,16 @@
 #include "private/lpc.h"
 #include "private/md5.h"
 #include "private/memory.h"
+#include "private/thread_pool.h"
 
 #ifdef max
 #undef max
 #endif
 #define max(a,b) ((a)>(b)?(a):(b))
+#ifdef min
+#undef min
+#endif
+#define min(a,b) ((a)<(b)?(a):(b))
 
 /* adjust for compilers that can't understand using LLU suffix for uint64_t literals */
 #ifdef _MSC_VER
@@ -77,6 +87,11 @@
 #define FLAC__U64L(x) x##LLU
 #endif
 
+/* with FLAC__stream_decoder_set_read_size(), file reads start on a multiple of this */
+#define FLAC__STREAM_DECODER_READ_ALIGNMENT 4096
+/* a seek range is prefetched once it is no more than this many read buffers long */
+#define FLAC__STREAM_DECODER_PREFETCH_LIMIT 8
+
 
 /* technically this should be in an "export.c" but this is convenient enough */
 FLAC_API int FLAC_API_SUPPORTS_OGG_FLAC =
@@ -130,16 +145,25 @@ static FLAC__StreamDecoderReadStatus read_callback_ogg_aspect_(const FLAC__Strea
 static FLAC__OggDecoderAspectReadStatus read_callback_proxy_(const void *void_decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 #endif
 static FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static FLAC__StreamDecoderWriteStatus write_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static FLAC__bool write_pending_batch_(FLAC__StreamDecoder *decoder);
+static FLAC__StreamDecoderWriteStatus deliver_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static void summarize_signal_(const FLAC__int32 signal[], unsigned data_len, unsigned bucket_size, FLAC__int32 summary[]);
+static void md5_accumulate_task_(void *data);
 static void send_error_to_client_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status);
 static FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 stream_length, FLAC__uint64 target_sample);
 #if FLAC__HAS_OGG
 static FLAC__bool seek_to_absolute_sample_ogg_(FLAC__StreamDecoder *decoder, FLAC__uint64 stream_length, FLAC__uint64 target_sample);
 #endif
+#if defined HAVE_PREAD
+static FLAC__bool fill_read_buffer_(const FLAC__StreamDecoder *decoder);
+#endif
 static FLAC__StreamDecoderReadStatus file_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 static FLAC__StreamDecoderSeekStatus file_seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
 static FLAC__StreamDecoderTellStatus file_tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
 static FLAC__StreamDecoderLengthStatus file_length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data);
 static FLAC__bool file_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data);
+static void file_prefetch_(FLAC__StreamDecoder *decoder, FLAC__uint64 lower_bound, FLAC__uint64 upper_bound);
 
 /***********************************************************************
  *
@@ -170,8 +194,21 @@ typedef struct FLAC__StreamDecoderPrivate {
 	FLAC__bool (*local_bitreader_read_rice_signed_block)(FLAC__BitReader *br, int vals[], unsigned nvals, unsigned parameter);
 	void *client_data;
 	FILE *file; /* only used if FLAC__stream_decoder_init_file()/FLAC__stream_decoder_init_file() called, else NULL */
+	FLAC__byte *read_buffer; /* only used if the file is read with pread() because protected_->read_size is set, else NULL */
+	size_t read_buffer_capacity; /* protected_->read_size rounded up to a multiple of FLAC__STREAM_DECODER_READ_ALIGNMENT */
+	size_t read_buffer_bytes; /* number of bytes in read_buffer */
+	FLAC__uint64 read_buffer_offset; /* file offset of read_buffer[0]; always a multiple of FLAC__STREAM_DECODER_READ_ALIGNMENT */
+	FLAC__uint64 read_position; /* file offset of the next byte to hand to the read callback */
+	FLAC__bool read_eof;
+	FLAC__uint64 prefetch_lower, prefetch_upper; /* the part of the file file_prefetch_() last hinted during the current seek; empty if none */
 	FLAC__BitReader *input;
 	FLAC__int32 *output[FLAC__MAX_CHANNELS];
+	FLAC__int32 *summary[FLAC__MAX_CHANNELS]; /* only allocated in waveform summary mode; min/max/RMS triples, one per bucket */
+	FLAC__int32 *batch[FLAC__MAX_CHANNELS]; /* only allocated when batching writes; holds the signal of frames not yet passed to the client */
+	unsigned batch_capacity, batch_channels;
+	unsigned batch_samples; /* number of samples (per channel) currently held in batch[] */
+	FLAC__bool batch_has_signal; /* false if the held frames have no signal, i.e. in CRC-check-only mode */
+	FLAC__Frame batch_frame; /* copy of the first held frame; the blocksize is set to batch_samples when the batch is delivered */
 	FLAC__int32 *residual[FLAC__MAX_CHANNELS]; /* WATCHOUT: these are the aligned pointers; the real pointers that should be free()'d are residual_unaligned[] below */
 	FLAC__EntropyCodingMethod_PartitionedRiceContents partitioned_rice_contents[FLAC__MAX_CHANNELS];
 	unsigned output_capacity, output_channels;
@@ -195,6 +232,8 @@ typedef struct FLAC__StreamDecoderPrivate {
 	FLAC__bool is_seeking;
 	FLAC__MD5Context md5context;
 	FLAC__byte computed_md5sum[16]; /* this is the sum we computed from the decoded data */
+	FLAC__ThreadPoolQueue *thread_pool_queue; /* our queue in protected_->thread_pool, if one is set */
+	size_t md5_bytes; /* size of the formatted signal in md5context waiting to be hashed by md5_accumulate_task_() */
 	/* (the rest of these are only used for seeking) */
 	FLAC__Frame last_frame; /* holds the info of the last frame we seeked to */
 	FLAC__uint64 first_frame_offset; /* hint to the seek routine of where in the stream the first audio frame starts */
@@ -318,8 +357,13 @@ FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void)
 
 	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
 		decoder->private_->output[i] = 0;
+		decoder->private_->summary[i] = 0;
+		decoder->private_->batch[i] = 0;
 		decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
 	}
+	decoder->private_->batch_capacity = 0;
+	decoder->private_->batch_channels = 0;
+	decoder->private_->batch_samples = 0;
 
 	decoder->private_->output_capacity = 0;
 	decoder->private_->output_channels = 0;
@@ -329,6 +373,8 @@ FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void)
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&decoder->private_->partitioned_rice_contents[i]);
 
 	decoder->private_->file = 0;
+	decoder->private_->read_buffer = 0;
+	decoder->private_->thread_pool_queue = 0;
 
 	set_defaults_(decoder);
 
@@ -449,6 +495,11 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 		return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
 	}
 
+	if(0 != decoder->protected_->thread_pool && 0 == (decoder->private_->thread_pool_queue = FLAC__thread_pool_attach(decoder->protected_->thread_pool))) {
+		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+		return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
+	}
+
 	decoder->private_->read_callback = read_callback;
 	decoder->private_->seek_callback = seek_callback;
 	decoder->private_->tell_callback = tell_callback;
@@ -463,7 +514,7 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 	decoder->private_->has_stream_info = false;
 	decoder->private_->cached = false;
 
-	decoder->private_->do_md5_checking = decoder->protected_->md5_checking;
+	decoder->private_->do_md5_checking = decoder->protected_->md5_checking && !decoder->protected_->crc_check_only;
 	decoder->private_->is_seeking = false;
 
 	decoder->private_->internal_reset_hack = true; /* so the following reset does not try to rewind the input */
@@ -560,6 +611,26 @@ static FLAC__StreamDecoderInitStatus init_FILE_internal_(
 
 	decoder->private_->file = file;
 
+#if defined HAVE_PREAD
+	if(decoder->protected_->read_size > 0 && file != stdin) {
+		const off_t pos = ftello(file);
+		if(pos >= 0) {
+			decoder->private_->read_buffer_capacity = (decoder->protected_->read_size + FLAC__STREAM_DECODER_READ_ALIGNMENT - 1) & ~(size_t)(FLAC__STREAM_DECODER_READ_ALIGNMENT - 1);
+			if(0 == (decoder->private_->read_buffer = (FLAC__byte*)malloc(decoder->private_->read_buffer_capacity))) {
+				decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+				return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
+			}
+			decoder->private_->read_buffer_bytes = 0;
+			decoder->private_->read_buffer_offset = 0;
+			decoder->private_->read_position = (FLAC__uint64)pos;
+			decoder->private_->read_eof = false;
+#if defined HAVE_POSIX_FADVISE
+			(void)posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		}
+	}
+#endif
+
 	return init_stream_internal_(
 		decoder,
 		file_read_callback_,
@@ -668,6 +739,15 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 	if(decoder->protected_->state == FLAC__STREAM_DECODER_UNINITIALIZED)
 		return true;
 
+	/* hand over anything still being held for a batched write */
+	(void)write_pending_batch_(decoder);
+
+	/* let any MD5 work still in the pool finish before finalizing */
+	if(0 != decoder->private_->thread_pool_queue) {
+		FLAC__thread_pool_detach(decoder->private_->thread_pool_queue);
+		decoder->private_->thread_pool_queue = 0;
+	}
+
 	/* see the comment in FLAC__seekable_stream_decoder_reset() as to why we
 	 * always call FLAC__MD5Final()
 	 */
@@ -690,6 +770,14 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 			free(decoder->private_->output[i]-4);
 			decoder->private_->output[i] = 0;
 		}
+		if(0 != decoder->private_->summary[i]) {
+			free(decoder->private_->summary[i]);
+			decoder->private_->summary[i] = 0;
+		}
+		if(0 != decoder->private_->batch[i]) {
+			free(decoder->private_->batch[i]);
+			decoder->private_->batch[i] = 0;
+		}
 		if(0 != decoder->private_->residual_unaligned[i]) {
 			free(decoder->private_->residual_unaligned[i]);
 			decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
@@ -697,6 +785,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 	}
 	decoder->private_->output_capacity = 0;
 	decoder->private_->output_channels = 0;
+	decoder->private_->batch_capacity = 0;
+	decoder->private_->batch_channels = 0;
+	decoder->private_->batch_samples = 0;
 
 #if FLAC__HAS_OGG
 	if(decoder->private_->is_ogg)
@@ -708,6 +799,10 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 			fclose(decoder->private_->file);
 		decoder->private_->file = 0;
 	}
+	if(0 != decoder->private_->read_buffer) {
+		free(decoder->private_->read_buffer);
+		decoder->private_->read_buffer = 0;
+	}
 
 	if(decoder->private_->do_md5_checking) {
 		if(memcmp(decoder->private_->stream_info.data.stream_info.md5sum, decoder->private_->computed_md5sum, 16))
@@ -749,6 +844,66 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *d
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_set_crc_check_only(FLAC__StreamDecoder *decoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->crc_check_only = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_channel_mask(FLAC__StreamDecoder *decoder, FLAC__uint32 value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->channel_mask = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_waveform_summary(FLAC__StreamDecoder *decoder, unsigned samples_per_bucket)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->waveform_summary = samples_per_bucket;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_write_batch_size(FLAC__StreamDecoder *decoder, unsigned samples)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->write_batch_size = samples;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_read_size(FLAC__StreamDecoder *decoder, unsigned value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->read_size = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_thread_pool(FLAC__StreamDecoder *decoder, FLAC__ThreadPool *pool)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->thread_pool = pool;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_decoder_set_metadata_respond(FLAC__StreamDecoder *decoder, FLAC__MetadataType type)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -884,6 +1039,48 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_md5_checking(const FLAC__StreamDeco
 	return decoder->protected_->md5_checking;
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_get_crc_check_only(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->crc_check_only;
+}
+
+FLAC_API FLAC__uint32 FLAC__stream_decoder_get_channel_mask(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->channel_mask;
+}
+
+FLAC_API unsigned FLAC__stream_decoder_get_waveform_summary(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->waveform_summary;
+}
+
+FLAC_API unsigned FLAC__stream_decoder_get_write_batch_size(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->write_batch_size;
+}
+
+FLAC_API unsigned FLAC__stream_decoder_get_read_size(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->read_size;
+}
+
+FLAC_API FLAC__ThreadPool *FLAC__stream_decoder_get_thread_pool(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->thread_pool;
+}
+
 FLAC_API FLAC__uint64 FLAC__stream_decoder_get_total_samples(const FLAC__StreamDecoder *decoder)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -954,6 +1151,10 @@ FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder)
 	FLAC__ASSERT(0 != decoder->private_);
 	FLAC__ASSERT(0 != decoder->protected_);
 
+	/* frames held for a batched write were decoded before the flush so they still go to the client */
+	if(!write_pending_batch_(decoder))
+		return false;
+
 	decoder->private_->samples_decoded = 0;
 	decoder->private_->do_md5_checking = false;
 
@@ -1010,7 +1211,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_reset(FLAC__StreamDecoder *decoder)
 		decoder->private_->seek_table.data.seek_table.points = 0;
 		decoder->private_->has_seek_table = false;
 	}
-	decoder->private_->do_md5_checking = decoder->protected_->md5_checking;
+	decoder->private_->do_md5_checking = decoder->protected_->md5_checking && !decoder->protected_->crc_check_only;
 	/*
 	 * This goes in reset() and not flush() because according to the spec, a
 	 * fixed-blocksize stream must stay that way through the whole stream.
@@ -1023,6 +1224,8 @@ FLAC_API FLAC__bool FLAC__stream_decoder_reset(FLAC__StreamDecoder *decoder)
 	 * FLAC__stream_decoder_finish() to make sure things are always cleaned up
 	 * properly.
 	 */
+	if(0 != decoder->private_->thread_pool_queue)
+		FLAC__thread_pool_wait(decoder->private_->thread_pool_queue);
 	FLAC__MD5Init(&decoder->private_->md5context);
 
 	decoder->private_->first_frame_offset = 0;
@@ -1059,6 +1262,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_process_single(FLAC__StreamDecoder *dec
 					return true; /* above function sets the status for us */
 				break;
 			case FLAC__STREAM_DECODER_END_OF_STREAM:
+				return write_pending_batch_(decoder);
 			case FLAC__STREAM_DECODER_ABORTED:
 				return true;
 			default:
@@ -1120,6 +1324,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_process_until_end_of_stream(FLAC__Strea
 					return false; /* above function sets the status for us */
 				break;
 			case FLAC__STREAM_DECODER_END_OF_STREAM:
+				return write_pending_batch_(decoder);
 			case FLAC__STREAM_DECODER_ABORTED:
 				return true;
 			default:
@@ -1151,6 +1356,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_skip_single_frame(FLAC__StreamDecoder *
 					return true; /* above function sets the status for us */
 				break;
 			case FLAC__STREAM_DECODER_END_OF_STREAM:
+				return write_pending_batch_(decoder);
 			case FLAC__STREAM_DECODER_ABORTED:
 				return true;
 			default:
@@ -1186,7 +1392,12 @@ FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(FLAC__StreamDecoder *deco
 	if(FLAC__stream_decoder_get_total_samples(decoder) > 0 && sample >= FLAC__stream_decoder_get_total_samples(decoder))
 		return false;
 
+	/* hand over anything held for a batched write before we move */
+	if(!write_pending_batch_(decoder))
+		return false;
+
 	decoder->private_->is_seeking = true;
+	decoder->private_->prefetch_lower = decoder->private_->prefetch_upper = 0;
 
 	/* turn off md5 checking if a seek is attempted */
 	decoder->private_->do_md5_checking = false;
@@ -1267,6 +1478,12 @@ void set_defaults_(FLAC__StreamDecoder *decoder)
 	decoder->private_->metadata_filter_ids_count = 0;
 
 	decoder->protected_->md5_checking = false;
+	decoder->protected_->crc_check_only = false;
+	decoder->protected_->channel_mask = 0xffffffff;
+	decoder->protected_->waveform_summary = 0;
+	decoder->protected_->write_batch_size = 0;
+	decoder->protected_->read_size = 0;
+	decoder->protected_->thread_pool = 0;
 
 #if FLAC__HAS_OGG
 	FLAC__ogg_decoder_aspect_set_defaults(&decoder->protected_->ogg_decoder_aspect);
@@ -1309,6 +1526,10 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigne
 			free(decoder->private_->output[i]-4);
 			decoder->private_->output[i] = 0;
 		}
+		if(0 != decoder->private_->summary[i]) {
+			free(decoder->private_->summary[i]);
+			decoder->private_->summary[i] = 0;
+		}
 		if(0 != decoder->private_->residual_unaligned[i]) {
 			free(decoder->private_->residual_unaligned[i]);
 			decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
@@ -1330,6 +1551,15 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigne
 		memset(tmp, 0, sizeof(FLAC__int32)*4);
 		decoder->private_->output[i] = tmp + 4;
 
+		if(decoder->protected_->waveform_summary) {
+			/* a batched write can hold up to write_batch_size-1 samples plus one more frame */
+			const unsigned buckets = (size + decoder->protected_->write_batch_size + decoder->protected_->waveform_summary - 1) / decoder->protected_->waveform_summary;
+			if(0 == (decoder->private_->summary[i] = (FLAC__int32*)safe_malloc_mul_2op_(sizeof(FLAC__int32)*3, /*times*/buckets))) {
+				decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
+		}
+
 		/* WATCHOUT:
 		 * minimum of quadword alignment for PPC vector optimizations is REQUIRED:
 		 */
@@ -1999,7 +2229,8 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	unsigned i;
 	FLAC__int32 mid, side;
 	unsigned frame_crc; /* the one we calculate from the input stream */
-	FLAC__uint32 x;
+	FLAC__uint32 x, all_channels, restore_mask;
+	FLAC__bool do_restore;
 
 	*got_a_frame = false;
 
@@ -2015,6 +2246,44 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 		return true;
 	if(!allocate_output_(decoder, decoder->private_->frame.header.blocksize, decoder->private_->frame.header.channels))
 		return false;
+
+	/* in CRC-check-only mode we still have to fully decode the frame we are seeking to, but not the ones passed on the way */
+	do_restore = do_full_decode;
+	if(do_restore && decoder->protected_->crc_check_only) {
+		const FLAC__uint64 first = decoder->private_->frame.header.number.sample_number;
+		do_restore =
+			decoder->private_->is_seeking &&
+			decoder->private_->frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER &&
+			first <= decoder->private_->target_sample &&
+			decoder->private_->target_sample < first + decoder->private_->frame.header.blocksize;
+	}
+
+	/*
+	 * figure out which channels need restoring; a wanted channel that is
+	 * stereo-decorrelated may also need its partner
+	 */
+	all_channels = (1u << decoder->private_->frame.header.channels) - 1;
+	restore_mask = do_restore? decoder->protected_->channel_mask & all_channels : 0;
+	switch(decoder->private_->frame.header.channel_assignment) {
+		case FLAC__CHANNEL_ASSIGNMENT_LEFT_SIDE: /* right = left - side */
+			if(restore_mask & 2)
+				restore_mask |= 3;
+			break;
+		case FLAC__CHANNEL_ASSIGNMENT_RIGHT_SIDE: /* left = side + right */
+			if(restore_mask & 1)
+				restore_mask |= 3;
+			break;
+		case FLAC__CHANNEL_ASSIGNMENT_MID_SIDE:
+			if(restore_mask & 3)
+				restore_mask |= 3;
+			break;
+		default:
+			break;
+	}
+	/* the MD5 signature covers all channels so we can't check it if any are left out */
+	if(do_restore && (decoder->protected_->channel_mask & all_channels) != all_channels)
+		decoder->private_->do_md5_checking = false;
+
 	for(channel = 0; channel < decoder->private_->frame.header.channels; channel++) {
 		/*
 		 * first figure the correct bits-per-sample of the subframe
@@ -2045,7 +2314,7 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 		/*
 		 * now read it
 		 */
-		if(!read_subframe_(decoder, channel, bps, do_full_decode))
+		if(!read_subframe_(decoder, channel, bps, /*do_full_decode=*/(restore_mask >> channel) & 1))
 			return false;
 		if(decoder->protected_->state == FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC) /* means bad sync or got corruption */
 			return true;
@@ -2062,7 +2331,8 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, FLAC__FRAME_FOOTER_CRC_LEN))
 		return false; /* read_callback_ sets the state for us */
 	if(frame_crc == x) {
-		if(do_full_decode) {
+		/* with a partial channel mask we may only have restored one channel of a decorrelated pair */
+		if(do_restore && (decoder->private_->frame.header.channel_assignment == FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT || (restore_mask & 3) == 3)) {
 			/* Undo any special channel coding */
 			switch(decoder->private_->frame.header.channel_assignment) {
 				case FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT:
@@ -2105,7 +2375,7 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	else {
 		/* Bad frame, emit error and zero the output signal */
 		send_error_to_client_(decoder, FLAC__STREAM_DECODER_ERROR_STATUS_FRAME_CRC_MISMATCH);
-		if(do_full_decode) {
+		if(do_restore) {
 			for(channel = 0; channel < decoder->private_->frame.header.channels; channel++) {
 				memset(decoder->private_->output[channel], 0, sizeof(FLAC__int32) * decoder->private_->frame.header.blocksize);
 			}
@@ -2130,7 +2400,8 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 
 	/* write it */
 	if(do_full_decode) {
-		if(write_audio_frame_to_client_(decoder, &decoder->private_->frame, (const FLAC__int32 * const *)decoder->private_->output) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE)
+		/* in CRC-check-only mode the output was never restored so the client gets a NULL buffer */
+		if(write_audio_frame_to_client_(decoder, &decoder->private_->frame, do_restore? (const FLAC__int32 * const *)decoder->private_->output : 0) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE)
 			return false;
 	}
 
@@ -2936,11 +3207,11 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 				decoder->private_->last_frame.header.blocksize -= delta;
 				decoder->private_->last_frame.header.number.sample_number += (FLAC__uint64)delta;
 				/* write the relevant samples */
-				return decoder->private_->write_callback(decoder, &decoder->private_->last_frame, newbuffer, decoder->private_->client_data);
+				return write_to_client_(decoder, &decoder->private_->last_frame, newbuffer);
 			}
 			else {
 				/* write the relevant samples */
-				return decoder->private_->write_callback(decoder, frame, buffer, decoder->private_->client_data);
+				return write_to_client_(decoder, frame, buffer);
 			}
 		}
 		else {
@@ -2955,10 +3226,145 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 		if(!decoder->private_->has_stream_info)
 			decoder->private_->do_md5_checking = false;
 		if(decoder->private_->do_md5_checking) {
-			if(!FLAC__MD5Accumulate(&decoder->private_->md5context, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8))
+			if(0 != decoder->private_->thread_pool_queue) {
+				/* the signal is copied out here and hashed in the pool while we go on decoding */
+				FLAC__thread_pool_wait(decoder->private_->thread_pool_queue);
+				if(!FLAC__MD5Format(&decoder->private_->md5context, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8, &decoder->private_->md5_bytes))
+					return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+				FLAC__thread_pool_submit(decoder->private_->thread_pool_queue, md5_accumulate_task_, decoder->private_);
+			}
+			else if(!FLAC__MD5Accumulate(&decoder->private_->md5context, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8))
 				return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 		}
-		return decoder->private_->write_callback(decoder, frame, buffer, decoder->private_->client_data);
+		return write_to_client_(decoder, frame, buffer);
+	}
+}
+
+FLAC__StreamDecoderWriteStatus write_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
+{
+	unsigned channel;
+	const unsigned channels = frame->header.channels, blocksize = frame->header.blocksize;
+
+	if(0 == decoder->protected_->write_batch_size)
+		return deliver_to_client_(decoder, frame, buffer);
+
+	FLAC__ASSERT(frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+
+	/* frames can only be joined if they are contiguous and have the same format */
+	if(decoder->private_->batch_samples > 0 && (
+		channels != decoder->private_->batch_frame.header.channels ||
+		frame->header.bits_per_sample != decoder->private_->batch_frame.header.bits_per_sample ||
+		frame->header.sample_rate != decoder->private_->batch_frame.header.sample_rate ||
+		frame->header.number.sample_number != decoder->private_->batch_frame.header.number.sample_number + decoder->private_->batch_samples ||
+		(0 != buffer) != decoder->private_->batch_has_signal
+	)) {
+		if(!write_pending_batch_(decoder))
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+
+	if(0 != buffer) {
+		if(decoder->private_->batch_samples + blocksize > decoder->private_->batch_capacity || channels > decoder->private_->batch_channels) {
+			const unsigned capacity = max(decoder->private_->batch_samples + blocksize, decoder->private_->batch_capacity);
+			for(channel = 0; channel < channels; channel++) {
+				FLAC__int32 *tmp = (FLAC__int32*)safe_realloc_mul_2op_(decoder->private_->batch[channel], sizeof(FLAC__int32), /*times*/capacity);
+				if(0 == tmp) {
+					decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+					return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+				}
+				decoder->private_->batch[channel] = tmp;
+			}
+			decoder->private_->batch_capacity = capacity;
+			decoder->private_->batch_channels = max(channels, decoder->private_->batch_channels);
+		}
+		for(channel = 0; channel < channels; channel++)
+			memcpy(decoder->private_->batch[channel] + decoder->private_->batch_samples, buffer[channel], sizeof(FLAC__int32) * blocksize);
+	}
+	if(0 == decoder->private_->batch_samples) {
+		decoder->private_->batch_frame = *frame;
+		decoder->private_->batch_has_signal = (0 != buffer);
+	}
+	decoder->private_->batch_samples += blocksize;
+
+	if(decoder->private_->batch_samples < decoder->protected_->write_batch_size)
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+
+	return write_pending_batch_(decoder)? FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE : FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+}
+
+FLAC__bool write_pending_batch_(FLAC__StreamDecoder *decoder)
+{
+	if(0 == decoder->private_->batch_samples)
+		return true;
+
+	/* once the client has aborted (from any callback) it gets nothing more, held samples included */
+	if(decoder->protected_->state == FLAC__STREAM_DECODER_ABORTED) {
+		decoder->private_->batch_samples = 0;
+		return true;
+	}
+
+	decoder->private_->batch_frame.header.blocksize = decoder->private_->batch_samples;
+	/* reset first so a client that aborts doesn't get the same samples again */
+	decoder->private_->batch_samples = 0;
+	if(deliver_to_client_(decoder, &decoder->private_->batch_frame, decoder->private_->batch_has_signal? (const FLAC__int32 * const *)decoder->private_->batch : 0) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE) {
+		decoder->protected_->state = FLAC__STREAM_DECODER_ABORTED;
+		return false;
+	}
+	return true;
+}
+
+FLAC__StreamDecoderWriteStatus deliver_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
+{
+	/* in waveform summary mode the client gets the per-bucket summaries instead of the signal */
+	if(decoder->protected_->waveform_summary && 0 != buffer) {
+		unsigned channel;
+		for(channel = 0; channel < frame->header.channels; channel++) {
+			if(decoder->protected_->channel_mask & (1u << channel))
+				summarize_signal_(buffer[channel], frame->header.blocksize, decoder->protected_->waveform_summary, decoder->private_->summary[channel]);
+		}
+		buffer = (const FLAC__int32 * const *)decoder->private_->summary;
+	}
+	return decoder->private_->write_callback(decoder, frame, buffer, decoder->private_->client_data);
+}
+
+void md5_accumulate_task_(void *data)
+{
+	FLAC__StreamDecoderPrivate *private_ = (FLAC__StreamDecoderPrivate*)data;
+	FLAC__MD5AccumulateFormatted(&private_->md5context, private_->md5_bytes);
+}
+
+void summarize_signal_(const FLAC__int32 signal[], unsigned data_len, unsigned bucket_size, FLAC__int32 summary[])
+{
+	unsigned i, j, n;
+	FLAC__int32 x, lo, hi;
+	FLAC__uint64 sum, root, bit;
+
+	for(i = 0; i < data_len; i += n) {
+		n = min(bucket_size, data_len - i);
+		lo = hi = signal[i];
+		sum = 0;
+		/* OPT: kept free of branches and early exits so the compiler can vectorize it */
+		for(j = i; j < i + n; j++) {
+			x = signal[j];
+			lo = min(lo, x);
+			hi = max(hi, x);
+			sum += (FLAC__uint64)((FLAC__int64)x * x);
+		}
+		sum /= n;
+		/* integer square root of the mean square */
+		root = 0;
+		for(bit = FLAC__U64L(1) << 62; bit > sum; bit >>= 2)
+			;
+		for( ; bit; bit >>= 2) {
+			if(sum >= root + bit) {
+				sum -= root + bit;
+				root = (root >> 1) + bit;
+			}
+			else
+				root >>= 1;
+		}
+		*summary++ = lo;
+		*summary++ = hi;
+		*summary++ = (FLAC__int32)root;
 	}
 }
 
@@ -3085,6 +3491,8 @@ FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 s
 	if(upper_bound_sample == lower_bound_sample)
 		upper_bound_sample++;
 
+	file_prefetch_(decoder, lower_bound, upper_bound);
+
 	decoder->private_->target_sample = target_sample;
 	while(1) {
 		/* check if the bounds are still ok */
@@ -3179,6 +3587,7 @@ FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 s
 			}
 			approx_bytes_per_frame = (unsigned)(2 * (lower_bound - pos) / 3 + 16);
 		}
+		file_prefetch_(decoder, lower_bound, upper_bound);
 	}
 
 	return true;
@@ -3243,6 +3652,7 @@ FLAC__bool seek_to_absolute_sample_ogg_(FLAC__StreamDecoder *decoder, FLAC__uint
 			}
 
 			/* physical seek */
+			file_prefetch_(decoder, left_pos, right_pos);
 			if(decoder->private_->seek_callback((FLAC__StreamDecoder*)decoder, (FLAC__uint64)pos, decoder->private_->client_data) != FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
 				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
 				return false;
@@ -3321,11 +3731,49 @@ FLAC__bool seek_to_absolute_sample_ogg_(FLAC__StreamDecoder *decoder, FLAC__uint
 }
 #endif
 
+#if defined HAVE_PREAD
+FLAC__bool fill_read_buffer_(const FLAC__StreamDecoder *decoder)
+{
+	const FLAC__uint64 offset = decoder->private_->read_position & ~(FLAC__uint64)(FLAC__STREAM_DECODER_READ_ALIGNMENT - 1);
+	ssize_t bytes;
+
+	do
+		bytes = pread(fileno(decoder->private_->file), decoder->private_->read_buffer, decoder->private_->read_buffer_capacity, (off_t)offset);
+	while(bytes < 0 && errno == EINTR);
+	if(bytes < 0)
+		return false;
+	decoder->private_->read_buffer_offset = offset;
+	decoder->private_->read_buffer_bytes = (size_t)bytes;
+	return true;
+}
+#endif
+
 FLAC__StreamDecoderReadStatus file_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
 {
 	(void)client_data;
 
 	if(*bytes > 0) {
+#if defined HAVE_PREAD
+		if(0 != decoder->private_->read_buffer) {
+			FLAC__StreamDecoderPrivate *private_ = decoder->private_;
+			size_t n;
+			if(private_->read_position < private_->read_buffer_offset || private_->read_position >= private_->read_buffer_offset + private_->read_buffer_bytes) {
+				if(!fill_read_buffer_(decoder))
+					return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+				if(private_->read_position >= private_->read_buffer_offset + private_->read_buffer_bytes) {
+					private_->read_eof = true;
+					*bytes = 0;
+					return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+				}
+			}
+			n = (size_t)(private_->read_buffer_offset + private_->read_buffer_bytes - private_->read_position);
+			if(*bytes > n)
+				*bytes = n;
+			memcpy(buffer, private_->read_buffer + (size_t)(private_->read_position - private_->read_buffer_offset), *bytes);
+			private_->read_position += *bytes;
+			return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+		}
+#endif
 		*bytes = fread(buffer, sizeof(FLAC__byte), *bytes, decoder->private_->file);
 		if(ferror(decoder->private_->file))
 			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
@@ -3344,6 +3792,12 @@ FLAC__StreamDecoderSeekStatus file_seek_callback_(const FLAC__StreamDecoder *dec
 
 	if(decoder->private_->file == stdin)
 		return FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED;
+	else if(0 != decoder->private_->read_buffer) {
+		/* the buffer is kept; seeks during bisection often land in it again */
+		decoder->private_->read_position = absolute_byte_offset;
+		decoder->private_->read_eof = false;
+		return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+	}
 	else if(fseeko(decoder->private_->file, (off_t)absolute_byte_offset, SEEK_SET) < 0)
 		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
 	else
@@ -3357,6 +3811,10 @@ FLAC__StreamDecoderTellStatus file_tell_callback_(const FLAC__StreamDecoder *dec
 
 	if(decoder->private_->file == stdin)
 		return FLAC__STREAM_DECODER_TELL_STATUS_UNSUPPORTED;
+	else if(0 != decoder->private_->read_buffer) {
+		*absolute_byte_offset = decoder->private_->read_position;
+		return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+	}
 	else if((pos = ftello(decoder->private_->file)) < 0)
 		return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
 	else {
@@ -3384,5 +3842,32 @@ FLAC__bool file_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_d
 {
 	(void)client_data;
 
+	if(0 != decoder->private_->read_buffer)
+		return decoder->private_->read_eof;
 	return feof(decoder->private_->file)? true : false;
 }
+
+/*
+ * Tells the OS that [lower_bound, upper_bound) will be read soon once the
+ * seek bisection has narrowed down to a range that is small enough, so
+ * it can start bringing the range into the page cache in the background.
+ * This is only a hint: the remaining steps of the search still do their
+ * own reads, they just find the data cached instead of waiting for the
+ * disk each time.  The search window only shrinks, so the hint is given
+ * again only if it moves outside the range already hinted for this seek.
+ */
+void file_prefetch_(FLAC__StreamDecoder *decoder, FLAC__uint64 lower_bound, FLAC__uint64 upper_bound)
+{
+#if defined HAVE_POSIX_FADVISE
+	if(0 != decoder->private_->read_buffer && upper_bound > lower_bound && upper_bound - lower_bound <= FLAC__STREAM_DECODER_PREFETCH_LIMIT * (FLAC__uint64)decoder->private_->read_buffer_capacity) {
+		lower_bound &= ~(FLAC__uint64)(FLAC__STREAM_DECODER_READ_ALIGNMENT - 1);
+		if(lower_bound >= decoder->private_->prefetch_lower && upper_bound <= decoder->private_->prefetch_upper)
+			return;
+		(void)posix_fadvise(fileno(decoder->private_->file), (off_t)lower_bound, (off_t)(upper_bound - lower_bound), POSIX_FADV_WILLNEED);
+		decoder->private_->prefetch_lower = lower_bound;
+		decoder->private_->prefetch_upper = upper_bound;
+	}
+#else
+	(void)decoder, (void)lower_bound, (void)upper_bound;
+#endif
+}
@@ -42,10 +42,18 @@
 #include <fcntl.h> /* for _O_BINARY */
 #endif
 #include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h> /* for malloc() */
 #include <string.h> /* for memcpy() */
 #include <sys/types.h> /* for off_t */
+#if defined _WIN32 && !defined __CYGWIN__
+#include <windows.h> /* for QueryPerformanceCounter() */
+#elif defined HAVE_CLOCK_GETTIME
+#include <time.h> /* for clock_gettime() */
+#else
+#include <sys/time.h> /* for gettimeofday() */
+#endif
 #if defined _MSC_VER || defined __BORLANDC__ || defined __MINGW32__
 #if _MSC_VER <= 1600 || defined __BORLANDC__ /* @@@ [2G limit] */
 #define fseeko fseek
@@ -65,10 +73,13 @@
 #include "private/lpc.h"
 #include "private/md5.h"
 #include "private/memory.h"
+#include "private/thread_pool.h"
+#include "private/uring_writer.h"
 #if FLAC__HAS_OGG
 #include "private/ogg_helper.h"
 #include "private/ogg_mapping.h"
 #endif
+#include "private/stream_encoder.h"
 #include "private/stream_encoder_framing.h"
 #include "private/window.h"
 
@@ -98,6 +109,11 @@
  */
 #undef ENABLE_RICE_PARAMETER_SEARCH 
 
+#ifndef M_LN2
+/* math.h in VC++ doesn't seem to have this (how Microsoft is that?) */
+#define M_LN2 0.69314718055994530942
+#endif
+
 
 typedef struct {
 	FLAC__int32 *data[FLAC__MAX_CHANNELS];
@@ -111,6 +127,139 @@ typedef struct {
 	unsigned bytes;
 } verify_output;
 
+/* what one pass over a subframe's signal tells us before any modeling; see analyze_signal_() */
+typedef struct {
+	FLAC__int32 min, max;
+	FLAC__uint32 peak;                                /* the largest magnitude, max(-min, max) */
+} signal_analysis;
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+/* what the LPC search learns from one window of the signal, before it tries any orders; see compute_lpc_model_() */
+typedef struct {
+	FLAC__real lp_coeff[FLAC__MAX_LPC_ORDER][FLAC__MAX_LPC_ORDER];
+	FLAC__double lpc_error[FLAC__MAX_LPC_ORDER];
+	unsigned min_lpc_order, max_lpc_order;            /* the orders to try */
+} lpc_model;
+#endif
+
+/*
+ * Scratch space for one subframe search.  Searches that may run at the
+ * same time (see FLAC__stream_encoder_set_parallel_subframes()) each get
+ * their own.
+ */
+typedef struct {
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	FLAC__real *windowed_signal;                      /* the integer_signal[] * current window[] */
+	lpc_model *lpc_model;                             /* the model of the current window, or with lpc_search_stripe_orders, of every active window */
+#endif
+	FLAC__uint64 *abs_residual_partition_sums;        /* workspace where the sum of abs(candidate residual) for each partition is stored */
+	unsigned *raw_bits_per_partition;                 /* workspace where the sum of silog2(candidate residual) for each partition is stored */
+	FLAC__EntropyCodingMethod_PartitionedRiceContents partitioned_rice_contents_extra[2]; /* for find_best_partition_order_() */
+	struct lpc_search_task *lpc_task;                 /* the other tasks sharing the LPC search, if searching apodizations in parallel */
+	FLAC__ThreadPoolQueue *lpc_queue;                 /* our queue in protected_->thread_pool for lpc_task[] */
+} subframe_search_workspace;
+
+/*
+ * With FLAC__stream_encoder_set_parallel_apodizations(), the LPC part of
+ * a subframe search is split among several tasks.  The searching thread
+ * does the first share itself into the subframe's own workspace; each of
+ * the others searches its share into its own candidate buffers, and the
+ * best of all of them is then copied back.
+ */
+typedef struct lpc_search_task {
+	subframe_search_workspace workspace;
+	FLAC__Subframe subframe[2];
+	FLAC__Subframe *subframe_ptr[2];
+	FLAC__EntropyCodingMethod_PartitionedRiceContents partitioned_rice_contents[2];
+	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents_ptr[2];
+	FLAC__int32 *residual[2];
+	/* the arguments to search_lpc_() */
+	FLAC__StreamEncoder *encoder;
+	unsigned min_partition_order;
+	unsigned max_partition_order;
+	const FLAC__FrameHeader *frame_header;
+	unsigned subframe_bps;
+	const FLAC__int32 *integer_signal;
+	FLAC__uint32 signal_peak;
+	unsigned rice_parameter_limit;
+	unsigned task;
+	unsigned num_tasks;
+	FLAC__bool stripe_orders;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	const lpc_model *lpc_model;
+#endif
+	/* and its results */
+	unsigned best_subframe;
+	unsigned best_bits;
+	unsigned best_ordinal;
+} lpc_search_task;
+
+/*
+ * The position of an LPC candidate in the order a single-threaded search
+ * would try it, so that ties between tasks go the same way; 0 is kept
+ * for whatever was best before the LPC search.
+ */
+#define LPC_SEARCH_ORDINAL_(apodization, order) ((apodization) * FLAC__MAX_LPC_ORDER + (order))
+
+/*
+ * With FLAC__stream_encoder_set_adaptive_apodization(), every window is
+ * tried on one frame in ADAPTIVE_APODIZATION_RETRY_FRAMES_, and on the
+ * others only the ADAPTIVE_APODIZATION_CANDIDATES_ windows that have won
+ * the most subframes lately.
+ */
+#define ADAPTIVE_APODIZATION_RETRY_FRAMES_ 16
+#define ADAPTIVE_APODIZATION_CANDIDATES_ 2
+
+/*
+ * With FLAC__stream_encoder_set_variable_blocksize(), each block may be
+ * split in halves up to MAX_BLOCK_SPLIT_LEVELS_ times, but not into
+ * frames shorter than MIN_SPLIT_BLOCKSIZE_.
+ */
+#define MAX_BLOCK_SPLIT_LEVELS_ 3
+#define MIN_SPLIT_BLOCKSIZE_ 256
+
+/* the arguments to process_subframe_(), for running it in the thread pool */
+typedef struct {
+	FLAC__StreamEncoder *encoder;
+	unsigned min_partition_order;
+	unsigned max_partition_order;
+	const FLAC__FrameHeader *frame_header;
+	unsigned subframe_bps;
+	const FLAC__int32 *integer_signal;
+	const signal_analysis *analysis;
+	FLAC__Subframe **subframe;
+	FLAC__EntropyCodingMethod_PartitionedRiceContents **partitioned_rice_contents;
+	FLAC__int32 **residual;
+	subframe_search_workspace *workspace;
+	unsigned *best_subframe;
+	unsigned *best_bits;
+	unsigned best_apodization;
+	FLAC__bool ok;
+} subframe_search_job;
+
+/*
+ * The search settings the current frame is encoded with.  They are the
+ * ones set by the client unless FLAC__stream_encoder_set_time_budget()
+ * has the encoder cutting back.
+ */
+typedef struct {
+	unsigned max_lpc_order;
+	unsigned num_apodizations;
+	FLAC__bool do_qlp_coeff_prec_search;
+	FLAC__bool do_exhaustive_model_search;
+	unsigned max_residual_partition_order;
+	FLAC__bool loose_mid_side_stereo;
+} search_effort;
+
+/* each level gives up a little more of the search; see get_search_effort_() */
+#define MAX_EFFORT_LEVEL_ 7
+/* frames to encode at a new effort level before judging it */
+#define EFFORT_SETTLE_FRAMES_ 8
+
+/* output buffers that may be in flight with FLAC__stream_encoder_set_async_write(), and their size if no write buffer size is set */
+#define ASYNC_WRITE_BUFFERS_ 4
+#define ASYNC_WRITE_BUFFER_SIZE_ (1u << 20)
+
 typedef enum {
 	ENCODER_IN_MAGIC = 0,
 	ENCODER_IN_METADATA = 1,
@@ -149,15 +298,36 @@ static struct CompressionLevels {
 
 static void set_defaults_(FLAC__StreamEncoder *encoder);
 static void free_(FLAC__StreamEncoder *encoder);
+static void free_buffers_(FLAC__StreamEncoder *encoder);
+static void free_lpc_search_task_(lpc_search_task *task);
+static FLAC__bool buffers_fit_(const FLAC__StreamEncoder *encoder);
+static unsigned num_lpc_models_(const FLAC__StreamEncoder *encoder);
 static FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, unsigned new_blocksize);
+static size_t layout_buffers_(FLAC__StreamEncoder *encoder, unsigned blocksize, FLAC__byte *arena);
+static void *arena_take_(FLAC__byte *arena, size_t *offset, size_t bytes);
+static FLAC__bool acquire_windows_(FLAC__StreamEncoder *encoder);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+static FLAC__bool alloc_lpc_search_tasks_(FLAC__StreamEncoder *encoder, subframe_search_workspace *workspace);
+#endif
 static FLAC__bool write_bitbuffer_(FLAC__StreamEncoder *encoder, unsigned samples, FLAC__bool is_last_block);
 static FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, FLAC__bool is_last_block);
 static void update_metadata_(const FLAC__StreamEncoder *encoder);
 #if FLAC__HAS_OGG
 static void update_ogg_metadata_(FLAC__StreamEncoder *encoder);
 #endif
+static FLAC__bool process_block_(FLAC__StreamEncoder *encoder);
+static FLAC__uint64 split_block_(FLAC__StreamEncoder *encoder, unsigned level, unsigned offset, unsigned split_level[], unsigned *num_frames);
+static FLAC__uint64 estimate_block_bits_(FLAC__StreamEncoder *encoder, unsigned offset, unsigned blocksize);
 static FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_fractional_block, FLAC__bool is_last_block);
 static FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fractional_block);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+static void select_apodizations_(FLAC__StreamEncoder *encoder);
+#endif
+static void md5_accumulate_task_(void *data);
+static FLAC__uint64 get_time_us_(void);
+static void get_search_effort_(const FLAC__StreamEncoder *encoder, unsigned level, search_effort *effort);
+static FLAC__bool search_effort_equal_(const search_effort *a, const search_effort *b);
+static void update_time_budget_(FLAC__StreamEncoder *encoder, FLAC__uint64 frame_time);
 
 static FLAC__bool process_subframe_(
 	FLAC__StreamEncoder *encoder,
@@ -166,12 +336,61 @@ static FLAC__bool process_subframe_(
 	const FLAC__FrameHeader *frame_header,
 	unsigned subframe_bps,
 	const FLAC__int32 integer_signal[],
+	const signal_analysis *analysis,
+	FLAC__Subframe *subframe[2],
+	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents[2],
+	FLAC__int32 *residual[2],
+	subframe_search_workspace *workspace,
+	unsigned *best_subframe,
+	unsigned *best_bits,
+	unsigned *best_apodization
+);
+
+static void subframe_search_task_(void *data);
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+static FLAC__bool compute_lpc_model_(
+	FLAC__StreamEncoder *encoder,
+	const FLAC__FrameHeader *frame_header,
+	unsigned subframe_bps,
+	const FLAC__int32 integer_signal[],
+	unsigned apodization,
+	FLAC__real windowed_signal[],
+	lpc_model *model
+);
+
+static void search_lpc_(
+	FLAC__StreamEncoder *encoder,
+	unsigned min_partition_order,
+	unsigned max_partition_order,
+	const FLAC__FrameHeader *frame_header,
+	unsigned subframe_bps,
+	const FLAC__int32 integer_signal[],
+	FLAC__uint32 signal_peak,
+	unsigned rice_parameter_limit,
+	unsigned task,
+	unsigned num_tasks,
+	FLAC__bool stripe_orders,
+	const lpc_model *shared_lpc_model,
+	subframe_search_workspace *workspace,
 	FLAC__Subframe *subframe[2],
 	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents[2],
 	FLAC__int32 *residual[2],
 	unsigned *best_subframe,
-	unsigned *best_bits
+	unsigned *best_bits,
+	unsigned *best_ordinal
+);
+
+static void lpc_search_task_(void *data);
+
+static FLAC__bool copy_lpc_subframe_(
+	const FLAC__Subframe *src,
+	FLAC__Subframe *dst,
+	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents,
+	FLAC__int32 residual[],
+	unsigned blocksize
 );
+#endif
 
 static FLAC__bool add_subframe_(
 	FLAC__StreamEncoder *encoder,
@@ -193,8 +412,7 @@ static unsigned evaluate_fixed_subframe_(
 	FLAC__StreamEncoder *encoder,
 	const FLAC__int32 signal[],
 	FLAC__int32 residual[],
-	FLAC__uint64 abs_residual_partition_sums[],
-	unsigned raw_bits_per_partition[],
+	subframe_search_workspace *workspace,
 	unsigned blocksize,
 	unsigned subframe_bps,
 	unsigned order,
@@ -213,11 +431,11 @@ static unsigned evaluate_lpc_subframe_(
 	FLAC__StreamEncoder *encoder,
 	const FLAC__int32 signal[],
 	FLAC__int32 residual[],
-	FLAC__uint64 abs_residual_partition_sums[],
-	unsigned raw_bits_per_partition[],
+	subframe_search_workspace *workspace,
 	const FLAC__real lp_coeff[],
 	unsigned blocksize,
 	unsigned subframe_bps,
+	FLAC__uint32 signal_peak,
 	unsigned order,
 	unsigned qlp_coeff_precision,
 	unsigned rice_parameter,
@@ -226,9 +444,12 @@ static unsigned evaluate_lpc_subframe_(
 	unsigned max_partition_order,
 	FLAC__bool do_escape_coding,
 	unsigned rice_parameter_search_dist,
+	unsigned bits_to_beat,
 	FLAC__Subframe *subframe,
 	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents
 );
+
+static FLAC__double rice_bits_lower_bound_(const FLAC__int32 residual[], unsigned residual_samples);
 #endif
 
 static unsigned evaluate_verbatim_subframe_(
@@ -241,9 +462,8 @@ static unsigned evaluate_verbatim_subframe_(
 
 static unsigned find_best_partition_order_(
 	struct FLAC__StreamEncoderPrivate *private_,
+	subframe_search_workspace *workspace,
 	const FLAC__int32 residual[],
-	FLAC__uint64 abs_residual_partition_sums[],
-	unsigned raw_bits_per_partition[],
 	unsigned residual_samples,
 	unsigned predictor_order,
 	unsigned rice_parameter,
@@ -292,7 +512,18 @@ static FLAC__bool set_partitioned_rice_(
 	unsigned *bits
 );
 
-static unsigned get_wasted_bits_(FLAC__int32 signal[], unsigned samples);
+static unsigned analyze_signal_(FLAC__int32 signal[], unsigned samples, signal_analysis *analysis);
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+static unsigned fixed_compute_best_predictor_(const FLAC__StreamEncoder *encoder, const FLAC__int32 data[], unsigned data_len, FLAC__uint32 peak, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
+#else
+static unsigned fixed_compute_best_predictor_(const FLAC__StreamEncoder *encoder, const FLAC__int32 data[], unsigned data_len, FLAC__uint32 peak, FLAC__fixedpoint residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
+#endif
+
+/* routines to buffer interleaved input; one is picked for the stream format in init_stream_internal_() */
+static void copy_interleaved_(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned offset, unsigned wide_samples);
+static void copy_interleaved_stereo_(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned offset, unsigned wide_samples);
+static void copy_interleaved_mid_side_(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned offset, unsigned wide_samples);
 
 /* verify-related routines: */
 static void append_to_verify_fifo_(
@@ -311,6 +542,14 @@ static void append_to_verify_fifo_interleaved_(
 	unsigned wide_samples
 );
 
+static void append_to_verify_fifo_interleaved_stereo_(
+	verify_input_fifo *fifo,
+	const FLAC__int32 input[],
+	unsigned input_offset,
+	unsigned channels,
+	unsigned wide_samples
+);
+
 static FLAC__StreamDecoderReadStatus verify_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 static FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
 static void verify_metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
@@ -320,6 +559,8 @@ static FLAC__StreamEncoderReadStatus file_read_callback_(const FLAC__StreamEncod
 static FLAC__StreamEncoderSeekStatus file_seek_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data);
 static FLAC__StreamEncoderTellStatus file_tell_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
 static FLAC__StreamEncoderWriteStatus file_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
+static FLAC__bool write_to_file_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes);
+static FLAC__bool flush_write_buffer_(const FLAC__StreamEncoder *encoder);
 static FILE *get_binary_stdout_(void);
 
 
@@ -331,13 +572,20 @@ static FILE *get_binary_stdout_(void);
 
 typedef struct FLAC__StreamEncoderPrivate {
 	unsigned input_capacity;                          /* current size (in samples) of the signal and residual buffers */
+	struct {
+		unsigned channels, search_workspaces, lpc_search_tasks, lpc_models;
+		FLAC__bool lpc, escape_coding;
+	} buffer_layout;                                  /* what the buffers were allocated for; they outlive finish() so the next init can reuse them, see buffers_fit_() */
 	FLAC__int32 *integer_signal[FLAC__MAX_CHANNELS];  /* the integer version of the input signal */
 	FLAC__int32 *integer_signal_mid_side[2];          /* the integer version of the mid-side input signal (stereo only) */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	FLAC__real *real_signal[FLAC__MAX_CHANNELS];      /* (@@@ currently unused) the floating-point version of the input signal */
 	FLAC__real *real_signal_mid_side[2];              /* (@@@ currently unused) the floating-point version of the mid-side input signal (stereo only) */
-	FLAC__real *window[FLAC__MAX_APODIZATION_FUNCTIONS]; /* the pre-computed floating-point window for each apodization function */
-	FLAC__real *windowed_signal;                      /* the integer_signal[] * current window[] */
+	const FLAC__real *window[MAX_BLOCK_SPLIT_LEVELS_+1][FLAC__MAX_APODIZATION_FUNCTIONS]; /* the pre-computed floating-point window for each apodization function, from FLAC__window_cache_acquire(); window[k] is for frames of blocksize/2^k */
+	unsigned apodization_score[FLAC__MAX_APODIZATION_FUNCTIONS]; /* decaying count of the subframes each window has won, for adaptive apodization */
+	unsigned active_apodization[FLAC__MAX_APODIZATION_FUNCTIONS]; /* indices of the windows to try on the current frame, in order */
+	unsigned num_active_apodizations;
+	unsigned adaptive_apodization_frame_count; /* number of frames since every window was last tried */
 #endif
 	unsigned subframe_bps[FLAC__MAX_CHANNELS];        /* the effective bits per sample of the input signal (stream bps - wasted bits) */
 	unsigned subframe_bps_mid_side[2];                /* the effective bits per sample of the mid-side input signal (stream bps - wasted bits + 0/1) */
@@ -355,8 +603,16 @@ typedef struct FLAC__StreamEncoderPrivate {
 	unsigned best_subframe_mid_side[2];
 	unsigned best_subframe_bits[FLAC__MAX_CHANNELS];  /* size in bits of the best subframe for each channel */
 	unsigned best_subframe_bits_mid_side[2];
-	FLAC__uint64 *abs_residual_partition_sums;        /* workspace where the sum of abs(candidate residual) for each partition is stored */
-	unsigned *raw_bits_per_partition;                 /* workspace where the sum of silog2(candidate residual) for each partition is stored */
+	signal_analysis analysis[FLAC__MAX_CHANNELS];     /* the pre-analysis of each channel's signal */
+	signal_analysis analysis_mid_side[2];
+	subframe_search_workspace search_workspace[FLAC__MAX_CHANNELS]; /* one for each subframe search that can be running at once */
+	unsigned num_search_workspaces;                   /* number of search_workspace[] in use, 1 unless searching subframes in parallel */
+	unsigned num_lpc_search_tasks;                    /* number of tasks each LPC search is split into, 1 unless searching apodizations in parallel */
+	FLAC__bool lpc_search_stripe_orders;              /* if true the tasks split the LPC orders of each window between them, else the windows */
+	search_effort effort;                             /* the search settings for the current frame */
+	unsigned effort_level;                            /* how far the search has been cut back to keep to the time budget, 0 for not at all */
+	unsigned effort_settle_frames;                    /* frames left before the current effort level is judged */
+	unsigned effort_cost[MAX_EFFORT_LEVEL_+1];        /* smoothed time per frame at each effort level, in thousandths of the budget; 0 if not known */
 	FLAC__BitWriter *frame;                           /* the current frame being worked on */
 	unsigned loose_mid_side_stereo_frames;            /* rounded number of frames the encoder will use before trying both independent and mid/side frames again */
 	unsigned loose_mid_side_stereo_frame_count;       /* number of frames using the current channel assignment */
@@ -365,20 +621,32 @@ typedef struct FLAC__StreamEncoderPrivate {
 	FLAC__StreamMetadata_SeekTable *seek_table;       /* pointer into encoder->protected_->metadata_ where the seek table is */
 	unsigned current_sample_number;
 	unsigned current_frame_number;
+	unsigned num_split_levels;                        /* how many times process_block_() may halve a block, 0 unless the blocksize is variable */
+	unsigned split_level;                             /* the current frame is blocksize/2^split_level samples of a split block */
+	unsigned min_frame_blocksize, max_frame_blocksize; /* of the frames so far but the last, for the STREAMINFO of a variable-blocksize stream */
+	FLAC__uint64 block_end_sample;                    /* the sample number just past the block being encoded, which is in the verify fifo */
 	FLAC__MD5Context md5context;
+	FLAC__ThreadPoolQueue *thread_pool_queue;        /* our queue in protected_->thread_pool, if one is set */
+	size_t md5_bytes;                                 /* size of the formatted signal in md5context waiting to be hashed by md5_accumulate_task_() */
+	FLAC__ThreadPoolQueue *subframe_queue;            /* our queue in protected_->thread_pool for the subframe searches, if searching in parallel */
 	FLAC__CPUInfo cpuinfo;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	unsigned (*local_fixed_compute_best_predictor)(const FLAC__int32 data[], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
+	unsigned (*local_fixed_compute_best_predictor_wide)(const FLAC__int32 data[], unsigned data_len, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
 #else
 	unsigned (*local_fixed_compute_best_predictor)(const FLAC__int32 data[], unsigned data_len, FLAC__fixedpoint residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
+	unsigned (*local_fixed_compute_best_predictor_wide)(const FLAC__int32 data[], unsigned data_len, FLAC__fixedpoint residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
 #endif
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
+	void (*local_lpc_window_data)(const FLAC__int32 in[], const FLAC__real window[], FLAC__real out[], unsigned data_len);
 	void (*local_lpc_compute_autocorrelation)(const FLAC__real data[], unsigned data_len, unsigned lag, FLAC__real autoc[]);
 	void (*local_lpc_compute_residual_from_qlp_coefficients)(const FLAC__int32 *data, unsigned data_len, const FLAC__int32 qlp_coeff[], unsigned order, int lp_quantization, FLAC__int32 residual[]);
 	void (*local_lpc_compute_residual_from_qlp_coefficients_64bit)(const FLAC__int32 *data, unsigned data_len, const FLAC__int32 qlp_coeff[], unsigned order, int lp_quantization, FLAC__int32 residual[]);
 	void (*local_lpc_compute_residual_from_qlp_coefficients_16bit)(const FLAC__int32 *data, unsigned data_len, const FLAC__int32 qlp_coeff[], unsigned order, int lp_quantization, FLAC__int32 residual[]);
 #endif
-	FLAC__bool use_wide_by_block;          /* use slow 64-bit versions of some functions because of the block size */
+	void (*local_precompute_partition_info_sums)(const FLAC__int32 residual[], FLAC__uint64 abs_residual_partition_sums[], unsigned residual_samples, unsigned predictor_order, unsigned min_partition_order, unsigned max_partition_order, unsigned bps);
+	void (*local_copy_interleaved)(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned offset, unsigned wide_samples);
+	void (*local_append_to_verify_fifo_interleaved)(verify_input_fifo *fifo, const FLAC__int32 input[], unsigned input_offset, unsigned channels, unsigned wide_samples);
 	FLAC__bool use_wide_by_partition;      /* use slow 64-bit versions of some functions because of the min partition order and blocksize */
 	FLAC__bool use_wide_by_order;          /* use slow 64-bit versions of some functions because of the lpc order */
 	FLAC__bool disable_constant_subframes;
@@ -393,34 +661,23 @@ typedef struct FLAC__StreamEncoderPrivate {
 	FLAC__StreamEncoderWriteCallback write_callback;
 	FLAC__StreamEncoderMetadataCallback metadata_callback;
 	FLAC__StreamEncoderProgressCallback progress_callback;
+	FLAC__StreamEncoderReserveCallback reserve_callback;
+	FLAC__StreamEncoderWriteCallback commit_callback;
 	void *client_data;
+	size_t frame_buffer_bytes;             /* the size asked of reserve_callback; 0 when frames go through write_callback */
 	unsigned first_seekpoint_to_check;
 	FILE *file;                            /* only used when encoding to a file */
+	FLAC__byte *write_buffer;              /* gathers the writes to 'file' when protected_->write_buffer_size > 0 */
+	size_t write_buffer_bytes;             /* # of bytes waiting in write_buffer */
+	FLAC__UringWriter *uring_writer;       /* takes the frame writes to 'file' when protected_->async_write is set, until the first flush */
 	FLAC__uint64 bytes_written;
 	FLAC__uint64 samples_written;
 	unsigned frames_written;
 	unsigned total_frames_estimate;
-	/* unaligned (original) pointers to allocated data */
-	FLAC__int32 *integer_signal_unaligned[FLAC__MAX_CHANNELS];
-	FLAC__int32 *integer_signal_mid_side_unaligned[2];
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-	FLAC__real *real_signal_unaligned[FLAC__MAX_CHANNELS]; /* (@@@ currently unused) */
-	FLAC__real *real_signal_mid_side_unaligned[2]; /* (@@@ currently unused) */
-	FLAC__real *window_unaligned[FLAC__MAX_APODIZATION_FUNCTIONS];
-	FLAC__real *windowed_signal_unaligned;
-#endif
-	FLAC__int32 *residual_workspace_unaligned[FLAC__MAX_CHANNELS][2];
-	FLAC__int32 *residual_workspace_mid_side_unaligned[2][2];
-	FLAC__uint64 *abs_residual_partition_sums_unaligned;
-	unsigned *raw_bits_per_partition_unaligned;
-	/*
-	 * These fields have been moved here from private function local
-	 * declarations merely to save stack space during encoding.
-	 */
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-	FLAC__real lp_coeff[FLAC__MAX_LPC_ORDER][FLAC__MAX_LPC_ORDER]; /* from process_subframe_() */
-#endif
-	FLAC__EntropyCodingMethod_PartitionedRiceContents partitioned_rice_contents_extra[2]; /* from find_best_partition_order_() */
+	/* the signal, residual and search buffers are all carved out of this one block; see layout_buffers_() */
+	void *workspace_arena;
+	size_t workspace_arena_bytes;
+	FLAC__bool workspace_arena_mapped;
 	/*
 	 * The data for the verify section
 	 */
@@ -553,6 +810,10 @@ FLAC_API FLAC__StreamEncoder *FLAC__stream_encoder_new(void)
 	}
 
 	encoder->private_->file = 0;
+	encoder->private_->write_buffer = 0;
+	encoder->private_->uring_writer = 0;
+	encoder->private_->thread_pool_queue = 0;
+	encoder->private_->subframe_queue = 0;
 
 	set_defaults_(encoder);
 
@@ -583,8 +844,10 @@ FLAC_API FLAC__StreamEncoder *FLAC__stream_encoder_new(void)
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][0]);
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][1]);
 	}
-	for(i = 0; i < 2; i++)
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&encoder->private_->partitioned_rice_contents_extra[i]);
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&encoder->private_->search_workspace[i].partitioned_rice_contents_extra[0]);
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&encoder->private_->search_workspace[i].partitioned_rice_contents_extra[1]);
+	}
 
 	encoder->protected_->state = FLAC__STREAM_ENCODER_UNINITIALIZED;
 
@@ -604,6 +867,8 @@ FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder)
 
 	(void)FLAC__stream_encoder_finish(encoder);
 
+	free_buffers_(encoder);
+
 	if(0 != encoder->private_->verify.decoder)
 		FLAC__stream_decoder_delete(encoder->private_->verify.decoder);
 
@@ -615,8 +880,10 @@ FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder)
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][0]);
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][1]);
 	}
-	for(i = 0; i < 2; i++)
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_extra[i]);
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->search_workspace[i].partitioned_rice_contents_extra[0]);
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->search_workspace[i].partitioned_rice_contents_extra[1]);
+	}
 
 	FLAC__bitwriter_delete(encoder->private_->frame);
 	free(encoder->private_);
@@ -642,6 +909,9 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 )
 {
 	unsigned i;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	unsigned level;
+#endif
 	FLAC__bool metadata_has_seektable, metadata_has_vorbis_comment, metadata_picture_has_type1, metadata_picture_has_type2;
 
 	FLAC__ASSERT(0 != encoder);
@@ -657,6 +927,10 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	if(0 == write_callback || (seek_callback && 0 == tell_callback))
 		return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS;
 
+	/* frames can only go into client buffers in a native stream the client writes itself */
+	if(0 != encoder->private_->reserve_callback && (is_ogg || write_callback == file_write_callback_))
+		return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS;
+
 	if(encoder->protected_->channels == 0 || encoder->protected_->channels > FLAC__MAX_CHANNELS)
 		return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_NUMBER_OF_CHANNELS;
 
@@ -837,36 +1111,47 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 		}
 	}
 
-	encoder->private_->input_capacity = 0;
-	for(i = 0; i < encoder->protected_->channels; i++) {
-		encoder->private_->integer_signal_unaligned[i] = encoder->private_->integer_signal[i] = 0;
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-		encoder->private_->real_signal_unaligned[i] = encoder->private_->real_signal[i] = 0;
-#endif
-	}
-	for(i = 0; i < 2; i++) {
-		encoder->private_->integer_signal_mid_side_unaligned[i] = encoder->private_->integer_signal_mid_side[i] = 0;
+	/* the signal and search buffers are left alone here: they are either unallocated or kept from the last stream, see free_buffers_() */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
-		encoder->private_->real_signal_mid_side_unaligned[i] = encoder->private_->real_signal_mid_side[i] = 0;
-#endif
+	for(i = 0; i < encoder->protected_->num_apodizations; i++) {
+		for(level = 0; level <= MAX_BLOCK_SPLIT_LEVELS_; level++)
+			encoder->private_->window[level][i] = 0;
+		encoder->private_->apodization_score[i] = 0;
+		encoder->private_->active_apodization[i] = i;
 	}
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-	for(i = 0; i < encoder->protected_->num_apodizations; i++)
-		encoder->private_->window_unaligned[i] = encoder->private_->window[i] = 0;
-	encoder->private_->windowed_signal_unaligned = encoder->private_->windowed_signal = 0;
+	encoder->private_->num_active_apodizations = encoder->protected_->num_apodizations;
+	encoder->private_->adaptive_apodization_frame_count = 0;
 #endif
-	for(i = 0; i < encoder->protected_->channels; i++) {
-		encoder->private_->residual_workspace_unaligned[i][0] = encoder->private_->residual_workspace[i][0] = 0;
-		encoder->private_->residual_workspace_unaligned[i][1] = encoder->private_->residual_workspace[i][1] = 0;
+	for(i = 0; i < encoder->protected_->channels; i++)
 		encoder->private_->best_subframe[i] = 0;
-	}
-	for(i = 0; i < 2; i++) {
-		encoder->private_->residual_workspace_mid_side_unaligned[i][0] = encoder->private_->residual_workspace_mid_side[i][0] = 0;
-		encoder->private_->residual_workspace_mid_side_unaligned[i][1] = encoder->private_->residual_workspace_mid_side[i][1] = 0;
+	for(i = 0; i < 2; i++)
 		encoder->private_->best_subframe_mid_side[i] = 0;
+	/* each subframe search in the frame gets its own workspace when they can run in parallel */
+	if(encoder->protected_->parallel_subframes && 0 != encoder->protected_->thread_pool)
+		encoder->private_->num_search_workspaces = encoder->protected_->channels + (encoder->protected_->do_mid_side_stereo? 2 : 0);
+	else
+		encoder->private_->num_search_workspaces = 1;
+	FLAC__ASSERT(encoder->private_->num_search_workspaces <= FLAC__MAX_CHANNELS);
+	for(i = 0; i < encoder->private_->num_search_workspaces; i++)
+		encoder->private_->search_workspace[i].lpc_queue = 0;
+	/*
+	 * The LPC search of each subframe can be split by window, or, when
+	 * there are fewer windows than threads and every order is tried, by
+	 * order.  The searching thread takes a share too.
+	 */
+	encoder->private_->num_lpc_search_tasks = 1;
+	encoder->private_->lpc_search_stripe_orders = false;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	if(encoder->protected_->parallel_apodizations && 0 != encoder->protected_->thread_pool && encoder->protected_->max_lpc_order > 0) {
+		const unsigned num_tasks = FLAC__thread_pool_get_threads(encoder->protected_->thread_pool) + 1;
+		if(encoder->protected_->do_exhaustive_model_search && encoder->protected_->num_apodizations < num_tasks) {
+			encoder->private_->num_lpc_search_tasks = min(num_tasks, encoder->protected_->max_lpc_order);
+			encoder->private_->lpc_search_stripe_orders = true;
+		}
+		else
+			encoder->private_->num_lpc_search_tasks = min(num_tasks, encoder->protected_->num_apodizations);
 	}
-	encoder->private_->abs_residual_partition_sums_unaligned = encoder->private_->abs_residual_partition_sums = 0;
-	encoder->private_->raw_bits_per_partition_unaligned = encoder->private_->raw_bits_per_partition = 0;
+#endif
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	encoder->private_->loose_mid_side_stereo_frames = (unsigned)((FLAC__double)encoder->protected_->sample_rate * 0.4 / (FLAC__double)encoder->protected_->blocksize + 0.5);
 #else
@@ -884,7 +1169,26 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->current_sample_number = 0;
 	encoder->private_->current_frame_number = 0;
 
-	encoder->private_->use_wide_by_block = (encoder->protected_->bits_per_sample + FLAC__bitmath_ilog2(encoder->protected_->blocksize)+1 > 30);
+	encoder->private_->num_split_levels = 0;
+	encoder->private_->min_frame_blocksize = UINT_MAX;
+	encoder->private_->max_frame_blocksize = 0;
+	encoder->private_->split_level = 0;
+	if(encoder->protected_->variable_blocksize) {
+		/* only split evenly, so that every frame at a level is the same size and can share its windows */
+		while(
+			encoder->private_->num_split_levels < MAX_BLOCK_SPLIT_LEVELS_ &&
+			(encoder->protected_->blocksize >> (encoder->private_->num_split_levels+1)) >= MIN_SPLIT_BLOCKSIZE_ &&
+			(encoder->protected_->blocksize >> (encoder->private_->num_split_levels+1) << (encoder->private_->num_split_levels+1)) == encoder->protected_->blocksize
+		)
+			encoder->private_->num_split_levels++;
+	}
+
+	encoder->private_->effort_level = 0;
+	encoder->private_->effort_settle_frames = EFFORT_SETTLE_FRAMES_;
+	for(i = 0; i <= MAX_EFFORT_LEVEL_; i++)
+		encoder->private_->effort_cost[i] = 0;
+	get_search_effort_(encoder, 0, &encoder->private_->effort);
+
 	encoder->private_->use_wide_by_order = (encoder->protected_->bits_per_sample + FLAC__bitmath_ilog2(max(encoder->protected_->max_lpc_order, FLAC__MAX_FIXED_ORDER))+1 > 30); /*@@@ need to use this? */
 	encoder->private_->use_wide_by_partition = (false); /*@@@ need to set this */
 
@@ -894,14 +1198,17 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	FLAC__cpu_info(&encoder->private_->cpuinfo);
 	/* first default to the non-asm routines */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
+	encoder->private_->local_lpc_window_data = FLAC__lpc_window_data;
 	encoder->private_->local_lpc_compute_autocorrelation = FLAC__lpc_compute_autocorrelation;
 #endif
 	encoder->private_->local_fixed_compute_best_predictor = FLAC__fixed_compute_best_predictor;
+	encoder->private_->local_fixed_compute_best_predictor_wide = FLAC__fixed_compute_best_predictor_wide;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	encoder->private_->local_lpc_compute_residual_from_qlp_coefficients = FLAC__lpc_compute_residual_from_qlp_coefficients;
 	encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_64bit = FLAC__lpc_compute_residual_from_qlp_coefficients_wide;
 	encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_16bit = FLAC__lpc_compute_residual_from_qlp_coefficients;
 #endif
+	encoder->private_->local_precompute_partition_info_sums = precompute_partition_info_sums_;
 	/* now override with asm where appropriate */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 # ifndef FLAC__NO_ASM
@@ -935,12 +1242,39 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 			encoder->private_->local_fixed_compute_best_predictor = FLAC__fixed_compute_best_predictor_asm_ia32_mmx_cmov;
 #   endif /* FLAC__HAS_NASM */
 #  endif /* FLAC__CPU_IA32 */
+#  if defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+		FLAC__ASSERT(encoder->private_->cpuinfo.type == FLAC__CPUINFO_TYPE_X86_64);
+		if(encoder->private_->cpuinfo.data.x86_64.avx2) {
+			encoder->private_->local_lpc_window_data = FLAC__lpc_window_data_intrin_avx2;
+			encoder->private_->local_lpc_compute_autocorrelation = FLAC__lpc_compute_autocorrelation_intrin_avx2;
+			encoder->private_->local_fixed_compute_best_predictor = FLAC__fixed_compute_best_predictor_intrin_avx2;
+			encoder->private_->local_fixed_compute_best_predictor_wide = FLAC__fixed_compute_best_predictor_wide_intrin_avx2;
+			encoder->private_->local_precompute_partition_info_sums = FLAC__precompute_partition_info_sums_intrin_avx2;
+		}
+		else if(encoder->private_->cpuinfo.data.x86_64.sse2) {
+			encoder->private_->local_lpc_window_data = FLAC__lpc_window_data_intrin_sse2;
+			encoder->private_->local_lpc_compute_autocorrelation = FLAC__lpc_compute_autocorrelation_intrin_sse2;
+			encoder->private_->local_fixed_compute_best_predictor = FLAC__fixed_compute_best_predictor_intrin_sse2;
+			encoder->private_->local_fixed_compute_best_predictor_wide = FLAC__fixed_compute_best_predictor_wide_intrin_sse2;
+			encoder->private_->local_precompute_partition_info_sums = FLAC__precompute_partition_info_sums_intrin_sse2;
+		}
+#  endif /* FLAC__CPU_X86_64 && FLAC__HAS_X86INTRIN */
 	}
 # endif /* !FLAC__NO_ASM */
 #endif /* !FLAC__INTEGER_ONLY_LIBRARY */
-	/* finally override based on wide-ness if necessary */
-	if(encoder->private_->use_wide_by_block) {
-		encoder->private_->local_fixed_compute_best_predictor = FLAC__fixed_compute_best_predictor_wide;
+	/* the wide versions are picked for each subframe from the size of its signal; see fixed_compute_best_predictor_() */
+
+	/*
+	 * pick the input routines for the stream format; stereo gets versions
+	 * with the channel loop unrolled
+	 */
+	if(encoder->protected_->channels == 2) {
+		encoder->private_->local_copy_interleaved = encoder->protected_->do_mid_side_stereo? copy_interleaved_mid_side_ : copy_interleaved_stereo_;
+		encoder->private_->local_append_to_verify_fifo_interleaved = append_to_verify_fifo_interleaved_stereo_;
+	}
+	else {
+		encoder->private_->local_copy_interleaved = copy_interleaved_;
+		encoder->private_->local_append_to_verify_fifo_interleaved = append_to_verify_fifo_interleaved_;
 	}
 
 	/* set state to OK; from here on, errors are fatal and we'll override the state then */
@@ -961,8 +1295,33 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->metadata_callback = metadata_callback;
 	encoder->private_->client_data = client_data;
 
-	if(!resize_buffers_(encoder, encoder->protected_->blocksize)) {
-		/* the above function sets the state for us in case of an error */
+	if(0 != encoder->private_->reserve_callback) {
+		/*
+		 * No frame is bigger than with verbatim subframes (see
+		 * process_subframe_()), here all counted with the extra bit of a
+		 * side channel and all the wasted bits flags as unary, plus the
+		 * longest frame header with CRC and the footer.  The two extra
+		 * words cover the bitwriter's rounding to whole words.
+		 */
+		const size_t subframe_bits =
+			FLAC__SUBFRAME_ZERO_PAD_LEN + FLAC__SUBFRAME_TYPE_LEN + FLAC__SUBFRAME_WASTED_BITS_FLAG_LEN +
+			encoder->protected_->bits_per_sample +
+			(size_t)encoder->protected_->blocksize * (encoder->protected_->bits_per_sample + 1);
+		encoder->private_->frame_buffer_bytes =
+			16 + /* MAGIC NUMBER based on the maximum frame header size, including CRC */
+			(encoder->protected_->channels * subframe_bits + 7) / 8 +
+			FLAC__FRAME_FOOTER_CRC_LEN / 8 +
+			2 * sizeof(FLAC__uint64);
+	}
+	else
+		encoder->private_->frame_buffer_bytes = 0;
+
+	/* buffers kept from the last stream are reused if they are big enough and laid out for these settings */
+	if(encoder->protected_->blocksize > encoder->private_->input_capacity || !buffers_fit_(encoder))
+		free_buffers_(encoder);
+
+	if(!resize_buffers_(encoder, encoder->protected_->blocksize) || !acquire_windows_(encoder)) {
+		/* the above functions set the state for us in case of an error */
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 	}
 
@@ -1043,7 +1402,7 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->streaminfo.type = FLAC__METADATA_TYPE_STREAMINFO;
 	encoder->private_->streaminfo.is_last = false; /* we will have at a minimum a VORBIS_COMMENT afterwards */
 	encoder->private_->streaminfo.length = FLAC__STREAM_METADATA_STREAMINFO_LENGTH;
-	encoder->private_->streaminfo.data.stream_info.min_blocksize = encoder->protected_->blocksize; /* this encoder uses the same blocksize for the whole stream */
+	encoder->private_->streaminfo.data.stream_info.min_blocksize = encoder->protected_->blocksize >> encoder->private_->num_split_levels; /* unless the blocksize is variable, this encoder uses the same blocksize for the whole stream; if it is, finish() puts in the sizes used */
 	encoder->private_->streaminfo.data.stream_info.max_blocksize = encoder->protected_->blocksize;
 	encoder->private_->streaminfo.data.stream_info.min_framesize = 0; /* we don't know this yet; have to fill it in later */
 	encoder->private_->streaminfo.data.stream_info.max_framesize = 0; /* we don't know this yet; have to fill it in later */
@@ -1054,6 +1413,23 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	memset(encoder->private_->streaminfo.data.stream_info.md5sum, 0, 16); /* we don't know this yet; have to fill it in later */
 	if(encoder->protected_->do_md5)
 		FLAC__MD5Init(&encoder->private_->md5context);
+	if(0 != encoder->protected_->thread_pool && 0 == (encoder->private_->thread_pool_queue = FLAC__thread_pool_attach(encoder->protected_->thread_pool))) {
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+	}
+	if(encoder->private_->num_search_workspaces > 1 && 0 == (encoder->private_->subframe_queue = FLAC__thread_pool_attach(encoder->protected_->thread_pool))) {
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+	}
+	if(encoder->private_->num_lpc_search_tasks > 1) {
+		/* each subframe search waits on its own queue, so that searches running in the pool never wait on each other */
+		for(i = 0; i < encoder->private_->num_search_workspaces; i++) {
+			if(0 == (encoder->private_->search_workspace[i].lpc_queue = FLAC__thread_pool_attach(encoder->protected_->thread_pool))) {
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+			}
+		}
+	}
 	if(!FLAC__add_metadata_block(&encoder->private_->streaminfo, encoder->private_->frame)) {
 		encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
@@ -1229,6 +1605,20 @@ static FLAC__StreamEncoderInitStatus init_FILE_internal_(
 		encoder->private_->total_frames_estimate = (unsigned)((FLAC__stream_encoder_get_total_samples_estimate(encoder) + blocksize - 1) / blocksize);
 	}
 
+	/* the metadata has gone out unbuffered; the frames are gathered from here on */
+	encoder->private_->write_buffer_bytes = 0;
+	if(encoder->protected_->async_write && encoder->private_->file != stdout && fflush(encoder->private_->file) == 0) {
+		const off_t offset = ftello(encoder->private_->file);
+		if(offset >= 0)
+			encoder->private_->uring_writer = FLAC__uring_writer_new(fileno(encoder->private_->file), (FLAC__uint64)offset, ASYNC_WRITE_BUFFERS_, encoder->protected_->write_buffer_size? encoder->protected_->write_buffer_size : ASYNC_WRITE_BUFFER_SIZE_);
+	}
+	if(0 == encoder->private_->uring_writer && encoder->protected_->write_buffer_size > 0) {
+		if(0 == (encoder->private_->write_buffer = (FLAC__byte*)malloc(encoder->protected_->write_buffer_size))) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+		}
+	}
+
 	return init_status;
 }
  
@@ -1304,6 +1694,7 @@ FLAC_API FLAC__StreamEncoderInitStatus FLAC__stream_encoder_init_ogg_file(
 
 FLAC_API FLAC__bool FLAC__stream_encoder_finish(FLAC__StreamEncoder *encoder)
 {
+	unsigned i;
 	FLAC__bool error = false;
 
 	FLAC__ASSERT(0 != encoder);
@@ -1317,14 +1708,37 @@ FLAC_API FLAC__bool FLAC__stream_encoder_finish(FLAC__StreamEncoder *encoder)
 		if(encoder->private_->current_sample_number != 0) {
 			const FLAC__bool is_fractional_block = encoder->protected_->blocksize != encoder->private_->current_sample_number;
 			encoder->protected_->blocksize = encoder->private_->current_sample_number;
+			encoder->private_->block_end_sample = encoder->private_->streaminfo.data.stream_info.total_samples + encoder->protected_->blocksize;
 			if(!process_frame_(encoder, is_fractional_block, /*is_last_block=*/true))
 				error = true;
 		}
 	}
 
+	/* let any MD5 work still in the pool finish before finalizing */
+	if(0 != encoder->private_->thread_pool_queue) {
+		FLAC__thread_pool_detach(encoder->private_->thread_pool_queue);
+		encoder->private_->thread_pool_queue = 0;
+	}
+	if(0 != encoder->private_->subframe_queue) {
+		FLAC__thread_pool_detach(encoder->private_->subframe_queue);
+		encoder->private_->subframe_queue = 0;
+	}
+	for(i = 0; i < encoder->private_->num_search_workspaces; i++) {
+		if(0 != encoder->private_->search_workspace[i].lpc_queue) {
+			FLAC__thread_pool_detach(encoder->private_->search_workspace[i].lpc_queue);
+			encoder->private_->search_workspace[i].lpc_queue = 0;
+		}
+	}
+
 	if(encoder->protected_->do_md5)
 		FLAC__MD5Final(encoder->private_->streaminfo.data.stream_info.md5sum, &encoder->private_->md5context);
 
+	/* the frame sizes actually used, in place of the bounds written at init; as usual the last frame does not count */
+	if(encoder->protected_->variable_blocksize && encoder->private_->max_frame_blocksize > 0) {
+		encoder->private_->streaminfo.data.stream_info.min_blocksize = encoder->private_->min_frame_blocksize;
+		encoder->private_->streaminfo.data.stream_info.max_blocksize = encoder->private_->max_frame_blocksize;
+	}
+
 	if(!encoder->private_->is_being_deleted) {
 		if(encoder->protected_->state == FLAC__STREAM_ENCODER_OK) {
 			if(encoder->private_->seek_callback) {
@@ -1351,10 +1765,23 @@ FLAC_API FLAC__bool FLAC__stream_encoder_finish(FLAC__StreamEncoder *encoder)
 	}
 
 	if(0 != encoder->private_->file) {
+		if(!flush_write_buffer_(encoder) && !error) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_IO_ERROR;
+			error = true;
+		}
 		if(encoder->private_->file != stdout)
 			fclose(encoder->private_->file);
 		encoder->private_->file = 0;
 	}
+	if(0 != encoder->private_->write_buffer) {
+		free(encoder->private_->write_buffer);
+		encoder->private_->write_buffer = 0;
+	}
+	if(0 != encoder->private_->uring_writer) {
+		/* only left here if an error kept flush_write_buffer_() from getting to it */
+		FLAC__uring_writer_delete(encoder->private_->uring_writer);
+		encoder->private_->uring_writer = 0;
+	}
 
 #if FLAC__HAS_OGG
 	if(encoder->private_->is_ogg)
@@ -1500,6 +1927,17 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_blocksize(FLAC__StreamEncoder *enco
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_variable_blocksize(FLAC__StreamEncoder *encoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->variable_blocksize = value;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_do_mid_side_stereo(FLAC__StreamEncoder *encoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1594,6 +2032,17 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_apodization(FLAC__StreamEncoder *en
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_adaptive_apodization(FLAC__StreamEncoder *encoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->adaptive_apodization = value;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_max_lpc_order(FLAC__StreamEncoder *encoder, unsigned value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1654,6 +2103,28 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_do_exhaustive_model_search(FLAC__St
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_prune_model_search(FLAC__StreamEncoder *encoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->prune_model_search = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_set_quiet_signal_bits(FLAC__StreamEncoder *encoder, unsigned value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->quiet_signal_bits = value;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_min_residual_partition_order(FLAC__StreamEncoder *encoder, unsigned value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1692,6 +2163,17 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_rice_parameter_search_dist(FLAC__St
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_time_budget(FLAC__StreamEncoder *encoder, unsigned value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->time_budget = value;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_total_samples_estimate(FLAC__StreamEncoder *encoder, FLAC__uint64 value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1735,68 +2217,137 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_metadata(FLAC__StreamEncoder *encod
 	return true;
 }
 
-/*
- * These three functions are not static, but not publically exposed in
- * include/FLAC/ either.  They are used by the test suite.
- */
-FLAC_API FLAC__bool FLAC__stream_encoder_disable_constant_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
+FLAC_API FLAC__bool FLAC__stream_encoder_set_thread_pool(FLAC__StreamEncoder *encoder, FLAC__ThreadPool *pool)
 {
 	FLAC__ASSERT(0 != encoder);
 	FLAC__ASSERT(0 != encoder->private_);
 	FLAC__ASSERT(0 != encoder->protected_);
 	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
 		return false;
-	encoder->private_->disable_constant_subframes = value;
+	encoder->protected_->thread_pool = pool;
 	return true;
 }
 
-FLAC_API FLAC__bool FLAC__stream_encoder_disable_fixed_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
+FLAC_API FLAC__bool FLAC__stream_encoder_set_parallel_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != encoder);
 	FLAC__ASSERT(0 != encoder->private_);
 	FLAC__ASSERT(0 != encoder->protected_);
 	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
 		return false;
-	encoder->private_->disable_fixed_subframes = value;
+	encoder->protected_->parallel_subframes = value;
 	return true;
 }
 
-FLAC_API FLAC__bool FLAC__stream_encoder_disable_verbatim_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
+FLAC_API FLAC__bool FLAC__stream_encoder_set_parallel_apodizations(FLAC__StreamEncoder *encoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != encoder);
 	FLAC__ASSERT(0 != encoder->private_);
 	FLAC__ASSERT(0 != encoder->protected_);
 	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
 		return false;
-	encoder->private_->disable_verbatim_subframes = value;
+	encoder->protected_->parallel_apodizations = value;
 	return true;
 }
 
-FLAC_API FLAC__StreamEncoderState FLAC__stream_encoder_get_state(const FLAC__StreamEncoder *encoder)
+FLAC_API FLAC__bool FLAC__stream_encoder_set_frame_buffer_callbacks(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderReserveCallback reserve_callback, FLAC__StreamEncoderWriteCallback commit_callback)
 {
 	FLAC__ASSERT(0 != encoder);
 	FLAC__ASSERT(0 != encoder->private_);
 	FLAC__ASSERT(0 != encoder->protected_);
-	return encoder->protected_->state;
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	if((0 == reserve_callback) != (0 == commit_callback))
+		return false;
+	encoder->private_->reserve_callback = reserve_callback;
+	encoder->private_->commit_callback = commit_callback;
+	return true;
 }
 
-FLAC_API FLAC__StreamDecoderState FLAC__stream_encoder_get_verify_decoder_state(const FLAC__StreamEncoder *encoder)
+FLAC_API FLAC__bool FLAC__stream_encoder_set_write_buffer_size(FLAC__StreamEncoder *encoder, unsigned value)
 {
 	FLAC__ASSERT(0 != encoder);
 	FLAC__ASSERT(0 != encoder->private_);
 	FLAC__ASSERT(0 != encoder->protected_);
-	if(encoder->protected_->verify)
-		return FLAC__stream_decoder_get_state(encoder->private_->verify.decoder);
-	else
-		return FLAC__STREAM_DECODER_UNINITIALIZED;
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->write_buffer_size = value;
+	return true;
 }
 
-FLAC_API const char *FLAC__stream_encoder_get_resolved_state_string(const FLAC__StreamEncoder *encoder)
+FLAC_API FLAC__bool FLAC__stream_encoder_set_async_write(FLAC__StreamEncoder *encoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != encoder);
 	FLAC__ASSERT(0 != encoder->private_);
 	FLAC__ASSERT(0 != encoder->protected_);
-	if(encoder->protected_->state != FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR)
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->async_write = value;
+	return true;
+}
+
+/*
+ * These three functions are not static, but not publically exposed in
+ * include/FLAC/ either.  They are used by the test suite.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_disable_constant_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->private_->disable_constant_subframes = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_disable_fixed_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->private_->disable_fixed_subframes = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_disable_verbatim_subframes(FLAC__StreamEncoder *encoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->private_->disable_verbatim_subframes = value;
+	return true;
+}
+
+FLAC_API FLAC__StreamEncoderState FLAC__stream_encoder_get_state(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->state;
+}
+
+FLAC_API FLAC__StreamDecoderState FLAC__stream_encoder_get_verify_decoder_state(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->verify)
+		return FLAC__stream_decoder_get_state(encoder->private_->verify.decoder);
+	else
+		return FLAC__STREAM_DECODER_UNINITIALIZED;
+}
+
+FLAC_API const char *FLAC__stream_encoder_get_resolved_state_string(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR)
 		return FLAC__StreamEncoderStateString[encoder->protected_->state];
 	else
 		return FLAC__stream_decoder_get_resolved_state_string(encoder->private_->verify.decoder);
@@ -1877,6 +2428,14 @@ FLAC_API unsigned FLAC__stream_encoder_get_blocksize(const FLAC__StreamEncoder *
 	return encoder->protected_->blocksize;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_get_variable_blocksize(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->variable_blocksize;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_get_do_mid_side_stereo(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1893,6 +2452,14 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_loose_mid_side_stereo(const FLAC__S
 	return encoder->protected_->loose_mid_side_stereo;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_get_adaptive_apodization(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->adaptive_apodization;
+}
+
 FLAC_API unsigned FLAC__stream_encoder_get_max_lpc_order(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1933,6 +2500,22 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_do_exhaustive_model_search(const FL
 	return encoder->protected_->do_exhaustive_model_search;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_get_prune_model_search(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->prune_model_search;
+}
+
+FLAC_API unsigned FLAC__stream_encoder_get_quiet_signal_bits(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->quiet_signal_bits;
+}
+
 FLAC_API unsigned FLAC__stream_encoder_get_min_residual_partition_order(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1957,6 +2540,14 @@ FLAC_API unsigned FLAC__stream_encoder_get_rice_parameter_search_dist(const FLAC
 	return encoder->protected_->rice_parameter_search_dist;
 }
 
+FLAC_API unsigned FLAC__stream_encoder_get_time_budget(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->time_budget;
+}
+
 FLAC_API FLAC__uint64 FLAC__stream_encoder_get_total_samples_estimate(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1965,6 +2556,54 @@ FLAC_API FLAC__uint64 FLAC__stream_encoder_get_total_samples_estimate(const FLAC
 	return encoder->protected_->total_samples_estimate;
 }
 
+FLAC_API FLAC__ThreadPool *FLAC__stream_encoder_get_thread_pool(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->thread_pool;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_get_parallel_subframes(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->parallel_subframes;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_get_parallel_apodizations(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->parallel_apodizations;
+}
+
+FLAC_API unsigned FLAC__stream_encoder_get_write_buffer_size(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->write_buffer_size;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_get_async_write(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->async_write;
+}
+
+FLAC_API size_t FLAC__stream_encoder_get_workspace_bytes(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->private_->workspace_arena_bytes;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, const FLAC__int32 * const buffer[], unsigned samples)
 {
 	unsigned i, j = 0, channel;
@@ -2001,7 +2640,7 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, c
 		if(encoder->private_->current_sample_number > blocksize) {
 			FLAC__ASSERT(encoder->private_->current_sample_number == blocksize+OVERREAD_);
 			FLAC__ASSERT(OVERREAD_ == 1); /* assert we only overread 1 sample which simplifies the rest of the code below */
-			if(!process_frame_(encoder, /*is_fractional_block=*/false, /*is_last_block=*/false))
+			if(!process_block_(encoder))
 				return false;
 			/* move unprocessed overread samples to beginnings of arrays */
 			for(channel = 0; channel < channels; channel++)
@@ -2019,8 +2658,7 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, c
 
 FLAC_API FLAC__bool FLAC__stream_encoder_process_interleaved(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned samples)
 {
-	unsigned i, j, k, channel;
-	FLAC__int32 x, mid, side;
+	unsigned j = 0, channel;
 	const unsigned channels = encoder->protected_->channels, blocksize = encoder->protected_->blocksize;
 
 	FLAC__ASSERT(0 != encoder);
@@ -2028,73 +2666,34 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process_interleaved(FLAC__StreamEncoder
 	FLAC__ASSERT(0 != encoder->protected_);
 	FLAC__ASSERT(encoder->protected_->state == FLAC__STREAM_ENCODER_OK);
 
-	j = k = 0;
-	/*
-	 * we have several flavors of the same basic loop, optimized for
-	 * different conditions:
-	 */
-	if(encoder->protected_->do_mid_side_stereo && channels == 2) {
-		/*
-		 * stereo coding: unroll channel loop
-		 */
-		do {
-			if(encoder->protected_->verify)
-				append_to_verify_fifo_interleaved_(&encoder->private_->verify.input_fifo, buffer, j, channels, min(blocksize+OVERREAD_-encoder->private_->current_sample_number, samples-j));
+	do {
+		/* "blocksize+OVERREAD_" to overread 1 sample; see comment in OVERREAD_ decl */
+		const unsigned n = min(blocksize+OVERREAD_-encoder->private_->current_sample_number, samples-j);
 
-			/* "i <= blocksize" to overread 1 sample; see comment in OVERREAD_ decl */
-			for(i = encoder->private_->current_sample_number; i <= blocksize && j < samples; i++, j++) {
-				encoder->private_->integer_signal[0][i] = mid = side = buffer[k++];
-				x = buffer[k++];
-				encoder->private_->integer_signal[1][i] = x;
-				mid += x;
-				side -= x;
-				mid >>= 1; /* NOTE: not the same as 'mid = (left + right) / 2' ! */
-				encoder->private_->integer_signal_mid_side[1][i] = side;
-				encoder->private_->integer_signal_mid_side[0][i] = mid;
-			}
-			encoder->private_->current_sample_number = i;
-			/* we only process if we have a full block + 1 extra sample; final block is always handled by FLAC__stream_encoder_finish() */
-			if(i > blocksize) {
-				if(!process_frame_(encoder, /*is_fractional_block=*/false, /*is_last_block=*/false))
-					return false;
-				/* move unprocessed overread samples to beginnings of arrays */
-				FLAC__ASSERT(i == blocksize+OVERREAD_);
-				FLAC__ASSERT(OVERREAD_ == 1); /* assert we only overread 1 sample which simplifies the rest of the code below */
-				encoder->private_->integer_signal[0][0] = encoder->private_->integer_signal[0][blocksize];
-				encoder->private_->integer_signal[1][0] = encoder->private_->integer_signal[1][blocksize];
+		if(encoder->protected_->verify)
+			encoder->private_->local_append_to_verify_fifo_interleaved(&encoder->private_->verify.input_fifo, buffer, j, channels, n);
+
+		encoder->private_->local_copy_interleaved(encoder, buffer + j * channels, encoder->private_->current_sample_number, n);
+
+		j += n;
+		encoder->private_->current_sample_number += n;
+
+		/* we only process if we have a full block + 1 extra sample; final block is always handled by FLAC__stream_encoder_finish() */
+		if(encoder->private_->current_sample_number > blocksize) {
+			FLAC__ASSERT(encoder->private_->current_sample_number == blocksize+OVERREAD_);
+			FLAC__ASSERT(OVERREAD_ == 1); /* assert we only overread 1 sample which simplifies the rest of the code below */
+			if(!process_block_(encoder))
+				return false;
+			/* move unprocessed overread samples to beginnings of arrays */
+			for(channel = 0; channel < channels; channel++)
+				encoder->private_->integer_signal[channel][0] = encoder->private_->integer_signal[channel][blocksize];
+			if(encoder->protected_->do_mid_side_stereo) {
 				encoder->private_->integer_signal_mid_side[0][0] = encoder->private_->integer_signal_mid_side[0][blocksize];
 				encoder->private_->integer_signal_mid_side[1][0] = encoder->private_->integer_signal_mid_side[1][blocksize];
-				encoder->private_->current_sample_number = 1;
-			}
-		} while(j < samples);
-	}
-	else {
-		/*
-		 * independent channel coding: buffer each channel in inner loop
-		 */
-		do {
-			if(encoder->protected_->verify)
-				append_to_verify_fifo_interleaved_(&encoder->private_->verify.input_fifo, buffer, j, channels, min(blocksize+OVERREAD_-encoder->private_->current_sample_number, samples-j));
-
-			/* "i <= blocksize" to overread 1 sample; see comment in OVERREAD_ decl */
-			for(i = encoder->private_->current_sample_number; i <= blocksize && j < samples; i++, j++) {
-				for(channel = 0; channel < channels; channel++)
-					encoder->private_->integer_signal[channel][i] = buffer[k++];
-			}
-			encoder->private_->current_sample_number = i;
-			/* we only process if we have a full block + 1 extra sample; final block is always handled by FLAC__stream_encoder_finish() */
-			if(i > blocksize) {
-				if(!process_frame_(encoder, /*is_fractional_block=*/false, /*is_last_block=*/false))
-					return false;
-				/* move unprocessed overread samples to beginnings of arrays */
-				FLAC__ASSERT(i == blocksize+OVERREAD_);
-				FLAC__ASSERT(OVERREAD_ == 1); /* assert we only overread 1 sample which simplifies the rest of the code below */
-				for(channel = 0; channel < channels; channel++)
-					encoder->private_->integer_signal[channel][0] = encoder->private_->integer_signal[channel][blocksize];
-				encoder->private_->current_sample_number = 1;
 			}
-		} while(j < samples);
-	}
+			encoder->private_->current_sample_number = 1;
+		}
+	} while(j < samples);
 
 	return true;
 }
@@ -2122,22 +2721,32 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->protected_->bits_per_sample = 16;
 	encoder->protected_->sample_rate = 44100;
 	encoder->protected_->blocksize = 0;
+	encoder->protected_->variable_blocksize = false;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	encoder->protected_->num_apodizations = 1;
 	encoder->protected_->apodizations[0].type = FLAC__APODIZATION_TUKEY;
 	encoder->protected_->apodizations[0].parameters.tukey.p = 0.5;
 #endif
+	encoder->protected_->adaptive_apodization = false;
 	encoder->protected_->max_lpc_order = 0;
 	encoder->protected_->qlp_coeff_precision = 0;
 	encoder->protected_->do_qlp_coeff_prec_search = false;
 	encoder->protected_->do_exhaustive_model_search = false;
+	encoder->protected_->prune_model_search = false;
+	encoder->protected_->quiet_signal_bits = 0;
 	encoder->protected_->do_escape_coding = false;
 	encoder->protected_->min_residual_partition_order = 0;
 	encoder->protected_->max_residual_partition_order = 0;
 	encoder->protected_->rice_parameter_search_dist = 0;
+	encoder->protected_->time_budget = 0;
 	encoder->protected_->total_samples_estimate = 0;
 	encoder->protected_->metadata = 0;
 	encoder->protected_->num_metadata_blocks = 0;
+	encoder->protected_->thread_pool = 0;
+	encoder->protected_->parallel_subframes = false;
+	encoder->protected_->parallel_apodizations = false;
+	encoder->protected_->write_buffer_size = 0;
+	encoder->protected_->async_write = false;
 
 	encoder->private_->seek_table = 0;
 	encoder->private_->disable_constant_subframes = false;
@@ -2152,6 +2761,8 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->private_->tell_callback = 0;
 	encoder->private_->metadata_callback = 0;
 	encoder->private_->progress_callback = 0;
+	encoder->private_->reserve_callback = 0;
+	encoder->private_->commit_callback = 0;
 	encoder->private_->client_data = 0;
 
 #if FLAC__HAS_OGG
@@ -2161,9 +2772,16 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	FLAC__stream_encoder_set_compression_level(encoder, 5);
 }
 
+/*
+ * Frees what belongs to the stream being finished.  The signal and
+ * search buffers stay for the next init; see free_buffers_().
+ */
 void free_(FLAC__StreamEncoder *encoder)
 {
-	unsigned i, channel;
+	unsigned i;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	unsigned level;
+#endif
 
 	FLAC__ASSERT(0 != encoder);
 	if(encoder->protected_->metadata) {
@@ -2171,66 +2789,16 @@ void free_(FLAC__StreamEncoder *encoder)
 		encoder->protected_->metadata = 0;
 		encoder->protected_->num_metadata_blocks = 0;
 	}
-	for(i = 0; i < encoder->protected_->channels; i++) {
-		if(0 != encoder->private_->integer_signal_unaligned[i]) {
-			free(encoder->private_->integer_signal_unaligned[i]);
-			encoder->private_->integer_signal_unaligned[i] = 0;
-		}
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-		if(0 != encoder->private_->real_signal_unaligned[i]) {
-			free(encoder->private_->real_signal_unaligned[i]);
-			encoder->private_->real_signal_unaligned[i] = 0;
-		}
-#endif
-	}
-	for(i = 0; i < 2; i++) {
-		if(0 != encoder->private_->integer_signal_mid_side_unaligned[i]) {
-			free(encoder->private_->integer_signal_mid_side_unaligned[i]);
-			encoder->private_->integer_signal_mid_side_unaligned[i] = 0;
-		}
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-		if(0 != encoder->private_->real_signal_mid_side_unaligned[i]) {
-			free(encoder->private_->real_signal_mid_side_unaligned[i]);
-			encoder->private_->real_signal_mid_side_unaligned[i] = 0;
-		}
-#endif
-	}
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	for(i = 0; i < encoder->protected_->num_apodizations; i++) {
-		if(0 != encoder->private_->window_unaligned[i]) {
-			free(encoder->private_->window_unaligned[i]);
-			encoder->private_->window_unaligned[i] = 0;
-		}
-	}
-	if(0 != encoder->private_->windowed_signal_unaligned) {
-		free(encoder->private_->windowed_signal_unaligned);
-		encoder->private_->windowed_signal_unaligned = 0;
-	}
-#endif
-	for(channel = 0; channel < encoder->protected_->channels; channel++) {
-		for(i = 0; i < 2; i++) {
-			if(0 != encoder->private_->residual_workspace_unaligned[channel][i]) {
-				free(encoder->private_->residual_workspace_unaligned[channel][i]);
-				encoder->private_->residual_workspace_unaligned[channel][i] = 0;
+		for(level = 0; level <= MAX_BLOCK_SPLIT_LEVELS_; level++) {
+			if(0 != encoder->private_->window[level][i]) {
+				FLAC__window_cache_release(encoder->private_->window[level][i]);
+				encoder->private_->window[level][i] = 0;
 			}
 		}
 	}
-	for(channel = 0; channel < 2; channel++) {
-		for(i = 0; i < 2; i++) {
-			if(0 != encoder->private_->residual_workspace_mid_side_unaligned[channel][i]) {
-				free(encoder->private_->residual_workspace_mid_side_unaligned[channel][i]);
-				encoder->private_->residual_workspace_mid_side_unaligned[channel][i] = 0;
-			}
-		}
-	}
-	if(0 != encoder->private_->abs_residual_partition_sums_unaligned) {
-		free(encoder->private_->abs_residual_partition_sums_unaligned);
-		encoder->private_->abs_residual_partition_sums_unaligned = 0;
-	}
-	if(0 != encoder->private_->raw_bits_per_partition_unaligned) {
-		free(encoder->private_->raw_bits_per_partition_unaligned);
-		encoder->private_->raw_bits_per_partition_unaligned = 0;
-	}
+#endif
 	if(encoder->protected_->verify) {
 		for(i = 0; i < encoder->protected_->channels; i++) {
 			if(0 != encoder->private_->verify.input_fifo.data[i]) {
@@ -2242,10 +2810,78 @@ void free_(FLAC__StreamEncoder *encoder)
 	FLAC__bitwriter_free(encoder->private_->frame);
 }
 
+/*
+ * Frees the signal and search buffers, going by buffer_layout since
+ * the settings they were allocated for may have been reset already.
+ */
+void free_buffers_(FLAC__StreamEncoder *encoder)
+{
+	unsigned i, t;
+
+	FLAC__ASSERT(0 != encoder);
+	for(i = 0; i < encoder->private_->buffer_layout.search_workspaces; i++) {
+		subframe_search_workspace *workspace = &encoder->private_->search_workspace[i];
+		if(0 != workspace->lpc_task) {
+			for(t = 0; t+1 < encoder->private_->buffer_layout.lpc_search_tasks; t++)
+				free_lpc_search_task_(&workspace->lpc_task[t]);
+			free(workspace->lpc_task);
+			workspace->lpc_task = 0;
+		}
+	}
+	FLAC__memory_free_arena(encoder->private_->workspace_arena, encoder->private_->workspace_arena_bytes, encoder->private_->workspace_arena_mapped);
+	encoder->private_->workspace_arena = 0;
+	encoder->private_->workspace_arena_bytes = 0;
+	encoder->private_->input_capacity = 0;
+	memset(&encoder->private_->buffer_layout, 0, sizeof(encoder->private_->buffer_layout));
+}
+
+void free_lpc_search_task_(lpc_search_task *task)
+{
+	unsigned i;
+
+	/* the buffers are in the workspace arena */
+	for(i = 0; i < 2; i++) {
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&task->partitioned_rice_contents[i]);
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&task->workspace.partitioned_rice_contents_extra[i]);
+	}
+}
+
+/*
+ * Whether the buffers kept from the last stream have everything the
+ * current settings need.  Having more channels or search workspaces
+ * than needed is fine; the extra ones are just not used.
+ */
+FLAC__bool buffers_fit_(const FLAC__StreamEncoder *encoder)
+{
+	return
+		encoder->protected_->channels <= encoder->private_->buffer_layout.channels &&
+		encoder->private_->num_search_workspaces <= encoder->private_->buffer_layout.search_workspaces &&
+		encoder->private_->num_lpc_search_tasks <= encoder->private_->buffer_layout.lpc_search_tasks &&
+		(encoder->protected_->max_lpc_order == 0 || (encoder->private_->buffer_layout.lpc && num_lpc_models_(encoder) <= encoder->private_->buffer_layout.lpc_models)) &&
+		(!encoder->protected_->do_escape_coding || encoder->private_->buffer_layout.escape_coding)
+	;
+}
+
+/*
+ * When the tasks of an LPC search split the orders between them, the
+ * searching thread works out the model of every window up front so the
+ * tasks can share them; otherwise each search only needs one at a time.
+ */
+unsigned num_lpc_models_(const FLAC__StreamEncoder *encoder)
+{
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	return encoder->private_->lpc_search_stripe_orders? encoder->protected_->num_apodizations : 1;
+#else
+	(void)encoder;
+	return 1;
+#endif
+}
+
 FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, unsigned new_blocksize)
 {
 	FLAC__bool ok;
-	unsigned i, channel;
+	void *arena;
+	unsigned i;
 
 	FLAC__ASSERT(new_blocksize > 0);
 	FLAC__ASSERT(encoder->protected_->state == FLAC__STREAM_ENCODER_OK);
@@ -2255,126 +2891,188 @@ FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, unsigned new_blocksize)
 	if(new_blocksize <= encoder->private_->input_capacity)
 		return true;
 
+	/* a smaller arena was freed by init, see buffers_fit_() */
+	FLAC__ASSERT(0 == encoder->private_->workspace_arena);
+
 	ok = true;
 
+	/* recorded up front so that free_buffers_() also catches a partial allocation */
+	encoder->private_->buffer_layout.channels = encoder->protected_->channels;
+	encoder->private_->buffer_layout.search_workspaces = encoder->private_->num_search_workspaces;
+	encoder->private_->buffer_layout.lpc_search_tasks = encoder->private_->num_lpc_search_tasks;
+	encoder->private_->buffer_layout.lpc = encoder->protected_->max_lpc_order > 0;
+	encoder->private_->buffer_layout.lpc_models = num_lpc_models_(encoder);
+	encoder->private_->buffer_layout.escape_coding = encoder->protected_->do_escape_coding;
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	if(encoder->private_->num_lpc_search_tasks > 1) {
+		for(i = 0; ok && i < encoder->private_->num_search_workspaces; i++)
+			ok = ok && alloc_lpc_search_tasks_(encoder, &encoder->private_->search_workspace[i]);
+	}
+#else
+	(void)i;
+#endif
+
+	if(ok) {
+		/* measure, then carve */
+		encoder->private_->workspace_arena_bytes = layout_buffers_(encoder, new_blocksize, 0);
+		encoder->private_->workspace_arena = FLAC__memory_alloc_arena(encoder->private_->workspace_arena_bytes, &arena, &encoder->private_->workspace_arena_mapped);
+		if(0 == encoder->private_->workspace_arena)
+			ok = false;
+		else
+			(void)layout_buffers_(encoder, new_blocksize, (FLAC__byte*)arena);
+	}
+
+	if(ok)
+		encoder->private_->input_capacity = new_blocksize;
+	else
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+
+	return ok;
+}
+
+/*
+ * Lays the signal, residual and search buffers out in the workspace
+ * arena and returns its size; with a NULL arena it only measures.  The
+ * buffers each stage of the search walks together are kept together:
+ * a channel's signal with its two candidate residuals, then each search
+ * workspace with the buffers of its LPC search tasks.  Every buffer
+ * starts on a cache line, so threads searching different subframes
+ * never write to the same line.
+ */
+size_t layout_buffers_(FLAC__StreamEncoder *encoder, unsigned blocksize, FLAC__byte *arena)
+{
+	size_t offset = 0;
+	unsigned i, channel;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	unsigned t;
+#endif
+
 	/* WATCHOUT: FLAC__lpc_compute_residual_from_qlp_coefficients_asm_ia32_mmx()
 	 * requires that the input arrays (in our case the integer signals)
 	 * have a buffer of up to 3 zeroes in front (at negative indices) for
 	 * alignment purposes; we use 4 in front to keep the data well-aligned.
 	 */
 
-	for(i = 0; ok && i < encoder->protected_->channels; i++) {
-		ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize+4+OVERREAD_, &encoder->private_->integer_signal_unaligned[i], &encoder->private_->integer_signal[i]);
-		memset(encoder->private_->integer_signal[i], 0, sizeof(FLAC__int32)*4);
-		encoder->private_->integer_signal[i] += 4;
+	for(channel = 0; channel < encoder->protected_->channels; channel++) {
+		FLAC__int32 *signal = (FLAC__int32*)arena_take_(arena, &offset, sizeof(FLAC__int32) * (blocksize+4+OVERREAD_));
+		if(0 != arena) {
+			memset(signal, 0, sizeof(FLAC__int32)*4);
+			encoder->private_->integer_signal[channel] = signal + 4;
+		}
+		for(i = 0; i < 2; i++)
+			encoder->private_->residual_workspace[channel][i] = (FLAC__int32*)arena_take_(arena, &offset, sizeof(FLAC__int32) * blocksize);
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 #if 0 /* @@@ currently unused */
 		if(encoder->protected_->max_lpc_order > 0)
-			ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize+OVERREAD_, &encoder->private_->real_signal_unaligned[i], &encoder->private_->real_signal[i]);
+			encoder->private_->real_signal[channel] = (FLAC__real*)arena_take_(arena, &offset, sizeof(FLAC__real) * (blocksize+OVERREAD_));
 #endif
 #endif
 	}
-	for(i = 0; ok && i < 2; i++) {
-		ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize+4+OVERREAD_, &encoder->private_->integer_signal_mid_side_unaligned[i], &encoder->private_->integer_signal_mid_side[i]);
-		memset(encoder->private_->integer_signal_mid_side[i], 0, sizeof(FLAC__int32)*4);
-		encoder->private_->integer_signal_mid_side[i] += 4;
+	for(channel = 0; channel < 2; channel++) {
+		FLAC__int32 *signal = (FLAC__int32*)arena_take_(arena, &offset, sizeof(FLAC__int32) * (blocksize+4+OVERREAD_));
+		if(0 != arena) {
+			memset(signal, 0, sizeof(FLAC__int32)*4);
+			encoder->private_->integer_signal_mid_side[channel] = signal + 4;
+		}
+		for(i = 0; i < 2; i++)
+			encoder->private_->residual_workspace_mid_side[channel][i] = (FLAC__int32*)arena_take_(arena, &offset, sizeof(FLAC__int32) * blocksize);
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 #if 0 /* @@@ currently unused */
 		if(encoder->protected_->max_lpc_order > 0)
-			ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize+OVERREAD_, &encoder->private_->real_signal_mid_side_unaligned[i], &encoder->private_->real_signal_mid_side[i]);
+			encoder->private_->real_signal_mid_side[channel] = (FLAC__real*)arena_take_(arena, &offset, sizeof(FLAC__real) * (blocksize+OVERREAD_));
 #endif
 #endif
 	}
+	/* the *2 is an approximation to the series 1 + 1/2 + 1/4 + ... that sums tree occupies in a flat array */
+	/*@@@ blocksize*2 is too pessimistic, but to fix, we need smarter logic because a smaller blocksize can actually increase the # of partitions; would require moving this out into a separate function, then checking its capacity against the need of the current blocksize&min/max_partition_order (and maybe predictor order) */
+	for(i = 0; i < encoder->private_->num_search_workspaces; i++) {
+		subframe_search_workspace *workspace = &encoder->private_->search_workspace[i];
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
-	if(ok && encoder->protected_->max_lpc_order > 0) {
-		for(i = 0; ok && i < encoder->protected_->num_apodizations; i++)
-			ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize, &encoder->private_->window_unaligned[i], &encoder->private_->window[i]);
-		ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize, &encoder->private_->windowed_signal_unaligned, &encoder->private_->windowed_signal);
-	}
-#endif
-	for(channel = 0; ok && channel < encoder->protected_->channels; channel++) {
-		for(i = 0; ok && i < 2; i++) {
-			ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize, &encoder->private_->residual_workspace_unaligned[channel][i], &encoder->private_->residual_workspace[channel][i]);
+		if(encoder->protected_->max_lpc_order > 0) {
+			workspace->windowed_signal = (FLAC__real*)arena_take_(arena, &offset, sizeof(FLAC__real) * blocksize);
+			workspace->lpc_model = (lpc_model*)arena_take_(arena, &offset, sizeof(lpc_model) * num_lpc_models_(encoder));
 		}
-	}
-	for(channel = 0; ok && channel < 2; channel++) {
-		for(i = 0; ok && i < 2; i++) {
-			ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize, &encoder->private_->residual_workspace_mid_side_unaligned[channel][i], &encoder->private_->residual_workspace_mid_side[channel][i]);
+#endif
+		workspace->abs_residual_partition_sums = (FLAC__uint64*)arena_take_(arena, &offset, sizeof(FLAC__uint64) * blocksize * 2);
+		if(encoder->protected_->do_escape_coding)
+			workspace->raw_bits_per_partition = (unsigned*)arena_take_(arena, &offset, sizeof(unsigned) * blocksize * 2);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+		for(t = 0; 0 != workspace->lpc_task && t+1 < encoder->private_->num_lpc_search_tasks; t++) {
+			lpc_search_task *task = &workspace->lpc_task[t];
+			task->workspace.windowed_signal = (FLAC__real*)arena_take_(arena, &offset, sizeof(FLAC__real) * blocksize);
+			task->workspace.lpc_model = (lpc_model*)arena_take_(arena, &offset, sizeof(lpc_model));
+			task->residual[0] = (FLAC__int32*)arena_take_(arena, &offset, sizeof(FLAC__int32) * blocksize);
+			task->residual[1] = (FLAC__int32*)arena_take_(arena, &offset, sizeof(FLAC__int32) * blocksize);
+			task->workspace.abs_residual_partition_sums = (FLAC__uint64*)arena_take_(arena, &offset, sizeof(FLAC__uint64) * blocksize * 2);
+			if(encoder->protected_->do_escape_coding)
+				task->workspace.raw_bits_per_partition = (unsigned*)arena_take_(arena, &offset, sizeof(unsigned) * blocksize * 2);
 		}
+#endif
 	}
-	/* the *2 is an approximation to the series 1 + 1/2 + 1/4 + ... that sums tree occupies in a flat array */
-	/*@@@ new_blocksize*2 is too pessimistic, but to fix, we need smarter logic because a smaller new_blocksize can actually increase the # of partitions; would require moving this out into a separate function, then checking its capacity against the need of the current blocksize&min/max_partition_order (and maybe predictor order) */
-	ok = ok && FLAC__memory_alloc_aligned_uint64_array(new_blocksize * 2, &encoder->private_->abs_residual_partition_sums_unaligned, &encoder->private_->abs_residual_partition_sums);
-	if(encoder->protected_->do_escape_coding)
-		ok = ok && FLAC__memory_alloc_aligned_unsigned_array(new_blocksize * 2, &encoder->private_->raw_bits_per_partition_unaligned, &encoder->private_->raw_bits_per_partition);
 
-	/* now adjust the windows if the blocksize has changed */
+	return offset;
+}
+
+/* Returns the next cache-line-aligned 'bytes' of the arena, or NULL when only measuring. */
+void *arena_take_(FLAC__byte *arena, size_t *offset, size_t bytes)
+{
+	void *p = 0 != arena? arena + *offset : 0;
+	*offset += (bytes + FLAC__MEMORY_ARENA_ALIGNMENT - 1) & ~(size_t)(FLAC__MEMORY_ARENA_ALIGNMENT - 1);
+	return p;
+}
+
+/*
+ * The windows are sized by the blocksize, not the buffer capacity, so
+ * they are acquired for every stream; free_() hands them back.
+ */
+FLAC__bool acquire_windows_(FLAC__StreamEncoder *encoder)
+{
+	FLAC__bool ok = true;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
-	if(ok && new_blocksize != encoder->private_->input_capacity && encoder->protected_->max_lpc_order > 0) {
+	unsigned i, level;
+
+	if(encoder->protected_->max_lpc_order > 0) {
 		for(i = 0; ok && i < encoder->protected_->num_apodizations; i++) {
-			switch(encoder->protected_->apodizations[i].type) {
-				case FLAC__APODIZATION_BARTLETT:
-					FLAC__window_bartlett(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_BARTLETT_HANN:
-					FLAC__window_bartlett_hann(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_BLACKMAN:
-					FLAC__window_blackman(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_BLACKMAN_HARRIS_4TERM_92DB_SIDELOBE:
-					FLAC__window_blackman_harris_4term_92db_sidelobe(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_CONNES:
-					FLAC__window_connes(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_FLATTOP:
-					FLAC__window_flattop(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_GAUSS:
-					FLAC__window_gauss(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.gauss.stddev);
-					break;
-				case FLAC__APODIZATION_HAMMING:
-					FLAC__window_hamming(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_HANN:
-					FLAC__window_hann(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_KAISER_BESSEL:
-					FLAC__window_kaiser_bessel(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_NUTTALL:
-					FLAC__window_nuttall(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_RECTANGLE:
-					FLAC__window_rectangle(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_TRIANGLE:
-					FLAC__window_triangle(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_TUKEY:
-					FLAC__window_tukey(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.tukey.p);
-					break;
-				case FLAC__APODIZATION_WELCH:
-					FLAC__window_welch(encoder->private_->window[i], new_blocksize);
-					break;
-				default:
-					FLAC__ASSERT(0);
-					/* double protection */
-					FLAC__window_hann(encoder->private_->window[i], new_blocksize);
-					break;
+			for(level = 0; ok && level <= encoder->private_->num_split_levels; level++) {
+				if(0 != encoder->private_->window[level][i])
+					FLAC__window_cache_release(encoder->private_->window[level][i]);
+				encoder->private_->window[level][i] = FLAC__window_cache_acquire(&encoder->protected_->apodizations[i], encoder->protected_->blocksize >> level);
+				ok = (0 != encoder->private_->window[level][i]);
 			}
 		}
 	}
+	if(!ok)
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+#else
+	(void)encoder;
 #endif
+	return ok;
+}
 
-	if(ok)
-		encoder->private_->input_capacity = new_blocksize;
-	else
-		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+/* The tasks' buffers are carved out of the workspace arena afterwards, see layout_buffers_(). */
+FLAC__bool alloc_lpc_search_tasks_(FLAC__StreamEncoder *encoder, subframe_search_workspace *workspace)
+{
+	unsigned t, i;
 
-	return ok;
+	FLAC__ASSERT(encoder->private_->num_lpc_search_tasks > 1);
+	FLAC__ASSERT(0 == workspace->lpc_task);
+
+	if(0 == (workspace->lpc_task = (lpc_search_task*)safe_calloc_(encoder->private_->num_lpc_search_tasks-1, sizeof(lpc_search_task))))
+		return false;
+	for(t = 0; t+1 < encoder->private_->num_lpc_search_tasks; t++) {
+		lpc_search_task *task = &workspace->lpc_task[t];
+		for(i = 0; i < 2; i++) {
+			task->subframe_ptr[i] = &task->subframe[i];
+			task->partitioned_rice_contents_ptr[i] = &task->partitioned_rice_contents[i];
+			FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&task->partitioned_rice_contents[i]);
+			FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&task->workspace.partitioned_rice_contents_extra[i]);
+		}
+	}
+	return true;
 }
+#endif
 
 FLAC__bool write_bitbuffer_(FLAC__StreamEncoder *encoder, unsigned samples, FLAC__bool is_last_block)
 {
@@ -2495,7 +3193,10 @@ FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const
 	}
 	else
 #endif
-	status = encoder->private_->write_callback(encoder, buffer, bytes, samples, encoder->private_->current_frame_number, encoder->private_->client_data);
+	if(samples > 0 && encoder->private_->frame_buffer_bytes > 0)
+		status = encoder->private_->commit_callback(encoder, buffer, bytes, samples, encoder->private_->current_frame_number, encoder->private_->client_data);
+	else
+		status = encoder->private_->write_callback(encoder, buffer, bytes, samples, encoder->private_->current_frame_number, encoder->private_->client_data);
 
 	if(status == FLAC__STREAM_ENCODER_WRITE_STATUS_OK) {
 		encoder->private_->bytes_written += bytes;
@@ -2591,6 +3292,25 @@ void update_metadata_(const FLAC__StreamEncoder *encoder)
 		}
 	}
 
+	/*
+	 * Write min/max blocksize, if they were not known up front
+	 */
+	if(encoder->protected_->variable_blocksize) {
+		b[0] = (FLAC__byte)((metadata->data.stream_info.min_blocksize >> 8) & 0xFF);
+		b[1] = (FLAC__byte)(metadata->data.stream_info.min_blocksize & 0xFF);
+		b[2] = (FLAC__byte)((metadata->data.stream_info.max_blocksize >> 8) & 0xFF);
+		b[3] = (FLAC__byte)(metadata->data.stream_info.max_blocksize & 0xFF);
+		if((seek_status = encoder->private_->seek_callback(encoder, encoder->protected_->streaminfo_offset + FLAC__STREAM_METADATA_HEADER_LENGTH, encoder->private_->client_data)) != FLAC__STREAM_ENCODER_SEEK_STATUS_OK) {
+			if(seek_status == FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR)
+				encoder->protected_->state = FLAC__STREAM_ENCODER_CLIENT_ERROR;
+			return;
+		}
+		if(encoder->private_->write_callback(encoder, b, 4, 0, 0, encoder->private_->client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_CLIENT_ERROR;
+			return;
+		}
+	}
+
 	/*
 	 * Write min/max framesize
 	 */
@@ -2768,6 +3488,27 @@ void update_ogg_metadata_(FLAC__StreamEncoder *encoder)
 		memcpy(page.body + total_samples_byte_offset, b, 5);
 	}
 
+	/*
+	 * Write min/max blocksize, if they were not known up front
+	 */
+	if(encoder->protected_->variable_blocksize) {
+		const unsigned min_blocksize_offset =
+			FIRST_OGG_PACKET_STREAMINFO_PREFIX_LENGTH +
+			FLAC__STREAM_METADATA_HEADER_LENGTH
+		;
+
+		if(min_blocksize_offset + 4 > (unsigned)page.body_len) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_OGG_ERROR;
+			simple_ogg_page__clear(&page);
+			return;
+		}
+		b[0] = (FLAC__byte)((metadata->data.stream_info.min_blocksize >> 8) & 0xFF);
+		b[1] = (FLAC__byte)(metadata->data.stream_info.min_blocksize & 0xFF);
+		b[2] = (FLAC__byte)((metadata->data.stream_info.max_blocksize >> 8) & 0xFF);
+		b[3] = (FLAC__byte)(metadata->data.stream_info.max_blocksize & 0xFF);
+		memcpy(page.body + min_blocksize_offset, b, 4);
+	}
+
 	/*
 	 * Write min/max framesize
 	 */
@@ -2858,17 +3599,148 @@ void update_ogg_metadata_(FLAC__StreamEncoder *encoder)
 }
 #endif
 
+FLAC__bool process_block_(FLAC__StreamEncoder *encoder)
+{
+	const unsigned blocksize = encoder->protected_->blocksize;
+	unsigned split_level[1u << MAX_BLOCK_SPLIT_LEVELS_], num_frames = 0, frame, offset = 0, channel;
+	FLAC__bool ok = true;
+
+	encoder->private_->block_end_sample = encoder->private_->streaminfo.data.stream_info.total_samples + blocksize;
+
+	if(encoder->private_->num_split_levels == 0)
+		return process_frame_(encoder, /*is_fractional_block=*/false, /*is_last_block=*/false);
+
+	split_block_(encoder, 0, 0, split_level, &num_frames);
+
+	/* the frame is always encoded from the start of the signal arrays, so move them along the block */
+	for(frame = 0; ok && frame < num_frames; frame++) {
+		const unsigned frame_blocksize = blocksize >> split_level[frame];
+		encoder->protected_->blocksize = frame_blocksize;
+		encoder->private_->split_level = split_level[frame];
+		ok = process_frame_(encoder, /*is_fractional_block=*/false, /*is_last_block=*/false);
+		for(channel = 0; channel < encoder->protected_->channels; channel++)
+			encoder->private_->integer_signal[channel] += frame_blocksize;
+		if(encoder->protected_->do_mid_side_stereo) {
+			encoder->private_->integer_signal_mid_side[0] += frame_blocksize;
+			encoder->private_->integer_signal_mid_side[1] += frame_blocksize;
+		}
+		offset += frame_blocksize;
+	}
+	for(channel = 0; channel < encoder->protected_->channels; channel++)
+		encoder->private_->integer_signal[channel] -= offset;
+	if(encoder->protected_->do_mid_side_stereo) {
+		encoder->private_->integer_signal_mid_side[0] -= offset;
+		encoder->private_->integer_signal_mid_side[1] -= offset;
+	}
+	encoder->protected_->blocksize = blocksize;
+	encoder->private_->split_level = 0;
+
+	return ok;
+}
+
+/*
+ * Finds the cheapest way to encode the part of the block at level 'level'
+ * starting at 'offset': as one frame, or as the best splits of its two
+ * halves.  The frames are appended to split_level[] as the level of each,
+ * and the estimated bits are returned.
+ */
+FLAC__uint64 split_block_(FLAC__StreamEncoder *encoder, unsigned level, unsigned offset, unsigned split_level[], unsigned *num_frames)
+{
+	const unsigned blocksize = encoder->protected_->blocksize >> level;
+	const FLAC__uint64 bits = estimate_block_bits_(encoder, offset, blocksize);
+
+	if(level < encoder->private_->num_split_levels) {
+		const unsigned first_frame = *num_frames;
+		FLAC__uint64 split_bits = split_block_(encoder, level+1, offset, split_level, num_frames);
+		split_bits += split_block_(encoder, level+1, offset + blocksize/2, split_level, num_frames);
+		if(split_bits < bits)
+			return split_bits;
+		*num_frames = first_frame;
+	}
+	split_level[(*num_frames)++] = level;
+	return bits;
+}
+
+/*
+ * A quick guess at the size of a frame of 'blocksize' samples of the
+ * current block starting at 'offset', from the residual of the best
+ * fixed predictor on each channel (mid and side, if doing mid/side
+ * stereo), plus the frame and subframe headers and the warmup samples
+ * and coefficients of a predictor of the largest order searched.  It
+ * only has to be good enough to compare the same samples split
+ * different ways.
+ */
+FLAC__uint64 estimate_block_bits_(FLAC__StreamEncoder *encoder, unsigned offset, unsigned blocksize)
+{
+	const FLAC__bool mid_side = encoder->protected_->do_mid_side_stereo;
+	const unsigned channels = mid_side? 2 : encoder->protected_->channels;
+	const unsigned bps = encoder->protected_->bits_per_sample;
+	/* a frame header is at most 16 bytes, then there is the CRC-16 footer */
+	FLAC__uint64 bits = 16 * 8 + FLAC__FRAME_FOOTER_CRC_LEN;
+	unsigned channel, order;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	FLAC__float fixed_residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1];
+#else
+	FLAC__fixedpoint fixed_residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1];
+#endif
+
+	for(channel = 0; channel < channels; channel++) {
+		const FLAC__int32 *signal = (mid_side? encoder->private_->integer_signal_mid_side[channel] : encoder->private_->integer_signal[channel]) + offset;
+		/* the signal has not been analyzed yet, so assume the largest it can be; the side channel has one more bit */
+		order = fixed_compute_best_predictor_(encoder, signal+FLAC__MAX_FIXED_ORDER, blocksize-FLAC__MAX_FIXED_ORDER, (FLAC__uint32)1 << (mid_side? bps : bps-1), fixed_residual_bits_per_sample);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+		bits += (FLAC__uint64)(fixed_residual_bits_per_sample[order] * blocksize);
+#else
+		bits += ((FLAC__uint64)fixed_residual_bits_per_sample[order] * blocksize) >> 16;
+#endif
+		if(encoder->private_->effort.max_lpc_order > 0) {
+			order = encoder->private_->effort.max_lpc_order;
+			bits += order * encoder->protected_->qlp_coeff_precision + FLAC__SUBFRAME_LPC_QLP_COEFF_PRECISION_LEN + FLAC__SUBFRAME_LPC_QLP_SHIFT_LEN;
+		}
+		/* 'order' warmup samples */
+		bits += FLAC__SUBFRAME_ZERO_PAD_LEN + FLAC__SUBFRAME_TYPE_LEN + FLAC__SUBFRAME_WASTED_BITS_FLAG_LEN + order * bps;
+		bits += FLAC__ENTROPY_CODING_METHOD_TYPE_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_ORDER_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_PARAMETER_LEN;
+	}
+
+	return bits;
+}
+
 FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_fractional_block, FLAC__bool is_last_block)
 {
 	FLAC__uint16 crc;
+	FLAC__bool ok;
+	const FLAC__uint64 start_time = encoder->protected_->time_budget > 0? get_time_us_() : 0;
+	FLAC__uint64 frame_time = 0;
 	FLAC__ASSERT(encoder->protected_->state == FLAC__STREAM_ENCODER_OK);
 
 	/*
 	 * Accumulate raw signal to the MD5 signature
 	 */
-	if(encoder->protected_->do_md5 && !FLAC__MD5Accumulate(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->integer_signal, encoder->protected_->channels, encoder->protected_->blocksize, (encoder->protected_->bits_per_sample+7) / 8)) {
-		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-		return false;
+	if(encoder->protected_->do_md5) {
+		if(0 != encoder->private_->thread_pool_queue) {
+			/* the signal is copied out here and hashed in the pool while we encode the frame */
+			FLAC__thread_pool_wait(encoder->private_->thread_pool_queue);
+			if(!FLAC__MD5Format(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->integer_signal, encoder->protected_->channels, encoder->protected_->blocksize, (encoder->protected_->bits_per_sample+7) / 8, &encoder->private_->md5_bytes)) {
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
+			FLAC__thread_pool_submit(encoder->private_->thread_pool_queue, md5_accumulate_task_, encoder->private_);
+		}
+		else if(!FLAC__MD5Accumulate(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->integer_signal, encoder->protected_->channels, encoder->protected_->blocksize, (encoder->protected_->bits_per_sample+7) / 8)) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+	}
+
+	/*
+	 * Encode straight into the client's buffer if it wants that
+	 */
+	if(encoder->private_->frame_buffer_bytes > 0) {
+		FLAC__byte *buffer = encoder->private_->reserve_callback(encoder, encoder->private_->frame_buffer_bytes, encoder->private_->client_data);
+		if(!FLAC__bitwriter_attach_buffer(encoder->private_->frame, buffer, encoder->private_->frame_buffer_bytes)) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_CLIENT_ERROR;
+			return false;
+		}
 	}
 
 	/*
@@ -2899,10 +3771,19 @@ FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_fractional
 		return false;
 	}
 
+	/* the budget is for encoding; the time spent in the client's write callback is its own */
+	if(encoder->protected_->time_budget > 0) {
+		const FLAC__uint64 end_time = get_time_us_();
+		frame_time = end_time > start_time? end_time - start_time : 0;
+	}
+
 	/*
 	 * Write it
 	 */
-	if(!write_bitbuffer_(encoder, encoder->protected_->blocksize, is_last_block)) {
+	ok = write_bitbuffer_(encoder, encoder->protected_->blocksize, is_last_block);
+	if(encoder->private_->frame_buffer_bytes > 0)
+		FLAC__bitwriter_detach_buffer(encoder->private_->frame);
+	if(!ok) {
 		/* the above function sets the state for us in case of an error */
 		return false;
 	}
@@ -2913,8 +3794,153 @@ FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_fractional
 	encoder->private_->current_sample_number = 0;
 	encoder->private_->current_frame_number++;
 	encoder->private_->streaminfo.data.stream_info.total_samples += (FLAC__uint64)encoder->protected_->blocksize;
+	if(!is_last_block) {
+		encoder->private_->min_frame_blocksize = min(encoder->protected_->blocksize, encoder->private_->min_frame_blocksize);
+		encoder->private_->max_frame_blocksize = max(encoder->protected_->blocksize, encoder->private_->max_frame_blocksize);
+	}
+
+	if(encoder->protected_->time_budget > 0)
+		update_time_budget_(encoder, frame_time);
+
+	return true;
+}
+
+void md5_accumulate_task_(void *data)
+{
+	FLAC__StreamEncoderPrivate *private_ = (FLAC__StreamEncoderPrivate*)data;
+	FLAC__MD5AccumulateFormatted(&private_->md5context, private_->md5_bytes);
+}
+
+/*
+ * A monotonic clock, in microseconds; only differences between two
+ * readings are used.  Where there is none the wall clock has to do,
+ * and the caller treats it going backwards as no time at all.
+ */
+FLAC__uint64 get_time_us_(void)
+{
+#if defined _WIN32 && !defined __CYGWIN__
+	LARGE_INTEGER count, frequency;
+	if(!QueryPerformanceCounter(&count) || !QueryPerformanceFrequency(&frequency) || frequency.QuadPart == 0)
+		return (FLAC__uint64)GetTickCount() * 1000;
+	return (FLAC__uint64)(count.QuadPart / frequency.QuadPart) * 1000000 + (FLAC__uint64)(count.QuadPart % frequency.QuadPart) * 1000000 / (FLAC__uint64)frequency.QuadPart;
+#elif defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return (FLAC__uint64)ts.tv_sec * 1000000 + (FLAC__uint64)ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	if(gettimeofday(&tv, 0) != 0)
+		return 0;
+	return (FLAC__uint64)tv.tv_sec * 1000000 + (FLAC__uint64)tv.tv_usec;
+#endif
+}
+
+/*
+ * The search settings for an effort level.  Each level keeps the cuts of
+ * the ones before it, roughly in order of how much time they save for
+ * how much compression they cost.
+ */
+void get_search_effort_(const FLAC__StreamEncoder *encoder, unsigned level, search_effort *effort)
+{
+	effort->max_lpc_order = encoder->protected_->max_lpc_order;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	effort->num_apodizations = encoder->protected_->num_apodizations;
+#else
+	effort->num_apodizations = 1;
+#endif
+	effort->do_qlp_coeff_prec_search = encoder->protected_->do_qlp_coeff_prec_search;
+	effort->do_exhaustive_model_search = encoder->protected_->do_exhaustive_model_search;
+	effort->max_residual_partition_order = encoder->protected_->max_residual_partition_order;
+	effort->loose_mid_side_stereo = encoder->protected_->loose_mid_side_stereo;
+
+	if(level >= 1) {
+		effort->do_qlp_coeff_prec_search = false;
+		effort->do_exhaustive_model_search = false;
+	}
+	if(level >= 2)
+		effort->num_apodizations = 1;
+	if(level >= 3 && encoder->protected_->do_mid_side_stereo)
+		effort->loose_mid_side_stereo = true;
+	if(level >= 4)
+		effort->max_residual_partition_order = min(effort->max_residual_partition_order, 3);
+	if(level >= 5)
+		effort->max_lpc_order = min(effort->max_lpc_order, 8);
+	if(level >= 6)
+		effort->max_lpc_order = min(effort->max_lpc_order, 4);
+	if(level >= 7)
+		effort->max_lpc_order = 0;
+}
+
+FLAC__bool search_effort_equal_(const search_effort *a, const search_effort *b)
+{
+	return
+		a->max_lpc_order == b->max_lpc_order &&
+		a->num_apodizations == b->num_apodizations &&
+		a->do_qlp_coeff_prec_search == b->do_qlp_coeff_prec_search &&
+		a->do_exhaustive_model_search == b->do_exhaustive_model_search &&
+		a->max_residual_partition_order == b->max_residual_partition_order &&
+		a->loose_mid_side_stereo == b->loose_mid_side_stereo
+	;
+}
+
+/*
+ * Moves the effort level one step whenever the frames at the current
+ * level are over the budget, or the level above it was last seen to fit.
+ * What a level was last seen to cost is forgotten little by little, so
+ * that the encoder tries it again once the audio may have gotten easier.
+ * Levels that would not change anything are skipped.
+ */
+void update_time_budget_(FLAC__StreamEncoder *encoder, FLAC__uint64 frame_time)
+{
+	FLAC__StreamEncoderPrivate *private_ = encoder->private_;
+	const FLAC__uint64 budget = (FLAC__uint64)encoder->protected_->blocksize * 10000 * encoder->protected_->time_budget / encoder->protected_->sample_rate;
+	const unsigned cost = budget > 0? (unsigned)min(frame_time * 1000 / budget + 1, 1000000) : 1000000;
+	unsigned *level_cost = &private_->effort_cost[private_->effort_level];
+	unsigned level, lower = 0;
+	search_effort effort, lower_effort;
+
+	/* smooth over about 8 frames */
+	*level_cost = *level_cost == 0? cost : *level_cost - *level_cost / 8 + cost / 8;
+
+	if(private_->effort_level > 0) {
+		/* the lowest level with the same settings as the one below ours */
+		lower = private_->effort_level - 1;
+		get_search_effort_(encoder, lower, &lower_effort);
+		while(lower > 0) {
+			get_search_effort_(encoder, lower - 1, &effort);
+			if(!search_effort_equal_(&effort, &lower_effort))
+				break;
+			lower--;
+		}
+		private_->effort_cost[lower] -= private_->effort_cost[lower] / 256;
+	}
+
+	if(private_->effort_settle_frames > 0) {
+		private_->effort_settle_frames--;
+		return;
+	}
+
+	if(*level_cost > 1000) {
+		for(level = private_->effort_level + 1; level <= MAX_EFFORT_LEVEL_; level++) {
+			get_search_effort_(encoder, level, &effort);
+			if(!search_effort_equal_(&effort, &private_->effort))
+				break;
+		}
+		if(level > MAX_EFFORT_LEVEL_)
+			return;
+	}
+	else if(private_->effort_level > 0 && private_->effort_cost[lower] < 900) {
+		level = lower;
+		effort = lower_effort;
+	}
+	else
+		return;
 
-	return true;
+	private_->effort_level = level;
+	private_->effort = effort;
+	private_->effort_cost[level] = 0;
+	private_->effort_settle_frames = EFFORT_SETTLE_FRAMES_;
 }
 
 FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fractional_block)
@@ -2922,6 +3948,8 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 	FLAC__FrameHeader frame_header;
 	unsigned channel, min_partition_order = encoder->protected_->min_residual_partition_order, max_partition_order;
 	FLAC__bool do_independent, do_mid_side;
+	subframe_search_job jobs[FLAC__MAX_CHANNELS];
+	unsigned i, num_jobs;
 
 	/*
 	 * Calculate the min,max Rice partition orders
@@ -2931,7 +3959,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 	}
 	else {
 		max_partition_order = FLAC__format_get_max_rice_partition_order_from_blocksize(encoder->protected_->blocksize);
-		max_partition_order = min(max_partition_order, encoder->protected_->max_residual_partition_order);
+		max_partition_order = min(max_partition_order, encoder->private_->effort.max_residual_partition_order);
 	}
 	min_partition_order = min(min_partition_order, max_partition_order);
 
@@ -2943,14 +3971,20 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 	frame_header.channels = encoder->protected_->channels;
 	frame_header.channel_assignment = FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT; /* the default unless the encoder determines otherwise */
 	frame_header.bits_per_sample = encoder->protected_->bits_per_sample;
-	frame_header.number_type = FLAC__FRAME_NUMBER_TYPE_FRAME_NUMBER;
-	frame_header.number.frame_number = encoder->private_->current_frame_number;
+	if(encoder->protected_->variable_blocksize) {
+		frame_header.number_type = FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER;
+		frame_header.number.sample_number = encoder->private_->streaminfo.data.stream_info.total_samples;
+	}
+	else {
+		frame_header.number_type = FLAC__FRAME_NUMBER_TYPE_FRAME_NUMBER;
+		frame_header.number.frame_number = encoder->private_->current_frame_number;
+	}
 
 	/*
 	 * Figure out what channel assignments to try
 	 */
 	if(encoder->protected_->do_mid_side_stereo) {
-		if(encoder->protected_->loose_mid_side_stereo) {
+		if(encoder->private_->effort.loose_mid_side_stereo) {
 			if(encoder->private_->loose_mid_side_stereo_frame_count == 0) {
 				do_independent = true;
 				do_mid_side = true;
@@ -2973,11 +4007,11 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 	FLAC__ASSERT(do_independent || do_mid_side);
 
 	/*
-	 * Check for wasted bits; set effective bps for each subframe
+	 * Check for wasted bits and the range of each signal; set effective bps for each subframe
 	 */
 	if(do_independent) {
 		for(channel = 0; channel < encoder->protected_->channels; channel++) {
-			const unsigned w = get_wasted_bits_(encoder->private_->integer_signal[channel], encoder->protected_->blocksize);
+			const unsigned w = analyze_signal_(encoder->private_->integer_signal[channel], encoder->protected_->blocksize, encoder->private_->analysis+channel);
 			encoder->private_->subframe_workspace[channel][0].wasted_bits = encoder->private_->subframe_workspace[channel][1].wasted_bits = w;
 			encoder->private_->subframe_bps[channel] = encoder->protected_->bits_per_sample - w;
 		}
@@ -2985,61 +4019,100 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 	if(do_mid_side) {
 		FLAC__ASSERT(encoder->protected_->channels == 2);
 		for(channel = 0; channel < 2; channel++) {
-			const unsigned w = get_wasted_bits_(encoder->private_->integer_signal_mid_side[channel], encoder->protected_->blocksize);
+			const unsigned w = analyze_signal_(encoder->private_->integer_signal_mid_side[channel], encoder->protected_->blocksize, encoder->private_->analysis_mid_side+channel);
 			encoder->private_->subframe_workspace_mid_side[channel][0].wasted_bits = encoder->private_->subframe_workspace_mid_side[channel][1].wasted_bits = w;
 			encoder->private_->subframe_bps_mid_side[channel] = encoder->protected_->bits_per_sample - w + (channel==0? 0:1);
 		}
 	}
 
 	/*
-	 * First do a normal encoding pass of each independent channel
+	 * First do a normal encoding pass of each independent channel, then
+	 * mid and side channels if requested
 	 */
+	num_jobs = 0;
 	if(do_independent) {
-		for(channel = 0; channel < encoder->protected_->channels; channel++) {
-			if(!
-				process_subframe_(
-					encoder,
-					min_partition_order,
-					max_partition_order,
-					&frame_header,
-					encoder->private_->subframe_bps[channel],
-					encoder->private_->integer_signal[channel],
-					encoder->private_->subframe_workspace_ptr[channel],
-					encoder->private_->partitioned_rice_contents_workspace_ptr[channel],
-					encoder->private_->residual_workspace[channel],
-					encoder->private_->best_subframe+channel,
-					encoder->private_->best_subframe_bits+channel
-				)
-			)
-				return false;
+		for(channel = 0; channel < encoder->protected_->channels; channel++, num_jobs++) {
+			jobs[num_jobs].subframe_bps = encoder->private_->subframe_bps[channel];
+			jobs[num_jobs].integer_signal = encoder->private_->integer_signal[channel];
+			jobs[num_jobs].analysis = encoder->private_->analysis+channel;
+			jobs[num_jobs].subframe = encoder->private_->subframe_workspace_ptr[channel];
+			jobs[num_jobs].partitioned_rice_contents = encoder->private_->partitioned_rice_contents_workspace_ptr[channel];
+			jobs[num_jobs].residual = encoder->private_->residual_workspace[channel];
+			jobs[num_jobs].best_subframe = encoder->private_->best_subframe+channel;
+			jobs[num_jobs].best_bits = encoder->private_->best_subframe_bits+channel;
 		}
 	}
-
-	/*
-	 * Now do mid and side channels if requested
-	 */
 	if(do_mid_side) {
 		FLAC__ASSERT(encoder->protected_->channels == 2);
+		for(channel = 0; channel < 2; channel++, num_jobs++) {
+			jobs[num_jobs].subframe_bps = encoder->private_->subframe_bps_mid_side[channel];
+			jobs[num_jobs].integer_signal = encoder->private_->integer_signal_mid_side[channel];
+			jobs[num_jobs].analysis = encoder->private_->analysis_mid_side+channel;
+			jobs[num_jobs].subframe = encoder->private_->subframe_workspace_ptr_mid_side[channel];
+			jobs[num_jobs].partitioned_rice_contents = encoder->private_->partitioned_rice_contents_workspace_ptr_mid_side[channel];
+			jobs[num_jobs].residual = encoder->private_->residual_workspace_mid_side[channel];
+			jobs[num_jobs].best_subframe = encoder->private_->best_subframe_mid_side+channel;
+			jobs[num_jobs].best_bits = encoder->private_->best_subframe_bits_mid_side+channel;
+		}
+	}
+	FLAC__ASSERT(num_jobs <= FLAC__MAX_CHANNELS);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	select_apodizations_(encoder);
+#endif
+	for(i = 0; i < num_jobs; i++) {
+		jobs[i].encoder = encoder;
+		jobs[i].min_partition_order = min_partition_order;
+		jobs[i].max_partition_order = max_partition_order;
+		jobs[i].frame_header = &frame_header;
+		jobs[i].workspace = &encoder->private_->search_workspace[0];
+		jobs[i].ok = true;
+	}
 
-		for(channel = 0; channel < 2; channel++) {
-			if(!
-				process_subframe_(
-					encoder,
-					min_partition_order,
-					max_partition_order,
-					&frame_header,
-					encoder->private_->subframe_bps_mid_side[channel],
-					encoder->private_->integer_signal_mid_side[channel],
-					encoder->private_->subframe_workspace_ptr_mid_side[channel],
-					encoder->private_->partitioned_rice_contents_workspace_ptr_mid_side[channel],
-					encoder->private_->residual_workspace_mid_side[channel],
-					encoder->private_->best_subframe_mid_side+channel,
-					encoder->private_->best_subframe_bits_mid_side+channel
-				)
-			)
-				return false;
+	if(0 != encoder->private_->subframe_queue) {
+		/*
+		 * The searches only share read-only state, so with a workspace each
+		 * they can all run at once.  We take the first one ourselves.
+		 */
+		FLAC__ASSERT(num_jobs <= encoder->private_->num_search_workspaces);
+		for(i = 1; i < num_jobs; i++) {
+			jobs[i].workspace = &encoder->private_->search_workspace[i];
+			FLAC__thread_pool_submit(encoder->private_->subframe_queue, subframe_search_task_, &jobs[i]);
+		}
+		subframe_search_task_(&jobs[0]);
+		FLAC__thread_pool_wait(encoder->private_->subframe_queue);
+	}
+	else {
+		for(i = 0; i < num_jobs; i++)
+			subframe_search_task_(&jobs[i]);
+	}
+
+	for(i = 0; i < num_jobs; i++) {
+		if(!jobs[i].ok) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+	}
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	/*
+	 * Only the frames where every window was tried are a fair contest, so
+	 * only they are scored; older wins fade by a quarter each time.
+	 */
+	if(encoder->protected_->adaptive_apodization) {
+		if(encoder->private_->adaptive_apodization_frame_count == 0) {
+			unsigned a;
+			for(a = 0; a < encoder->protected_->num_apodizations; a++)
+				encoder->private_->apodization_score[a] -= encoder->private_->apodization_score[a] >> 2;
+			for(i = 0; i < num_jobs; i++) {
+				if(jobs[i].best_apodization != UINT_MAX)
+					encoder->private_->apodization_score[jobs[i].best_apodization] += 256;
+			}
 		}
+		encoder->private_->adaptive_apodization_frame_count++;
+		if(encoder->private_->adaptive_apodization_frame_count >= ADAPTIVE_APODIZATION_RETRY_FRAMES_)
+			encoder->private_->adaptive_apodization_frame_count = 0;
 	}
+#endif
 
 	/*
 	 * Compose the frame bitbuffer
@@ -3051,7 +4124,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 
 		FLAC__ASSERT(encoder->protected_->channels == 2);
 
-		if(encoder->protected_->loose_mid_side_stereo && encoder->private_->loose_mid_side_stereo_frame_count > 0) {
+		if(encoder->private_->effort.loose_mid_side_stereo && encoder->private_->loose_mid_side_stereo_frame_count > 0) {
 			channel_assignment = (encoder->private_->last_channel_assignment == FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT? FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT : FLAC__CHANNEL_ASSIGNMENT_MID_SIDE);
 		}
 		else {
@@ -3150,7 +4223,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 		}
 	}
 
-	if(encoder->protected_->loose_mid_side_stereo) {
+	if(encoder->private_->effort.loose_mid_side_stereo) {
 		encoder->private_->loose_mid_side_stereo_frame_count++;
 		if(encoder->private_->loose_mid_side_stereo_frame_count >= encoder->private_->loose_mid_side_stereo_frames)
 			encoder->private_->loose_mid_side_stereo_frame_count = 0;
@@ -3161,6 +4234,36 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__bool is_fracti
 	return true;
 }
 
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+void select_apodizations_(FLAC__StreamEncoder *encoder)
+{
+	const unsigned *score = encoder->private_->apodization_score;
+	const unsigned limit = encoder->private_->effort.num_apodizations;
+	FLAC__uint32 chosen = 0;
+	unsigned a, i;
+
+	encoder->private_->num_active_apodizations = 0;
+	if(encoder->protected_->adaptive_apodization && encoder->private_->adaptive_apodization_frame_count > 0) {
+		/* take the highest scores, the earlier window on a tie; a window that has never won is not a candidate */
+		for(i = 0; i < min(limit, ADAPTIVE_APODIZATION_CANDIDATES_); i++) {
+			unsigned best = UINT_MAX;
+			for(a = 0; a < encoder->protected_->num_apodizations; a++) {
+				if(!(chosen & ((FLAC__uint32)1 << a)) && score[a] > 0 && (best == UINT_MAX || score[a] > score[best]))
+					best = a;
+			}
+			if(best == UINT_MAX)
+				break;
+			chosen |= (FLAC__uint32)1 << best;
+		}
+	}
+	/* keep them in the configured order so ties between windows go the same way as in a full search */
+	for(a = 0; a < encoder->protected_->num_apodizations && encoder->private_->num_active_apodizations < limit; a++) {
+		if(chosen == 0 || (chosen & ((FLAC__uint32)1 << a)))
+			encoder->private_->active_apodization[encoder->private_->num_active_apodizations++] = a;
+	}
+}
+#endif
+
 FLAC__bool process_subframe_(
 	FLAC__StreamEncoder *encoder,
 	unsigned min_partition_order,
@@ -3168,29 +4271,26 @@ FLAC__bool process_subframe_(
 	const FLAC__FrameHeader *frame_header,
 	unsigned subframe_bps,
 	const FLAC__int32 integer_signal[],
+	const signal_analysis *analysis,
 	FLAC__Subframe *subframe[2],
 	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents[2],
 	FLAC__int32 *residual[2],
+	subframe_search_workspace *workspace,
 	unsigned *best_subframe,
-	unsigned *best_bits
+	unsigned *best_bits,
+	unsigned *best_apodization
 )
 {
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	FLAC__float fixed_residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1];
 #else
 	FLAC__fixedpoint fixed_residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1];
-#endif
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-	FLAC__double lpc_residual_bits_per_sample;
-	FLAC__real autoc[FLAC__MAX_LPC_ORDER+1]; /* WATCHOUT: the size is important even though encoder->protected_->max_lpc_order might be less; some asm routines need all the space */
-	FLAC__double lpc_error[FLAC__MAX_LPC_ORDER];
-	unsigned min_lpc_order, max_lpc_order, lpc_order;
-	unsigned min_qlp_coeff_precision, max_qlp_coeff_precision, qlp_coeff_precision;
 #endif
 	unsigned min_fixed_order, max_fixed_order, guess_fixed_order, fixed_order;
 	unsigned rice_parameter;
 	unsigned _candidate_bits, _best_bits;
 	unsigned _best_subframe;
+	unsigned _best_apodization = UINT_MAX;
 	/* only use RICE2 partitions if stream bps > 16 */
 	const unsigned rice_parameter_limit = FLAC__stream_encoder_get_bits_per_sample(encoder) > 16? FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2_ESCAPE_PARAMETER : FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_ESCAPE_PARAMETER;
 
@@ -3204,27 +4304,11 @@ FLAC__bool process_subframe_(
 		_best_bits = evaluate_verbatim_subframe_(encoder, integer_signal, frame_header->blocksize, subframe_bps, subframe[_best_subframe]);
 
 	if(frame_header->blocksize >= FLAC__MAX_FIXED_ORDER) {
-		unsigned signal_is_constant = false;
-		guess_fixed_order = encoder->private_->local_fixed_compute_best_predictor(integer_signal+FLAC__MAX_FIXED_ORDER, frame_header->blocksize-FLAC__MAX_FIXED_ORDER, fixed_residual_bits_per_sample);
-		/* check for constant subframe */
-		if(
-			!encoder->private_->disable_constant_subframes &&
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
-			fixed_residual_bits_per_sample[1] == 0.0
-#else
-			fixed_residual_bits_per_sample[1] == FLAC__FP_ZERO
-#endif
-		) {
-			/* the above means it's possible all samples are the same value; now double-check it: */
-			unsigned i;
-			signal_is_constant = true;
-			for(i = 1; i < frame_header->blocksize; i++) {
-				if(integer_signal[0] != integer_signal[i]) {
-					signal_is_constant = false;
-					break;
-				}
-			}
-		}
+		/* the pre-analysis has already found constant and quiet signals, without running any predictors */
+		const FLAC__bool signal_is_constant = !encoder->private_->disable_constant_subframes && analysis->min == analysis->max;
+		const FLAC__bool signal_is_quiet =
+			encoder->protected_->quiet_signal_bits > 0 && !encoder->private_->disable_fixed_subframes &&
+			max(FLAC__bitmath_silog2(analysis->min), FLAC__bitmath_silog2(analysis->max)) <= encoder->protected_->quiet_signal_bits;
 		if(signal_is_constant) {
 			_candidate_bits = evaluate_constant_subframe_(encoder, integer_signal[0], frame_header->blocksize, subframe_bps, subframe[!_best_subframe]);
 			if(_candidate_bits < _best_bits) {
@@ -3233,9 +4317,10 @@ FLAC__bool process_subframe_(
 			}
 		}
 		else {
-			if(!encoder->private_->disable_fixed_subframes || (encoder->protected_->max_lpc_order == 0 && _best_bits == UINT_MAX)) {
+			guess_fixed_order = fixed_compute_best_predictor_(encoder, integer_signal+FLAC__MAX_FIXED_ORDER, frame_header->blocksize-FLAC__MAX_FIXED_ORDER, analysis->peak, fixed_residual_bits_per_sample);
+			if(!encoder->private_->disable_fixed_subframes || (encoder->private_->effort.max_lpc_order == 0 && _best_bits == UINT_MAX)) {
 				/* encode fixed */
-				if(encoder->protected_->do_exhaustive_model_search) {
+				if(encoder->private_->effort.do_exhaustive_model_search) {
 					min_fixed_order = 0;
 					max_fixed_order = FLAC__MAX_FIXED_ORDER;
 				}
@@ -3266,8 +4351,7 @@ FLAC__bool process_subframe_(
 							encoder,
 							integer_signal,
 							residual[!_best_subframe],
-							encoder->private_->abs_residual_partition_sums,
-							encoder->private_->raw_bits_per_partition,
+							workspace,
 							frame_header->blocksize,
 							subframe_bps,
 							fixed_order,
@@ -3289,97 +4373,81 @@ FLAC__bool process_subframe_(
 
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 			/* encode lpc */
-			if(encoder->protected_->max_lpc_order > 0) {
-				if(encoder->protected_->max_lpc_order >= frame_header->blocksize)
-					max_lpc_order = frame_header->blocksize-1;
-				else
-					max_lpc_order = encoder->protected_->max_lpc_order;
-				if(max_lpc_order > 0) {
-					unsigned a;
-					for (a = 0; a < encoder->protected_->num_apodizations; a++) {
-						FLAC__lpc_window_data(integer_signal, encoder->private_->window[a], encoder->private_->windowed_signal, frame_header->blocksize);
-						encoder->private_->local_lpc_compute_autocorrelation(encoder->private_->windowed_signal, frame_header->blocksize, max_lpc_order+1, autoc);
-						/* if autoc[0] == 0.0, the signal is constant and we usually won't get here, but it can happen */
-						if(autoc[0] != 0.0) {
-							FLAC__lpc_compute_lp_coefficients(autoc, &max_lpc_order, encoder->private_->lp_coeff, lpc_error);
-							if(encoder->protected_->do_exhaustive_model_search) {
-								min_lpc_order = 1;
-							}
-							else {
-								const unsigned guess_lpc_order =
-									FLAC__lpc_compute_best_order(
-										lpc_error,
-										max_lpc_order,
-										frame_header->blocksize,
-										subframe_bps + (
-											encoder->protected_->do_qlp_coeff_prec_search?
-												FLAC__MIN_QLP_COEFF_PRECISION : /* have to guess; use the min possible size to avoid accidentally favoring lower orders */
-												encoder->protected_->qlp_coeff_precision
-										)
-									);
-								min_lpc_order = max_lpc_order = guess_lpc_order;
-							}
-							if(max_lpc_order >= frame_header->blocksize)
-								max_lpc_order = frame_header->blocksize - 1;
-							for(lpc_order = min_lpc_order; lpc_order <= max_lpc_order; lpc_order++) {
-								lpc_residual_bits_per_sample = FLAC__lpc_compute_expected_bits_per_residual_sample(lpc_error[lpc_order-1], frame_header->blocksize-lpc_order);
-								if(lpc_residual_bits_per_sample >= (FLAC__double)subframe_bps)
-									continue; /* don't even try */
-								rice_parameter = (lpc_residual_bits_per_sample > 0.0)? (unsigned)(lpc_residual_bits_per_sample+0.5) : 0; /* 0.5 is for rounding */
-								rice_parameter++; /* to account for the signed->unsigned conversion during rice coding */
-								if(rice_parameter >= rice_parameter_limit) {
-#ifdef DEBUG_VERBOSE
-									fprintf(stderr, "clipping rice_parameter (%u -> %u) @1\n", rice_parameter, rice_parameter_limit - 1);
-#endif
-									rice_parameter = rice_parameter_limit - 1;
-								}
-								if(encoder->protected_->do_qlp_coeff_prec_search) {
-									min_qlp_coeff_precision = FLAC__MIN_QLP_COEFF_PRECISION;
-									/* try to ensure a 32-bit datapath throughout for 16bps(+1bps for side channel) or less */
-									if(subframe_bps <= 17) {
-										max_qlp_coeff_precision = min(32 - subframe_bps - lpc_order, FLAC__MAX_QLP_COEFF_PRECISION);
-										max_qlp_coeff_precision = max(max_qlp_coeff_precision, min_qlp_coeff_precision);
-									}
-									else
-										max_qlp_coeff_precision = FLAC__MAX_QLP_COEFF_PRECISION;
-								}
-								else {
-									min_qlp_coeff_precision = max_qlp_coeff_precision = encoder->protected_->qlp_coeff_precision;
-								}
-								for(qlp_coeff_precision = min_qlp_coeff_precision; qlp_coeff_precision <= max_qlp_coeff_precision; qlp_coeff_precision++) {
-									_candidate_bits =
-										evaluate_lpc_subframe_(
-											encoder,
-											integer_signal,
-											residual[!_best_subframe],
-											encoder->private_->abs_residual_partition_sums,
-											encoder->private_->raw_bits_per_partition,
-											encoder->private_->lp_coeff[lpc_order-1],
-											frame_header->blocksize,
-											subframe_bps,
-											lpc_order,
-											qlp_coeff_precision,
-											rice_parameter,
-											rice_parameter_limit,
-											min_partition_order,
-											max_partition_order,
-											encoder->protected_->do_escape_coding,
-											encoder->protected_->rice_parameter_search_dist,
-											subframe[!_best_subframe],
-											partitioned_rice_contents[!_best_subframe]
-										);
-									if(_candidate_bits > 0) { /* if == 0, there was a problem quantizing the lpcoeffs */
-										if(_candidate_bits < _best_bits) {
-											_best_subframe = !_best_subframe;
-											_best_bits = _candidate_bits;
-										}
-									}
-								}
-							}
+			if(encoder->private_->effort.max_lpc_order > 0 && frame_header->blocksize > 1 && !signal_is_quiet) {
+				const unsigned num_tasks = 0 != workspace->lpc_queue? encoder->private_->num_lpc_search_tasks : 1;
+				const FLAC__bool stripe_orders = num_tasks > 1 && encoder->private_->lpc_search_stripe_orders;
+				unsigned best_ordinal = 0, t;
+				if(stripe_orders) {
+					/* the window, autocorrelation and coefficients of each window are the same for all the orders */
+					for(t = 0; t < encoder->private_->num_active_apodizations; t++) {
+						lpc_model *model = &workspace->lpc_model[t];
+						if(!compute_lpc_model_(encoder, frame_header, subframe_bps, integer_signal, encoder->private_->active_apodization[t], workspace->windowed_signal, model)) {
+							model->min_lpc_order = 1;
+							model->max_lpc_order = 0;
+						}
+					}
+				}
+				for(t = 1; t < num_tasks; t++) {
+					lpc_search_task *task = &workspace->lpc_task[t-1];
+					task->encoder = encoder;
+					task->min_partition_order = min_partition_order;
+					task->max_partition_order = max_partition_order;
+					task->frame_header = frame_header;
+					task->subframe_bps = subframe_bps;
+					task->integer_signal = integer_signal;
+					task->signal_peak = analysis->peak;
+					task->rice_parameter_limit = rice_parameter_limit;
+					task->task = t;
+					task->num_tasks = num_tasks;
+					task->stripe_orders = stripe_orders;
+					task->lpc_model = workspace->lpc_model;
+					task->subframe[0].wasted_bits = task->subframe[1].wasted_bits = subframe[0]->wasted_bits;
+					/* the others only have to beat what we have so far; if none does, the UINT_MAX ordinal loses any tie */
+					task->best_subframe = 0;
+					task->best_bits = _best_bits;
+					task->best_ordinal = UINT_MAX;
+					FLAC__thread_pool_submit(workspace->lpc_queue, lpc_search_task_, task);
+				}
+				search_lpc_(
+					encoder,
+					min_partition_order,
+					max_partition_order,
+					frame_header,
+					subframe_bps,
+					integer_signal,
+					analysis->peak,
+					rice_parameter_limit,
+					/*task=*/0,
+					num_tasks,
+					stripe_orders,
+					workspace->lpc_model,
+					workspace,
+					subframe,
+					partitioned_rice_contents,
+					residual,
+					&_best_subframe,
+					&_best_bits,
+					&best_ordinal
+				);
+				if(num_tasks > 1) {
+					FLAC__thread_pool_wait(workspace->lpc_queue);
+					/* take the smallest candidate; on a tie, the one a single search would have found first */
+					for(t = 1; t < num_tasks; t++) {
+						const lpc_search_task *task = &workspace->lpc_task[t-1];
+						if(task->best_bits < _best_bits || (task->best_bits == _best_bits && task->best_ordinal < best_ordinal)) {
+							if(!copy_lpc_subframe_(&task->subframe[task->best_subframe], subframe[!_best_subframe], partitioned_rice_contents[!_best_subframe], residual[!_best_subframe], frame_header->blocksize))
+								return false;
+							_best_subframe = !_best_subframe;
+							_best_bits = task->best_bits;
+							best_ordinal = task->best_ordinal;
 						}
 					}
 				}
+				if(best_ordinal > 0)
+					_best_apodization = (best_ordinal - 1) / FLAC__MAX_LPC_ORDER;
 			}
+#else
+			(void)signal_is_quiet;
 #endif /* !defined FLAC__INTEGER_ONLY_LIBRARY */
 		}
 	}
@@ -3392,9 +4460,249 @@ FLAC__bool process_subframe_(
 
 	*best_subframe = _best_subframe;
 	*best_bits = _best_bits;
+	*best_apodization = _best_apodization;
+
+	return true;
+}
+
+void subframe_search_task_(void *data)
+{
+	subframe_search_job *job = (subframe_search_job*)data;
+	job->ok =
+		process_subframe_(
+			job->encoder,
+			job->min_partition_order,
+			job->max_partition_order,
+			job->frame_header,
+			job->subframe_bps,
+			job->integer_signal,
+			job->analysis,
+			job->subframe,
+			job->partitioned_rice_contents,
+			job->residual,
+			job->workspace,
+			job->best_subframe,
+			job->best_bits,
+			&job->best_apodization
+		);
+}
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+/* Windows the signal with apodization 'apodization' and works out which LPC orders to try; false if it leaves nothing to predict. */
+FLAC__bool compute_lpc_model_(
+	FLAC__StreamEncoder *encoder,
+	const FLAC__FrameHeader *frame_header,
+	unsigned subframe_bps,
+	const FLAC__int32 integer_signal[],
+	unsigned apodization,
+	FLAC__real windowed_signal[],
+	lpc_model *model
+)
+{
+	FLAC__real autoc[FLAC__MAX_LPC_ORDER+1]; /* WATCHOUT: the size is important even though encoder->protected_->max_lpc_order might be less; some asm routines need all the space */
+	unsigned max_lpc_order;
+
+	/* each window starts from the full order; FLAC__lpc_compute_lp_coefficients() may lower it */
+	if(encoder->private_->effort.max_lpc_order >= frame_header->blocksize)
+		max_lpc_order = frame_header->blocksize-1;
+	else
+		max_lpc_order = encoder->private_->effort.max_lpc_order;
+	encoder->private_->local_lpc_window_data(integer_signal, encoder->private_->window[encoder->private_->split_level][apodization], windowed_signal, frame_header->blocksize);
+	encoder->private_->local_lpc_compute_autocorrelation(windowed_signal, frame_header->blocksize, max_lpc_order+1, autoc);
+	/* if autoc[0] == 0.0, the signal is constant and we usually won't get here, but it can happen */
+	if(autoc[0] == 0.0)
+		return false;
+	FLAC__lpc_compute_lp_coefficients(autoc, &max_lpc_order, model->lp_coeff, model->lpc_error);
+	if(encoder->private_->effort.do_exhaustive_model_search) {
+		model->min_lpc_order = 1;
+	}
+	else {
+		const unsigned guess_lpc_order =
+			FLAC__lpc_compute_best_order(
+				model->lpc_error,
+				max_lpc_order,
+				frame_header->blocksize,
+				subframe_bps + (
+					encoder->private_->effort.do_qlp_coeff_prec_search?
+						FLAC__MIN_QLP_COEFF_PRECISION : /* have to guess; use the min possible size to avoid accidentally favoring lower orders */
+						encoder->protected_->qlp_coeff_precision
+				)
+			);
+		model->min_lpc_order = max_lpc_order = guess_lpc_order;
+	}
+	if(max_lpc_order >= frame_header->blocksize)
+		max_lpc_order = frame_header->blocksize - 1;
+	model->max_lpc_order = max_lpc_order;
+	return true;
+}
+
+/*
+ * Searches this task's share of the LPC candidates.  With stripe_orders,
+ * shared_lpc_model[i] holds the model of active window i, worked out
+ * once for all the tasks, and a max_lpc_order of 0 for a window that
+ * leaves nothing to predict; otherwise each task does its own windows.
+ */
+void search_lpc_(
+	FLAC__StreamEncoder *encoder,
+	unsigned min_partition_order,
+	unsigned max_partition_order,
+	const FLAC__FrameHeader *frame_header,
+	unsigned subframe_bps,
+	const FLAC__int32 integer_signal[],
+	FLAC__uint32 signal_peak,
+	unsigned rice_parameter_limit,
+	unsigned task,
+	unsigned num_tasks,
+	FLAC__bool stripe_orders,
+	const lpc_model *shared_lpc_model,
+	subframe_search_workspace *workspace,
+	FLAC__Subframe *subframe[2],
+	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents[2],
+	FLAC__int32 *residual[2],
+	unsigned *best_subframe,
+	unsigned *best_bits,
+	unsigned *best_ordinal
+)
+{
+	FLAC__double lpc_residual_bits_per_sample;
+	const lpc_model *model;
+	unsigned lpc_order;
+	unsigned min_qlp_coeff_precision, max_qlp_coeff_precision, qlp_coeff_precision;
+	unsigned rice_parameter;
+	unsigned _candidate_bits, _best_bits = *best_bits;
+	unsigned _best_subframe = *best_subframe, _best_ordinal = *best_ordinal;
+	unsigned i, a;
+
+	FLAC__ASSERT(!stripe_orders || 0 != shared_lpc_model);
+
+	for (i = 0; i < encoder->private_->num_active_apodizations; i++) {
+		if(!stripe_orders && i % num_tasks != task)
+			continue;
+		a = encoder->private_->active_apodization[i];
+		if(stripe_orders)
+			model = &shared_lpc_model[i];
+		else if(compute_lpc_model_(encoder, frame_header, subframe_bps, integer_signal, a, workspace->windowed_signal, workspace->lpc_model))
+			model = workspace->lpc_model;
+		else
+			continue;
+		for(lpc_order = model->min_lpc_order; lpc_order <= model->max_lpc_order; lpc_order++) {
+			if(stripe_orders && lpc_order % num_tasks != task)
+				continue;
+			lpc_residual_bits_per_sample = FLAC__lpc_compute_expected_bits_per_residual_sample(model->lpc_error[lpc_order-1], frame_header->blocksize-lpc_order);
+			if(lpc_residual_bits_per_sample >= (FLAC__double)subframe_bps)
+				continue; /* don't even try */
+			rice_parameter = (lpc_residual_bits_per_sample > 0.0)? (unsigned)(lpc_residual_bits_per_sample+0.5) : 0; /* 0.5 is for rounding */
+			rice_parameter++; /* to account for the signed->unsigned conversion during rice coding */
+			if(rice_parameter >= rice_parameter_limit) {
+#ifdef DEBUG_VERBOSE
+				fprintf(stderr, "clipping rice_parameter (%u -> %u) @1\n", rice_parameter, rice_parameter_limit - 1);
+#endif
+				rice_parameter = rice_parameter_limit - 1;
+			}
+			if(encoder->private_->effort.do_qlp_coeff_prec_search) {
+				min_qlp_coeff_precision = FLAC__MIN_QLP_COEFF_PRECISION;
+				/* try to ensure a 32-bit datapath throughout for 16bps(+1bps for side channel) or less */
+				if(subframe_bps <= 17) {
+					max_qlp_coeff_precision = min(32 - subframe_bps - lpc_order, FLAC__MAX_QLP_COEFF_PRECISION);
+					max_qlp_coeff_precision = max(max_qlp_coeff_precision, min_qlp_coeff_precision);
+				}
+				else
+					max_qlp_coeff_precision = FLAC__MAX_QLP_COEFF_PRECISION;
+			}
+			else {
+				min_qlp_coeff_precision = max_qlp_coeff_precision = encoder->protected_->qlp_coeff_precision;
+			}
+			for(qlp_coeff_precision = min_qlp_coeff_precision; qlp_coeff_precision <= max_qlp_coeff_precision; qlp_coeff_precision++) {
+				_candidate_bits =
+					evaluate_lpc_subframe_(
+						encoder,
+						integer_signal,
+						residual[!_best_subframe],
+						workspace,
+						model->lp_coeff[lpc_order-1],
+						frame_header->blocksize,
+						subframe_bps,
+						signal_peak,
+						lpc_order,
+						qlp_coeff_precision,
+						rice_parameter,
+						rice_parameter_limit,
+						min_partition_order,
+						max_partition_order,
+						encoder->protected_->do_escape_coding,
+						encoder->protected_->rice_parameter_search_dist,
+						encoder->protected_->prune_model_search? _best_bits : UINT_MAX,
+						subframe[!_best_subframe],
+						partitioned_rice_contents[!_best_subframe]
+					);
+				if(_candidate_bits > 0) { /* if == 0, there was a problem quantizing the lpcoeffs */
+					if(_candidate_bits < _best_bits) {
+						_best_subframe = !_best_subframe;
+						_best_bits = _candidate_bits;
+						_best_ordinal = LPC_SEARCH_ORDINAL_(a, lpc_order);
+					}
+				}
+			}
+		}
+	}
+
+	*best_subframe = _best_subframe;
+	*best_bits = _best_bits;
+	*best_ordinal = _best_ordinal;
+}
+
+void lpc_search_task_(void *data)
+{
+	lpc_search_task *task = (lpc_search_task*)data;
+	search_lpc_(
+		task->encoder,
+		task->min_partition_order,
+		task->max_partition_order,
+		task->frame_header,
+		task->subframe_bps,
+		task->integer_signal,
+		task->signal_peak,
+		task->rice_parameter_limit,
+		task->task,
+		task->num_tasks,
+		task->stripe_orders,
+		task->lpc_model,
+		&task->workspace,
+		task->subframe_ptr,
+		task->partitioned_rice_contents_ptr,
+		task->residual,
+		&task->best_subframe,
+		&task->best_bits,
+		&task->best_ordinal
+	);
+}
+
+FLAC__bool copy_lpc_subframe_(
+	const FLAC__Subframe *src,
+	FLAC__Subframe *dst,
+	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents,
+	FLAC__int32 residual[],
+	unsigned blocksize
+)
+{
+	const FLAC__EntropyCodingMethod_PartitionedRiceContents *src_contents = src->data.lpc.entropy_coding_method.data.partitioned_rice.contents;
+	const unsigned partition_order = src->data.lpc.entropy_coding_method.data.partitioned_rice.order;
+
+	FLAC__ASSERT(src->type == FLAC__SUBFRAME_TYPE_LPC);
+
+	if(!FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(partitioned_rice_contents, max(6, partition_order)))
+		return false;
+	memcpy(partitioned_rice_contents->parameters, src_contents->parameters, sizeof(unsigned)*(1<<partition_order));
+	memcpy(partitioned_rice_contents->raw_bits, src_contents->raw_bits, sizeof(unsigned)*(1<<partition_order));
+	memcpy(residual, src->data.lpc.residual, sizeof(FLAC__int32)*(blocksize-src->data.lpc.order));
+
+	*dst = *src;
+	dst->data.lpc.entropy_coding_method.data.partitioned_rice.contents = partitioned_rice_contents;
+	dst->data.lpc.residual = residual;
 
 	return true;
 }
+#endif
 
 FLAC__bool add_subframe_(
 	FLAC__StreamEncoder *encoder,
@@ -3494,8 +4802,7 @@ unsigned evaluate_fixed_subframe_(
 	FLAC__StreamEncoder *encoder,
 	const FLAC__int32 signal[],
 	FLAC__int32 residual[],
-	FLAC__uint64 abs_residual_partition_sums[],
-	unsigned raw_bits_per_partition[],
+	subframe_search_workspace *workspace,
 	unsigned blocksize,
 	unsigned subframe_bps,
 	unsigned order,
@@ -3523,9 +4830,8 @@ unsigned evaluate_fixed_subframe_(
 	residual_bits =
 		find_best_partition_order_(
 			encoder->private_,
+			workspace,
 			residual,
-			abs_residual_partition_sums,
-			raw_bits_per_partition,
 			residual_samples,
 			order,
 			rice_parameter,
@@ -3546,6 +4852,8 @@ unsigned evaluate_fixed_subframe_(
 
 #if SPOTCHECK_ESTIMATE
 	spotcheck_subframe_estimate_(encoder, blocksize, subframe_bps, subframe, estimate);
+#else
+	(void)encoder;
 #endif
 
 	return estimate;
@@ -3556,11 +4864,11 @@ unsigned evaluate_lpc_subframe_(
 	FLAC__StreamEncoder *encoder,
 	const FLAC__int32 signal[],
 	FLAC__int32 residual[],
-	FLAC__uint64 abs_residual_partition_sums[],
-	unsigned raw_bits_per_partition[],
+	subframe_search_workspace *workspace,
 	const FLAC__real lp_coeff[],
 	unsigned blocksize,
 	unsigned subframe_bps,
+	FLAC__uint32 signal_peak,
 	unsigned order,
 	unsigned qlp_coeff_precision,
 	unsigned rice_parameter,
@@ -3569,14 +4877,17 @@ unsigned evaluate_lpc_subframe_(
 	unsigned max_partition_order,
 	FLAC__bool do_escape_coding,
 	unsigned rice_parameter_search_dist,
+	unsigned bits_to_beat,
 	FLAC__Subframe *subframe,
 	FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents
 )
 {
 	FLAC__int32 qlp_coeff[FLAC__MAX_LPC_ORDER];
+	FLAC__uint64 qlp_coeff_sum;
 	unsigned i, residual_bits, estimate;
 	int quantization, ret;
 	const unsigned residual_samples = blocksize - order;
+	void (*compute_residual)(const FLAC__int32 *data, unsigned data_len, const FLAC__int32 qlp_coeff[], unsigned order, int lp_quantization, FLAC__int32 residual[]);
 
 	/* try to keep qlp coeff precision such that only 32-bit math is required for decode of <=16bps streams */
 	if(subframe_bps <= 16) {
@@ -3585,17 +4896,57 @@ unsigned evaluate_lpc_subframe_(
 		qlp_coeff_precision = min(qlp_coeff_precision, 32 - subframe_bps - FLAC__bitmath_ilog2(order));
 	}
 
+	/*
+	 * Everything but the residual is a known size; if that alone won't
+	 * beat bits_to_beat, there is no point going on.  The rice parameter
+	 * and partition order take at least the smallest header possible.
+	 */
+	estimate = FLAC__SUBFRAME_ZERO_PAD_LEN + FLAC__SUBFRAME_TYPE_LEN + FLAC__SUBFRAME_WASTED_BITS_FLAG_LEN + subframe->wasted_bits + FLAC__SUBFRAME_LPC_QLP_COEFF_PRECISION_LEN + FLAC__SUBFRAME_LPC_QLP_SHIFT_LEN + (order * (qlp_coeff_precision + subframe_bps));
+	if(estimate + FLAC__ENTROPY_CODING_METHOD_TYPE_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_ORDER_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_PARAMETER_LEN >= bits_to_beat)
+		return UINT_MAX;
+
 	ret = FLAC__lpc_quantize_coefficients(lp_coeff, order, qlp_coeff_precision, qlp_coeff, &quantization);
 	if(ret != 0)
 		return 0; /* this is a hack to indicate to the caller that we can't do lp at this order on this subframe */
 
-	if(subframe_bps + qlp_coeff_precision + FLAC__bitmath_ilog2(order) <= 32)
-		if(subframe_bps <= 16 && qlp_coeff_precision <= 16)
-			encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_16bit(signal+order, residual_samples, qlp_coeff, order, quantization, residual);
+	/*
+	 * No prediction can be larger than the largest magnitude in the signal
+	 * times the sum of the coefficient magnitudes, so if that fits in 32
+	 * bits, so does the 32-bit version's sum.  The 16-bit version also
+	 * needs the samples and coefficients to fit in 16 bits.
+	 */
+	for(i = 0, qlp_coeff_sum = 0; i < order; i++)
+		qlp_coeff_sum += (FLAC__uint64)(qlp_coeff[i] < 0? -(FLAC__int64)qlp_coeff[i] : qlp_coeff[i]);
+	if(signal_peak * qlp_coeff_sum <= 0x7fffffff)
+		if(signal_peak <= 0x7fff && qlp_coeff_precision <= 16)
+			compute_residual = encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_16bit;
 		else
-			encoder->private_->local_lpc_compute_residual_from_qlp_coefficients(signal+order, residual_samples, qlp_coeff, order, quantization, residual);
+			compute_residual = encoder->private_->local_lpc_compute_residual_from_qlp_coefficients;
+	else
+		compute_residual = encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_64bit;
+
+	if(bits_to_beat != UINT_MAX && !do_escape_coding) {
+		/*
+		 * Do the residual one partition of the highest partition order at
+		 * a time and stop as soon as the partitions so far can't be coded
+		 * in fewer bits than we need to beat.  Every partition of a lower
+		 * order is a run of these, so the bound holds whatever partition
+		 * order is picked in the end.  An escaped partition can be smaller
+		 * than the bound, so this is only done without escape coding.
+		 */
+		const unsigned partition_samples = blocksize >> FLAC__format_get_max_rice_partition_order_from_blocksize_limited_max_and_predictor_order(max_partition_order, blocksize, order);
+		FLAC__double bound = (FLAC__double)(estimate + FLAC__ENTROPY_CODING_METHOD_TYPE_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_ORDER_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_PARAMETER_LEN);
+		unsigned n;
+		FLAC__ASSERT(partition_samples > order);
+		for(i = 0, n = partition_samples - order; i < residual_samples; i += n, n = partition_samples) {
+			compute_residual(signal+order+i, n, qlp_coeff, order, quantization, residual+i);
+			bound += rice_bits_lower_bound_(residual+i, n);
+			if(bound >= (FLAC__double)bits_to_beat)
+				return UINT_MAX;
+		}
+	}
 	else
-		encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_64bit(signal+order, residual_samples, qlp_coeff, order, quantization, residual);
+		compute_residual(signal+order, residual_samples, qlp_coeff, order, quantization, residual);
 
 	subframe->type = FLAC__SUBFRAME_TYPE_LPC;
 
@@ -3606,9 +4957,8 @@ unsigned evaluate_lpc_subframe_(
 	residual_bits =
 		find_best_partition_order_(
 			encoder->private_,
+			workspace,
 			residual,
-			abs_residual_partition_sums,
-			raw_bits_per_partition,
 			residual_samples,
 			order,
 			rice_parameter,
@@ -3636,6 +4986,28 @@ unsigned evaluate_lpc_subframe_(
 
 	return estimate;
 }
+
+FLAC__double rice_bits_lower_bound_(const FLAC__int32 residual[], unsigned residual_samples)
+{
+	/*
+	 * Folding r to unsigned gives u >= 2|r|-1, so with rice parameter k
+	 * a sample takes 1+k+floor(u/2^k) >= k+2|r|/2^k bits.  Summed over
+	 * the samples that is n*k+2*S/2^k, which is smallest at
+	 * 2^k = 2*S*ln(2)/n.  The bound is concave in (n,S), so splitting a
+	 * partition into pieces never makes the sum of their bounds larger.
+	 */
+	FLAC__uint64 abs_residual_sum = 0;
+	FLAC__double x;
+	unsigned i;
+
+	for(i = 0; i < residual_samples; i++)
+		abs_residual_sum += (FLAC__uint64)(residual[i] < 0? -(FLAC__int64)residual[i] : residual[i]);
+
+	x = 2.0 * M_LN2 * (FLAC__double)abs_residual_sum / (FLAC__double)residual_samples;
+	if(x <= 1.0)
+		return 2.0 * (FLAC__double)abs_residual_sum; /* k = 0 */
+	return (FLAC__double)residual_samples * (log(x) + 1.0) / M_LN2;
+}
 #endif
 
 unsigned evaluate_verbatim_subframe_(
@@ -3664,10 +5036,9 @@ unsigned evaluate_verbatim_subframe_(
 }
 
 unsigned find_best_partition_order_(
-	FLAC__StreamEncoderPrivate *private_,
+	struct FLAC__StreamEncoderPrivate *private_,
+	subframe_search_workspace *workspace,
 	const FLAC__int32 residual[],
-	FLAC__uint64 abs_residual_partition_sums[],
-	unsigned raw_bits_per_partition[],
 	unsigned residual_samples,
 	unsigned predictor_order,
 	unsigned rice_parameter,
@@ -3688,10 +5059,10 @@ unsigned find_best_partition_order_(
 	max_partition_order = FLAC__format_get_max_rice_partition_order_from_blocksize_limited_max_and_predictor_order(max_partition_order, blocksize, predictor_order);
 	min_partition_order = min(min_partition_order, max_partition_order);
 
-	precompute_partition_info_sums_(residual, abs_residual_partition_sums, residual_samples, predictor_order, min_partition_order, max_partition_order, bps);
+	private_->local_precompute_partition_info_sums(residual, workspace->abs_residual_partition_sums, residual_samples, predictor_order, min_partition_order, max_partition_order, bps);
 
 	if(do_escape_coding)
-		precompute_partition_info_escapes_(residual, raw_bits_per_partition, residual_samples, predictor_order, min_partition_order, max_partition_order);
+		precompute_partition_info_escapes_(residual, workspace->raw_bits_per_partition, residual_samples, predictor_order, min_partition_order, max_partition_order);
 
 	{
 		int partition_order;
@@ -3703,8 +5074,8 @@ unsigned find_best_partition_order_(
 #ifdef EXACT_RICE_BITS_CALCULATION
 					residual,
 #endif
-					abs_residual_partition_sums+sum,
-					raw_bits_per_partition+sum,
+					workspace->abs_residual_partition_sums+sum,
+					workspace->raw_bits_per_partition+sum,
 					residual_samples,
 					predictor_order,
 					rice_parameter,
@@ -3712,7 +5083,7 @@ unsigned find_best_partition_order_(
 					rice_parameter_search_dist,
 					(unsigned)partition_order,
 					do_escape_coding,
-					&private_->partitioned_rice_contents_extra[!best_parameters_index],
+					&workspace->partitioned_rice_contents_extra[!best_parameters_index],
 					&residual_bits
 				)
 			)
@@ -3741,9 +5112,9 @@ unsigned find_best_partition_order_(
 
 		/* save best parameters and raw_bits */
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(prc, max(6, best_partition_order));
-		memcpy(prc->parameters, private_->partitioned_rice_contents_extra[best_parameters_index].parameters, sizeof(unsigned)*(1<<(best_partition_order)));
+		memcpy(prc->parameters, workspace->partitioned_rice_contents_extra[best_parameters_index].parameters, sizeof(unsigned)*(1<<(best_partition_order)));
 		if(do_escape_coding)
-			memcpy(prc->raw_bits, private_->partitioned_rice_contents_extra[best_parameters_index].raw_bits, sizeof(unsigned)*(1<<(best_partition_order)));
+			memcpy(prc->raw_bits, workspace->partitioned_rice_contents_extra[best_parameters_index].raw_bits, sizeof(unsigned)*(1<<(best_partition_order)));
 		/*
 		 * Now need to check if the type should be changed to
 		 * FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2 based on the
@@ -3940,6 +5311,27 @@ static FLaC__INLINE unsigned count_rice_bits_in_partition_(
 }
 #endif
 
+/*
+ * The parameter that minimizes count_rice_bits_in_partition_()'s
+ * estimate, in closed form: going from k to k+1 costs a bit per sample
+ * and saves about abs_residual_partition_sum/2^k bits of unary code, so
+ * the best k is the smallest one with
+ * partition_samples<<k >= abs_residual_partition_sum.
+ */
+static FLaC__INLINE unsigned rice_parameter_from_sum_(
+	const FLAC__uint64 abs_residual_partition_sum,
+	const unsigned partition_samples
+)
+{
+	unsigned k;
+	FLAC__ASSERT(partition_samples > 0);
+	if(abs_residual_partition_sum <= partition_samples)
+		return 0;
+	/* partition_samples<<k has the same top bit as the sum, so it is either enough or one short */
+	k = FLAC__bitmath_ilog2_wide(abs_residual_partition_sum) - FLAC__bitmath_ilog2(partition_samples);
+	return k + (((FLAC__uint64)partition_samples << k) < abs_residual_partition_sum);
+}
+
 FLAC__bool set_partitioned_rice_(
 #ifdef EXACT_RICE_BITS_CALCULATION
 	const FLAC__int32 residual[],
@@ -3995,7 +5387,16 @@ FLAC__bool set_partitioned_rice_(
 
 		for(rice_parameter = min_rice_parameter; rice_parameter <= max_rice_parameter; rice_parameter++) {
 #else
-			rice_parameter = suggested_rice_parameter;
+			/* the sum gives the parameter that minimises the estimate below; the
+			 * predictor's guess only approximates it */
+			(void)suggested_rice_parameter;
+			rice_parameter = rice_parameter_from_sum_(abs_residual_partition_sums[0], residual_samples);
+			if(rice_parameter >= rice_parameter_limit) {
+#ifdef DEBUG_VERBOSE
+				fprintf(stderr, "clipping rice_parameter (%u -> %u) @5\n", rice_parameter, rice_parameter_limit - 1);
+#endif
+				rice_parameter = rice_parameter_limit - 1;
+			}
 #endif
 #ifdef EXACT_RICE_BITS_CALCULATION
 			partition_bits = count_rice_bits_in_partition_(rice_parameter, residual_samples, residual);
@@ -4025,7 +5426,6 @@ FLAC__bool set_partitioned_rice_(
 	else {
 		unsigned partition, residual_sample;
 		unsigned partition_samples;
-		FLAC__uint64 mean, k;
 		const unsigned partitions = 1u << partition_order;
 		for(partition = residual_sample = 0; partition < partitions; partition++) {
 			partition_samples = (residual_samples+predictor_order) >> partition_order;
@@ -4035,17 +5435,8 @@ FLAC__bool set_partitioned_rice_(
 				else
 					partition_samples -= predictor_order;
 			}
-			mean = abs_residual_partition_sums[partition];
-			/* we are basically calculating the size in bits of the
-			 * average residual magnitude in the partition:
-			 *   rice_parameter = floor(log2(mean/partition_samples))
-			 * 'mean' is not a good name for the variable, it is
-			 * actually the sum of magnitudes of all residual values
-			 * in the partition, so the actual mean is
-			 * mean/partition_samples
-			 */
-			for(rice_parameter = 0, k = partition_samples; k < mean; rice_parameter++, k <<= 1)
-				;
+			/* this is basically the size in bits of the average residual magnitude in the partition */
+			rice_parameter = rice_parameter_from_sum_(abs_residual_partition_sums[partition], partition_samples);
 			if(rice_parameter >= rice_parameter_limit) {
 #ifdef DEBUG_VERBOSE
 				fprintf(stderr, "clipping rice_parameter (%u -> %u) @6\n", rice_parameter, rice_parameter_limit - 1);
@@ -4105,13 +5496,25 @@ FLAC__bool set_partitioned_rice_(
 	return true;
 }
 
-unsigned get_wasted_bits_(FLAC__int32 signal[], unsigned samples)
+/*
+ * The one pass over a subframe's signal before the search: it finds the
+ * range of the samples and their wasted bits, which are shifted out of
+ * the signal, returning the shift.  The loop has no early exit so that
+ * the compiler can vectorize it.
+ */
+unsigned analyze_signal_(FLAC__int32 signal[], unsigned samples, signal_analysis *analysis)
 {
 	unsigned i, shift;
-	FLAC__int32 x = 0;
+	FLAC__int32 x = 0, lo, hi;
+
+	FLAC__ASSERT(samples > 0);
 
-	for(i = 0; i < samples && !(x&1); i++)
+	lo = hi = signal[0];
+	for(i = 0; i < samples; i++) {
 		x |= signal[i];
+		lo = signal[i] < lo? signal[i] : lo;
+		hi = signal[i] > hi? signal[i] : hi;
+	}
 
 	if(x == 0) {
 		shift = 0;
@@ -4124,11 +5527,34 @@ unsigned get_wasted_bits_(FLAC__int32 signal[], unsigned samples)
 	if(shift > 0) {
 		for(i = 0; i < samples; i++)
 			 signal[i] >>= shift;
+		lo >>= shift;
+		hi >>= shift;
 	}
 
+	analysis->min = lo;
+	analysis->max = hi;
+	analysis->peak = (FLAC__uint32)max(-(FLAC__int64)lo, (FLAC__int64)hi);
 	return shift;
 }
 
+/*
+ * Runs the 32-bit fixed predictor analysis when it cannot overflow on a
+ * signal whose magnitude is at most 'peak', else the 64-bit one.  The
+ * order 4 residual is at most 2^4 times the peak, and the 32-bit version
+ * sums the residual magnitudes into unsigned 32-bit totals.
+ */
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+unsigned fixed_compute_best_predictor_(const FLAC__StreamEncoder *encoder, const FLAC__int32 data[], unsigned data_len, FLAC__uint32 peak, FLAC__float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+#else
+unsigned fixed_compute_best_predictor_(const FLAC__StreamEncoder *encoder, const FLAC__int32 data[], unsigned data_len, FLAC__uint32 peak, FLAC__fixedpoint residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1])
+#endif
+{
+	if((FLAC__uint64)peak * (1u << FLAC__MAX_FIXED_ORDER) * data_len <= 0xffffffff)
+		return encoder->private_->local_fixed_compute_best_predictor(data, data_len, residual_bits_per_sample);
+	else
+		return encoder->private_->local_fixed_compute_best_predictor_wide(data, data_len, residual_bits_per_sample);
+}
+
 void append_to_verify_fifo_(verify_input_fifo *fifo, const FLAC__int32 * const input[], unsigned input_offset, unsigned channels, unsigned wide_samples)
 {
 	unsigned channel;
@@ -4141,21 +5567,71 @@ void append_to_verify_fifo_(verify_input_fifo *fifo, const FLAC__int32 * const i
 	FLAC__ASSERT(fifo->tail <= fifo->size);
 }
 
-void append_to_verify_fifo_interleaved_(verify_input_fifo *fifo, const FLAC__int32 input[], unsigned input_offset, unsigned channels, unsigned wide_samples)
+/*
+ * The interleaved input routines are each built from one of these
+ * macros, with the channel count either a constant or the 'channels'
+ * variable, so that the stereo versions have fixed loop bounds.
+ */
+#define DEFINE_COPY_INTERLEAVED_(name, CHANNELS) \
+void name(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned offset, unsigned wide_samples) \
+{ \
+	FLAC__int32 * const *signal = encoder->private_->integer_signal; \
+	const unsigned channels = encoder->protected_->channels; \
+	const unsigned end = offset + wide_samples; \
+	unsigned i, channel; \
+	\
+	FLAC__ASSERT(channels == CHANNELS); \
+	(void)channels; \
+	for(i = offset; i < end; i++) { \
+		for(channel = 0; channel < CHANNELS; channel++) \
+			signal[channel][i] = *buffer++; \
+	} \
+}
+
+#define DEFINE_APPEND_TO_VERIFY_FIFO_INTERLEAVED_(name, CHANNELS) \
+void name(verify_input_fifo *fifo, const FLAC__int32 input[], unsigned input_offset, unsigned channels, unsigned wide_samples) \
+{ \
+	unsigned channel; \
+	unsigned sample, wide_sample; \
+	unsigned tail = fifo->tail; \
+	\
+	FLAC__ASSERT(channels == CHANNELS); \
+	(void)channels; \
+	sample = input_offset * CHANNELS; \
+	for(wide_sample = 0; wide_sample < wide_samples; wide_sample++) { \
+		for(channel = 0; channel < CHANNELS; channel++) \
+			fifo->data[channel][tail] = input[sample++]; \
+		tail++; \
+	} \
+	fifo->tail = tail; \
+	\
+	FLAC__ASSERT(fifo->tail <= fifo->size); \
+}
+
+DEFINE_COPY_INTERLEAVED_(copy_interleaved_, channels)
+DEFINE_COPY_INTERLEAVED_(copy_interleaved_stereo_, 2)
+DEFINE_APPEND_TO_VERIFY_FIFO_INTERLEAVED_(append_to_verify_fifo_interleaved_, channels)
+DEFINE_APPEND_TO_VERIFY_FIFO_INTERLEAVED_(append_to_verify_fifo_interleaved_stereo_, 2)
+
+void copy_interleaved_mid_side_(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], unsigned offset, unsigned wide_samples)
 {
-	unsigned channel;
-	unsigned sample, wide_sample;
-	unsigned tail = fifo->tail;
+	FLAC__int32 * const *signal = encoder->private_->integer_signal;
+	FLAC__int32 * const *signal_mid_side = encoder->private_->integer_signal_mid_side;
+	const unsigned end = offset + wide_samples;
+	FLAC__int32 x, mid, side;
+	unsigned i;
 
-	sample = input_offset * channels;
-	for(wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
-		for(channel = 0; channel < channels; channel++)
-			fifo->data[channel][tail] = input[sample++];
-		tail++;
+	FLAC__ASSERT(encoder->protected_->channels == 2);
+	for(i = offset; i < end; i++) {
+		signal[0][i] = mid = side = *buffer++;
+		x = *buffer++;
+		signal[1][i] = x;
+		mid += x;
+		side -= x;
+		mid >>= 1; /* NOTE: not the same as 'mid = (left + right) / 2' ! */
+		signal_mid_side[1][i] = side;
+		signal_mid_side[0][i] = mid;
 	}
-	fifo->tail = tail;
-
-	FLAC__ASSERT(fifo->tail <= fifo->size);
 }
 
 FLAC__StreamDecoderReadStatus verify_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
@@ -4199,6 +5675,10 @@ FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder
 
 	(void)decoder;
 
+	/* the decoder hands us sample numbers even for fixed-blocksize frames; the frame must start at the head of the fifo */
+	FLAC__ASSERT(frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+	FLAC__ASSERT(frame->header.number.sample_number == encoder->private_->streaminfo.data.stream_info.total_samples);
+
 	for(channel = 0; channel < channels; channel++) {
 		if(0 != memcmp(buffer[channel], encoder->private_->verify.input_fifo.data[channel], bytes_per_block)) {
 			unsigned i, sample = 0;
@@ -4213,9 +5693,9 @@ FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder
 				}
 			}
 			FLAC__ASSERT(i < blocksize);
-			FLAC__ASSERT(frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
 			encoder->private_->verify.error_stats.absolute_sample = frame->header.number.sample_number + sample;
-			encoder->private_->verify.error_stats.frame_number = (unsigned)(frame->header.number.sample_number / blocksize);
+			/* the frame being verified is the one being written; with variable-blocksize frames this cannot come from the sample number */
+			encoder->private_->verify.error_stats.frame_number = encoder->private_->current_frame_number;
 			encoder->private_->verify.error_stats.channel = channel;
 			encoder->private_->verify.error_stats.sample = sample;
 			encoder->private_->verify.error_stats.expected = expect;
@@ -4226,7 +5706,8 @@ FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder
 	}
 	/* dequeue the frame from the fifo */
 	encoder->private_->verify.input_fifo.tail -= blocksize;
-	FLAC__ASSERT(encoder->private_->verify.input_fifo.tail <= OVERREAD_);
+	/* what is left is the rest of the block, when it is split into several frames, and the overread sample */
+	FLAC__ASSERT(frame->header.number.sample_number + blocksize + encoder->private_->verify.input_fifo.tail <= encoder->private_->block_end_sample + OVERREAD_);
 	for(channel = 0; channel < channels; channel++)
 		memmove(&encoder->private_->verify.input_fifo.data[channel][0], &encoder->private_->verify.input_fifo.data[channel][blocksize], encoder->private_->verify.input_fifo.tail * sizeof(encoder->private_->verify.input_fifo.data[0][0]));
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
@@ -4248,6 +5729,9 @@ FLAC__StreamEncoderReadStatus file_read_callback_(const FLAC__StreamEncoder *enc
 {
 	(void)client_data;
 
+	if(!flush_write_buffer_(encoder))
+		return FLAC__STREAM_ENCODER_READ_STATUS_ABORT;
+
 	*bytes = fread(buffer, 1, *bytes, encoder->private_->file);
 	if (*bytes == 0) {
 		if (feof(encoder->private_->file))
@@ -4262,6 +5746,9 @@ FLAC__StreamEncoderSeekStatus file_seek_callback_(const FLAC__StreamEncoder *enc
 {
 	(void)client_data;
 
+	if(!flush_write_buffer_(encoder))
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+
 	if(fseeko(encoder->private_->file, (off_t)absolute_byte_offset, SEEK_SET) < 0)
 		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
 	else
@@ -4274,13 +5761,19 @@ FLAC__StreamEncoderTellStatus file_tell_callback_(const FLAC__StreamEncoder *enc
 
 	(void)client_data;
 
+	if(0 != encoder->private_->uring_writer) {
+		*absolute_byte_offset = FLAC__uring_writer_get_offset(encoder->private_->uring_writer);
+		return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+	}
+
 	offset = ftello(encoder->private_->file);
 
 	if(offset < 0) {
 		return FLAC__STREAM_ENCODER_TELL_STATUS_ERROR;
 	}
 	else {
-		*absolute_byte_offset = (FLAC__uint64)offset;
+		/* what is still waiting in the write buffer counts as written */
+		*absolute_byte_offset = (FLAC__uint64)offset + encoder->private_->write_buffer_bytes;
 		return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
 	}
 }
@@ -4297,11 +5790,53 @@ static size_t local__fwrite(const void *ptr, size_t size, size_t nmemb, FILE *st
 #define local__fwrite fwrite
 #endif
 
+/*
+ * With a write buffer, small writes are gathered in it and written out
+ * when it fills up; anything that would not fit in an empty buffer goes
+ * straight to the file.
+ */
+FLAC__bool write_to_file_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes)
+{
+	const size_t size = encoder->protected_->write_buffer_size;
+
+	if(0 != encoder->private_->uring_writer)
+		return FLAC__uring_writer_write(encoder->private_->uring_writer, buffer, bytes);
+	if(0 == encoder->private_->write_buffer)
+		return local__fwrite(buffer, sizeof(FLAC__byte), bytes, encoder->private_->file) == bytes;
+
+	if(encoder->private_->write_buffer_bytes + bytes > size && !flush_write_buffer_(encoder))
+		return false;
+	if(bytes >= size)
+		return local__fwrite(buffer, sizeof(FLAC__byte), bytes, encoder->private_->file) == bytes;
+	memcpy(encoder->private_->write_buffer + encoder->private_->write_buffer_bytes, buffer, bytes);
+	encoder->private_->write_buffer_bytes += bytes;
+	return true;
+}
+
+FLAC__bool flush_write_buffer_(const FLAC__StreamEncoder *encoder)
+{
+	const size_t bytes = encoder->private_->write_buffer_bytes;
+
+	if(0 != encoder->private_->uring_writer) {
+		/* the rest (the metadata rewrite, if any) goes through stdio from where the frames end */
+		FLAC__UringWriter *writer = encoder->private_->uring_writer;
+		const FLAC__uint64 offset = FLAC__uring_writer_get_offset(writer);
+		const FLAC__bool ok = FLAC__uring_writer_drain(writer);
+		FLAC__uring_writer_delete(writer);
+		encoder->private_->uring_writer = 0;
+		return ok && fseeko(encoder->private_->file, (off_t)offset, SEEK_SET) == 0;
+	}
+	if(bytes == 0)
+		return true;
+	encoder->private_->write_buffer_bytes = 0;
+	return local__fwrite(encoder->private_->write_buffer, sizeof(FLAC__byte), bytes, encoder->private_->file) == bytes;
+}
+
 FLAC__StreamEncoderWriteStatus file_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
 {
 	(void)client_data, (void)current_frame;
 
-	if(local__fwrite(buffer, sizeof(FLAC__byte), bytes, encoder->private_->file) == bytes) {
+	if(write_to_file_(encoder, buffer, bytes)) {
 		FLAC__bool call_it = 0 != encoder->private_->progress_callback && (
 #if FLAC__HAS_OGG
 			/* We would like to be able to use 'samples > 0' in the
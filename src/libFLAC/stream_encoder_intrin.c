@@ -0,0 +1,175 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if defined FLAC__CPU_X86_64 && defined FLAC__HAS_X86INTRIN
+
+#include <stdlib.h> /* for abs() */
+#include <immintrin.h>
+#include "private/bitmath.h"
+#include "private/stream_encoder.h"
+#include "FLAC/assert.h"
+
+static void merge_partition_sums_(FLAC__uint64 abs_residual_partition_sums[], unsigned min_partition_order, unsigned max_partition_order)
+{
+	unsigned partitions = 1u << max_partition_order;
+	unsigned from_partition = 0, to_partition = partitions;
+	int partition_order;
+	for(partition_order = (int)max_partition_order - 1; partition_order >= (int)min_partition_order; partition_order--) {
+		unsigned i;
+		partitions >>= 1;
+		for(i = 0; i < partitions; i++) {
+			abs_residual_partition_sums[to_partition++] =
+				abs_residual_partition_sums[from_partition  ] +
+				abs_residual_partition_sums[from_partition+1];
+			from_partition += 2;
+		}
+	}
+}
+
+/*
+ * SSE2
+ */
+
+static __m128i abs_epi32_sse2_(__m128i x)
+{
+	const __m128i sign = _mm_srai_epi32(x, 31);
+	return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+}
+
+void FLAC__precompute_partition_info_sums_intrin_sse2(const FLAC__int32 residual[], FLAC__uint64 abs_residual_partition_sums[], unsigned residual_samples, unsigned predictor_order, unsigned min_partition_order, unsigned max_partition_order, unsigned bps)
+{
+	const unsigned default_partition_samples = (residual_samples + predictor_order) >> max_partition_order;
+	const unsigned partitions = 1u << max_partition_order;
+	unsigned partition, residual_sample, end = (unsigned)(-(int)predictor_order);
+
+	FLAC__ASSERT(default_partition_samples > predictor_order);
+
+	/* first do max_partition_order; see precompute_partition_info_sums_() for the choice of accumulator */
+	if(FLAC__bitmath_ilog2(default_partition_samples) + bps < 32) {
+		FLAC__uint32 lane[4];
+		for(partition = residual_sample = 0; partition < partitions; partition++) {
+			__m128i sum = _mm_setzero_si128();
+			FLAC__uint32 abs_residual_partition_sum;
+			end += default_partition_samples;
+			for( ; residual_sample + 4 <= end; residual_sample += 4)
+				sum = _mm_add_epi32(sum, abs_epi32_sse2_(_mm_loadu_si128((const __m128i*)(residual+residual_sample))));
+			_mm_storeu_si128((__m128i*)lane, sum);
+			abs_residual_partition_sum = lane[0] + lane[1] + lane[2] + lane[3];
+			for( ; residual_sample < end; residual_sample++)
+				abs_residual_partition_sum += abs(residual[residual_sample]);
+			abs_residual_partition_sums[partition] = abs_residual_partition_sum;
+		}
+	}
+	else {
+		const __m128i zero = _mm_setzero_si128();
+		FLAC__uint64 lane[2];
+		for(partition = residual_sample = 0; partition < partitions; partition++) {
+			__m128i sum = zero;
+			FLAC__uint64 abs_residual_partition_sum;
+			end += default_partition_samples;
+			for( ; residual_sample + 4 <= end; residual_sample += 4) {
+				const __m128i a = abs_epi32_sse2_(_mm_loadu_si128((const __m128i*)(residual+residual_sample)));
+				sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(a, zero));
+				sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(a, zero));
+			}
+			_mm_storeu_si128((__m128i*)lane, sum);
+			abs_residual_partition_sum = lane[0] + lane[1];
+			for( ; residual_sample < end; residual_sample++)
+				abs_residual_partition_sum += abs(residual[residual_sample]);
+			abs_residual_partition_sums[partition] = abs_residual_partition_sum;
+		}
+	}
+
+	merge_partition_sums_(abs_residual_partition_sums, min_partition_order, max_partition_order);
+}
+
+/*
+ * AVX2
+ */
+
+FLAC__AVX2_TARGET
+void FLAC__precompute_partition_info_sums_intrin_avx2(const FLAC__int32 residual[], FLAC__uint64 abs_residual_partition_sums[], unsigned residual_samples, unsigned predictor_order, unsigned min_partition_order, unsigned max_partition_order, unsigned bps)
+{
+	const unsigned default_partition_samples = (residual_samples + predictor_order) >> max_partition_order;
+	const unsigned partitions = 1u << max_partition_order;
+	unsigned partition, residual_sample, end = (unsigned)(-(int)predictor_order);
+
+	FLAC__ASSERT(default_partition_samples > predictor_order);
+
+	/* first do max_partition_order; see precompute_partition_info_sums_() for the choice of accumulator */
+	if(FLAC__bitmath_ilog2(default_partition_samples) + bps < 32) {
+		FLAC__uint32 lane[8];
+		for(partition = residual_sample = 0; partition < partitions; partition++) {
+			__m256i sum = _mm256_setzero_si256();
+			FLAC__uint32 abs_residual_partition_sum;
+			end += default_partition_samples;
+			for( ; residual_sample + 8 <= end; residual_sample += 8)
+				sum = _mm256_add_epi32(sum, _mm256_abs_epi32(_mm256_loadu_si256((const __m256i*)(residual+residual_sample))));
+			_mm256_storeu_si256((__m256i*)lane, sum);
+			abs_residual_partition_sum = lane[0] + lane[1] + lane[2] + lane[3] + lane[4] + lane[5] + lane[6] + lane[7];
+			for( ; residual_sample < end; residual_sample++)
+				abs_residual_partition_sum += abs(residual[residual_sample]);
+			abs_residual_partition_sums[partition] = abs_residual_partition_sum;
+		}
+	}
+	else {
+		const __m256i zero = _mm256_setzero_si256();
+		FLAC__uint64 lane[4];
+		for(partition = residual_sample = 0; partition < partitions; partition++) {
+			__m256i sum = zero;
+			FLAC__uint64 abs_residual_partition_sum;
+			end += default_partition_samples;
+			for( ; residual_sample + 8 <= end; residual_sample += 8) {
+				const __m256i a = _mm256_abs_epi32(_mm256_loadu_si256((const __m256i*)(residual+residual_sample)));
+				sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(a, zero));
+				sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(a, zero));
+			}
+			_mm256_storeu_si256((__m256i*)lane, sum);
+			abs_residual_partition_sum = lane[0] + lane[1] + lane[2] + lane[3];
+			for( ; residual_sample < end; residual_sample++)
+				abs_residual_partition_sum += abs(residual[residual_sample]);
+			abs_residual_partition_sums[partition] = abs_residual_partition_sum;
+		}
+	}
+	_mm256_zeroupper();
+
+	merge_partition_sums_(abs_residual_partition_sums, min_partition_order, max_partition_order);
+}
+
+#endif /* FLAC__CPU_X86_64 && FLAC__HAS_X86INTRIN */
+#endif /* FLAC__NO_ASM */
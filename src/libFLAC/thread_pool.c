@@ -0,0 +1,424 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h> /* for free() */
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <unistd.h> /* for sysconf() */
+#endif
+#include "FLAC/assert.h"
+#include "share/alloc.h"
+#include "private/thread_pool.h"
+
+/*
+ * Every attached instance has its own queue with its own lock, so
+ * instances submitting work never contend with each other.  The
+ * threads go round the queues taking work from whichever have some.
+ * The pool mutex is only used by threads going to sleep when there is
+ * nothing to do, and by submitters waking them up; a count of queued
+ * tasks, kept with atomic operations, tells a submitter whether anyone
+ * needs waking, and a thread whether there is anything to look for.
+ */
+
+#ifdef HAVE_PTHREAD_H
+#ifdef __ATOMIC_SEQ_CST
+#define ATOMIC_ADD_(p, n) __atomic_add_fetch((p), (n), __ATOMIC_SEQ_CST)
+#define ATOMIC_LOAD_(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#else
+/* the older builtins are full barriers */
+#define ATOMIC_ADD_(p, n) __sync_add_and_fetch((p), (n))
+#define ATOMIC_LOAD_(p) __sync_add_and_fetch((p), 0)
+#endif
+#endif
+
+typedef struct {
+	FLAC__ThreadPoolTask task;
+	void *data;
+} FLAC__ThreadPoolEntry;
+
+struct FLAC__ThreadPoolQueue {
+	FLAC__ThreadPool *pool;
+	FLAC__ThreadPoolEntry *entries; /* circular buffer of pool->queue_depth entries */
+	unsigned head, count; /* index of the oldest waiting task, and number of waiting tasks */
+	unsigned running; /* number of tasks taken off the queue but not yet finished */
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t mutex; /* protects entries, head, count and running */
+	pthread_cond_t idle; /* signalled when count and running both drop to 0 */
+#endif
+};
+
+struct FLAC__ThreadPool {
+	unsigned threads, queue_depth;
+	FLAC__ThreadPoolQueue **queue; /* the attached queues, in no particular order */
+	unsigned attached, capacity; /* number of queues, and the size of the queue array */
+#ifdef HAVE_PTHREAD_H
+	pthread_rwlock_t queues; /* protects queue, attached and capacity; the threads only read them */
+	pthread_mutex_t mutex; /* protects quit, and is held by a thread from deciding to sleep until it waits on work */
+	pthread_cond_t work; /* signalled when a task is queued or the pool is shutting down */
+	unsigned queued; /* number of tasks waiting in all the queues; only changed with ATOMIC_ADD_() */
+	unsigned sleeping; /* number of threads waiting on work, or about to; only changed with ATOMIC_ADD_() */
+	pthread_t *thread;
+	FLAC__bool quit;
+#endif
+};
+
+#ifdef HAVE_PTHREAD_H
+static unsigned count_processors_(void);
+static void *worker_(void *arg);
+static FLAC__ThreadPoolQueue *find_task_(FLAC__ThreadPool *pool, unsigned *start, FLAC__ThreadPoolEntry *entry);
+static FLAC__bool take_task_(FLAC__ThreadPoolQueue *queue, FLAC__ThreadPoolEntry *entry);
+static void finish_task_(FLAC__ThreadPoolQueue *queue);
+#endif
+
+FLAC_API FLAC__ThreadPool *FLAC__thread_pool_new(unsigned threads, unsigned queue_depth)
+{
+	FLAC__ThreadPool *pool = (FLAC__ThreadPool*)calloc(1, sizeof(FLAC__ThreadPool));
+
+	if(pool == 0)
+		return 0;
+
+#ifdef HAVE_PTHREAD_H
+	if(threads == 0)
+		threads = count_processors_();
+	pool->queue_depth = queue_depth? queue_depth : 2 * threads;
+
+	if(0 != pthread_rwlock_init(&pool->queues, 0)) {
+		free(pool);
+		return 0;
+	}
+	if(0 != pthread_mutex_init(&pool->mutex, 0)) {
+		pthread_rwlock_destroy(&pool->queues);
+		free(pool);
+		return 0;
+	}
+	if(0 != pthread_cond_init(&pool->work, 0)) {
+		pthread_mutex_destroy(&pool->mutex);
+		pthread_rwlock_destroy(&pool->queues);
+		free(pool);
+		return 0;
+	}
+	if(0 == (pool->thread = (pthread_t*)safe_malloc_mul_2op_(sizeof(pthread_t), /*times*/threads))) {
+		FLAC__thread_pool_delete(pool);
+		return 0;
+	}
+	for(pool->threads = 0; pool->threads < threads; pool->threads++) {
+		if(0 != pthread_create(&pool->thread[pool->threads], 0, worker_, pool)) {
+			FLAC__thread_pool_delete(pool);
+			return 0;
+		}
+	}
+#else
+	(void)threads;
+	pool->queue_depth = queue_depth? queue_depth : 1;
+#endif
+
+	return pool;
+}
+
+FLAC_API void FLAC__thread_pool_delete(FLAC__ThreadPool *pool)
+{
+#ifdef HAVE_PTHREAD_H
+	unsigned i;
+#endif
+
+	FLAC__ASSERT(0 != pool);
+	FLAC__ASSERT(pool->attached == 0);
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->mutex);
+	for(i = 0; i < pool->threads; i++)
+		pthread_join(pool->thread[i], 0);
+	if(0 != pool->thread)
+		free(pool->thread);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_rwlock_destroy(&pool->queues);
+#endif
+
+	if(0 != pool->queue)
+		free(pool->queue);
+	free(pool);
+}
+
+FLAC_API unsigned FLAC__thread_pool_get_threads(const FLAC__ThreadPool *pool)
+{
+	FLAC__ASSERT(0 != pool);
+	return pool->threads;
+}
+
+FLAC_API unsigned FLAC__thread_pool_get_queue_depth(const FLAC__ThreadPool *pool)
+{
+	FLAC__ASSERT(0 != pool);
+	return pool->queue_depth;
+}
+
+FLAC__ThreadPoolQueue *FLAC__thread_pool_attach(FLAC__ThreadPool *pool)
+{
+	FLAC__ThreadPoolQueue *queue;
+	FLAC__bool ok = true;
+
+	FLAC__ASSERT(0 != pool);
+
+	if(0 == (queue = (FLAC__ThreadPoolQueue*)calloc(1, sizeof(FLAC__ThreadPoolQueue))))
+		return 0;
+	if(0 == (queue->entries = (FLAC__ThreadPoolEntry*)safe_malloc_mul_2op_(sizeof(FLAC__ThreadPoolEntry), /*times*/pool->queue_depth))) {
+		free(queue);
+		return 0;
+	}
+	queue->pool = pool;
+
+#ifdef HAVE_PTHREAD_H
+	if(0 != pthread_mutex_init(&queue->mutex, 0)) {
+		free(queue->entries);
+		free(queue);
+		return 0;
+	}
+	if(0 != pthread_cond_init(&queue->idle, 0)) {
+		pthread_mutex_destroy(&queue->mutex);
+		free(queue->entries);
+		free(queue);
+		return 0;
+	}
+	pthread_rwlock_wrlock(&pool->queues);
+#endif
+	if(pool->attached == pool->capacity) {
+		const unsigned capacity = pool->capacity? 2 * pool->capacity : 16;
+		FLAC__ThreadPoolQueue **array = (FLAC__ThreadPoolQueue**)safe_realloc_mul_2op_(pool->queue, sizeof(FLAC__ThreadPoolQueue*), /*times*/capacity);
+		if(0 == array)
+			ok = false;
+		else {
+			pool->queue = array;
+			pool->capacity = capacity;
+		}
+	}
+	if(ok)
+		pool->queue[pool->attached++] = queue;
+#ifdef HAVE_PTHREAD_H
+	pthread_rwlock_unlock(&pool->queues);
+#endif
+
+	if(!ok) {
+#ifdef HAVE_PTHREAD_H
+		pthread_cond_destroy(&queue->idle);
+		pthread_mutex_destroy(&queue->mutex);
+#endif
+		free(queue->entries);
+		free(queue);
+		return 0;
+	}
+	return queue;
+}
+
+void FLAC__thread_pool_detach(FLAC__ThreadPoolQueue *queue)
+{
+	FLAC__ThreadPool *pool;
+	unsigned i;
+
+	FLAC__ASSERT(0 != queue);
+
+	pool = queue->pool;
+	FLAC__thread_pool_wait(queue);
+
+#ifdef HAVE_PTHREAD_H
+	/* once this is held no thread is looking at the queue */
+	pthread_rwlock_wrlock(&pool->queues);
+#endif
+	for(i = 0; i < pool->attached; i++) {
+		if(pool->queue[i] == queue) {
+			pool->queue[i] = pool->queue[--pool->attached];
+			break;
+		}
+	}
+#ifdef HAVE_PTHREAD_H
+	pthread_rwlock_unlock(&pool->queues);
+	pthread_cond_destroy(&queue->idle);
+	pthread_mutex_destroy(&queue->mutex);
+#endif
+
+	free(queue->entries);
+	free(queue);
+}
+
+void FLAC__thread_pool_submit(FLAC__ThreadPoolQueue *queue, FLAC__ThreadPoolTask task, void *data)
+{
+#ifdef HAVE_PTHREAD_H
+	FLAC__ThreadPool *pool;
+	FLAC__ThreadPoolEntry *entry;
+
+	FLAC__ASSERT(0 != queue);
+	FLAC__ASSERT(0 != task);
+
+	pool = queue->pool;
+	if(pool->threads > 0) {
+		pthread_mutex_lock(&queue->mutex);
+		if(queue->count < pool->queue_depth) {
+			entry = &queue->entries[(queue->head + queue->count) % pool->queue_depth];
+			entry->task = task;
+			entry->data = data;
+			queue->count++;
+			pthread_mutex_unlock(&queue->mutex);
+			/* a thread going to sleep counts itself before it checks queued, so one of the two sees the other */
+			(void)ATOMIC_ADD_(&pool->queued, 1);
+			if(ATOMIC_LOAD_(&pool->sleeping) > 0) {
+				pthread_mutex_lock(&pool->mutex);
+				pthread_cond_signal(&pool->work);
+				pthread_mutex_unlock(&pool->mutex);
+			}
+			return;
+		}
+		pthread_mutex_unlock(&queue->mutex);
+	}
+#else
+	FLAC__ASSERT(0 != queue);
+	FLAC__ASSERT(0 != task);
+	(void)queue;
+#endif
+
+	/* no room (or no threads) so do it ourselves */
+	task(data);
+}
+
+void FLAC__thread_pool_wait(FLAC__ThreadPoolQueue *queue)
+{
+#ifdef HAVE_PTHREAD_H
+	FLAC__ThreadPoolEntry entry;
+
+	FLAC__ASSERT(0 != queue);
+
+	pthread_mutex_lock(&queue->mutex);
+	while(queue->count > 0 || queue->running > 0) {
+		if(take_task_(queue, &entry)) {
+			pthread_mutex_unlock(&queue->mutex);
+			entry.task(entry.data);
+			pthread_mutex_lock(&queue->mutex);
+			finish_task_(queue);
+		}
+		else
+			pthread_cond_wait(&queue->idle, &queue->mutex);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+#else
+	/* every task was already run by FLAC__thread_pool_submit() */
+	FLAC__ASSERT(0 != queue);
+	(void)queue;
+#endif
+}
+
+#ifdef HAVE_PTHREAD_H
+unsigned count_processors_(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n > 0)
+		return (unsigned)n;
+#endif
+	return 1;
+}
+
+void *worker_(void *arg)
+{
+	FLAC__ThreadPool *pool = (FLAC__ThreadPool*)arg;
+	FLAC__ThreadPoolQueue *queue;
+	FLAC__ThreadPoolEntry entry;
+	unsigned start = 0; /* where this thread starts looking for work; moves past each queue it takes from so every instance gets its turn */
+	FLAC__bool quit = false;
+
+	while(!quit) {
+		if(ATOMIC_LOAD_(&pool->queued) > 0 && 0 != (queue = find_task_(pool, &start, &entry))) {
+			entry.task(entry.data);
+			pthread_mutex_lock(&queue->mutex);
+			finish_task_(queue);
+			pthread_mutex_unlock(&queue->mutex);
+			continue;
+		}
+		pthread_mutex_lock(&pool->mutex);
+		(void)ATOMIC_ADD_(&pool->sleeping, 1);
+		while(!pool->quit && ATOMIC_LOAD_(&pool->queued) == 0)
+			pthread_cond_wait(&pool->work, &pool->mutex);
+		(void)ATOMIC_ADD_(&pool->sleeping, (unsigned)-1);
+		quit = pool->quit;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	return 0;
+}
+
+/* takes a task from the first queue from *start on that has one, and returns that queue, or NULL if none had any */
+FLAC__ThreadPoolQueue *find_task_(FLAC__ThreadPool *pool, unsigned *start, FLAC__ThreadPoolEntry *entry)
+{
+	FLAC__ThreadPoolQueue *queue = 0;
+	unsigned i, n;
+
+	pthread_rwlock_rdlock(&pool->queues);
+	for(i = 0; i < pool->attached; i++) {
+		n = (*start + i) % pool->attached;
+		pthread_mutex_lock(&pool->queue[n]->mutex);
+		if(take_task_(pool->queue[n], entry))
+			queue = pool->queue[n];
+		pthread_mutex_unlock(&pool->queue[n]->mutex);
+		if(0 != queue) {
+			*start = n + 1;
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&pool->queues);
+	return queue;
+}
+
+/* must be called with the queue mutex held */
+FLAC__bool take_task_(FLAC__ThreadPoolQueue *queue, FLAC__ThreadPoolEntry *entry)
+{
+	if(queue->count == 0)
+		return false;
+	*entry = queue->entries[queue->head];
+	queue->head = (queue->head + 1) % queue->pool->queue_depth;
+	queue->count--;
+	queue->running++;
+	(void)ATOMIC_ADD_(&queue->pool->queued, (unsigned)-1);
+	return true;
+}
+
+/* must be called with the queue mutex held */
+void finish_task_(FLAC__ThreadPoolQueue *queue)
+{
+	FLAC__ASSERT(queue->running > 0);
+	queue->running--;
+	if(queue->count == 0 && queue->running == 0)
+		pthread_cond_broadcast(&queue->idle);
+}
+#endif
@@ -0,0 +1,366 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2009  Josh Coalson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h> /* for calloc() */
+#ifdef HAVE_LINUX_IO_URING_H
+#include <errno.h>
+#include <string.h> /* for memcpy() */
+#include <unistd.h> /* for pwrite() */
+#include <sys/mman.h> /* for mmap() */
+#include <sys/syscall.h>
+#include <sys/uio.h> /* for struct iovec */
+#include <linux/io_uring.h>
+#endif
+#include "FLAC/assert.h"
+#include "share/alloc.h"
+#include "private/uring_writer.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#define FLAC__URING_WRITER_MAX_BUFFERS 16
+
+struct FLAC__UringWriter {
+	int ring_fd, fd;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring, *cq_ring; /* cq_ring == sq_ring if the kernel maps both with one mmap() */
+	size_t sq_ring_size, cq_ring_size, sqes_size;
+	FLAC__bool registered; /* if the buffers could not be registered (e.g. RLIMIT_MEMLOCK), plain writes are used */
+	FLAC__byte *memory; /* all the buffers, in one allocation */
+	FLAC__byte *buffer[FLAC__URING_WRITER_MAX_BUFFERS];
+	size_t buffer_bytes[FLAC__URING_WRITER_MAX_BUFFERS]; /* # of bytes in each buffer */
+	FLAC__uint64 buffer_offset[FLAC__URING_WRITER_MAX_BUFFERS]; /* file offset of each submitted buffer */
+	FLAC__bool in_flight[FLAC__URING_WRITER_MAX_BUFFERS];
+	unsigned buffers, current, pending; /* current is the buffer being filled; pending is the # of submitted writes not yet reaped */
+	size_t buffer_size;
+	FLAC__uint64 offset; /* file offset of buffer[current][0] */
+	FLAC__bool error;
+};
+
+static FLAC__bool op_supported_(int ring_fd, unsigned op);
+static FLAC__bool submit_(FLAC__UringWriter *writer);
+static FLAC__bool reap_(FLAC__UringWriter *writer, FLAC__bool wait);
+
+FLAC__UringWriter *FLAC__uring_writer_new(int fd, FLAC__uint64 offset, unsigned buffers, size_t buffer_size)
+{
+	FLAC__UringWriter *writer;
+	struct io_uring_params params;
+	struct iovec iov[FLAC__URING_WRITER_MAX_BUFFERS];
+	unsigned i;
+
+	FLAC__ASSERT(buffers > 0);
+	FLAC__ASSERT(buffer_size > 0);
+
+	if(buffers > FLAC__URING_WRITER_MAX_BUFFERS)
+		buffers = FLAC__URING_WRITER_MAX_BUFFERS;
+
+	if(0 == (writer = (FLAC__UringWriter*)calloc(1, sizeof(FLAC__UringWriter))))
+		return 0;
+	writer->ring_fd = -1;
+	writer->fd = fd;
+	writer->buffers = buffers;
+	writer->buffer_size = buffer_size;
+	writer->offset = offset;
+
+	memset(&params, 0, sizeof(params));
+	if((writer->ring_fd = (int)syscall(__NR_io_uring_setup, buffers, &params)) < 0) {
+		FLAC__uring_writer_delete(writer);
+		return 0;
+	}
+
+	writer->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	writer->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		if(writer->cq_ring_size > writer->sq_ring_size)
+			writer->sq_ring_size = writer->cq_ring_size;
+		writer->cq_ring_size = writer->sq_ring_size;
+	}
+	writer->sq_ring = mmap(0, writer->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, writer->ring_fd, IORING_OFF_SQ_RING);
+	if(writer->sq_ring == MAP_FAILED) {
+		writer->sq_ring = 0;
+		FLAC__uring_writer_delete(writer);
+		return 0;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		writer->cq_ring = writer->sq_ring;
+	else if(MAP_FAILED == (writer->cq_ring = mmap(0, writer->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, writer->ring_fd, IORING_OFF_CQ_RING))) {
+		writer->cq_ring = 0;
+		FLAC__uring_writer_delete(writer);
+		return 0;
+	}
+	writer->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	writer->sqes = (struct io_uring_sqe*)mmap(0, writer->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, writer->ring_fd, IORING_OFF_SQES);
+	if((void*)writer->sqes == MAP_FAILED) {
+		writer->sqes = 0;
+		FLAC__uring_writer_delete(writer);
+		return 0;
+	}
+	writer->sq_head = (unsigned*)((FLAC__byte*)writer->sq_ring + params.sq_off.head);
+	writer->sq_tail = (unsigned*)((FLAC__byte*)writer->sq_ring + params.sq_off.tail);
+	writer->sq_mask = (unsigned*)((FLAC__byte*)writer->sq_ring + params.sq_off.ring_mask);
+	writer->sq_array = (unsigned*)((FLAC__byte*)writer->sq_ring + params.sq_off.array);
+	writer->cq_head = (unsigned*)((FLAC__byte*)writer->cq_ring + params.cq_off.head);
+	writer->cq_tail = (unsigned*)((FLAC__byte*)writer->cq_ring + params.cq_off.tail);
+	writer->cq_mask = (unsigned*)((FLAC__byte*)writer->cq_ring + params.cq_off.ring_mask);
+	writer->cqes = (struct io_uring_cqe*)((FLAC__byte*)writer->cq_ring + params.cq_off.cqes);
+
+	if(0 == (writer->memory = (FLAC__byte*)safe_malloc_mul_2op_(buffers, /*times*/buffer_size))) {
+		FLAC__uring_writer_delete(writer);
+		return 0;
+	}
+	for(i = 0; i < buffers; i++) {
+		writer->buffer[i] = writer->memory + i * buffer_size;
+		iov[i].iov_base = writer->buffer[i];
+		iov[i].iov_len = buffer_size;
+	}
+	writer->registered = syscall(__NR_io_uring_register, writer->ring_fd, IORING_REGISTER_BUFFERS, iov, buffers) == 0;
+
+	/* a kernel that can set up a ring may still fail every write with -EINVAL; then the caller is better off with stdio */
+	if(!op_supported_(writer->ring_fd, writer->registered? IORING_OP_WRITE_FIXED : IORING_OP_WRITE)) {
+		FLAC__uring_writer_delete(writer);
+		return 0;
+	}
+
+	return writer;
+}
+
+void FLAC__uring_writer_delete(FLAC__UringWriter *writer)
+{
+	FLAC__ASSERT(0 != writer);
+
+	/* the buffers must not be freed under writes that are still going on */
+	while(writer->pending > 0) {
+		const unsigned pending = writer->pending;
+		reap_(writer, /*wait=*/true);
+		if(writer->pending == pending)
+			break;
+	}
+	if(0 != writer->sqes)
+		munmap(writer->sqes, writer->sqes_size);
+	if(0 != writer->cq_ring && writer->cq_ring != writer->sq_ring)
+		munmap(writer->cq_ring, writer->cq_ring_size);
+	if(0 != writer->sq_ring)
+		munmap(writer->sq_ring, writer->sq_ring_size);
+	if(writer->ring_fd >= 0)
+		close(writer->ring_fd);
+	if(0 != writer->memory)
+		free(writer->memory);
+	free(writer);
+}
+
+FLAC__bool FLAC__uring_writer_write(FLAC__UringWriter *writer, const FLAC__byte buffer[], size_t bytes)
+{
+	FLAC__ASSERT(0 != writer);
+
+	while(bytes > 0) {
+		size_t n = writer->buffer_size - writer->buffer_bytes[writer->current];
+		if(n > bytes)
+			n = bytes;
+		memcpy(writer->buffer[writer->current] + writer->buffer_bytes[writer->current], buffer, n);
+		writer->buffer_bytes[writer->current] += n;
+		buffer += n;
+		bytes -= n;
+		if(writer->buffer_bytes[writer->current] == writer->buffer_size && !submit_(writer))
+			return false;
+	}
+	return !writer->error;
+}
+
+FLAC__bool FLAC__uring_writer_drain(FLAC__UringWriter *writer)
+{
+	FLAC__ASSERT(0 != writer);
+
+	if(writer->buffer_bytes[writer->current] > 0 && !submit_(writer))
+		return false;
+	while(writer->pending > 0) {
+		if(!reap_(writer, /*wait=*/true))
+			return false;
+	}
+	return !writer->error;
+}
+
+FLAC__uint64 FLAC__uring_writer_get_offset(const FLAC__UringWriter *writer)
+{
+	FLAC__ASSERT(0 != writer);
+	return writer->offset + writer->buffer_bytes[writer->current];
+}
+
+/*
+ * IORING_REGISTER_PROBE came in Linux 5.6, with IORING_OP_WRITE; on the
+ * kernels before it, back to 5.1, only IORING_OP_WRITE_FIXED is there.
+ */
+FLAC__bool op_supported_(int ring_fd, unsigned op)
+{
+	const unsigned ops = 256;
+	struct io_uring_probe *probe;
+	FLAC__bool supported;
+
+	if(0 == (probe = (struct io_uring_probe*)calloc(1, sizeof(struct io_uring_probe) + ops * sizeof(struct io_uring_probe_op))))
+		return false;
+	if(syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, ops) < 0)
+		supported = errno == EINVAL && op == IORING_OP_WRITE_FIXED;
+	else
+		supported = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	return supported;
+}
+
+/*
+ * Queues the current buffer for writing and moves on to the next one,
+ * waiting for it to come back if it is still in flight.
+ */
+FLAC__bool submit_(FLAC__UringWriter *writer)
+{
+	const unsigned i = writer->current;
+	const unsigned tail = *writer->sq_tail;
+	const unsigned index = tail & *writer->sq_mask;
+	struct io_uring_sqe *sqe = &writer->sqes[index];
+
+	FLAC__ASSERT(!writer->in_flight[i]);
+	FLAC__ASSERT(writer->buffer_bytes[i] > 0);
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = writer->registered? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	sqe->fd = writer->fd;
+	sqe->off = writer->offset;
+	sqe->addr = (FLAC__uint64)(size_t)writer->buffer[i];
+	sqe->len = (unsigned)writer->buffer_bytes[i];
+	sqe->buf_index = (FLAC__uint16)i;
+	sqe->user_data = i;
+	writer->sq_array[index] = index;
+	/* the kernel must see the entry before it sees the new tail */
+	__atomic_store_n(writer->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	while(syscall(__NR_io_uring_enter, writer->ring_fd, 1, 0, 0, 0, 0) < 0) {
+		if(errno != EINTR) {
+			writer->error = true;
+			return false;
+		}
+	}
+
+	writer->in_flight[i] = true;
+	writer->buffer_offset[i] = writer->offset;
+	writer->offset += writer->buffer_bytes[i];
+	writer->pending++;
+
+	writer->current = (i + 1) % writer->buffers;
+	while(writer->in_flight[writer->current]) {
+		if(!reap_(writer, /*wait=*/true))
+			return false;
+	}
+	writer->buffer_bytes[writer->current] = 0;
+	return true;
+}
+
+/*
+ * Collects finished writes, after waiting for at least one if 'wait' is
+ * set.  A short write is completed right here with pwrite().
+ */
+FLAC__bool reap_(FLAC__UringWriter *writer, FLAC__bool wait)
+{
+	unsigned head = *writer->cq_head;
+
+	if(wait && head == __atomic_load_n(writer->cq_tail, __ATOMIC_ACQUIRE)) {
+		while(syscall(__NR_io_uring_enter, writer->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, 0, 0) < 0) {
+			if(errno != EINTR) {
+				writer->error = true;
+				return false;
+			}
+		}
+	}
+
+	while(head != __atomic_load_n(writer->cq_tail, __ATOMIC_ACQUIRE)) {
+		const struct io_uring_cqe *cqe = &writer->cqes[head & *writer->cq_mask];
+		const unsigned i = (unsigned)cqe->user_data;
+		size_t done = cqe->res < 0? 0 : (size_t)cqe->res;
+
+		FLAC__ASSERT(i < writer->buffers);
+		FLAC__ASSERT(writer->in_flight[i]);
+
+		if(cqe->res < 0)
+			writer->error = true;
+		while(!writer->error && done < writer->buffer_bytes[i]) {
+			const ssize_t n = pwrite(writer->fd, writer->buffer[i] + done, writer->buffer_bytes[i] - done, (off_t)(writer->buffer_offset[i] + done));
+			if(n > 0)
+				done += (size_t)n;
+			else if(n == 0 || errno != EINTR)
+				writer->error = true;
+		}
+		writer->in_flight[i] = false;
+		writer->pending--;
+		head++;
+		__atomic_store_n(writer->cq_head, head, __ATOMIC_RELEASE);
+	}
+	return !writer->error;
+}
+
+#else
+
+FLAC__UringWriter *FLAC__uring_writer_new(int fd, FLAC__uint64 offset, unsigned buffers, size_t buffer_size)
+{
+	(void)fd, (void)offset, (void)buffers, (void)buffer_size;
+	return 0;
+}
+
+void FLAC__uring_writer_delete(FLAC__UringWriter *writer)
+{
+	(void)writer;
+	FLAC__ASSERT(0);
+}
+
+FLAC__bool FLAC__uring_writer_write(FLAC__UringWriter *writer, const FLAC__byte buffer[], size_t bytes)
+{
+	(void)writer, (void)buffer, (void)bytes;
+	FLAC__ASSERT(0);
+	return false;
+}
+
+FLAC__bool FLAC__uring_writer_drain(FLAC__UringWriter *writer)
+{
+	(void)writer;
+	FLAC__ASSERT(0);
+	return false;
+}
+
+FLAC__uint64 FLAC__uring_writer_get_offset(const FLAC__UringWriter *writer)
+{
+	(void)writer;
+	FLAC__ASSERT(0);
+	return 0;
+}
+
+#endif
@@ -34,8 +34,15 @@
 #endif
 
 #include <math.h>
+#include <stdlib.h> /* for malloc() */
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#elif defined _WIN32
+#include <windows.h> /* for InterlockedExchange() */
+#endif
 #include "FLAC/assert.h"
 #include "FLAC/format.h"
+#include "private/memory.h"
 #include "private/window.h"
 
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
@@ -222,4 +229,191 @@ void FLAC__window_welch(FLAC__real *window, const FLAC__int32 L)
 	}
 }
 
+/*
+ * The window cache is a list of every window some encoder holds, plus up
+ * to WINDOW_CACHE_IDLE_LIMIT_ that nobody does, so that encoders created
+ * one after another with the same settings share their windows too.
+ */
+#define WINDOW_CACHE_IDLE_LIMIT_ 16
+
+typedef struct window_cache_entry {
+	FLAC__ApodizationFunction type;
+	FLAC__real parameter;           /* stddev for gauss, p for tukey, else 0 */
+	unsigned L;
+	unsigned references;
+	unsigned long last_release;     /* value of window_cache_clock_ when references last went to 0 */
+	FLAC__real *window;
+	FLAC__real *window_unaligned;
+	struct window_cache_entry *next;
+} window_cache_entry;
+
+static window_cache_entry *window_cache_ = 0;
+static unsigned window_cache_idle_ = 0;
+static unsigned long window_cache_clock_ = 0;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t window_cache_mutex_ = PTHREAD_MUTEX_INITIALIZER;
+static void window_cache_lock_(void) { pthread_mutex_lock(&window_cache_mutex_); }
+static void window_cache_unlock_(void) { pthread_mutex_unlock(&window_cache_mutex_); }
+#elif defined _WIN32
+/* a spin lock, since a CRITICAL_SECTION would need initializing before the first encoder */
+static volatile LONG window_cache_mutex_ = 0;
+static void window_cache_lock_(void) { while(InterlockedExchange(&window_cache_mutex_, 1)) Sleep(0); }
+static void window_cache_unlock_(void) { InterlockedExchange(&window_cache_mutex_, 0); }
+#else
+static void window_cache_lock_(void) { }
+static void window_cache_unlock_(void) { }
+#endif
+
+static FLAC__real window_parameter_(const FLAC__ApodizationSpecification *apodization)
+{
+	switch(apodization->type) {
+		case FLAC__APODIZATION_GAUSS:
+			return apodization->parameters.gauss.stddev;
+		case FLAC__APODIZATION_TUKEY:
+			return apodization->parameters.tukey.p;
+		default:
+			return 0.0f;
+	}
+}
+
+static void compute_window_(FLAC__real *window, const FLAC__ApodizationSpecification *apodization, unsigned L)
+{
+	switch(apodization->type) {
+		case FLAC__APODIZATION_BARTLETT:
+			FLAC__window_bartlett(window, L);
+			break;
+		case FLAC__APODIZATION_BARTLETT_HANN:
+			FLAC__window_bartlett_hann(window, L);
+			break;
+		case FLAC__APODIZATION_BLACKMAN:
+			FLAC__window_blackman(window, L);
+			break;
+		case FLAC__APODIZATION_BLACKMAN_HARRIS_4TERM_92DB_SIDELOBE:
+			FLAC__window_blackman_harris_4term_92db_sidelobe(window, L);
+			break;
+		case FLAC__APODIZATION_CONNES:
+			FLAC__window_connes(window, L);
+			break;
+		case FLAC__APODIZATION_FLATTOP:
+			FLAC__window_flattop(window, L);
+			break;
+		case FLAC__APODIZATION_GAUSS:
+			FLAC__window_gauss(window, L, apodization->parameters.gauss.stddev);
+			break;
+		case FLAC__APODIZATION_HAMMING:
+			FLAC__window_hamming(window, L);
+			break;
+		case FLAC__APODIZATION_HANN:
+			FLAC__window_hann(window, L);
+			break;
+		case FLAC__APODIZATION_KAISER_BESSEL:
+			FLAC__window_kaiser_bessel(window, L);
+			break;
+		case FLAC__APODIZATION_NUTTALL:
+			FLAC__window_nuttall(window, L);
+			break;
+		case FLAC__APODIZATION_RECTANGLE:
+			FLAC__window_rectangle(window, L);
+			break;
+		case FLAC__APODIZATION_TRIANGLE:
+			FLAC__window_triangle(window, L);
+			break;
+		case FLAC__APODIZATION_TUKEY:
+			FLAC__window_tukey(window, L, apodization->parameters.tukey.p);
+			break;
+		case FLAC__APODIZATION_WELCH:
+			FLAC__window_welch(window, L);
+			break;
+		default:
+			FLAC__ASSERT(0);
+			/* double protection */
+			FLAC__window_hann(window, L);
+			break;
+	}
+}
+
+/* free the idle entry that was released the longest time ago; must hold the lock */
+static void window_cache_evict_(void)
+{
+	window_cache_entry **e, **oldest = 0;
+
+	for(e = &window_cache_; *e; e = &(*e)->next)
+		if((*e)->references == 0 && (0 == oldest || (*e)->last_release < (*oldest)->last_release))
+			oldest = e;
+	if(0 != oldest) {
+		window_cache_entry *entry = *oldest;
+		*oldest = entry->next;
+		free(entry->window_unaligned);
+		free(entry);
+		window_cache_idle_--;
+	}
+}
+
+const FLAC__real *FLAC__window_cache_acquire(const FLAC__ApodizationSpecification *apodization, unsigned L)
+{
+	FLAC__real parameter;
+	window_cache_entry *entry;
+
+	FLAC__ASSERT(0 != apodization);
+	FLAC__ASSERT(L > 0);
+
+	parameter = window_parameter_(apodization);
+	window_cache_lock_();
+	for(entry = window_cache_; entry; entry = entry->next) {
+		if(entry->type == apodization->type && entry->parameter == parameter && entry->L == L) {
+			if(entry->references++ == 0)
+				window_cache_idle_--;
+			window_cache_unlock_();
+			return entry->window;
+		}
+	}
+	window_cache_unlock_();
+
+	/*
+	 * Compute it outside the lock.  If another encoder adds the same
+	 * window meanwhile there are briefly two copies, which is harmless.
+	 */
+	if(0 == (entry = malloc(sizeof(window_cache_entry))))
+		return 0;
+	entry->window_unaligned = 0; /* FLAC__memory_alloc_aligned_real_array() frees the old pointer */
+	if(!FLAC__memory_alloc_aligned_real_array(L, &entry->window_unaligned, &entry->window)) {
+		free(entry);
+		return 0;
+	}
+	compute_window_(entry->window, apodization, L);
+	entry->type = apodization->type;
+	entry->parameter = parameter;
+	entry->L = L;
+	entry->references = 1;
+	entry->last_release = 0;
+
+	window_cache_lock_();
+	entry->next = window_cache_;
+	window_cache_ = entry;
+	window_cache_unlock_();
+
+	return entry->window;
+}
+
+void FLAC__window_cache_release(const FLAC__real *window)
+{
+	window_cache_entry *entry;
+
+	window_cache_lock_();
+	for(entry = window_cache_; entry; entry = entry->next) {
+		if(entry->window == window) {
+			FLAC__ASSERT(entry->references > 0);
+			if(--entry->references == 0) {
+				entry->last_release = ++window_cache_clock_;
+				if(++window_cache_idle_ > WINDOW_CACHE_IDLE_LIMIT_)
+					window_cache_evict_();
+			}
+			break;
+		}
+	}
+	FLAC__ASSERT(0 != entry);
+	window_cache_unlock_();
+}
+
 #endif /* !defined FLAC__INTEGER_ONLY_LIBRARY */
@@ -441,6 +441,7 @@ static bool test_stream_decoder(Layer layer, bool is_ogg)
 {
 	FLAC::Decoder::Stream *decoder;
 	::FLAC__StreamDecoderInitStatus init_status;
+	::FLAC__ThreadPool *pool;
 	bool expect;
 
 	printf("\n+++ libFLAC++ unit test: FLAC::Decoder::%s (layer: %s, format: %s)\n\n", layer<LAYER_FILE? "Stream":"File", LayerString[layer], is_ogg? "Ogg FLAC" : "FLAC");
@@ -729,6 +730,143 @@ static bool test_stream_decoder(Layer layer, bool is_ogg)
 	}
 	printf("OK\n");
 
+	/*
+	 * CRC check only
+	 */
+
+	printf("testing set_crc_check_only()... ");
+	if(!decoder->set_crc_check_only(true)) {
+		printf("FAILED, returned false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_crc_check_only()... ");
+	if(!decoder->get_crc_check_only()) {
+		printf("FAILED, returned false, expected true\n");
+		return false;
+	}
+	printf("OK\n");
+
+	if(!(layer < LAYER_FILE? dynamic_cast<StreamDecoder*>(decoder)->test_respond(is_ogg) : dynamic_cast<FileDecoder*>(decoder)->test_respond(is_ogg)))
+		return false;
+
+	/*
+	 * partial channel mask
+	 */
+
+	printf("testing set_channel_mask()... ");
+	if(!decoder->set_channel_mask(0x1)) {
+		printf("FAILED, returned false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_channel_mask()... ");
+	if(decoder->get_channel_mask() != 0x1) {
+		printf("FAILED, returned 0x%x, expected 0x1\n", (unsigned)decoder->get_channel_mask());
+		return false;
+	}
+	printf("OK\n");
+
+	if(!(layer < LAYER_FILE? dynamic_cast<StreamDecoder*>(decoder)->test_respond(is_ogg) : dynamic_cast<FileDecoder*>(decoder)->test_respond(is_ogg)))
+		return false;
+
+	/*
+	 * waveform summary
+	 */
+
+	printf("testing set_waveform_summary()... ");
+	if(!decoder->set_waveform_summary(256)) {
+		printf("FAILED, returned false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_waveform_summary()... ");
+	if(decoder->get_waveform_summary() != 256) {
+		printf("FAILED, returned %u, expected 256\n", decoder->get_waveform_summary());
+		return false;
+	}
+	printf("OK\n");
+
+	if(!(layer < LAYER_FILE? dynamic_cast<StreamDecoder*>(decoder)->test_respond(is_ogg) : dynamic_cast<FileDecoder*>(decoder)->test_respond(is_ogg)))
+		return false;
+
+	/*
+	 * write batching
+	 */
+
+	printf("testing set_write_batch_size()... ");
+	if(!decoder->set_write_batch_size(8192)) {
+		printf("FAILED, returned false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_write_batch_size()... ");
+	if(decoder->get_write_batch_size() != 8192) {
+		printf("FAILED, returned %u, expected 8192\n", decoder->get_write_batch_size());
+		return false;
+	}
+	printf("OK\n");
+
+	if(!(layer < LAYER_FILE? dynamic_cast<StreamDecoder*>(decoder)->test_respond(is_ogg) : dynamic_cast<FileDecoder*>(decoder)->test_respond(is_ogg)))
+		return false;
+
+	/*
+	 * read size
+	 */
+
+	printf("testing set_read_size()... ");
+	if(!decoder->set_read_size(10000)) {
+		printf("FAILED, returned false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_read_size()... ");
+	if(decoder->get_read_size() != 10000) {
+		printf("FAILED, returned %u, expected 10000\n", decoder->get_read_size());
+		return false;
+	}
+	printf("OK\n");
+
+	if(!(layer < LAYER_FILE? dynamic_cast<StreamDecoder*>(decoder)->test_respond(is_ogg) : dynamic_cast<FileDecoder*>(decoder)->test_respond(is_ogg)))
+		return false;
+
+	/*
+	 * thread pool
+	 */
+
+	printf("testing FLAC__thread_pool_new()... ");
+	if(0 == (pool = ::FLAC__thread_pool_new(2, 0))) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing set_thread_pool()... ");
+	if(!decoder->set_thread_pool(pool)) {
+		printf("FAILED, returned false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_thread_pool()... ");
+	if(decoder->get_thread_pool() != pool) {
+		printf("FAILED, returned wrong pool\n");
+		return false;
+	}
+	printf("OK\n");
+
+	if(!(layer < LAYER_FILE? dynamic_cast<StreamDecoder*>(decoder)->test_respond(is_ogg) : dynamic_cast<FileDecoder*>(decoder)->test_respond(is_ogg)))
+		return false;
+
+	printf("testing FLAC__thread_pool_delete()... ");
+	::FLAC__thread_pool_delete(pool);
+	printf("OK\n");
+
 	/*
 	 * respond all
 	 */
@@ -90,9 +90,11 @@ class StreamEncoder : public FLAC::Encoder::Stream {
 public:
 	Layer layer_;
 	FILE *file_;
+	FLAC__byte *frame_buffer_;
+	size_t frame_buffer_size_;
 
-	StreamEncoder(Layer layer): FLAC::Encoder::Stream(), layer_(layer), file_(0) { }
-	~StreamEncoder() { }
+	StreamEncoder(Layer layer): FLAC::Encoder::Stream(), layer_(layer), file_(0), frame_buffer_(0), frame_buffer_size_(0) { }
+	~StreamEncoder() { free(frame_buffer_); }
 
 	// from FLAC::Encoder::Stream
 	::FLAC__StreamEncoderReadStatus read_callback(FLAC__byte buffer[], size_t *bytes);
@@ -100,6 +102,8 @@ public:
 	::FLAC__StreamEncoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset);
 	::FLAC__StreamEncoderTellStatus tell_callback(FLAC__uint64 *absolute_byte_offset);
 	void metadata_callback(const ::FLAC__StreamMetadata *metadata);
+	FLAC__byte *reserve_callback(size_t max_bytes);
+	::FLAC__StreamEncoderWriteStatus commit_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame);
 };
 
 ::FLAC__StreamEncoderReadStatus StreamEncoder::read_callback(FLAC__byte buffer[], size_t *bytes)
@@ -127,6 +131,25 @@ public:
 		return ::FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
 }
 
+FLAC__byte *StreamEncoder::reserve_callback(size_t max_bytes)
+{
+	if(max_bytes > frame_buffer_size_) {
+		free(frame_buffer_);
+		frame_buffer_size_ = 0;
+		if(0 == (frame_buffer_ = (FLAC__byte*)malloc(max_bytes)))
+			return 0;
+		frame_buffer_size_ = max_bytes;
+	}
+	return frame_buffer_;
+}
+
+::FLAC__StreamEncoderWriteStatus StreamEncoder::commit_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame)
+{
+	if(buffer != frame_buffer_ || bytes > frame_buffer_size_ || samples == 0)
+		return ::FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	return write_callback(buffer, bytes, samples, current_frame);
+}
+
 ::FLAC__StreamEncoderSeekStatus StreamEncoder::seek_callback(FLAC__uint64 absolute_byte_offset)
 {
 	if(layer_==LAYER_STREAM)
@@ -183,6 +206,7 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 {
 	FLAC::Encoder::Stream *encoder;
 	::FLAC__StreamEncoderInitStatus init_status;
+	::FLAC__ThreadPool *pool;
 	FILE *file = 0;
 	FLAC__int32 samples[1024];
 	FLAC__int32 *samples_array[1] = { samples };
@@ -247,6 +271,11 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing set_variable_blocksize()... ");
+	if(!encoder->set_variable_blocksize(true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing set_do_mid_side_stereo()... ");
 	if(!encoder->set_do_mid_side_stereo(false))
 		return die_s_("returned false", encoder);
@@ -257,6 +286,11 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing set_adaptive_apodization()... ");
+	if(!encoder->set_adaptive_apodization(true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing set_max_lpc_order()... ");
 	if(!encoder->set_max_lpc_order(0))
 		return die_s_("returned false", encoder);
@@ -282,6 +316,16 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing set_prune_model_search()... ");
+	if(!encoder->set_prune_model_search(true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing set_quiet_signal_bits()... ");
+	if(!encoder->set_quiet_signal_bits(2))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing set_min_residual_partition_order()... ");
 	if(!encoder->set_min_residual_partition_order(0))
 		return die_s_("returned false", encoder);
@@ -297,6 +341,11 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing set_time_budget()... ");
+	if(!encoder->set_time_budget(50))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing set_total_samples_estimate()... ");
 	if(!encoder->set_total_samples_estimate(streaminfo_.data.stream_info.total_samples))
 		return die_s_("returned false", encoder);
@@ -307,6 +356,45 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__thread_pool_new()... ");
+	if(0 == (pool = ::FLAC__thread_pool_new(2, 0))) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing set_thread_pool()... ");
+	if(!encoder->set_thread_pool(pool))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing set_parallel_subframes()... ");
+	if(!encoder->set_parallel_subframes(true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing set_parallel_apodizations()... ");
+	if(!encoder->set_parallel_apodizations(true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing set_write_buffer_size()... ");
+	if(!encoder->set_write_buffer_size(1u << 20))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing set_async_write()... ");
+	if(!encoder->set_async_write(true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	if(layer == LAYER_SEEKABLE_STREAM && !is_ogg) {
+		printf("testing set_frame_buffer_output()... ");
+		if(!encoder->set_frame_buffer_output(true))
+			return die_s_("returned false", encoder);
+		printf("OK\n");
+	}
+
 	if(layer < LAYER_FILENAME) {
 		printf("opening file for FLAC output... ");
 		file = ::fopen(flacfilename(is_ogg), "w+b");
@@ -422,6 +510,20 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing get_variable_blocksize()... ");
+	if(encoder->get_variable_blocksize() != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_adaptive_apodization()... ");
+	if(encoder->get_adaptive_apodization() != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
 	printf("testing get_max_lpc_order()... ");
 	if(encoder->get_max_lpc_order() != 0) {
 		printf("FAILED, expected %u, got %u\n", 0, encoder->get_max_lpc_order());
@@ -455,6 +557,20 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing get_prune_model_search()... ");
+	if(encoder->get_prune_model_search() != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_quiet_signal_bits()... ");
+	if(encoder->get_quiet_signal_bits() != 2) {
+		printf("FAILED, expected %u, got %u\n", 2, encoder->get_quiet_signal_bits());
+		return false;
+	}
+	printf("OK\n");
+
 	printf("testing get_min_residual_partition_order()... ");
 	if(encoder->get_min_residual_partition_order() != 0) {
 		printf("FAILED, expected %u, got %u\n", 0, encoder->get_min_residual_partition_order());
@@ -476,6 +592,13 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing get_time_budget()... ");
+	if(encoder->get_time_budget() != 50) {
+		printf("FAILED, expected %u, got %u\n", 50, encoder->get_time_budget());
+		return false;
+	}
+	printf("OK\n");
+
 	printf("testing get_total_samples_estimate()... ");
 	if(encoder->get_total_samples_estimate() != streaminfo_.data.stream_info.total_samples) {
 #ifdef _MSC_VER
@@ -487,6 +610,48 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing get_thread_pool()... ");
+	if(encoder->get_thread_pool() != pool) {
+		printf("FAILED, returned wrong pool\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_parallel_subframes()... ");
+	if(encoder->get_parallel_subframes() != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_parallel_apodizations()... ");
+	if(encoder->get_parallel_apodizations() != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_write_buffer_size()... ");
+	if(encoder->get_write_buffer_size() != 1u << 20) {
+		printf("FAILED, expected %u, got %u\n", 1u << 20, encoder->get_write_buffer_size());
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_async_write()... ");
+	if(encoder->get_async_write() != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing get_workspace_bytes()... ");
+	if(encoder->get_workspace_bytes() == 0) {
+		printf("FAILED, expected a workspace after init\n");
+		return false;
+	}
+	printf("OK\n");
+
 	/* init the dummy sample buffer */
 	for(i = 0; i < sizeof(samples) / sizeof(FLAC__int32); i++)
 		samples[i] = i & 7;
@@ -516,11 +681,128 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 	delete encoder;
 	printf("OK\n");
 
+	printf("testing FLAC__thread_pool_delete()... ");
+	::FLAC__thread_pool_delete(pool);
+	printf("OK\n");
+
 	printf("\nPASSED!\n");
 
 	return true;
 }
 
+// Fails every write once 'fail_' is set, to make finish() fail
+class FailingStreamEncoder : public FLAC::Encoder::Stream {
+public:
+	bool fail_;
+
+	FailingStreamEncoder(): FLAC::Encoder::Stream(), fail_(false) { }
+	~FailingStreamEncoder() { }
+
+	// from FLAC::Encoder::Stream
+	::FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame)
+	{
+		(void)buffer, (void)bytes, (void)samples, (void)current_frame;
+		return fail_? ::FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR : ::FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	}
+};
+
+static bool test_encoder_pool()
+{
+	FLAC__int32 samples[1024];
+	unsigned i;
+
+	printf("\n+++ libFLAC++ unit test: FLAC::Encoder::Pool\n\n");
+
+	for(i = 0; i < sizeof(samples) / sizeof(FLAC__int32); i++)
+		samples[i] = (FLAC__int32)(i % 61) - 30;
+
+	FLAC::Encoder::Pool<FLAC::Encoder::File> pool(1);
+	FLAC::Encoder::File *first = 0;
+
+	for(i = 0; i < 2; i++) {
+		printf("testing Pool::acquire()... ");
+		FLAC::Encoder::File *encoder = pool.acquire();
+		if(0 == encoder)
+			return die_("returned NULL");
+		if(i > 0 && (encoder != first || pool.get_idle_count() != 0)) {
+			printf("FAILED, did not hand back the released encoder\n");
+			return false;
+		}
+		first = encoder;
+		printf("OK\n");
+
+		printf("testing encoding with a pooled encoder... ");
+		if(!encoder->set_channels(1) || !encoder->set_verify(true))
+			return die_s_("setting encoder parameters", encoder);
+		if(encoder->init(flacfilename(/*is_ogg=*/false)) != ::FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+			return die_s_("init failed", encoder);
+		if(!encoder->process_interleaved(samples, sizeof(samples) / sizeof(FLAC__int32)))
+			return die_s_("process failed", encoder);
+		printf("OK\n");
+
+		printf("testing Pool::release()... ");
+		pool.release(encoder);
+		if(pool.get_idle_count() != 1) {
+			printf("FAILED, expected 1 idle encoder, got %u\n", pool.get_idle_count());
+			return false;
+		}
+		printf("OK\n");
+	}
+
+	printf("testing Pool::release() on a full pool... ");
+	pool.release(new FLAC::Encoder::File());
+	if(pool.get_idle_count() != 1) {
+		printf("FAILED, expected 1 idle encoder, got %u\n", pool.get_idle_count());
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing Pool::clear()... ");
+	pool.clear();
+	if(pool.get_idle_count() != 0) {
+		printf("FAILED, expected 0 idle encoders, got %u\n", pool.get_idle_count());
+		return false;
+	}
+	printf("OK\n");
+
+	FLAC::Encoder::Pool<FailingStreamEncoder> failing_pool(1);
+
+	for(i = 0; i < 2; i++) {
+		FailingStreamEncoder *encoder = failing_pool.acquire();
+		if(0 == encoder)
+			return die_("returned NULL");
+		if(!encoder->set_channels(1))
+			return die_s_("setting encoder parameters", encoder);
+		if(encoder->init() != ::FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+			return die_s_("init failed", encoder);
+		/* less than a block, so the frame is only written by finish() */
+		if(!encoder->process_interleaved(samples, sizeof(samples) / sizeof(FLAC__int32)))
+			return die_s_("process failed", encoder);
+
+		if(i == 0) {
+			printf("testing Pool::release() when finish() fails... ");
+			encoder->fail_ = true;
+			failing_pool.release(encoder);
+			if(failing_pool.get_idle_count() != 0) {
+				printf("FAILED, kept the encoder that failed to finish\n");
+				return false;
+			}
+		}
+		else {
+			printf("testing Pool::acquire() after that... ");
+			failing_pool.release(encoder);
+			if(failing_pool.get_idle_count() != 1) {
+				printf("FAILED, expected 1 idle encoder, got %u\n", failing_pool.get_idle_count());
+				return false;
+			}
+		}
+		printf("OK\n");
+	}
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
 bool test_encoders()
 {
 	FLAC__bool is_ogg = false;
@@ -540,6 +822,9 @@ bool test_encoders()
 		if(!test_stream_encoder(LAYER_FILENAME, is_ogg))
 			return false;
 
+		if(!is_ogg && !test_encoder_pool())
+			return false;
+
 		(void) grabbag__file_remove_file(flacfilename(is_ogg));
 
 		free_metadata_blocks_();
@@ -38,7 +38,11 @@
  * the definition here to get at the internals.  Make sure this is kept up
  * to date with what is in ../libFLAC/bitwriter.c
  */
+#if FLAC__BITWRITER_64BIT_WORDS
+typedef FLAC__uint64 bwword;
+#else
 typedef FLAC__uint32 bwword;
+#endif
 
 struct FLAC__BitWriter {
 	bwword *buffer;
@@ -46,21 +50,45 @@ struct FLAC__BitWriter {
 	unsigned capacity; /* of buffer in words */
 	unsigned words; /* # of complete words in buffer */
 	unsigned bits; /* # of used bits in accum */
+	unsigned swapped_words; /* # of words at the start of buffer already swapped to big-endian */
+	bwword *own_buffer; /* while a caller's buffer is attached, our own buffer is kept here; else 0 */
+	unsigned own_capacity;
 };
 
 #define TOTAL_BITS(bw) ((bw)->words*sizeof(bwword)*8 + (bw)->bits)
 
+/* compares the first 'bytes' bytes of the byte-aligned output against the big-endian 'val' */
+static FLAC__bool buffer_matches_(FLAC__BitWriter *bw, FLAC__uint64 val, unsigned bytes)
+{
+	const FLAC__byte *buffer;
+	size_t n;
+	unsigned i;
+	FLAC__bool ok;
+
+	if(!FLAC__bitwriter_get_buffer(bw, &buffer, &n))
+		return false;
+	ok = (n == bytes);
+	for(i = 0; ok && i < bytes; i++)
+		ok = (buffer[i] == (FLAC__byte)(val >> ((bytes-1-i)*8)));
+	FLAC__bitwriter_release_buffer(bw);
+	return ok;
+}
+
 
 FLAC__bool test_bitwriter(void)
 {
 	FLAC__BitWriter *bw;
 	FLAC__bool ok;
 	unsigned i, j;
-#if WORDS_BIGENDIAN
-	static bwword test_pattern1[5] = { 0xaaf0aabe, 0xaaaaaaa8, 0x300aaaaa, 0xaaadeadb, 0x00eeface };
+	/* the words stay in host byte order until FLAC__bitwriter_get_buffer() */
+#if FLAC__BITWRITER_64BIT_WORDS
+	static bwword test_pattern1[3] = { FLAC__U64L(0xaaf0aabeaaaaaaa8), FLAC__U64L(0x300aaaaaaaadeadb), 0x00eeface };
 #else
-	static bwword test_pattern1[5] = { 0xbeaaf0aa, 0xa8aaaaaa, 0xaaaa0a30, 0xdbeaadaa, 0x00eeface };
+	static bwword test_pattern1[5] = { 0xaaf0aabe, 0xaaaaaaa8, 0x300aaaaa, 0xaaadeadb, 0x00eeface };
 #endif
+	static const FLAC__byte test_bytes1[19] = { 0xaa, 0xf0, 0xaa, 0xbe, 0xaa, 0xaa, 0xaa, 0xa8, 0x30, 0x0a, 0xaa, 0xaa, 0xaa, 0xad, 0xea, 0xdb, 0xee, 0xfa, 0xce };
+	const FLAC__byte *buffer;
+	size_t bytes;
 	unsigned words, bits; /* what we think bw->words and bw->bits should be */
 
 	printf("\n+++ libFLAC unit test: bitwriter\n\n");
@@ -179,7 +207,7 @@ FLAC__bool test_bitwriter(void)
 		FLAC__bitwriter_dump(bw, stdout);
 		return false;
 	}
-	words = 4;
+	words = 152 / (sizeof(bwword)*8);
 	bits = 24;
 	if(bw->words != words) {
 		printf("FAILED byte count %u != %u\n", bw->words, words);
@@ -197,13 +225,35 @@ FLAC__bool test_bitwriter(void)
 		return false;
 	}
 	if((bw->accum & 0x00ffffff) != test_pattern1[words]) {
-		printf("FAILED pattern match (bw->accum=%08X != %08X)\n", bw->accum&0x00ffffff, test_pattern1[words]);
+		printf("FAILED pattern match (bw->accum=%08X != %08X)\n", (unsigned)(bw->accum&0x00ffffff), (unsigned)test_pattern1[words]);
 		FLAC__bitwriter_dump(bw, stdout);
 		return false;
 	}
 	printf("OK\n");
 	FLAC__bitwriter_dump(bw, stdout);
 
+	printf("testing get_buffer... ");
+	ok = FLAC__bitwriter_get_buffer(bw, &buffer, &bytes);
+	if(!ok) {
+		printf("FAILED\n");
+		FLAC__bitwriter_dump(bw, stdout);
+		return false;
+	}
+	if(bytes != sizeof(test_bytes1) || memcmp(buffer, test_bytes1, bytes) != 0) {
+		printf("FAILED pattern match (buffer)\n");
+		FLAC__bitwriter_dump(bw, stdout);
+		return false;
+	}
+	FLAC__bitwriter_release_buffer(bw);
+	if(bw->swapped_words != words) {
+		printf("FAILED swapped word count %u != %u\n", bw->swapped_words, words);
+		FLAC__bitwriter_dump(bw, stdout);
+		return false;
+	}
+	/* the complete words are big-endian in the buffer from now on */
+	memcpy(test_pattern1, buffer, sizeof(bwword)*words);
+	printf("OK\n");
+
 	printf("testing raw_uint32 some more... ");
 	ok = FLAC__bitwriter_write_raw_uint32(bw, 0x3d, 6);
 	if(!ok) {
@@ -230,7 +280,7 @@ FLAC__bool test_bitwriter(void)
 		return false;
 	}
 	if((bw->accum & 0x3fffffff) != test_pattern1[words]) {
-		printf("FAILED pattern match (bw->accum=%08X != %08X)\n", bw->accum&0x3fffffff, test_pattern1[words]);
+		printf("FAILED pattern match (bw->accum=%08X != %08X)\n", (unsigned)(bw->accum&0x3fffffff), (unsigned)test_pattern1[words]);
 		FLAC__bitwriter_dump(bw, stdout);
 		return false;
 	}
@@ -300,11 +350,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint32(0x00010000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint32(bw, 0x00010000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0xF0908080;
-#else
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0x808090F0;
-#endif
+	ok = TOTAL_BITS(bw) == 32 && buffer_matches_(bw, 0xF0908080, 4);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -314,11 +360,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint32(0x001FFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint32(bw, 0x001FFFFF);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0xF7BFBFBF;
-#else
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0xBFBFBFF7;
-#endif
+	ok = TOTAL_BITS(bw) == 32 && buffer_matches_(bw, 0xF7BFBFBF, 4);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -328,11 +370,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint32(0x00200000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint32(bw, 0x00200000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0xF8888080 && (bw->accum & 0xff) == 0x80;
-#else
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0x808088F8 && (bw->accum & 0xff) == 0x80;
-#endif
+	ok = TOTAL_BITS(bw) == 40 && buffer_matches_(bw, FLAC__U64L(0xF888808080), 5);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -342,11 +380,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint32(0x03FFFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint32(bw, 0x03FFFFFF);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0xFBBFBFBF && (bw->accum & 0xff) == 0xBF;
-#else
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0xBFBFBFFB && (bw->accum & 0xff) == 0xBF;
-#endif
+	ok = TOTAL_BITS(bw) == 40 && buffer_matches_(bw, FLAC__U64L(0xFBBFBFBFBF), 5);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -356,11 +390,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint32(0x04000000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint32(bw, 0x04000000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0xFC848080 && (bw->accum & 0xffff) == 0x8080;
-#else
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0x808084FC && (bw->accum & 0xffff) == 0x8080;
-#endif
+	ok = TOTAL_BITS(bw) == 48 && buffer_matches_(bw, FLAC__U64L(0xFC8480808080), 6);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -370,11 +400,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint32(0x7FFFFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint32(bw, 0x7FFFFFFF);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0xFDBFBFBF && (bw->accum & 0xffff) == 0xBFBF;
-#else
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0xBFBFBFFD && (bw->accum & 0xffff) == 0xBFBF;
-#endif
+	ok = TOTAL_BITS(bw) == 48 && buffer_matches_(bw, FLAC__U64L(0xFDBFBFBFBFBF), 6);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -444,11 +470,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x0000000000010000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x0000000000010000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0xF0908080;
-#else
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0x808090F0;
-#endif
+	ok = TOTAL_BITS(bw) == 32 && buffer_matches_(bw, 0xF0908080, 4);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -458,11 +480,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x00000000001FFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x00000000001FFFFF);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0xF7BFBFBF;
-#else
-	ok = TOTAL_BITS(bw) == 32 && bw->buffer[0] == 0xBFBFBFF7;
-#endif
+	ok = TOTAL_BITS(bw) == 32 && buffer_matches_(bw, 0xF7BFBFBF, 4);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -472,11 +490,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x0000000000200000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x0000000000200000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0xF8888080 && (bw->accum & 0xff) == 0x80;
-#else
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0x808088F8 && (bw->accum & 0xff) == 0x80;
-#endif
+	ok = TOTAL_BITS(bw) == 40 && buffer_matches_(bw, FLAC__U64L(0xF888808080), 5);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -486,11 +500,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x0000000003FFFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x0000000003FFFFFF);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0xFBBFBFBF && (bw->accum & 0xff) == 0xBF;
-#else
-	ok = TOTAL_BITS(bw) == 40 && bw->buffer[0] == 0xBFBFBFFB && (bw->accum & 0xff) == 0xBF;
-#endif
+	ok = TOTAL_BITS(bw) == 40 && buffer_matches_(bw, FLAC__U64L(0xFBBFBFBFBF), 5);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -500,11 +510,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x0000000004000000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x0000000004000000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0xFC848080 && (bw->accum & 0xffff) == 0x8080;
-#else
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0x808084FC && (bw->accum & 0xffff) == 0x8080;
-#endif
+	ok = TOTAL_BITS(bw) == 48 && buffer_matches_(bw, FLAC__U64L(0xFC8480808080), 6);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -514,11 +520,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x000000007FFFFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x000000007FFFFFFF);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0xFDBFBFBF && (bw->accum & 0xffff) == 0xBFBF;
-#else
-	ok = TOTAL_BITS(bw) == 48 && bw->buffer[0] == 0xBFBFBFFD && (bw->accum & 0xffff) == 0xBFBF;
-#endif
+	ok = TOTAL_BITS(bw) == 48 && buffer_matches_(bw, FLAC__U64L(0xFDBFBFBFBFBF), 6);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -528,11 +530,7 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x0000000080000000)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, 0x0000000080000000);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 56 && bw->buffer[0] == 0xFE828080 && (bw->accum & 0xffffff) == 0x808080;
-#else
-	ok = TOTAL_BITS(bw) == 56 && bw->buffer[0] == 0x808082FE && (bw->accum & 0xffffff) == 0x808080;
-#endif
+	ok = TOTAL_BITS(bw) == 56 && buffer_matches_(bw, FLAC__U64L(0xFE828080808080), 7);
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -542,11 +540,36 @@ FLAC__bool test_bitwriter(void)
 	printf("testing utf8_uint64(0x0000000FFFFFFFFF)... ");
 	FLAC__bitwriter_clear(bw);
 	FLAC__bitwriter_write_utf8_uint64(bw, FLAC__U64L(0x0000000FFFFFFFFF));
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == 56 && bw->buffer[0] == 0xFEBFBFBF && (bw->accum & 0xffffff) == 0xBFBFBF;
-#else
-	ok = TOTAL_BITS(bw) == 56 && bw->buffer[0] == 0xBFBFBFFE && (bw->accum & 0xffffff) == 0xBFBFBF;
-#endif
+	ok = TOTAL_BITS(bw) == 56 && buffer_matches_(bw, FLAC__U64L(0xFEBFBFBFBFBFBF), 7);
+	printf("%s\n", ok?"OK":"FAILED");
+	if(!ok) {
+		FLAC__bitwriter_dump(bw, stdout);
+		return false;
+	}
+
+	printf("testing attach_buffer... ");
+	FLAC__bitwriter_clear(bw);
+	{
+		bwword external[4];
+		ok = FLAC__bitwriter_attach_buffer(bw, (FLAC__byte*)external, sizeof(external)) &&
+			bw->buffer == external &&
+			FLAC__bitwriter_write_raw_uint32(bw, 0xdeadbeef, 32) &&
+			FLAC__bitwriter_write_raw_uint32(bw, 0xface, 16) &&
+			FLAC__bitwriter_get_buffer(bw, &buffer, &bytes) &&
+			buffer == (const FLAC__byte*)external &&
+			bytes == 6 && memcmp(buffer, "\xde\xad\xbe\xef\xfa\xce", 6) == 0;
+		if(ok) {
+			FLAC__bitwriter_release_buffer(bw);
+			/* the attached buffer must not grow */
+			for(i = 0; ok && i < 4*sizeof(bwword); i++)
+				ok = FLAC__bitwriter_write_raw_uint32(bw, 0xaa, 8);
+			ok = !ok;
+		}
+		if(ok) {
+			FLAC__bitwriter_detach_buffer(bw);
+			ok = bw->buffer != external && TOTAL_BITS(bw) == 0;
+		}
+	}
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
@@ -559,11 +582,7 @@ FLAC__bool test_bitwriter(void)
 	j = bw->capacity;
 	for(i = 0; i < j; i++)
 		FLAC__bitwriter_write_raw_uint32(bw, 0xaaaaaaaa, 32);
-#if WORDS_BIGENDIAN
-	ok = TOTAL_BITS(bw) == i*32+4 && bw->buffer[0] == 0x5aaaaaaa && (bw->accum & 0xf) == 0xa;
-#else
-	ok = TOTAL_BITS(bw) == i*32+4 && bw->buffer[0] == 0xaaaaaa5a && (bw->accum & 0xf) == 0xa;
-#endif
+	ok = TOTAL_BITS(bw) == i*32+4 && (bw->buffer[0] >> (sizeof(bwword)*8-32)) == 0x5aaaaaaa && (bw->accum & 0xf) == 0xa;
 	printf("%s\n", ok?"OK":"FAILED");
 	if(!ok) {
 		FLAC__bitwriter_dump(bw, stdout);
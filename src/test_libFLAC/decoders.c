@@ -33,6 +33,7 @@
 #include "decoders.h"
 #include "FLAC/assert.h"
 #include "FLAC/stream_decoder.h"
+#include "FLAC/stream_encoder.h"
 #include "share/grabbag.h"
 #include "test_libs_common/file_utils_flac.h"
 #include "test_libs_common/metadata_utils.h"
@@ -388,6 +389,7 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg)
 	FLAC__StreamDecoderInitStatus init_status;
 	FLAC__StreamDecoderState state;
 	StreamDecoderClientData decoder_client_data;
+	FLAC__ThreadPool *pool;
 	FLAC__bool expect;
 
 	decoder_client_data.layer = layer;
@@ -650,6 +652,131 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", decoder);
 	printf("OK\n");
 
+	/*
+	 * CRC check only
+	 */
+
+	printf("testing FLAC__stream_decoder_set_crc_check_only()... ");
+	if(!FLAC__stream_decoder_set_crc_check_only(decoder, true))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_get_crc_check_only()... ");
+	if(!FLAC__stream_decoder_get_crc_check_only(decoder)) {
+		printf("FAILED, returned false, expected true\n");
+		return false;
+	}
+	printf("OK\n");
+
+	if(!stream_decoder_test_respond_(decoder, &decoder_client_data, is_ogg))
+		return false;
+
+	/*
+	 * partial channel mask
+	 */
+
+	printf("testing FLAC__stream_decoder_set_channel_mask()... ");
+	if(!FLAC__stream_decoder_set_channel_mask(decoder, 0x1))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_get_channel_mask()... ");
+	if(FLAC__stream_decoder_get_channel_mask(decoder) != 0x1) {
+		printf("FAILED, returned 0x%x, expected 0x1\n", (unsigned)FLAC__stream_decoder_get_channel_mask(decoder));
+		return false;
+	}
+	printf("OK\n");
+
+	if(!stream_decoder_test_respond_(decoder, &decoder_client_data, is_ogg))
+		return false;
+
+	/*
+	 * waveform summary
+	 */
+
+	printf("testing FLAC__stream_decoder_set_waveform_summary()... ");
+	if(!FLAC__stream_decoder_set_waveform_summary(decoder, 256))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_get_waveform_summary()... ");
+	if(FLAC__stream_decoder_get_waveform_summary(decoder) != 256) {
+		printf("FAILED, returned %u, expected 256\n", FLAC__stream_decoder_get_waveform_summary(decoder));
+		return false;
+	}
+	printf("OK\n");
+
+	if(!stream_decoder_test_respond_(decoder, &decoder_client_data, is_ogg))
+		return false;
+
+	/*
+	 * write batching
+	 */
+
+	printf("testing FLAC__stream_decoder_set_write_batch_size()... ");
+	if(!FLAC__stream_decoder_set_write_batch_size(decoder, 8192))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_get_write_batch_size()... ");
+	if(FLAC__stream_decoder_get_write_batch_size(decoder) != 8192) {
+		printf("FAILED, returned %u, expected 8192\n", FLAC__stream_decoder_get_write_batch_size(decoder));
+		return false;
+	}
+	printf("OK\n");
+
+	if(!stream_decoder_test_respond_(decoder, &decoder_client_data, is_ogg))
+		return false;
+
+	/*
+	 * read size
+	 */
+
+	printf("testing FLAC__stream_decoder_set_read_size()... ");
+	if(!FLAC__stream_decoder_set_read_size(decoder, 10000))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_get_read_size()... ");
+	if(FLAC__stream_decoder_get_read_size(decoder) != 10000) {
+		printf("FAILED, returned %u, expected 10000\n", FLAC__stream_decoder_get_read_size(decoder));
+		return false;
+	}
+	printf("OK\n");
+
+	if(!stream_decoder_test_respond_(decoder, &decoder_client_data, is_ogg))
+		return false;
+
+	/*
+	 * thread pool
+	 */
+
+	printf("testing FLAC__thread_pool_new()... ");
+	if(0 == (pool = FLAC__thread_pool_new(2, 0))) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_set_thread_pool()... ");
+	if(!FLAC__stream_decoder_set_thread_pool(decoder, pool))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_get_thread_pool()... ");
+	if(FLAC__stream_decoder_get_thread_pool(decoder) != pool) {
+		printf("FAILED, returned wrong pool\n");
+		return false;
+	}
+	printf("OK\n");
+
+	if(!stream_decoder_test_respond_(decoder, &decoder_client_data, is_ogg))
+		return false;
+
+	printf("testing FLAC__thread_pool_delete()... ");
+	FLAC__thread_pool_delete(pool);
+	printf("OK\n");
+
 	/*
 	 * respond all
 	 */
@@ -1013,6 +1140,654 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg)
 	return true;
 }
 
+/*
+ * The tests below check what the decoding modes actually deliver.  They
+ * encode a known signal into memory and decode it from there, so that
+ * the stream can be altered and the result compared with a plain decode.
+ */
+
+#define MEMORY_STREAM_MAX_FRAMES_ 64
+
+typedef struct {
+	FLAC__byte *data;
+	size_t bytes, capacity;
+	size_t position;
+	size_t read_chunk;                                /* if non-zero, the most the read callback returns at a time */
+	size_t abort_after;                               /* if non-zero, the read callback aborts once this much has been read */
+	unsigned num_frames;
+	size_t frame_end[MEMORY_STREAM_MAX_FRAMES_];      /* offset just past each frame */
+} memory_stream_;
+
+typedef struct {
+	memory_stream_ *stream;
+	unsigned channels;
+	FLAC__uint64 total_samples;
+	FLAC__int32 *pcm[FLAC__MAX_CHANNELS];             /* the decoded signal, by sample number */
+	FLAC__int32 *summary[FLAC__MAX_CHANNELS];         /* in waveform summary mode, the min/max/RMS triples in the order received */
+	unsigned summary_bucket, summary_values;
+	unsigned write_calls, writes_with_signal;
+	unsigned blocksize[MEMORY_STREAM_MAX_FRAMES_];    /* frame->header.blocksize of each write call */
+	FLAC__uint64 sample_number[MEMORY_STREAM_MAX_FRAMES_];
+	unsigned error_calls;
+	FLAC__StreamDecoderErrorStatus last_error;
+} memory_decode_;
+
+static FLAC__StreamEncoderWriteStatus memory_encoder_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
+{
+	memory_stream_ *stream = (memory_stream_*)client_data;
+	(void)encoder, (void)current_frame;
+	if(stream->bytes + bytes > stream->capacity) {
+		size_t capacity = (stream->bytes + bytes) * 2;
+		FLAC__byte *data = (FLAC__byte*)realloc(stream->data, capacity);
+		if(0 == data)
+			return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+		stream->data = data;
+		stream->capacity = capacity;
+	}
+	memcpy(stream->data + stream->bytes, buffer, bytes);
+	stream->bytes += bytes;
+	/* each frame comes in a single write */
+	if(samples > 0 && stream->num_frames < MEMORY_STREAM_MAX_FRAMES_)
+		stream->frame_end[stream->num_frames++] = stream->bytes;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__int32 test_signal_(unsigned channel, unsigned i)
+{
+	/* a different sawtooth in each channel, plus a little noise, so that the channels can't be mixed up */
+	return (FLAC__int32)((i * (channel * 2 + 3)) % 997) - 498 + (FLAC__int32)(((i * 2654435761u) >> 24) & 15) + (FLAC__int32)channel * 1000;
+}
+
+static FLAC__bool encode_memory_stream_(memory_stream_ *stream, unsigned channels, unsigned blocksize, unsigned samples)
+{
+	FLAC__StreamEncoder *encoder;
+	FLAC__int32 buffer[FLAC__MAX_CHANNELS * 1000];
+	unsigned i, n, channel, done;
+	FLAC__bool ok = true;
+
+	memset(stream, 0, sizeof(*stream));
+	if(0 == (encoder = FLAC__stream_encoder_new()))
+		return die_("FLAC__stream_encoder_new() returned NULL");
+	ok = ok && FLAC__stream_encoder_set_channels(encoder, channels);
+	ok = ok && FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	ok = ok && FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+	ok = ok && FLAC__stream_encoder_set_compression_level(encoder, 5);
+	ok = ok && FLAC__stream_encoder_set_blocksize(encoder, blocksize);
+	ok = ok && FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	ok = ok && FLAC__stream_encoder_init_stream(encoder, memory_encoder_write_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*metadata_callback=*/0, stream) == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+	for(done = 0; ok && done < samples; done += n) {
+		n = samples - done < 1000? samples - done : 1000;
+		for(i = 0; i < n; i++)
+			for(channel = 0; channel < channels; channel++)
+				buffer[i * channels + channel] = test_signal_(channel, done + i);
+		ok = FLAC__stream_encoder_process_interleaved(encoder, buffer, n);
+	}
+	ok = FLAC__stream_encoder_finish(encoder) && ok;
+	FLAC__stream_encoder_delete(encoder);
+	if(!ok)
+		return die_("encoding the test stream");
+	return true;
+}
+
+static FLAC__StreamDecoderReadStatus memory_decoder_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	memory_stream_ *stream = ((memory_decode_*)client_data)->stream;
+	size_t n = stream->bytes - stream->position;
+	(void)decoder;
+	if(stream->abort_after > 0 && stream->position >= stream->abort_after)
+		return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+	if(n == 0) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	if(stream->read_chunk > 0 && n > stream->read_chunk)
+		n = stream->read_chunk;
+	if(n > *bytes)
+		n = *bytes;
+	memcpy(buffer, stream->data + stream->position, n);
+	stream->position += n;
+	*bytes = n;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderSeekStatus memory_decoder_seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	memory_stream_ *stream = ((memory_decode_*)client_data)->stream;
+	(void)decoder;
+	if(absolute_byte_offset > stream->bytes)
+		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+	stream->position = (size_t)absolute_byte_offset;
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+static FLAC__StreamDecoderTellStatus memory_decoder_tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	(void)decoder;
+	*absolute_byte_offset = ((memory_decode_*)client_data)->stream->position;
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+static FLAC__StreamDecoderLengthStatus memory_decoder_length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
+{
+	(void)decoder;
+	*stream_length = ((memory_decode_*)client_data)->stream->bytes;
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+static FLAC__bool memory_decoder_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data)
+{
+	memory_stream_ *stream = ((memory_decode_*)client_data)->stream;
+	(void)decoder;
+	return stream->position >= stream->bytes;
+}
+
+static FLAC__StreamDecoderWriteStatus memory_decoder_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	memory_decode_ *dcd = (memory_decode_*)client_data;
+	const FLAC__uint64 first = frame->header.number.sample_number;
+	unsigned channel, n;
+	(void)decoder;
+
+	if(frame->header.number_type != FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER || first + frame->header.blocksize > dcd->total_samples)
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	if(dcd->write_calls < MEMORY_STREAM_MAX_FRAMES_) {
+		dcd->blocksize[dcd->write_calls] = frame->header.blocksize;
+		dcd->sample_number[dcd->write_calls] = first;
+	}
+	dcd->write_calls++;
+	if(0 == buffer)
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	dcd->writes_with_signal++;
+	for(channel = 0; channel < frame->header.channels && channel < dcd->channels; channel++) {
+		if(dcd->summary_bucket > 0) {
+			n = 3 * ((frame->header.blocksize + dcd->summary_bucket - 1) / dcd->summary_bucket);
+			memcpy(dcd->summary[channel] + dcd->summary_values, buffer[channel], sizeof(FLAC__int32) * n);
+		}
+		else
+			memcpy(dcd->pcm[channel] + first, buffer[channel], sizeof(FLAC__int32) * frame->header.blocksize);
+	}
+	if(dcd->summary_bucket > 0)
+		dcd->summary_values += 3 * ((frame->header.blocksize + dcd->summary_bucket - 1) / dcd->summary_bucket);
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void memory_decoder_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	memory_decode_ *dcd = (memory_decode_*)client_data;
+	(void)decoder;
+	dcd->error_calls++;
+	dcd->last_error = status;
+}
+
+static FLAC__bool memory_decode_init_(memory_decode_ *dcd, memory_stream_ *stream, unsigned channels, FLAC__uint64 total_samples, unsigned summary_bucket)
+{
+	unsigned channel;
+
+	memset(dcd, 0, sizeof(*dcd));
+	dcd->stream = stream;
+	dcd->channels = channels;
+	dcd->total_samples = total_samples;
+	dcd->summary_bucket = summary_bucket;
+	stream->position = 0;
+	for(channel = 0; channel < channels; channel++) {
+		if(0 == (dcd->pcm[channel] = (FLAC__int32*)calloc((size_t)total_samples, sizeof(FLAC__int32))))
+			return die_("out of memory");
+		/* each bucket becomes 3 values, and each frame can end in one partial bucket */
+		if(summary_bucket > 0 && 0 == (dcd->summary[channel] = (FLAC__int32*)calloc((size_t)(3 * (total_samples / summary_bucket + MEMORY_STREAM_MAX_FRAMES_)), sizeof(FLAC__int32))))
+			return die_("out of memory");
+	}
+	return true;
+}
+
+static void memory_decode_free_(memory_decode_ *dcd)
+{
+	unsigned channel;
+	for(channel = 0; channel < FLAC__MAX_CHANNELS; channel++) {
+		free(dcd->pcm[channel]);
+		free(dcd->summary[channel]);
+	}
+}
+
+static FLAC__bool memory_decoder_init_(FLAC__StreamDecoder *decoder, memory_decode_ *dcd)
+{
+	if(FLAC__stream_decoder_init_stream(decoder, memory_decoder_read_callback_, memory_decoder_seek_callback_, memory_decoder_tell_callback_, memory_decoder_length_callback_, memory_decoder_eof_callback_, memory_decoder_write_callback_, /*metadata_callback=*/0, memory_decoder_error_callback_, dcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_decoder_init_stream() failed", decoder);
+	return true;
+}
+
+/* decodes the whole of 'stream' with the current settings of 'decoder', which is left initialized */
+static FLAC__bool memory_decode_all_(FLAC__StreamDecoder *decoder, memory_decode_ *dcd, memory_stream_ *stream, unsigned channels, FLAC__uint64 samples, unsigned summary_bucket)
+{
+	if(!memory_decode_init_(dcd, stream, channels, samples, summary_bucket))
+		return false;
+	if(!memory_decoder_init_(decoder, dcd))
+		return false;
+	if(!FLAC__stream_decoder_process_until_end_of_stream(decoder))
+		return die_s_("FLAC__stream_decoder_process_until_end_of_stream() returned false", decoder);
+	return true;
+}
+
+static FLAC__bool test_crc_check_only(void)
+{
+	const unsigned samples = 20000, bad_frame = 5;
+	memory_stream_ stream;
+	memory_decode_ dcd;
+	FLAC__StreamDecoder *decoder;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (CRC-check-only mode)\n\n");
+
+	if(!encode_memory_stream_(&stream, 2, 1152, samples))
+		return false;
+	/* the last two bytes of a frame are its CRC-16; flipping one breaks nothing but the check */
+	stream.data[stream.frame_end[bad_frame] - 1] ^= 0x5a;
+
+	if(0 == (decoder = FLAC__stream_decoder_new()))
+		return die_("FLAC__stream_decoder_new() returned NULL");
+
+	printf("testing CRC-check-only decoding of a stream with a corrupted frame... ");
+	if(!FLAC__stream_decoder_set_crc_check_only(decoder, true))
+		return die_s_("FLAC__stream_decoder_set_crc_check_only() returned false", decoder);
+	if(!memory_decode_all_(decoder, &dcd, &stream, 2, samples, 0))
+		return false;
+	/* the write callback still marks each frame, for progress, but never gets any samples */
+	if(dcd.writes_with_signal != 0) {
+		printf("FAILED, %u write callbacks got samples, expected none\n", dcd.writes_with_signal);
+		return false;
+	}
+	if(dcd.write_calls != stream.num_frames) {
+		printf("FAILED, got %u write callbacks for %u frames\n", dcd.write_calls, stream.num_frames);
+		return false;
+	}
+	if(dcd.error_calls != 1 || dcd.last_error != FLAC__STREAM_DECODER_ERROR_STATUS_FRAME_CRC_MISMATCH) {
+		printf("FAILED, got %u error callbacks (last %s), expected one FLAC__STREAM_DECODER_ERROR_STATUS_FRAME_CRC_MISMATCH\n", dcd.error_calls, dcd.error_calls? FLAC__StreamDecoderErrorStatusString[dcd.last_error] : "none");
+		return false;
+	}
+	(void)FLAC__stream_decoder_finish(decoder);
+	memory_decode_free_(&dcd);
+	printf("OK\n");
+
+	printf("testing that only the target frame of a seek is decoded in CRC-check-only mode... ");
+	if(!FLAC__stream_decoder_set_crc_check_only(decoder, true))
+		return die_s_("FLAC__stream_decoder_set_crc_check_only() returned false", decoder);
+	if(!memory_decode_init_(&dcd, &stream, 2, samples, 0) || !memory_decoder_init_(decoder, &dcd))
+		return false;
+	if(!FLAC__stream_decoder_seek_absolute(decoder, 15000))
+		return die_s_("FLAC__stream_decoder_seek_absolute() returned false", decoder);
+	if(!FLAC__stream_decoder_process_single(decoder))
+		return die_s_("FLAC__stream_decoder_process_single() returned false", decoder);
+	if(dcd.write_calls != 2 || dcd.writes_with_signal != 1 || dcd.sample_number[0] != 15000) {
+		printf("FAILED, got %u write callbacks, %u with samples, expected the seek target with samples and then one without\n", dcd.write_calls, dcd.writes_with_signal);
+		return false;
+	}
+	for(i = 15000; i < 15000 + dcd.blocksize[0]; i++) {
+		if(dcd.pcm[0][i] != test_signal_(0, i) || dcd.pcm[1][i] != test_signal_(1, i)) {
+			printf("FAILED, sample %u of the target frame is wrong\n", i);
+			return false;
+		}
+	}
+	(void)FLAC__stream_decoder_finish(decoder);
+	printf("OK\n");
+
+	FLAC__stream_decoder_delete(decoder);
+	memory_decode_free_(&dcd);
+	free(stream.data);
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
+static FLAC__bool test_channel_mask(void)
+{
+	static const struct { unsigned channels; FLAC__uint32 mask; } cases[] = {
+		{ 4, 0x5 }, /* independent channels */
+		{ 2, 0x2 }, /* the right channel alone, which mid/side coding makes depend on the left */
+		{ 2, 0x1 }
+	};
+	const unsigned samples = 20000;
+	unsigned c, channel;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (channel mask)\n\n");
+
+	for(c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		memory_stream_ stream;
+		memory_decode_ full, masked;
+		FLAC__StreamDecoder *decoder;
+
+		if(!encode_memory_stream_(&stream, cases[c].channels, 1152, samples))
+			return false;
+		if(0 == (decoder = FLAC__stream_decoder_new()))
+			return die_("FLAC__stream_decoder_new() returned NULL");
+
+		printf("testing %u-channel stream with channel mask 0x%x... ", cases[c].channels, (unsigned)cases[c].mask);
+		if(!memory_decode_all_(decoder, &full, &stream, cases[c].channels, samples, 0))
+			return false;
+		(void)FLAC__stream_decoder_finish(decoder);
+		if(!FLAC__stream_decoder_set_channel_mask(decoder, cases[c].mask))
+			return die_s_("FLAC__stream_decoder_set_channel_mask() returned false", decoder);
+		if(!memory_decode_all_(decoder, &masked, &stream, cases[c].channels, samples, 0))
+			return false;
+		(void)FLAC__stream_decoder_finish(decoder);
+
+		if(masked.write_calls != full.write_calls) {
+			printf("FAILED, got %u write callbacks, expected %u\n", masked.write_calls, full.write_calls);
+			return false;
+		}
+		for(channel = 0; channel < cases[c].channels; channel++) {
+			const FLAC__bool same = 0 == memcmp(masked.pcm[channel], full.pcm[channel], sizeof(FLAC__int32) * samples);
+			if(cases[c].mask & (1u << channel)) {
+				if(!same) {
+					printf("FAILED, channel %u differs from the full decode\n", channel);
+					return false;
+				}
+			}
+			/* the contents of a masked-out channel are undefined, but a channel that was restored all the same would match */
+			else if(same && cases[c].channels > 2) {
+				printf("FAILED, masked-out channel %u was restored\n", channel);
+				return false;
+			}
+		}
+		printf("OK\n");
+
+		FLAC__stream_decoder_delete(decoder);
+		memory_decode_free_(&full);
+		memory_decode_free_(&masked);
+		free(stream.data);
+	}
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
+static FLAC__bool test_waveform_summary(void)
+{
+	/* frames are a whole number of buckets except for the last, so the buckets just tile the signal */
+	const unsigned samples = 20000, blocksize = 1024, bucket = 256, channels = 2;
+	memory_stream_ stream;
+	memory_decode_ full, summary;
+	FLAC__StreamDecoder *decoder;
+	unsigned channel, first, i, v;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (waveform summary)\n\n");
+
+	if(!encode_memory_stream_(&stream, channels, blocksize, samples))
+		return false;
+	if(0 == (decoder = FLAC__stream_decoder_new()))
+		return die_("FLAC__stream_decoder_new() returned NULL");
+
+	printf("testing waveform summary against the decoded signal... ");
+	if(!memory_decode_all_(decoder, &full, &stream, channels, samples, 0))
+		return false;
+	(void)FLAC__stream_decoder_finish(decoder);
+	if(!FLAC__stream_decoder_set_waveform_summary(decoder, bucket))
+		return die_s_("FLAC__stream_decoder_set_waveform_summary() returned false", decoder);
+	if(!memory_decode_all_(decoder, &summary, &stream, channels, samples, bucket))
+		return false;
+	(void)FLAC__stream_decoder_finish(decoder);
+
+	if(summary.summary_values != 3 * ((samples + bucket - 1) / bucket)) {
+		printf("FAILED, got %u summary values, expected %u\n", summary.summary_values, 3 * ((samples + bucket - 1) / bucket));
+		return false;
+	}
+	for(channel = 0; channel < channels; channel++) {
+		for(first = 0, v = 0; first < samples; first += bucket, v += 3) {
+			const unsigned n = samples - first < bucket? samples - first : bucket;
+			const FLAC__int32 *x = full.pcm[channel] + first;
+			const FLAC__int32 *got = summary.summary[channel] + v;
+			FLAC__int32 lo = x[0], hi = x[0];
+			FLAC__uint64 mean_square = 0, rms;
+			for(i = 0; i < n; i++) {
+				lo = x[i] < lo? x[i] : lo;
+				hi = x[i] > hi? x[i] : hi;
+				mean_square += (FLAC__uint64)((FLAC__int64)x[i] * x[i]);
+			}
+			mean_square /= n;
+			rms = (FLAC__uint64)got[2];
+			if(got[0] != lo || got[1] != hi || got[2] < 0 || rms * rms > mean_square || (rms + 1) * (rms + 1) <= mean_square) {
+				printf("FAILED, channel %u samples %u-%u: got min/max/RMS %d/%d/%d, expected %d/%d/floor(sqrt(%u))\n", channel, first, first + n - 1, got[0], got[1], got[2], lo, hi, (unsigned)mean_square);
+				return false;
+			}
+		}
+	}
+	printf("OK\n");
+
+	FLAC__stream_decoder_delete(decoder);
+	memory_decode_free_(&full);
+	memory_decode_free_(&summary);
+	free(stream.data);
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
+/* checks that the write callbacks delivered from 'first' on are contiguous batches of at least 'batch' samples but the last, ending at 'samples' */
+static FLAC__bool check_batches_(const memory_decode_ *dcd, unsigned call, FLAC__uint64 first, FLAC__uint64 samples, unsigned batch, unsigned blocksize)
+{
+	for( ; call < dcd->write_calls; call++) {
+		const FLAC__bool last = call + 1 == dcd->write_calls;
+		if(dcd->sample_number[call] != first) {
+			printf("FAILED, write callback %u starts at sample %u, expected %u\n", call, (unsigned)dcd->sample_number[call], (unsigned)first);
+			return false;
+		}
+		/* a batch can overshoot by less than a frame; only the one at the end of the stream may be short */
+		if(dcd->blocksize[call] >= batch + blocksize || (!last && dcd->blocksize[call] < batch)) {
+			printf("FAILED, write callback %u got %u samples, batch size is %u\n", call, dcd->blocksize[call], batch);
+			return false;
+		}
+		first += dcd->blocksize[call];
+	}
+	if(first != samples) {
+		printf("FAILED, write callbacks ended at sample %u, expected %u\n", (unsigned)first, (unsigned)samples);
+		return false;
+	}
+	return true;
+}
+
+static FLAC__bool test_write_batch(void)
+{
+	const unsigned samples = 20000, blocksize = 1152, batch = 4096, channels = 2;
+	memory_stream_ stream;
+	memory_decode_ full, batched;
+	FLAC__StreamDecoder *decoder;
+	unsigned channel;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (write batching)\n\n");
+
+	if(!encode_memory_stream_(&stream, channels, blocksize, samples))
+		return false;
+	if(0 == (decoder = FLAC__stream_decoder_new()))
+		return die_("FLAC__stream_decoder_new() returned NULL");
+	if(!memory_decode_all_(decoder, &full, &stream, channels, samples, 0))
+		return false;
+	(void)FLAC__stream_decoder_finish(decoder);
+
+	printf("testing batch sizes through the end of the stream... ");
+	if(!FLAC__stream_decoder_set_write_batch_size(decoder, batch))
+		return die_s_("FLAC__stream_decoder_set_write_batch_size() returned false", decoder);
+	if(!memory_decode_all_(decoder, &batched, &stream, channels, samples, 0))
+		return false;
+	(void)FLAC__stream_decoder_finish(decoder);
+	/* 4 frames a batch, and the last 2 frames (the second short) are passed on at the end of the stream */
+	if(batched.write_calls != (samples / blocksize) / 4 + 1) {
+		printf("FAILED, got %u write callbacks, expected %u\n", batched.write_calls, (samples / blocksize) / 4 + 1);
+		return false;
+	}
+	if(!check_batches_(&batched, 0, 0, samples, batch, blocksize))
+		return false;
+	for(channel = 0; channel < channels; channel++) {
+		if(memcmp(batched.pcm[channel], full.pcm[channel], sizeof(FLAC__int32) * samples)) {
+			printf("FAILED, channel %u differs from the unbatched decode\n", channel);
+			return false;
+		}
+	}
+	printf("OK\n");
+	memory_decode_free_(&batched);
+
+	printf("testing that a seek passes on the held batch first... ");
+	if(!FLAC__stream_decoder_set_write_batch_size(decoder, batch))
+		return die_s_("FLAC__stream_decoder_set_write_batch_size() returned false", decoder);
+	if(!memory_decode_init_(&batched, &stream, channels, samples, 0) || !memory_decoder_init_(decoder, &batched))
+		return false;
+	if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder) || !FLAC__stream_decoder_process_single(decoder) || !FLAC__stream_decoder_process_single(decoder))
+		return die_s_("decoding the first frames", decoder);
+	if(batched.write_calls != 0) {
+		printf("FAILED, got %u write callbacks before the batch was full\n", batched.write_calls);
+		return false;
+	}
+	if(!FLAC__stream_decoder_seek_absolute(decoder, 10000))
+		return die_s_("FLAC__stream_decoder_seek_absolute() returned false", decoder);
+	if(batched.write_calls < 1 || batched.sample_number[0] != 0 || batched.blocksize[0] != 2 * blocksize) {
+		printf("FAILED, the held frames were not passed on before the seek\n");
+		return false;
+	}
+	if(!FLAC__stream_decoder_process_until_end_of_stream(decoder))
+		return die_s_("FLAC__stream_decoder_process_until_end_of_stream() returned false", decoder);
+	(void)FLAC__stream_decoder_finish(decoder);
+	if(!check_batches_(&batched, 1, 10000, samples, batch, blocksize))
+		return false;
+	for(channel = 0; channel < channels; channel++) {
+		if(memcmp(batched.pcm[channel] + 10000, full.pcm[channel] + 10000, sizeof(FLAC__int32) * (samples - 10000))) {
+			printf("FAILED, channel %u differs from the unbatched decode after the seek\n", channel);
+			return false;
+		}
+	}
+	printf("OK\n");
+	memory_decode_free_(&batched);
+
+	printf("testing that nothing is passed on after the client aborts... ");
+	if(!FLAC__stream_decoder_set_write_batch_size(decoder, samples))
+		return die_s_("FLAC__stream_decoder_set_write_batch_size() returned false", decoder);
+	if(!memory_decode_init_(&batched, &stream, channels, samples, 0) || !memory_decoder_init_(decoder, &batched))
+		return false;
+	/* small reads, so that some frames are held by the time the read callback aborts */
+	stream.read_chunk = 512;
+	stream.abort_after = stream.bytes / 2;
+	(void)FLAC__stream_decoder_process_until_end_of_stream(decoder);
+	if(FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_ABORTED) {
+		printf("FAILED, state is %s, expected FLAC__STREAM_DECODER_ABORTED\n", FLAC__stream_decoder_get_resolved_state_string(decoder));
+		return false;
+	}
+	stream.abort_after = 0;
+	(void)FLAC__stream_decoder_flush(decoder);
+	(void)FLAC__stream_decoder_finish(decoder);
+	if(batched.write_calls != 0) {
+		printf("FAILED, got %u write callbacks after the abort\n", batched.write_calls);
+		return false;
+	}
+	printf("OK\n");
+
+	FLAC__stream_decoder_delete(decoder);
+	memory_decode_free_(&full);
+	memory_decode_free_(&batched);
+	free(stream.data);
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
+/* decodes 'filename' from the start with the current settings of 'decoder', using the memory_decode_ write callback */
+static FLAC__bool file_decode_init_(FLAC__StreamDecoder *decoder, memory_decode_ *dcd, memory_stream_ *stream, const char *filename, unsigned channels, FLAC__uint64 samples)
+{
+	if(!memory_decode_init_(dcd, stream, channels, samples, 0))
+		return false;
+	if(FLAC__stream_decoder_init_file(decoder, filename, memory_decoder_write_callback_, /*metadata_callback=*/0, memory_decoder_error_callback_, dcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_decoder_init_file() failed", decoder);
+	return true;
+}
+
+static FLAC__bool same_pcm_(const memory_decode_ *dcd, const memory_decode_ *expect, FLAC__uint64 from, FLAC__uint64 to)
+{
+	unsigned channel;
+	for(channel = 0; channel < expect->channels; channel++) {
+		if(memcmp(dcd->pcm[channel] + from, expect->pcm[channel] + from, sizeof(FLAC__int32) * (size_t)(to - from))) {
+			printf("FAILED, channel %u of samples %u..%u differs from the decode from memory\n", channel, (unsigned)from, (unsigned)to - 1);
+			return false;
+		}
+	}
+	return true;
+}
+
+static FLAC__bool test_read_size(void)
+{
+	/* 0 reads through stdio; the others are rounded up to a multiple of 4096, and the largest holds the whole file */
+	static const unsigned read_sizes[] = { 0, 1, 4096, 10000, 1u << 20 };
+	/* far forward, back to near the start, then forward by less and by less than a frame */
+	static const unsigned seek_targets[] = { 50000, 3000, 33333, 34000 };
+	const unsigned samples = 60000, blocksize = 1152, channels = 2;
+	const char *filename = "read_size.flac";
+	memory_stream_ stream;
+	memory_decode_ full, dcd;
+	FLAC__StreamDecoder *decoder;
+	FILE *file;
+	unsigned i, j, k;
+	FLAC__uint64 end;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (read size)\n\n");
+
+	if(!encode_memory_stream_(&stream, channels, blocksize, samples))
+		return false;
+	if(0 == (file = fopen(filename, "wb")))
+		return die_("opening the test file");
+	if(fwrite(stream.data, 1, stream.bytes, file) != stream.bytes) {
+		fclose(file);
+		return die_("writing the test file");
+	}
+	fclose(file);
+	if(0 == (decoder = FLAC__stream_decoder_new()))
+		return die_("FLAC__stream_decoder_new() returned NULL");
+	if(!memory_decode_all_(decoder, &full, &stream, channels, samples, 0))
+		return false;
+	(void)FLAC__stream_decoder_finish(decoder);
+
+	for(i = 0; i < sizeof(read_sizes) / sizeof(read_sizes[0]); i++) {
+		printf("testing a read size of %u through the end of the file... ", read_sizes[i]);
+		if(!FLAC__stream_decoder_set_read_size(decoder, read_sizes[i]) || !FLAC__stream_decoder_set_md5_checking(decoder, true))
+			return die_s_("setting decoder parameters", decoder);
+		if(!file_decode_init_(decoder, &dcd, &stream, filename, channels, samples))
+			return false;
+		if(!FLAC__stream_decoder_process_until_end_of_stream(decoder))
+			return die_s_("FLAC__stream_decoder_process_until_end_of_stream() returned false", decoder);
+		if(!FLAC__stream_decoder_finish(decoder))
+			return die_("MD5 mismatch");
+		if(!same_pcm_(&dcd, &full, 0, samples))
+			return false;
+		printf("OK\n");
+		memory_decode_free_(&dcd);
+
+		printf("testing a read size of %u with seeks... ", read_sizes[i]);
+		if(!FLAC__stream_decoder_set_read_size(decoder, read_sizes[i]))
+			return die_s_("setting decoder parameters", decoder);
+		if(!file_decode_init_(decoder, &dcd, &stream, filename, channels, samples))
+			return false;
+		if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder))
+			return die_s_("FLAC__stream_decoder_process_until_end_of_metadata() returned false", decoder);
+		for(j = 0; j < sizeof(seek_targets) / sizeof(seek_targets[0]); j++) {
+			/* so that what an earlier seek decoded does not count */
+			for(k = 0; k < channels; k++)
+				memset(dcd.pcm[k], 0, sizeof(FLAC__int32) * samples);
+			if(!FLAC__stream_decoder_seek_absolute(decoder, seek_targets[j]))
+				return die_s_("FLAC__stream_decoder_seek_absolute() returned false", decoder);
+			/* the rest of the frame seeked into comes with the seek, then one whole frame */
+			if(!FLAC__stream_decoder_process_single(decoder))
+				return die_s_("FLAC__stream_decoder_process_single() returned false", decoder);
+			end = (seek_targets[j] / blocksize + 2) * blocksize;
+			if(!same_pcm_(&dcd, &full, seek_targets[j], end < samples? end : samples))
+				return false;
+		}
+		(void)FLAC__stream_decoder_finish(decoder);
+		printf("OK\n");
+		memory_decode_free_(&dcd);
+	}
+
+	FLAC__stream_decoder_delete(decoder);
+	memory_decode_free_(&full);
+	free(stream.data);
+	(void)grabbag__file_remove_file(filename);
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
 FLAC__bool test_decoders(void)
 {
 	FLAC__bool is_ogg = false;
@@ -1035,6 +1810,21 @@ FLAC__bool test_decoders(void)
 		if(!test_stream_decoder(LAYER_FILENAME, is_ogg))
 			return false;
 
+		if(!is_ogg && !test_crc_check_only())
+			return false;
+
+		if(!is_ogg && !test_channel_mask())
+			return false;
+
+		if(!is_ogg && !test_waveform_summary())
+			return false;
+
+		if(!is_ogg && !test_write_batch())
+			return false;
+
+		if(!is_ogg && !test_read_size())
+			return false;
+
 		(void) grabbag__file_remove_file(flacfilename(is_ogg));
 
 		free_metadata_blocks_();
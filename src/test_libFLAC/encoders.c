@@ -21,12 +21,17 @@
 #endif
 
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "encoders.h"
 #include "FLAC/assert.h"
+#include "FLAC/metadata.h"
+#include "FLAC/stream_decoder.h"
 #include "FLAC/stream_encoder.h"
+#include "private/uring_writer.h" /* from the libFLAC private include area */
 #include "share/grabbag.h"
 #include "test_libs_common/file_utils_flac.h"
 #include "test_libs_common/metadata_utils.h"
@@ -115,6 +120,29 @@ static FLAC__StreamEncoderWriteStatus stream_encoder_write_callback_(const FLAC_
 		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
 }
 
+static FLAC__byte *frame_buffer_ = 0;
+static size_t frame_buffer_size_ = 0;
+
+static FLAC__byte *stream_encoder_reserve_callback_(const FLAC__StreamEncoder *encoder, size_t max_bytes, void *client_data)
+{
+	(void)encoder, (void)client_data;
+	if(max_bytes > frame_buffer_size_) {
+		free(frame_buffer_);
+		frame_buffer_size_ = 0;
+		if(0 == (frame_buffer_ = (FLAC__byte*)malloc(max_bytes)))
+			return 0;
+		frame_buffer_size_ = max_bytes;
+	}
+	return frame_buffer_;
+}
+
+static FLAC__StreamEncoderWriteStatus stream_encoder_commit_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
+{
+	if(buffer != frame_buffer_ || bytes > frame_buffer_size_ || samples == 0)
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	return stream_encoder_write_callback_(encoder, buffer, bytes, samples, current_frame, client_data);
+}
+
 static FLAC__StreamEncoderSeekStatus stream_encoder_seek_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data)
 {
 	FILE *f = (FILE*)client_data;
@@ -154,6 +182,7 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	FLAC__StreamEncoderInitStatus init_status;
 	FLAC__StreamEncoderState state;
 	FLAC__StreamDecoderState dstate;
+	FLAC__ThreadPool *pool;
 	FILE *file = 0;
 	FLAC__int32 samples[1024];
 	FLAC__int32 *samples_array[1];
@@ -213,6 +242,11 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_set_variable_blocksize()... ");
+	if(!FLAC__stream_encoder_set_variable_blocksize(encoder, true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_set_do_mid_side_stereo()... ");
 	if(!FLAC__stream_encoder_set_do_mid_side_stereo(encoder, false))
 		return die_s_("returned false", encoder);
@@ -223,6 +257,11 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_set_adaptive_apodization()... ");
+	if(!FLAC__stream_encoder_set_adaptive_apodization(encoder, true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_set_max_lpc_order()... ");
 	if(!FLAC__stream_encoder_set_max_lpc_order(encoder, 0))
 		return die_s_("returned false", encoder);
@@ -248,6 +287,16 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_set_prune_model_search()... ");
+	if(!FLAC__stream_encoder_set_prune_model_search(encoder, true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_set_quiet_signal_bits()... ");
+	if(!FLAC__stream_encoder_set_quiet_signal_bits(encoder, 2))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_set_min_residual_partition_order()... ");
 	if(!FLAC__stream_encoder_set_min_residual_partition_order(encoder, 0))
 		return die_s_("returned false", encoder);
@@ -263,6 +312,11 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_set_time_budget()... ");
+	if(!FLAC__stream_encoder_set_time_budget(encoder, 50))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_set_total_samples_estimate()... ");
 	if(!FLAC__stream_encoder_set_total_samples_estimate(encoder, streaminfo_.data.stream_info.total_samples))
 		return die_s_("returned false", encoder);
@@ -273,6 +327,45 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__thread_pool_new()... ");
+	if(0 == (pool = FLAC__thread_pool_new(2, 0))) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_set_thread_pool()... ");
+	if(!FLAC__stream_encoder_set_thread_pool(encoder, pool))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_set_parallel_subframes()... ");
+	if(!FLAC__stream_encoder_set_parallel_subframes(encoder, true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_set_parallel_apodizations()... ");
+	if(!FLAC__stream_encoder_set_parallel_apodizations(encoder, true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_set_write_buffer_size()... ");
+	if(!FLAC__stream_encoder_set_write_buffer_size(encoder, 1u << 20))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_set_async_write()... ");
+	if(!FLAC__stream_encoder_set_async_write(encoder, true))
+		return die_s_("returned false", encoder);
+	printf("OK\n");
+
+	if(layer == LAYER_SEEKABLE_STREAM && !is_ogg) {
+		printf("testing FLAC__stream_encoder_set_frame_buffer_callbacks()... ");
+		if(!FLAC__stream_encoder_set_frame_buffer_callbacks(encoder, stream_encoder_reserve_callback_, stream_encoder_commit_callback_))
+			return die_s_("returned false", encoder);
+		printf("OK\n");
+	}
+
 	if(layer < LAYER_FILENAME) {
 		printf("opening file for FLAC output... ");
 		file = fopen(flacfilename(is_ogg), "w+b");
@@ -393,6 +486,20 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_get_variable_blocksize()... ");
+	if(FLAC__stream_encoder_get_variable_blocksize(encoder) != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_adaptive_apodization()... ");
+	if(FLAC__stream_encoder_get_adaptive_apodization(encoder) != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_get_max_lpc_order()... ");
 	if(FLAC__stream_encoder_get_max_lpc_order(encoder) != 0) {
 		printf("FAILED, expected %u, got %u\n", 0, FLAC__stream_encoder_get_max_lpc_order(encoder));
@@ -426,6 +533,20 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_get_prune_model_search()... ");
+	if(FLAC__stream_encoder_get_prune_model_search(encoder) != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_quiet_signal_bits()... ");
+	if(FLAC__stream_encoder_get_quiet_signal_bits(encoder) != 2) {
+		printf("FAILED, expected %u, got %u\n", 2, FLAC__stream_encoder_get_quiet_signal_bits(encoder));
+		return false;
+	}
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_get_min_residual_partition_order()... ");
 	if(FLAC__stream_encoder_get_min_residual_partition_order(encoder) != 0) {
 		printf("FAILED, expected %u, got %u\n", 0, FLAC__stream_encoder_get_min_residual_partition_order(encoder));
@@ -447,6 +568,13 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_get_time_budget()... ");
+	if(FLAC__stream_encoder_get_time_budget(encoder) != 50) {
+		printf("FAILED, expected %u, got %u\n", 50, FLAC__stream_encoder_get_time_budget(encoder));
+		return false;
+	}
+	printf("OK\n");
+
 	printf("testing FLAC__stream_encoder_get_total_samples_estimate()... ");
 	if(FLAC__stream_encoder_get_total_samples_estimate(encoder) != streaminfo_.data.stream_info.total_samples) {
 #ifdef _MSC_VER
@@ -458,6 +586,48 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_get_thread_pool()... ");
+	if(FLAC__stream_encoder_get_thread_pool(encoder) != pool) {
+		printf("FAILED, returned wrong pool\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_parallel_subframes()... ");
+	if(FLAC__stream_encoder_get_parallel_subframes(encoder) != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_parallel_apodizations()... ");
+	if(FLAC__stream_encoder_get_parallel_apodizations(encoder) != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_write_buffer_size()... ");
+	if(FLAC__stream_encoder_get_write_buffer_size(encoder) != 1u << 20) {
+		printf("FAILED, expected %u, got %u\n", 1u << 20, FLAC__stream_encoder_get_write_buffer_size(encoder));
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_async_write()... ");
+	if(FLAC__stream_encoder_get_async_write(encoder) != true) {
+		printf("FAILED, expected true, got false\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing FLAC__stream_encoder_get_workspace_bytes()... ");
+	if(FLAC__stream_encoder_get_workspace_bytes(encoder) == 0) {
+		printf("FAILED, expected a workspace after init\n");
+		return false;
+	}
+	printf("OK\n");
+
 	/* init the dummy sample buffer */
 	for(i = 0; i < sizeof(samples) / sizeof(FLAC__int32); i++)
 		samples[i] = i & 7;
@@ -484,11 +654,1113 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	FLAC__stream_encoder_delete(encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__thread_pool_delete()... ");
+	FLAC__thread_pool_delete(pool);
+	printf("OK\n");
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+typedef struct {
+	FLAC__byte *data;
+	size_t bytes, capacity;
+	size_t position;                                  /* where the next write goes; only moved back by memory_seek_callback_() */
+} memory_output_;
+
+static FLAC__StreamEncoderWriteStatus memory_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
+{
+	memory_output_ *out = (memory_output_*)client_data;
+	(void)encoder, (void)samples, (void)current_frame;
+	if(out->position + bytes > out->capacity) {
+		size_t capacity = (out->position + bytes) * 2;
+		FLAC__byte *data = (FLAC__byte*)realloc(out->data, capacity);
+		if(0 == data)
+			return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+		out->data = data;
+		out->capacity = capacity;
+	}
+	memcpy(out->data + out->position, buffer, bytes);
+	out->position += bytes;
+	if(out->position > out->bytes)
+		out->bytes = out->position;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__StreamEncoderSeekStatus memory_seek_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	memory_output_ *out = (memory_output_*)client_data;
+	(void)encoder;
+	if(absolute_byte_offset > out->bytes)
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	out->position = (size_t)absolute_byte_offset;
+	return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
+
+static FLAC__StreamEncoderTellStatus memory_tell_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	memory_output_ *out = (memory_output_*)client_data;
+	(void)encoder;
+	*absolute_byte_offset = out->position;
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
+
+static FLAC__bool reuse_encode_(FLAC__StreamEncoder *encoder, unsigned channels, unsigned level, memory_output_ *out)
+{
+	FLAC__int32 samples[6 * 1000];
+	unsigned i, n = 0;
+
+	for(i = 0; i < sizeof(samples) / sizeof(FLAC__int32); i++) {
+		n = n * 1103515245u + 12345u;
+		samples[i] = (FLAC__int32)((i * 37) % 2001) - 1000 + (FLAC__int32)((n >> 16) & 63);
+	}
+
+	out->bytes = out->position = 0;
+	if(
+		!FLAC__stream_encoder_set_channels(encoder, channels) ||
+		!FLAC__stream_encoder_set_sample_rate(encoder, 44100) ||
+		!FLAC__stream_encoder_set_compression_level(encoder, level) ||
+		!FLAC__stream_encoder_set_verify(encoder, true)
+	)
+		return die_s_("setting encoder parameters", encoder);
+	if(FLAC__stream_encoder_init_stream(encoder, memory_write_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*metadata_callback=*/0, out) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return die_s_("init failed", encoder);
+	for(i = 0; i < 10; i++) {
+		if(!FLAC__stream_encoder_process_interleaved(encoder, samples, sizeof(samples) / sizeof(FLAC__int32) / channels))
+			return die_s_("process failed", encoder);
+	}
+	if(!FLAC__stream_encoder_finish(encoder))
+		return die_s_("finish failed", encoder);
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_reuse(void)
+{
+	/* stereo level 5, the same again, then settings that need bigger and smaller buffers, then back */
+	static const unsigned channels[] = { 2, 2, 6, 1, 2 };
+	static const unsigned level[] = { 5, 5, 8, 0, 5 };
+	memory_output_ first = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	FLAC__StreamEncoder *encoder;
+	FLAC__bool ok = true;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (reusing one instance)\n\n");
+
+	if(0 == (encoder = FLAC__stream_encoder_new()))
+		return die_("FLAC__stream_encoder_new() returned NULL");
+
+	printf("testing FLAC__stream_encoder_init_stream() after FLAC__stream_encoder_finish()... ");
+	ok = reuse_encode_(encoder, channels[0], level[0], &first);
+	for(i = 1; ok && i < sizeof(channels) / sizeof(channels[0]); i++) {
+		if(!(ok = reuse_encode_(encoder, channels[i], level[i], &out)))
+			break;
+		if(channels[i] == channels[0] && level[i] == level[0] && (out.bytes != first.bytes || memcmp(out.data, first.data, first.bytes))) {
+			printf("FAILED, stream %u differs from the first\n", i);
+			ok = false;
+		}
+	}
+	if(ok)
+		printf("OK\n");
+
+	FLAC__stream_encoder_delete(encoder);
+	free(first.data);
+	free(out.data);
+
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+static FLAC__bool test_stream_encoder_workspace_bytes(void)
+{
+	static const unsigned channels[] = { 1, 2, 6 };
+	static const unsigned blocksize[] = { 1152, 4608 };
+	static const unsigned max_lpc_order[] = { 0, 12 };
+	memory_output_ out = { 0, 0, 0, 0 };
+	FLAC__StreamEncoder *encoder;
+	FLAC__bool ok = true;
+	unsigned c, b, l;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (workspace size)\n\n");
+
+	for(c = 0; ok && c < sizeof(channels) / sizeof(channels[0]); c++) {
+		for(b = 0; ok && b < sizeof(blocksize) / sizeof(blocksize[0]); b++) {
+			for(l = 0; ok && l < sizeof(max_lpc_order) / sizeof(max_lpc_order[0]); l++) {
+				/* each channel and the mid and side channels have a signal and two candidate residuals of blocksize samples, and the search has partition sums of twice that */
+				const unsigned signals = channels[c] + 2;
+				size_t min_bytes = sizeof(FLAC__int32) * blocksize[b] * 3 * signals + sizeof(FLAC__uint64) * blocksize[b] * 2;
+				/* every buffer may be padded to a cache line, and a signal has a few samples more in front and behind */
+				size_t max_bytes = min_bytes + 64 * (3 * signals + 1) + sizeof(FLAC__int32) * 5 * signals;
+				size_t bytes;
+
+				if(max_lpc_order[l] > 0) {
+					/* the windowed signal, and the model of the window */
+					min_bytes += sizeof(float) * blocksize[b];
+					max_bytes += sizeof(double) * blocksize[b] + 64 * 2 + sizeof(double) * FLAC__MAX_LPC_ORDER * (FLAC__MAX_LPC_ORDER + 1) + 64;
+				}
+
+				printf("testing FLAC__stream_encoder_get_workspace_bytes() with %u channels, blocksize %u, max LPC order %u... ", channels[c], blocksize[b], max_lpc_order[l]);
+				if(0 == (encoder = FLAC__stream_encoder_new()))
+					return die_("FLAC__stream_encoder_new() returned NULL");
+				if(FLAC__stream_encoder_get_workspace_bytes(encoder) != 0) {
+					printf("FAILED, expected no workspace before init, got %u bytes\n", (unsigned)FLAC__stream_encoder_get_workspace_bytes(encoder));
+					ok = false;
+				}
+				else if(
+					!FLAC__stream_encoder_set_channels(encoder, channels[c]) ||
+					!FLAC__stream_encoder_set_blocksize(encoder, blocksize[b]) ||
+					!FLAC__stream_encoder_set_max_lpc_order(encoder, max_lpc_order[l])
+				)
+					ok = die_s_("setting encoder parameters", encoder);
+				else if(FLAC__stream_encoder_init_stream(encoder, memory_write_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*metadata_callback=*/0, &out) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+					ok = die_s_("init failed", encoder);
+				else if((bytes = FLAC__stream_encoder_get_workspace_bytes(encoder)) < min_bytes || bytes > max_bytes) {
+					printf("FAILED, expected %u to %u bytes, got %u\n", (unsigned)min_bytes, (unsigned)max_bytes, (unsigned)bytes);
+					ok = false;
+				}
+				else if(!FLAC__stream_encoder_finish(encoder))
+					ok = die_s_("finish failed", encoder);
+				else if(FLAC__stream_encoder_get_workspace_bytes(encoder) != bytes) {
+					printf("FAILED, the workspace was not kept across finish\n");
+					ok = false;
+				}
+				else
+					printf("OK, %u bytes\n", (unsigned)bytes);
+				FLAC__stream_encoder_delete(encoder);
+			}
+		}
+	}
+
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+/* settings for encode_init_(); start from encode_settings_init_() and change what the test is about */
+typedef struct {
+	unsigned channels, level;
+	unsigned blocksize;                               /* 0 for the level's default */
+	unsigned time_budget;
+	FLAC__ThreadPool *pool;
+	FLAC__bool parallel_subframes, parallel_apodizations, adaptive_apodization;
+	FLAC__bool prune_model_search, do_qlp_coeff_prec_search, do_escape_coding;
+	unsigned quiet_signal_bits;
+	FLAC__bool single_partition;                      /* code each residual as one Rice partition */
+	const char *apodization;                          /* NULL for the level's default */
+	FLAC__bool variable_blocksize;
+	FLAC__bool transients;                            /* add bursts of noise to the test signal, see encode_signal_() */
+	FLAC__bool quiet;                                 /* make all but the first chunk of the test signal dithered silence, see encode_signal_() */
+	FLAC__bool seekable;                              /* give the encoder seek and tell callbacks, so it rewrites STREAMINFO when done */
+	unsigned write_buffer_size;                       /* only used by encode_file_() */
+	FLAC__bool async_write;                           /* only used by encode_file_() */
+} encode_settings_;
+
+#define ENCODE_CHUNK_SAMPLES_ 10000
+#define ENCODE_CHUNKS_ 4
+
+static void encode_settings_init_(encode_settings_ *settings, unsigned channels, unsigned level)
+{
+	memset(settings, 0, sizeof(*settings));
+	settings->channels = channels;
+	settings->level = level;
+}
+
+/*
+ * A couple of tones and a little noise, so that the LPC search and the
+ * apodization functions matter; with 'transients', loud bursts of noise
+ * 700 samples long every 4900, for the block splitting to find; with
+ * 'quiet', only noise from -2 to 1 after the first chunk, like the
+ * silence between programmes in a radio capture.
+ */
+static FLAC__int32 encode_signal_(const encode_settings_ *settings, unsigned channel, unsigned i)
+{
+	const FLAC__bool transients = settings->transients;
+	FLAC__uint32 n = (i + 1) * 2654435761u ^ (channel + 1) * 40503u;
+	n ^= n >> 15;
+	if(settings->quiet && i >= ENCODE_CHUNK_SAMPLES_)
+		return (FLAC__int32)((n >> 7) & 3) - 2;
+	return
+		(FLAC__int32)(6000.0 * sin(0.031 * (channel + 1) * i)) +
+		(FLAC__int32)(2500.0 * sin(0.0073 * i + channel)) +
+		(FLAC__int32)(n & 127) - 64 +
+		(transients && i / 700 % 7 == 3? (FLAC__int32)((n >> 18) & 16383) - 8192 : 0);
+}
+
+static FLAC__bool encode_set_(FLAC__StreamEncoder *encoder, const encode_settings_ *settings)
+{
+	if(
+		!FLAC__stream_encoder_set_channels(encoder, settings->channels) ||
+		!FLAC__stream_encoder_set_sample_rate(encoder, 44100) ||
+		!FLAC__stream_encoder_set_compression_level(encoder, settings->level) ||
+		!FLAC__stream_encoder_set_verify(encoder, true) ||
+		(0 != settings->blocksize && !FLAC__stream_encoder_set_blocksize(encoder, settings->blocksize)) ||
+		!FLAC__stream_encoder_set_variable_blocksize(encoder, settings->variable_blocksize) ||
+		!FLAC__stream_encoder_set_time_budget(encoder, settings->time_budget) ||
+		!FLAC__stream_encoder_set_thread_pool(encoder, settings->pool) ||
+		!FLAC__stream_encoder_set_parallel_subframes(encoder, settings->parallel_subframes) ||
+		!FLAC__stream_encoder_set_parallel_apodizations(encoder, settings->parallel_apodizations) ||
+		(0 != settings->apodization && !FLAC__stream_encoder_set_apodization(encoder, settings->apodization)) ||
+		!FLAC__stream_encoder_set_adaptive_apodization(encoder, settings->adaptive_apodization) ||
+		!FLAC__stream_encoder_set_prune_model_search(encoder, settings->prune_model_search) ||
+		!FLAC__stream_encoder_set_quiet_signal_bits(encoder, settings->quiet_signal_bits) ||
+		(settings->single_partition && !FLAC__stream_encoder_set_max_residual_partition_order(encoder, 0)) ||
+		!FLAC__stream_encoder_set_do_qlp_coeff_prec_search(encoder, settings->do_qlp_coeff_prec_search) ||
+		!FLAC__stream_encoder_set_do_escape_coding(encoder, settings->do_escape_coding)
+	)
+		return die_s_("setting encoder parameters", encoder);
+	return true;
+}
+
+static FLAC__bool encode_init_(FLAC__StreamEncoder *encoder, const encode_settings_ *settings, memory_output_ *out)
+{
+	out->bytes = out->position = 0;
+	if(!encode_set_(encoder, settings))
+		return false;
+	if(
+		FLAC__stream_encoder_init_stream(
+			encoder,
+			memory_write_callback_,
+			settings->seekable? memory_seek_callback_ : 0,
+			settings->seekable? memory_tell_callback_ : 0,
+			/*metadata_callback=*/0,
+			out
+		) != FLAC__STREAM_ENCODER_INIT_STATUS_OK
+	)
+		return die_s_("init failed", encoder);
+	return true;
+}
+
+/* feeds the encoder chunk number 'chunk' of the test signal */
+static FLAC__bool encode_chunk_(FLAC__StreamEncoder *encoder, const encode_settings_ *settings, unsigned chunk)
+{
+	static FLAC__int32 samples[ENCODE_CHUNK_SAMPLES_ * 8];
+	const unsigned channels = settings->channels;
+	unsigned i, channel;
+
+	FLAC__ASSERT(channels <= 8);
+	for(i = 0; i < ENCODE_CHUNK_SAMPLES_; i++)
+		for(channel = 0; channel < channels; channel++)
+			samples[i * channels + channel] = encode_signal_(settings, channel, chunk * ENCODE_CHUNK_SAMPLES_ + i);
+	if(!FLAC__stream_encoder_process_interleaved(encoder, samples, ENCODE_CHUNK_SAMPLES_))
+		return die_s_("process failed", encoder);
+	return true;
+}
+
+/* encodes the whole test signal with a fresh encoder */
+static FLAC__bool encode_memory_(const encode_settings_ *settings, memory_output_ *out)
+{
+	FLAC__StreamEncoder *encoder;
+	FLAC__bool ok;
+	unsigned chunk;
+
+	if(0 == (encoder = FLAC__stream_encoder_new()))
+		return die_("FLAC__stream_encoder_new() returned NULL");
+	ok = encode_init_(encoder, settings, out);
+	for(chunk = 0; ok && chunk < ENCODE_CHUNKS_; chunk++)
+		ok = encode_chunk_(encoder, settings, chunk);
+	if(ok && !FLAC__stream_encoder_finish(encoder))
+		ok = die_s_("finish failed", encoder);
+	FLAC__stream_encoder_delete(encoder);
+	return ok;
+}
+
+static FLAC__bool read_file_(const char *filename, memory_output_ *out)
+{
+	FILE *file;
+	long bytes;
+	FLAC__bool ok;
+
+	if(0 == (file = fopen(filename, "rb")))
+		return die_("opening the encoded file");
+	ok = fseek(file, 0, SEEK_END) == 0 && (bytes = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0;
+	if(ok && (size_t)bytes > out->capacity) {
+		FLAC__byte *data = (FLAC__byte*)realloc(out->data, (size_t)bytes);
+		if(0 == data)
+			ok = false;
+		else {
+			out->data = data;
+			out->capacity = (size_t)bytes;
+		}
+	}
+	if(ok) {
+		out->bytes = out->position = (size_t)bytes;
+		ok = fread(out->data, 1, out->bytes, file) == out->bytes;
+	}
+	fclose(file);
+	if(!ok)
+		return die_("reading the encoded file");
+	return true;
+}
+
+/*
+ * Encodes the whole test signal to 'filename' with a fresh encoder, with a
+ * PADDING block and a SEEKTABLE for FLAC__stream_encoder_finish() to fill
+ * in, and reads the file back into 'out'.
+ */
+static FLAC__bool encode_file_(const encode_settings_ *settings, const char *filename, memory_output_ *out)
+{
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamMetadata *metadata[2];
+	FLAC__bool ok;
+	unsigned chunk, i;
+
+	if(0 == (encoder = FLAC__stream_encoder_new()))
+		return die_("FLAC__stream_encoder_new() returned NULL");
+	metadata[0] = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE);
+	metadata[1] = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
+	ok = true;
+	if(!(
+		0 != metadata[0] && 0 != metadata[1] &&
+		FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(metadata[0], 4096, ENCODE_CHUNK_SAMPLES_ * ENCODE_CHUNKS_) &&
+		FLAC__metadata_object_seektable_template_sort(metadata[0], /*compact=*/true)
+	))
+		ok = die_("building the SEEKTABLE");
+	else if(!(
+		encode_set_(encoder, settings) &&
+		FLAC__stream_encoder_set_total_samples_estimate(encoder, ENCODE_CHUNK_SAMPLES_ * ENCODE_CHUNKS_) &&
+		FLAC__stream_encoder_set_metadata(encoder, metadata, 2) &&
+		FLAC__stream_encoder_set_write_buffer_size(encoder, settings->write_buffer_size) &&
+		FLAC__stream_encoder_set_async_write(encoder, settings->async_write)
+	))
+		ok = die_s_("setting encoder parameters", encoder);
+	if(ok && FLAC__stream_encoder_init_file(encoder, filename, /*progress_callback=*/0, /*client_data=*/0) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		ok = die_s_("init failed", encoder);
+	for(chunk = 0; ok && chunk < ENCODE_CHUNKS_; chunk++)
+		ok = encode_chunk_(encoder, settings, chunk);
+	if(ok && !FLAC__stream_encoder_finish(encoder))
+		ok = die_s_("finish failed", encoder);
+	for(i = 0; ok && i < metadata[0]->data.seek_table.num_points; i++) {
+		if(metadata[0]->data.seek_table.points[i].frame_samples == 0)
+			ok = die_("SEEKTABLE was not filled in");
+	}
+	FLAC__stream_encoder_delete(encoder);
+	if(0 != metadata[0])
+		FLAC__metadata_object_delete(metadata[0]);
+	if(0 != metadata[1])
+		FLAC__metadata_object_delete(metadata[1]);
+	return ok && read_file_(filename, out);
+}
+
+static FLAC__bool same_output_(const memory_output_ *out, const memory_output_ *expect)
+{
+	if(out->bytes != expect->bytes) {
+		printf("FAILED, %u bytes instead of %u\n", (unsigned)out->bytes, (unsigned)expect->bytes);
+		return false;
+	}
+	if(memcmp(out->data, expect->data, expect->bytes)) {
+		printf("FAILED, the encoded stream differs\n");
+		return false;
+	}
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_shared_pool(void)
+{
+	encode_settings_ settings[2];
+	memory_output_ expect[2] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 } }, out[2] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 } };
+	FLAC__StreamEncoder *encoder[2] = { 0, 0 };
+	FLAC__ThreadPool *pool;
+	FLAC__bool ok;
+	unsigned i, chunk;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (two instances sharing a thread pool)\n\n");
+
+	encode_settings_init_(&settings[0], 2, 5);
+	encode_settings_init_(&settings[1], 1, 8);
+
+	printf("testing encoding without a pool... ");
+	ok = encode_memory_(&settings[0], &expect[0]) && encode_memory_(&settings[1], &expect[1]);
+	if(!ok)
+		goto done;
+	printf("OK\n");
+
+	if(0 == (pool = FLAC__thread_pool_new(2, 0))) {
+		ok = die_("FLAC__thread_pool_new() returned NULL");
+		goto done;
+	}
+
+	printf("testing two encoders taking turns on one pool... ");
+	for(i = 0; ok && i < 2; i++) {
+		settings[i].pool = pool;
+		if(0 == (encoder[i] = FLAC__stream_encoder_new()))
+			ok = die_("FLAC__stream_encoder_new() returned NULL");
+		else
+			ok = encode_init_(encoder[i], &settings[i], &out[i]);
+	}
+	for(chunk = 0; ok && chunk < ENCODE_CHUNKS_; chunk++)
+		for(i = 0; ok && i < 2; i++)
+			ok = encode_chunk_(encoder[i], &settings[i], chunk);
+	for(i = 0; ok && i < 2; i++) {
+		if(!FLAC__stream_encoder_finish(encoder[i]))
+			ok = die_s_("finish failed", encoder[i]);
+	}
+	for(i = 0; ok && i < 2; i++)
+		ok = same_output_(&out[i], &expect[i]);
+	if(ok)
+		printf("OK\n");
+
+	for(i = 0; i < 2; i++)
+		if(0 != encoder[i])
+			FLAC__stream_encoder_delete(encoder[i]);
+	FLAC__thread_pool_delete(pool);
+
+done:
+	for(i = 0; i < 2; i++) {
+		free(expect[i].data);
+		free(out[i].data);
+	}
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+/* encodes with each of 'threads' pool sizes, 0 for no pool, and checks all match the first */
+static FLAC__bool same_output_for_threads_(encode_settings_ *settings, const unsigned threads[], unsigned num_threads)
+{
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	FLAC__bool ok = true;
+	unsigned i;
+
+	for(i = 0; ok && i < num_threads; i++) {
+		settings->pool = 0;
+		if(threads[i] > 0 && 0 == (settings->pool = FLAC__thread_pool_new(threads[i], 0))) {
+			ok = die_("FLAC__thread_pool_new() returned NULL");
+			break;
+		}
+		ok = encode_memory_(settings, i == 0? &expect : &out);
+		if(ok && i > 0 && !same_output_(&out, &expect)) {
+			printf("       with %u threads\n", threads[i]);
+			ok = false;
+		}
+		if(0 != settings->pool)
+			FLAC__thread_pool_delete(settings->pool);
+	}
+	settings->pool = 0;
+	free(expect.data);
+	free(out.data);
+	return ok;
+}
+
+static FLAC__bool test_stream_encoder_parallel_subframes(void)
+{
+	static const unsigned threads[] = { 0, 1, 2, 4 };
+	static const unsigned channels[] = { 1, 2, 6 };
+	encode_settings_ settings;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (parallel subframes)\n\n");
+
+	for(i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+		printf("testing %u channels at level 8 with 0, 1, 2 and 4 threads... ", channels[i]);
+		encode_settings_init_(&settings, channels[i], 8);
+		settings.parallel_subframes = true;
+		if(!same_output_for_threads_(&settings, threads, sizeof(threads) / sizeof(threads[0])))
+			return false;
+		printf("OK\n");
+	}
+
+	printf("\nPASSED!\n");
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_parallel_apodizations(void)
+{
+	/* 1 to 8 threads with one window split the LPC orders between them; with five, 1 to 4 split the windows and 8 the orders */
+	static const unsigned threads[] = { 0, 1, 2, 4, 8 };
+	static const char * const apodization[] = { 0, "tukey(0.5);partial_tukey(2);hann;welch;bartlett" };
+	encode_settings_ settings;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (parallel apodizations)\n\n");
+
+	for(i = 0; i < sizeof(apodization) / sizeof(apodization[0]); i++) {
+		printf("testing %s at level 8 with 0, 1, 2, 4 and 8 threads... ", 0 == apodization[i]? "the default window" : apodization[i]);
+		encode_settings_init_(&settings, 2, 8);
+		settings.parallel_apodizations = true;
+		settings.apodization = apodization[i];
+		if(!same_output_for_threads_(&settings, threads, sizeof(threads) / sizeof(threads[0])))
+			return false;
+		printf("OK\n");
+	}
+
+	printf("testing parallel subframes and apodizations together... ");
+	encode_settings_init_(&settings, 2, 8);
+	settings.parallel_subframes = true;
+	settings.parallel_apodizations = true;
+	settings.apodization = apodization[1];
+	if(!same_output_for_threads_(&settings, threads, sizeof(threads) / sizeof(threads[0])))
+		return false;
+	printf("OK\n");
+
 	printf("\nPASSED!\n");
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_prune_model_search(void)
+{
+	static const struct {
+		unsigned channels, level, threads;
+		FLAC__bool do_qlp_coeff_prec_search, do_escape_coding;
+	} cases[] = {
+		{ 2, 5, 0, false, false },
+		{ 2, 8, 0, false, false },
+		{ 2, 8, 0, true , false },
+		{ 1, 8, 0, true , true  },
+		{ 2, 8, 4, true , false }
+	};
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	encode_settings_ settings;
+	FLAC__bool ok = true;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (pruned model search)\n\n");
+
+	for(i = 0; ok && i < sizeof(cases) / sizeof(cases[0]); i++) {
+		printf(
+			"testing %u channels at level %u%s%s%s against the full search... ",
+			cases[i].channels, cases[i].level,
+			cases[i].do_qlp_coeff_prec_search? " with qlp precision search" : "",
+			cases[i].do_escape_coding? " and escape coding" : "",
+			cases[i].threads > 0? " on a thread pool" : ""
+		);
+		encode_settings_init_(&settings, cases[i].channels, cases[i].level);
+		settings.do_qlp_coeff_prec_search = cases[i].do_qlp_coeff_prec_search;
+		settings.do_escape_coding = cases[i].do_escape_coding;
+		if(cases[i].threads > 0) {
+			settings.parallel_apodizations = true;
+			if(0 == (settings.pool = FLAC__thread_pool_new(cases[i].threads, 0))) {
+				ok = die_("FLAC__thread_pool_new() returned NULL");
+				break;
+			}
+		}
+		ok = encode_memory_(&settings, &expect);
+		settings.prune_model_search = true;
+		ok = ok && encode_memory_(&settings, &out) && same_output_(&out, &expect);
+		if(0 != settings.pool)
+			FLAC__thread_pool_delete(settings.pool);
+		if(ok)
+			printf("OK\n");
+	}
+
+	free(expect.data);
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+static FLAC__bool test_stream_encoder_adaptive_apodization(void)
+{
+	static const unsigned threads[] = { 0, 1, 4 };
+	static const char * const few = "tukey(0.5);partial_tukey(2)";
+	static const char * const many = "tukey(0.5);partial_tukey(2);hann;welch;bartlett;gauss(0.2)";
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	encode_settings_ settings;
+	FLAC__bool ok;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (adaptive apodization)\n\n");
+
+	/* with no more windows than it keeps as candidates, every frame tries them all anyway */
+	printf("testing that two windows give the same stream as without it... ");
+	encode_settings_init_(&settings, 2, 8);
+	settings.apodization = few;
+	ok = encode_memory_(&settings, &expect);
+	settings.adaptive_apodization = true;
+	ok = ok && encode_memory_(&settings, &out) && same_output_(&out, &expect);
+	if(ok)
+		printf("OK\n");
 
+	if(ok) {
+		printf("testing that six windows compress within 1%% of trying them all... ");
+		encode_settings_init_(&settings, 2, 8);
+		settings.apodization = many;
+		ok = encode_memory_(&settings, &expect);
+		settings.adaptive_apodization = true;
+		ok = ok && encode_memory_(&settings, &out);
+		if(ok && out.bytes > expect.bytes + expect.bytes / 100) {
+			printf("FAILED, %u bytes instead of at most %u\n", (unsigned)out.bytes, (unsigned)(expect.bytes + expect.bytes / 100));
+			ok = false;
+		}
+		if(ok)
+			printf("OK\n");
+	}
+
+	if(ok) {
+		printf("testing six windows with 0, 1 and 4 threads... ");
+		settings.parallel_subframes = true;
+		settings.parallel_apodizations = true;
+		ok = same_output_for_threads_(&settings, threads, sizeof(threads) / sizeof(threads[0]));
+		if(ok)
+			printf("OK\n");
+	}
+
+	free(expect.data);
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+static FLAC__bool test_stream_encoder_time_budget(void)
+{
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	encode_settings_ settings;
+	FLAC__bool ok;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (time budget)\n\n");
+
+	/* a search that no machine does in 1% of real time, in short frames so the encoder has time to cut it back */
+	encode_settings_init_(&settings, 2, 8);
+	settings.blocksize = 1152;
+	settings.apodization = "tukey(0.5);partial_tukey(2);hann;welch";
+	settings.do_qlp_coeff_prec_search = true;
+
+	printf("testing that the search is cut back to keep to a budget of 1%%... ");
+	ok = encode_memory_(&settings, &expect);
+	settings.time_budget = 1;
+	ok = ok && encode_memory_(&settings, &out);
+	if(ok && out.bytes == expect.bytes && 0 == memcmp(out.data, expect.data, expect.bytes)) {
+		printf("FAILED, the stream is the same as with the full search\n");
+		ok = false;
+	}
+	if(ok)
+		printf("OK\n");
+
+	if(ok) {
+		printf("testing that a budget of 0 does not limit the search... ");
+		settings.time_budget = 0;
+		ok = encode_memory_(&settings, &out) && same_output_(&out, &expect);
+		if(ok)
+			printf("OK\n");
+	}
+
+	free(expect.data);
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+/* for decoding an encoded test signal back out of memory and checking it */
+typedef struct {
+	const memory_output_ *in;
+	size_t position;
+	const encode_settings_ *settings;
+	FLAC__uint64 samples;                             /* decoded so far */
+	unsigned last_blocksize;                          /* of the latest frame, which is left out of min/max_blocksize until the next */
+	unsigned min_blocksize, max_blocksize;
+	unsigned quiet_lpc_subframes;                     /* LPC subframes in frames that are all quiet, see encode_signal_() */
+	unsigned rice_partitions;                         /* Rice coded partitions seen with 'single_partition' */
+	unsigned rice_misses;                             /* of those, how many had a parameter more than one off the best */
+	FLAC__uint64 rice_bits, best_rice_bits;           /* what those partitions take, and what they would with the best parameters */
+	FLAC__StreamMetadata_StreamInfo stream_info;
+	FLAC__bool error;
+} memory_decode_;
+
+static FLAC__StreamDecoderReadStatus memory_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	memory_decode_ *dcd = (memory_decode_*)client_data;
+	(void)decoder;
+	if(dcd->position >= dcd->in->bytes) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	if(*bytes > dcd->in->bytes - dcd->position)
+		*bytes = dcd->in->bytes - dcd->position;
+	memcpy(buffer, dcd->in->data + dcd->position, *bytes);
+	dcd->position += *bytes;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+/* the exact size of 'residual' Rice coded with parameter 'k' */
+static FLAC__uint64 rice_bits_(const FLAC__int32 residual[], unsigned samples, unsigned k)
+{
+	FLAC__uint64 bits = 0;
+	unsigned i;
+	for(i = 0; i < samples; i++) {
+		const FLAC__uint32 u = residual[i] < 0? ((FLAC__uint32)-(residual[i] + 1) << 1) + 1 : (FLAC__uint32)residual[i] << 1;
+		bits += 1 + k + (u >> k);
+	}
+	return bits;
+}
+
+/* checks the single Rice partition of a subframe against the best parameter found by trying them all */
+static void check_rice_partition_(memory_decode_ *dcd, const FLAC__Subframe *subframe, unsigned blocksize)
+{
+	const FLAC__EntropyCodingMethod *method;
+	const FLAC__int32 *residual;
+	unsigned order, k, best_k = 0, limit;
+	FLAC__uint64 bits, best_bits = 0;
+
+	if(subframe->type == FLAC__SUBFRAME_TYPE_FIXED) {
+		method = &subframe->data.fixed.entropy_coding_method;
+		residual = subframe->data.fixed.residual;
+		order = subframe->data.fixed.order;
+	}
+	else if(subframe->type == FLAC__SUBFRAME_TYPE_LPC) {
+		method = &subframe->data.lpc.entropy_coding_method;
+		residual = subframe->data.lpc.residual;
+		order = subframe->data.lpc.order;
+	}
+	else
+		return;
+	limit = method->type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE? FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_ESCAPE_PARAMETER : FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2_ESCAPE_PARAMETER;
+	if(method->data.partitioned_rice.order != 0 || method->data.partitioned_rice.contents->parameters[0] >= limit)
+		return;
+	for(k = 0; k < limit; k++) {
+		bits = rice_bits_(residual, blocksize - order, k);
+		if(k == 0 || bits < best_bits) {
+			best_bits = bits;
+			best_k = k;
+		}
+	}
+	k = method->data.partitioned_rice.contents->parameters[0];
+	dcd->rice_partitions++;
+	if(k + 1 < best_k || k > best_k + 1)
+		dcd->rice_misses++;
+	dcd->rice_bits += rice_bits_(residual, blocksize - order, k);
+	dcd->best_rice_bits += best_bits;
+}
+
+static FLAC__StreamDecoderWriteStatus memory_decoder_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	memory_decode_ *dcd = (memory_decode_*)client_data;
+	unsigned i, channel;
+	(void)decoder;
+	if(frame->header.number.sample_number != dcd->samples) {
+		dcd->error = true;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	for(i = 0; i < frame->header.blocksize; i++) {
+		for(channel = 0; channel < frame->header.channels; channel++) {
+			if(buffer[channel][i] != encode_signal_(dcd->settings, channel, (unsigned)dcd->samples + i)) {
+				dcd->error = true;
+				return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+			}
+		}
+	}
+	if(dcd->last_blocksize > 0) {
+		if(dcd->min_blocksize == 0 || dcd->last_blocksize < dcd->min_blocksize)
+			dcd->min_blocksize = dcd->last_blocksize;
+		if(dcd->last_blocksize > dcd->max_blocksize)
+			dcd->max_blocksize = dcd->last_blocksize;
+	}
+	if(dcd->settings->quiet && dcd->samples >= ENCODE_CHUNK_SAMPLES_) {
+		for(channel = 0; channel < frame->header.channels; channel++) {
+			if(frame->subframes[channel].type == FLAC__SUBFRAME_TYPE_LPC)
+				dcd->quiet_lpc_subframes++;
+		}
+	}
+	if(dcd->settings->single_partition) {
+		for(channel = 0; channel < frame->header.channels; channel++)
+			check_rice_partition_(dcd, &frame->subframes[channel], frame->header.blocksize);
+	}
+	dcd->last_blocksize = frame->header.blocksize;
+	dcd->samples += frame->header.blocksize;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void memory_decoder_metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	memory_decode_ *dcd = (memory_decode_*)client_data;
+	(void)decoder;
+	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO)
+		dcd->stream_info = metadata->data.stream_info;
+}
+
+static void memory_decoder_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	(void)decoder, (void)status;
+	((memory_decode_*)client_data)->error = true;
+}
+
+/* decodes 'in', which must be the test signal encoded with 'settings' */
+static FLAC__bool decode_memory_(const memory_output_ *in, const encode_settings_ *settings, memory_decode_ *dcd)
+{
+	FLAC__StreamDecoder *decoder;
+	FLAC__bool ok;
+
+	memset(dcd, 0, sizeof(*dcd));
+	dcd->in = in;
+	dcd->settings = settings;
+	if(0 == (decoder = FLAC__stream_decoder_new()))
+		return die_("FLAC__stream_decoder_new() returned NULL");
+	ok =
+		FLAC__stream_decoder_set_md5_checking(decoder, true) &&
+		FLAC__stream_decoder_init_stream(decoder, memory_read_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*length_callback=*/0, /*eof_callback=*/0, memory_decoder_write_callback_, memory_decoder_metadata_callback_, memory_decoder_error_callback_, dcd) == FLAC__STREAM_DECODER_INIT_STATUS_OK &&
+		FLAC__stream_decoder_process_until_end_of_stream(decoder) &&
+		FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	if(!ok || dcd->error) {
+		printf("FAILED, the stream does not decode to the signal\n");
+		return false;
+	}
+	if(dcd->samples != (FLAC__uint64)ENCODE_CHUNKS_ * ENCODE_CHUNK_SAMPLES_) {
+		printf("FAILED, decoded %u samples instead of %u\n", (unsigned)dcd->samples, ENCODE_CHUNKS_ * ENCODE_CHUNK_SAMPLES_);
+		return false;
+	}
 	return true;
 }
 
+static FLAC__bool test_stream_encoder_variable_blocksize(void)
+{
+	memory_output_ out = { 0, 0, 0, 0 };
+	memory_decode_ dcd;
+	encode_settings_ settings;
+	FLAC__bool ok;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (variable blocksize)\n\n");
+
+	encode_settings_init_(&settings, 2, 5);
+	settings.blocksize = 4096;
+	settings.variable_blocksize = true;
+	settings.transients = true;
+	settings.seekable = true;
+
+	printf("testing that split blocks verify and decode... ");
+	ok = encode_memory_(&settings, &out) && decode_memory_(&out, &settings, &dcd);
+	if(ok && dcd.min_blocksize == dcd.max_blocksize) {
+		printf("FAILED, no block was split\n");
+		ok = false;
+	}
+	if(ok)
+		printf("OK\n");
+
+	if(ok) {
+		printf("testing that STREAMINFO has the frame sizes used... ");
+		if(dcd.stream_info.min_blocksize != dcd.min_blocksize || dcd.stream_info.max_blocksize != dcd.max_blocksize) {
+			printf("FAILED, %u..%u instead of %u..%u\n", dcd.stream_info.min_blocksize, dcd.stream_info.max_blocksize, dcd.min_blocksize, dcd.max_blocksize);
+			ok = false;
+		}
+		else
+			printf("OK\n");
+	}
+
+	if(ok) {
+		/* without a seek callback the STREAMINFO written up front stays, so it must be a bound on what follows */
+		printf("testing that STREAMINFO bounds the frame sizes when it cannot be rewritten... ");
+		settings.seekable = false;
+		ok = encode_memory_(&settings, &out) && decode_memory_(&out, &settings, &dcd);
+		if(ok && (dcd.stream_info.min_blocksize > dcd.min_blocksize || dcd.stream_info.max_blocksize < dcd.max_blocksize)) {
+			printf("FAILED, %u..%u does not cover %u..%u\n", dcd.stream_info.min_blocksize, dcd.stream_info.max_blocksize, dcd.min_blocksize, dcd.max_blocksize);
+			ok = false;
+		}
+		if(ok)
+			printf("OK\n");
+	}
+
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+/* encodes the test signal 'repeats' times and decodes the result; *ticks is the CPU time the fastest encode took */
+static FLAC__bool encode_timed_(const encode_settings_ *settings, unsigned repeats, memory_output_ *out, memory_decode_ *dcd, clock_t *ticks)
+{
+	clock_t start;
+	unsigned r;
+
+	/* the fastest of a few runs, so that a busy machine is less likely to upset the comparison */
+	for(r = 0; r < repeats; r++) {
+		start = clock();
+		if(!encode_memory_(settings, out))
+			return false;
+		if(r == 0 || clock() - start < *ticks)
+			*ticks = clock() - start;
+	}
+	return decode_memory_(out, settings, dcd);
+}
+
+static FLAC__bool test_stream_encoder_quiet_signal(void)
+{
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	memory_decode_ full, quick;
+	encode_settings_ settings;
+	clock_t full_ticks = 0, quick_ticks = 0;
+	FLAC__bool ok;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (quiet signal)\n\n");
+
+	encode_settings_init_(&settings, 2, 8);
+	settings.quiet = true;
+
+	printf("testing that the full search uses LPC on the quiet part... ");
+	ok = encode_timed_(&settings, 3, &expect, &full, &full_ticks);
+	if(ok && full.quiet_lpc_subframes == 0) {
+		printf("FAILED, no LPC subframes to skip\n");
+		ok = false;
+	}
+	if(ok)
+		printf("OK\n");
+
+	if(ok) {
+		printf("testing that quiet subframes skip LPC... ");
+		settings.quiet_signal_bits = 2;
+		ok = encode_timed_(&settings, 3, &out, &quick, &quick_ticks);
+		if(ok && quick.quiet_lpc_subframes != 0) {
+			printf("FAILED, %u quiet subframes still use LPC\n", quick.quiet_lpc_subframes);
+			ok = false;
+		}
+		if(ok)
+			printf("OK\n");
+	}
+
+	if(ok) {
+		printf("testing that skipping LPC costs at most 3%% in size... ");
+		if(out.bytes * 100 > expect.bytes * 103) {
+			printf("FAILED, %u bytes instead of %u\n", (unsigned)out.bytes, (unsigned)expect.bytes);
+			ok = false;
+		}
+		else
+			printf("OK, %u bytes instead of %u\n", (unsigned)out.bytes, (unsigned)expect.bytes);
+	}
+
+	if(ok) {
+		printf("testing that skipping LPC saves time... ");
+		if(quick_ticks >= full_ticks) {
+			printf("FAILED, %ld clock ticks against %ld for the full search\n", (long)quick_ticks, (long)full_ticks);
+			ok = false;
+		}
+		else
+			printf("OK\n");
+	}
+
+	free(expect.data);
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+static FLAC__bool test_stream_encoder_rice_parameter(void)
+{
+	static const unsigned levels[] = { 0, 5, 8 };
+	memory_output_ out = { 0, 0, 0, 0 };
+	memory_decode_ dcd;
+	encode_settings_ settings;
+	FLAC__bool ok = true;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (Rice parameter)\n\n");
+
+	for(i = 0; ok && i < sizeof(levels) / sizeof(levels[0]); i++) {
+		printf("testing single-partition Rice parameters at level %u against trying them all... ", levels[i]);
+		encode_settings_init_(&settings, 2, levels[i]);
+		settings.single_partition = true;
+		ok = encode_memory_(&settings, &out) && decode_memory_(&out, &settings, &dcd);
+		if(ok && dcd.rice_partitions == 0) {
+			printf("FAILED, no Rice partitions to check\n");
+			ok = false;
+		}
+		if(ok && dcd.rice_misses > 0) {
+			printf("FAILED, %u of %u parameters are more than one off the best\n", dcd.rice_misses, dcd.rice_partitions);
+			ok = false;
+		}
+		/* the parameter comes from the sum of the residual, which cannot see how it is spread; that costs a little */
+		if(ok && dcd.rice_bits * 1000 > dcd.best_rice_bits * 1005) {
+			printf("FAILED, %u bits instead of %u\n", (unsigned)dcd.rice_bits, (unsigned)dcd.best_rice_bits);
+			ok = false;
+		}
+		if(ok)
+			printf("OK, %u partitions in %u bits, %u with the best parameters\n", dcd.rice_partitions, (unsigned)dcd.rice_bits, (unsigned)dcd.best_rice_bits);
+	}
+
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+static FLAC__bool test_stream_encoder_write_buffer(void)
+{
+	/* smaller than one write, about one frame, and the whole stream */
+	static const unsigned write_buffer_sizes[] = { 1, 100, 4096, 1u << 20 };
+	const char *filename = flacfilename(/*is_ogg=*/false);
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	memory_decode_ dcd;
+	encode_settings_ settings;
+	FLAC__bool ok;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (write buffer)\n\n");
+
+	encode_settings_init_(&settings, 2, 5);
+
+	printf("testing an unbuffered file with a SEEKTABLE... ");
+	ok = encode_file_(&settings, filename, &expect) && decode_memory_(&expect, &settings, &dcd);
+	if(ok)
+		printf("OK\n");
+
+	for(i = 0; ok && i < sizeof(write_buffer_sizes) / sizeof(write_buffer_sizes[0]); i++) {
+		printf("testing that a %u byte write buffer gives the same file... ", write_buffer_sizes[i]);
+		settings.write_buffer_size = write_buffer_sizes[i];
+		ok = encode_file_(&settings, filename, &out) && same_output_(&out, &expect);
+		if(ok)
+			printf("OK\n");
+	}
+
+	free(expect.data);
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
+/* whether FLAC__stream_encoder_set_async_write() can take effect here, tried on a file at 'filename' */
+static FLAC__bool async_write_available_(const char *filename)
+{
+	FLAC__UringWriter *writer;
+	FILE *file;
+
+	if(0 == (file = fopen(filename, "wb")))
+		return false;
+	if(0 != (writer = FLAC__uring_writer_new(fileno(file), 0, 1, 4096)))
+		FLAC__uring_writer_delete(writer);
+	fclose(file);
+	return 0 != writer;
+}
+
+static FLAC__bool test_stream_encoder_async_write(void)
+{
+	/* 0 gets a megabyte, which holds the whole stream; the others go round all the buffers, ending at odd offsets */
+	static const unsigned write_buffer_sizes[] = { 0, 100, 4096 };
+	const char *filename = flacfilename(/*is_ogg=*/false);
+	memory_output_ expect = { 0, 0, 0, 0 }, out = { 0, 0, 0, 0 };
+	encode_settings_ settings;
+	FLAC__bool ok;
+	unsigned i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (async write)\n\n");
+
+	if(!async_write_available_(filename)) {
+		printf("io_uring is not available here, nothing to test\n");
+		printf("\nPASSED!\n");
+		return true;
+	}
+
+	encode_settings_init_(&settings, 2, 5);
+	ok = encode_file_(&settings, filename, &expect);
+
+	settings.async_write = true;
+	for(i = 0; ok && i < sizeof(write_buffer_sizes) / sizeof(write_buffer_sizes[0]); i++) {
+		/* the frames go through io_uring, then STREAMINFO and SEEKTABLE are rewritten through stdio */
+		printf("testing that async writes with a write buffer size of %u give the same file... ", write_buffer_sizes[i]);
+		settings.write_buffer_size = write_buffer_sizes[i];
+		ok = encode_file_(&settings, filename, &out) && same_output_(&out, &expect);
+		if(ok)
+			printf("OK\n");
+	}
+
+	free(expect.data);
+	free(out.data);
+	if(ok)
+		printf("\nPASSED!\n");
+	return ok;
+}
+
 FLAC__bool test_encoders(void)
 {
 	FLAC__bool is_ogg = false;
@@ -508,8 +1780,51 @@ FLAC__bool test_encoders(void)
 		if(!test_stream_encoder(LAYER_FILENAME, is_ogg))
 			return false;
 
+		if(!is_ogg && !test_stream_encoder_reuse())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_workspace_bytes())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_shared_pool())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_parallel_subframes())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_parallel_apodizations())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_prune_model_search())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_adaptive_apodization())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_time_budget())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_variable_blocksize())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_quiet_signal())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_rice_parameter())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_write_buffer())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_async_write())
+			return false;
+
 		(void) grabbag__file_remove_file(flacfilename(is_ogg));
 
+		free(frame_buffer_);
+		frame_buffer_ = 0;
+		frame_buffer_size_ = 0;
+
 		free_metadata_blocks_();
 
 		if(!FLAC_API_SUPPORTS_OGG_FLAC || is_ogg)
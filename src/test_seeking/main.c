@@ -264,7 +264,7 @@ static void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDeco
  * 1 - read 2 frames
  * 2 - read until end
  */
-static FLAC__bool seek_barrage(FLAC__bool is_ogg, const char *filename, off_t filesize, unsigned count, FLAC__int64 total_samples, unsigned read_mode, FLAC__int32 **pcm)
+static FLAC__bool seek_barrage(FLAC__bool is_ogg, const char *filename, off_t filesize, unsigned count, FLAC__int64 total_samples, unsigned read_mode, unsigned read_size, FLAC__int32 **pcm)
 {
 	FLAC__StreamDecoder *decoder;
 	DecoderClientData decoder_client_data;
@@ -278,12 +278,15 @@ static FLAC__bool seek_barrage(FLAC__bool is_ogg, const char *filename, off_t fi
 	decoder_client_data.ignore_errors = false;
 	decoder_client_data.error_occurred = false;
 
-	printf("\n+++ seek test: FLAC__StreamDecoder (%s FLAC, read_mode=%u)\n\n", is_ogg? "Ogg":"native", read_mode);
+	printf("\n+++ seek test: FLAC__StreamDecoder (%s FLAC, read_mode=%u, read_size=%u)\n\n", is_ogg? "Ogg":"native", read_mode, read_size);
 
 	decoder = FLAC__stream_decoder_new();
 	if(0 == decoder)
 		return die_("FLAC__stream_decoder_new() FAILED, returned NULL\n");
 
+	if(!FLAC__stream_decoder_set_read_size(decoder, read_size))
+		return die_s_("FLAC__stream_decoder_set_read_size() FAILED", decoder);
+
 	if(is_ogg) {
 		if(FLAC__stream_decoder_init_ogg_file(decoder, filename, write_callback_, metadata_callback_, error_callback_, &decoder_client_data) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
 			return die_s_("FLAC__stream_decoder_init_file() FAILED", decoder);
@@ -417,7 +420,7 @@ static FLAC__uint64 local__strtoull(const char *src)
 int main(int argc, char *argv[])
 {
 	const char *flacfilename, *rawfilename = 0;
-	unsigned count = 0, read_mode;
+	unsigned count = 0, pass;
 	FLAC__int64 samples = -1;
 	off_t flacfilesize;
 	FLAC__int32 *pcm[2] = { 0, 0 };
@@ -474,20 +477,23 @@ int main(int argc, char *argv[])
 
 	(void) signal(SIGINT, our_sigint_handler_);
 
-	for (read_mode = 0; ok && read_mode <= 2; read_mode++) {
+	for (pass = 0; ok && pass <= 3; pass++) {
+		/* the last pass is read_mode 1 again through the pread() file reader, in small blocks so the seeks cross them */
+		const unsigned read_mode = pass < 3? pass : 1;
+		const unsigned read_size = pass < 3? 0 : 8192;
 		/* no need to do "decode all" read_mode if PCM checking is available */
 		if (rawfilename && read_mode > 1)
 			continue;
 		if (strlen(flacfilename) > 4 && (0 == strcmp(flacfilename+strlen(flacfilename)-4, ".oga") || 0 == strcmp(flacfilename+strlen(flacfilename)-4, ".ogg"))) {
 #if FLAC__HAS_OGG
-			ok = seek_barrage(/*is_ogg=*/true, flacfilename, flacfilesize, count, samples, read_mode, rawfilename? pcm : 0);
+			ok = seek_barrage(/*is_ogg=*/true, flacfilename, flacfilesize, count, samples, read_mode, read_size, rawfilename? pcm : 0);
 #else
 			fprintf(stderr, "ERROR: Ogg FLAC not supported\n");
 			ok = false;
 #endif
 		}
 		else {
-			ok = seek_barrage(/*is_ogg=*/false, flacfilename, flacfilesize, count, samples, read_mode, rawfilename? pcm : 0);
+			ok = seek_barrage(/*is_ogg=*/false, flacfilename, flacfilesize, count, samples, read_mode, read_size, rawfilename? pcm : 0);
 		}
 	}
 